@@ -0,0 +1,248 @@
+#include "BenchmarkScenes.h"
+#include "SimdKernels.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+
+namespace {
+
+    const double SUBSTEP_TIME = 1.0 / 60;
+
+    void phaseArguments(benchmark::internal::Benchmark* benchmark)
+    {
+        benchmark->ArgName("particles");
+        for (long long particles : { 1000, 10000, 100000, 1000000 }) benchmark->Arg(particles);
+        benchmark->Unit(benchmark::kMicrosecond);
+    }
+
+    /**
+     * Selects the SIMD level of a benchmark's second argument, skipping levels the CPU lacks.
+     *
+     * @param supported Set to false if the CPU lacks the level and the benchmark was skipped.
+     * @return The level to restore once the benchmark finishes.
+     */
+    VerletPhysics::SimdLevel selectSimdLevel(benchmark::State& state, bool& supported)
+    {
+        const VerletPhysics::SimdLevel previous = VerletPhysics::SimdKernels::getSimdLevel();
+        VerletPhysics::SimdKernels::setSimdLevel(static_cast<VerletPhysics::SimdLevel>(state.range(1)));
+
+        supported = VerletPhysics::SimdKernels::getSimdLevel() == static_cast<VerletPhysics::SimdLevel>(state.range(1));
+        if (!supported) {
+            VerletPhysics::SimdKernels::setSimdLevel(previous);
+            state.SkipWithError("SIMD level not supported by this CPU");
+        }
+        return previous;
+    }
+
+    void BM_PhaseGenerators(benchmark::State& state)
+    {
+        BenchmarkScenes::Scene scene = BenchmarkScenes::buildBallpit(state.range(0), 1);
+
+        for (auto _ : state) {
+            scene.world->applyGenerators();
+        }
+        state.SetItemsProcessed(state.iterations() * scene.world->getParticleCount());
+    }
+
+    void BM_PhaseFieldGeneratorsSimdLevel(benchmark::State& state)
+    {
+        bool supported;
+        const VerletPhysics::SimdLevel previous = selectSimdLevel(state, supported);
+        if (!supported) return;
+
+        // Gravity, drag and an attractor acting on every particle, all streamed through the batch kernels
+        BenchmarkScenes::Scene scene = BenchmarkScenes::buildBallpit(state.range(0), 1);
+        VerletPhysics::ParticleStore& particles = scene.world->getParticles();
+        scene.world->emplaceGenerator<VerletPhysics::DragForce>(0.1)->subscribeAllParticles(particles);
+        scene.world->emplaceGenerator<VerletPhysics::RadialAttractor>(VerletPhysics::Vector2(0, 0), 1000.0, 10.0)->subscribeAllParticles(particles);
+
+        for (auto _ : state) {
+            scene.world->applyGenerators();
+        }
+        state.SetItemsProcessed(state.iterations() * scene.world->getParticleCount());
+
+        VerletPhysics::SimdKernels::setSimdLevel(previous);
+    }
+
+    void BM_PhaseNBodyGravity(benchmark::State& state)
+    {
+        // Every particle attracts every other through the Barnes-Hut tree, rebuilt on every pass
+        BenchmarkScenes::Scene scene = BenchmarkScenes::buildBallpit(state.range(0), 1);
+        scene.world->emplaceGenerator<VerletPhysics::NBodyGravity>(1.0, state.range(1) / 10.0, 2.0)->subscribeAllParticles(scene.world->getParticles());
+
+        for (auto _ : state) {
+            scene.world->applyGenerators();
+        }
+        state.SetItemsProcessed(state.iterations() * scene.world->getParticleCount());
+    }
+
+    void BM_PhaseIntegrate(benchmark::State& state)
+    {
+        BenchmarkScenes::Scene scene = BenchmarkScenes::buildBallpit(state.range(0), 1);
+
+        for (auto _ : state) {
+            scene.world->integrateParticles(SUBSTEP_TIME);
+        }
+        state.SetItemsProcessed(state.iterations() * scene.world->getParticleCount());
+    }
+
+    void BM_PhaseIntegrateSimdLevel(benchmark::State& state)
+    {
+        bool supported;
+        const VerletPhysics::SimdLevel previous = selectSimdLevel(state, supported);
+        if (!supported) return;
+
+        BenchmarkScenes::Scene scene = BenchmarkScenes::buildBallpit(state.range(0), 1);
+
+        for (auto _ : state) {
+            scene.world->integrateParticles(SUBSTEP_TIME);
+        }
+        state.SetItemsProcessed(state.iterations() * scene.world->getParticleCount());
+
+        VerletPhysics::SimdKernels::setSimdLevel(previous);
+    }
+
+    void BM_PhaseBoxSimdLevel(benchmark::State& state)
+    {
+        bool supported;
+        const VerletPhysics::SimdLevel previous = selectSimdLevel(state, supported);
+        if (!supported) return;
+
+        // The ballpit's only constraint is the box every particle is subscribed to
+        BenchmarkScenes::Scene scene = BenchmarkScenes::buildBallpit(state.range(0), 1);
+        for (int i = 0; i < 30; i++) scene.world->update(SUBSTEP_TIME);
+
+        for (auto _ : state) {
+            scene.world->solveConstraints();
+        }
+        state.SetItemsProcessed(state.iterations() * scene.world->getParticleCount());
+
+        VerletPhysics::SimdKernels::setSimdLevel(previous);
+    }
+
+    void BM_PhaseCircleSimdLevel(benchmark::State& state)
+    {
+        bool supported;
+        const VerletPhysics::SimdLevel previous = selectSimdLevel(state, supported);
+        if (!supported) return;
+
+        // Particles spread over a disc, with a few percent pressed against its rim
+        const size_t particleCount = static_cast<size_t>(state.range(0));
+        const double arenaRadius = 20 * std::sqrt(static_cast<double>(particleCount));
+
+        VerletPhysics::SimulationWorld world(1, false, 1);
+        VerletPhysics::EncircledPositionConstraint* circle = world.emplaceConstraint<VerletPhysics::EncircledPositionConstraint>(arenaRadius, VerletPhysics::Vector2(0, 0));
+
+        for (size_t i = 0; i < particleCount; i++) {
+            const double angle = i * 2.399963;
+            const double distance = arenaRadius * std::sqrt((i + 0.5) / particleCount) * 1.01;
+            circle->subscribeParticle(world.addParticle(VerletPhysics::Vector2(distance * std::cos(angle), distance * std::sin(angle)), 5));
+        }
+
+        for (auto _ : state) {
+            world.solveConstraints();
+        }
+        state.SetItemsProcessed(state.iterations() * particleCount);
+
+        VerletPhysics::SimdKernels::setSimdLevel(previous);
+    }
+
+    void BM_PhaseCollisions(benchmark::State& state)
+    {
+        BenchmarkScenes::Scene scene = BenchmarkScenes::buildBallpit(state.range(0), 1);
+
+        // Let the pile settle into contact so the narrow phase has work to do
+        for (int i = 0; i < 30; i++) scene.world->update(SUBSTEP_TIME);
+
+        for (auto _ : state) {
+            scene.world->handleCollisions();
+        }
+        state.SetItemsProcessed(state.iterations() * scene.world->getParticleCount());
+    }
+
+    void BM_PhaseCollisionsSorted(benchmark::State& state)
+    {
+        // Particles added in random order, measured as added and after a Morton sort
+        BenchmarkScenes::Scene scene = BenchmarkScenes::buildBallpit(state.range(0), 1, true);
+        for (int i = 0; i < 30; i++) scene.world->update(SUBSTEP_TIME);
+        if (state.range(1)) scene.world->sortParticles();
+
+        for (auto _ : state) {
+            scene.world->handleCollisions();
+        }
+        state.SetItemsProcessed(state.iterations() * scene.world->getParticleCount());
+    }
+
+    void BM_PhaseContinuousCollisions(benchmark::State& state)
+    {
+        BenchmarkScenes::Scene scene = BenchmarkScenes::buildBallpit(state.range(0), 1);
+        for (int i = 0; i < 30; i++) scene.world->update(SUBSTEP_TIME);
+
+        // Fling every hundredth particle several radii into the pile so the sweep has paths to check
+        VerletPhysics::ParticleStore& particles = scene.world->getParticles();
+        for (size_t i = 0; i < particles.size(); i += 100) particles.previousY()[i] = particles.positionY()[i] - particles.radius()[i] * 4;
+        scene.world->setContinuousCollisionsEnabled(true);
+
+        for (auto _ : state) {
+            scene.world->handleCollisions();
+        }
+        state.SetItemsProcessed(state.iterations() * scene.world->getParticleCount());
+    }
+
+    // Both broad phases on similar radii and on widely mixed ones; the grid is too slow for a million mixed particles
+    void broadPhaseArguments(benchmark::internal::Benchmark* benchmark)
+    {
+        benchmark->ArgNames({ "particles", "broadphase", "mixed" });
+        for (long long mixed : { 0, 1 }) {
+            for (long long particles : { 1000, 10000, 100000, 1000000 }) {
+                if (mixed && particles > 100000) continue;
+                for (long long broadPhase : { 0, 1 }) benchmark->Args({ particles, broadPhase, mixed });
+            }
+        }
+        benchmark->Unit(benchmark::kMicrosecond);
+    }
+
+    void BM_PhaseBroadPhase(benchmark::State& state)
+    {
+        BenchmarkScenes::Scene scene = state.range(2)
+            ? BenchmarkScenes::buildGravel(state.range(0), 1)
+            : BenchmarkScenes::buildBallpit(state.range(0), 1);
+
+        // Settle with sweep and prune, which handles both scenes quickly, then measure the selected strategy
+        scene.world->setBroadPhase(VerletPhysics::BroadPhase::SweepAndPrune);
+        for (int i = 0; i < 30; i++) scene.world->update(SUBSTEP_TIME);
+        scene.world->setBroadPhase(static_cast<VerletPhysics::BroadPhase>(state.range(1)));
+
+        for (auto _ : state) {
+            scene.world->handleCollisions();
+        }
+        state.SetItemsProcessed(state.iterations() * scene.world->getParticleCount());
+    }
+
+    void BM_PhaseConstraints(benchmark::State& state)
+    {
+        BenchmarkScenes::Scene scene = BenchmarkScenes::buildCloth(state.range(0), 1);
+
+        // Stretch the cloth so every link is being corrected
+        for (int i = 0; i < 10; i++) scene.world->update(SUBSTEP_TIME);
+
+        for (auto _ : state) {
+            scene.world->solveConstraints();
+        }
+        state.SetItemsProcessed(state.iterations() * scene.constraintCount);
+    }
+}
+
+BENCHMARK(BM_PhaseGenerators)->Apply(phaseArguments);
+BENCHMARK(BM_PhaseFieldGeneratorsSimdLevel)->ArgNames({ "particles", "level" })->ArgsProduct({ { 100000 }, { 0, 1, 2 } })->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_PhaseNBodyGravity)->ArgNames({ "particles", "angle_x10" })->ArgsProduct({ { 10000, 100000 }, { 5, 7 } })->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_PhaseIntegrate)->Apply(phaseArguments);
+BENCHMARK(BM_PhaseIntegrateSimdLevel)->ArgNames({ "particles", "level" })->ArgsProduct({ { 100000 }, { 0, 1, 2 } })->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_PhaseBoxSimdLevel)->ArgNames({ "particles", "level" })->ArgsProduct({ { 100000 }, { 0, 1, 2 } })->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_PhaseCircleSimdLevel)->ArgNames({ "particles", "level" })->ArgsProduct({ { 100000 }, { 0, 1, 2 } })->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_PhaseCollisions)->Apply(phaseArguments);
+BENCHMARK(BM_PhaseCollisionsSorted)->ArgNames({ "particles", "sorted" })->ArgsProduct({ { 10000, 100000, 1000000 }, { 0, 1 } })->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_PhaseContinuousCollisions)->Apply(phaseArguments);
+BENCHMARK(BM_PhaseBroadPhase)->Apply(broadPhaseArguments);
+BENCHMARK(BM_PhaseConstraints)->Apply(phaseArguments);
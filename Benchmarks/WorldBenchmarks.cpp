@@ -0,0 +1,88 @@
+#include "BenchmarkScenes.h"
+
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <deque>
+#include <thread>
+#include <vector>
+
+namespace {
+
+    const double FRAME_TIME = 1.0 / 60;
+
+    // Particle counts from 1k to 1M, single threaded and on every hardware thread
+    void sceneArguments(benchmark::internal::Benchmark* benchmark)
+    {
+        const long long hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+
+        benchmark->ArgNames({ "particles", "threads" });
+        for (long long particles : { 1000, 10000, 100000, 1000000 }) {
+            benchmark->Args({ particles, 1 });
+            if (hardwareThreads > 1) benchmark->Args({ particles, hardwareThreads });
+        }
+        benchmark->Unit(benchmark::kMillisecond);
+    }
+
+    // Throughput is reported as particle-substeps per second
+    void runUpdates(benchmark::State& state, BenchmarkScenes::Scene& scene)
+    {
+        for (auto _ : state) {
+            scene.world->update(FRAME_TIME);
+        }
+        state.SetItemsProcessed(state.iterations() * scene.world->getParticleCount() * scene.steps);
+    }
+
+    void BM_BallpitUpdate(benchmark::State& state)
+    {
+        BenchmarkScenes::Scene scene = BenchmarkScenes::buildBallpit(state.range(0), state.range(1));
+        runUpdates(state, scene);
+    }
+
+    void BM_ClothUpdate(benchmark::State& state)
+    {
+        BenchmarkScenes::Scene scene = BenchmarkScenes::buildCloth(state.range(0), state.range(1));
+        runUpdates(state, scene);
+    }
+
+    void BM_PendulumChainUpdate(benchmark::State& state)
+    {
+        BenchmarkScenes::Scene scene = BenchmarkScenes::buildPendulumChains(state.range(0), state.range(1));
+        runUpdates(state, scene);
+    }
+
+    void BM_ParticleChurn(benchmark::State& state)
+    {
+        // An emitter replacing a hundredth of the ballpit every frame, oldest particles first
+        BenchmarkScenes::Scene scene = BenchmarkScenes::buildBallpit(state.range(0), 1);
+        VerletPhysics::ParticleStore& particles = scene.world->getParticles();
+        const size_t batch = std::max<size_t>(particles.size() / 100, 1);
+
+        std::deque<VerletPhysics::Particle*> alive;
+        for (size_t i = 0; i < particles.size(); i++) alive.push_back(particles.getHandle(i));
+
+        std::vector<VerletPhysics::Vector2> positions;
+        std::vector<VerletPhysics::Real> radii;
+        for (size_t i = 0; i < batch; i++) {
+            positions.push_back(alive[i]->getPosition());
+            radii.push_back(alive[i]->getRadius());
+        }
+
+        std::vector<VerletPhysics::Particle*> dying;
+        std::vector<VerletPhysics::Particle*> born;
+        for (auto _ : state) {
+            dying.assign(alive.begin(), alive.begin() + batch);
+            alive.erase(alive.begin(), alive.begin() + batch);
+            scene.world->removeParticles(dying);
+
+            born.clear();
+            scene.world->addParticles(positions, radii, born);
+            alive.insert(alive.end(), born.begin(), born.end());
+        }
+        state.SetItemsProcessed(state.iterations() * batch);
+    }
+}
+
+BENCHMARK(BM_BallpitUpdate)->Apply(sceneArguments);
+BENCHMARK(BM_ClothUpdate)->Apply(sceneArguments);
+BENCHMARK(BM_PendulumChainUpdate)->Apply(sceneArguments);
+BENCHMARK(BM_ParticleChurn)->ArgName("particles")->Arg(10000)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMicrosecond);
@@ -3,6 +3,7 @@
 #include "Contraint.h"
 #include "ForceGeneration.h"
 #include "Particle.h"
+#include "FixedStepper.h"
 
 #include "DemoDisplayer.h"
 
@@ -18,6 +19,11 @@ namespace BallpitDemo {
     VerletPhysics::ConstantAcceleration gravity = VerletPhysics::ConstantAcceleration(VerletPhysics::Vector2(0, 98.1));
     VerletPhysics::BoxedPositionConstraint worldBox = VerletPhysics::BoxedPositionConstraint(VerletPhysics::Vector2(10, 10), VerletPhysics::Vector2(990, 690));
 
+    // physics runs at a fixed 60 Hz on its own thread, the window draws in between
+    VerletPhysics::FixedStepper stepper = VerletPhysics::FixedStepper(simulation, 1.0 / 60);
+    std::vector<VerletPhysics::Real> renderX;
+    std::vector<VerletPhysics::Real> renderY;
+
     DemoDisplayer displayer = DemoDisplayer();
     std::vector<const VerletPhysics::Particle*> particles;
 
@@ -26,9 +32,9 @@ namespace BallpitDemo {
     void click(sf::Vector2i mousePosition)
     {
         // Create a new circle body with random properties
+        auto lock = stepper.lockWorld();
         VerletPhysics::Particle* p = simulation.addParticle(VerletPhysics::Vector2(mousePosition.x, mousePosition.y), sizeDistribution(gen));
 
-        gravity.subscribeParticle(p);
         worldBox.subscribeParticle(p);
 
         particles.push_back(p);
@@ -36,8 +42,11 @@ namespace BallpitDemo {
 
     void update(double deltaTime)
     {
-        simulation.update(deltaTime);
-        for (const VerletPhysics::Particle* p : particles) displayer.drawParticle(p);
+        stepper.readInterpolatedPositions(renderX, renderY);
+        for (const VerletPhysics::Particle* p : particles) {
+            const size_t i = p->getIndex();
+            if (i < renderX.size()) displayer.drawParticle(VerletPhysics::Vector2(renderX[i], renderY[i]), p->getRadius());
+        }
     }
 
     void runDemo()
@@ -46,9 +55,12 @@ namespace BallpitDemo {
         displayer.duringUpdate = update;
 
         simulation.addConstraint(&worldBox);
+        gravity.subscribeAllParticles(simulation.getParticles());
         simulation.addGenerator(&gravity);
 
+        stepper.start();
         displayer.loop();
+        stepper.stop();
     }
 
 };
@@ -3,6 +3,7 @@
 #include "Contraint.h"
 #include "ForceGeneration.h"
 #include "Particle.h"
+#include "FixedStepper.h"
 
 #include "DemoDisplayer.h"
 #include "ClothSimDemo.h"
@@ -15,6 +16,11 @@ namespace ClothSimDemo
     VerletPhysics::SimulationWorld simulation = VerletPhysics::SimulationWorld(3, true);
     VerletPhysics::ConstantAcceleration gravity = VerletPhysics::ConstantAcceleration(VerletPhysics::Vector2(0, 150));
 
+    // cloth is stepped at a fixed rate on the render thread, so tearing a link behaves the same at any frame rate
+    VerletPhysics::FixedStepper stepper = VerletPhysics::FixedStepper(simulation, 1.0 / 60);
+    std::vector<VerletPhysics::Real> renderX;
+    std::vector<VerletPhysics::Real> renderY;
+
     DemoDisplayer displayer = DemoDisplayer();
     const int ROWS = 10;
     const int COLUMNS = 20;
@@ -23,54 +29,33 @@ namespace ClothSimDemo
 
     std::vector<const VerletPhysics::PairedParticleConstraint*> ppConstraints;
 
-    bool isPointIntersectingLineSegment(double x, double y, double x1, double y1, double x2, double y2, double leeway) {
-        // Check if the point is within the bounding box of the extended line segment
-        double minX = std::min(x1, x2) - leeway;
-        double minY = std::min(y1, y2) - leeway;
-        double maxX = std::max(x1, x2) + leeway;
-        double maxY = std::max(y1, y2) + leeway;
-
-        if (x < minX || x > maxX || y < minY || y > maxY) {
-            return false; // The point is outside the bounding box
-        }
-
-        // Calculate the distance from the point to the line defined by the line segment
-        double distance = std::abs((x2 - x1) * (y1 - y) - (x1 - x) * (y2 - y1)) /
-            std::sqrt((x2 - x1) * (x2 - x1) + (y2 - y1) * (y2 - y1));
-
-        return distance <= leeway;
-    }
+    std::vector<VerletPhysics::PairedParticleConstraint*> clickedConstraints;
 
     void click(sf::Vector2i mousePosition)
     {
-        for (size_t i = 0; i < ppConstraints.size(); i++)
-        {
-            if (!((VerletPhysics::Constraint*)ppConstraints[i])->isEnabled()) continue;
-            
-            double x = mousePosition.x;
-            double y = mousePosition.y;
+        VerletPhysics::Vector2 point = VerletPhysics::Vector2(mousePosition.x, mousePosition.y);
+        double leeway = 5;
 
-            double x1 = ppConstraints[i]->getParticleA()->getPosition().x();
-            double y1 = ppConstraints[i]->getParticleA()->getPosition().y();
+        simulation.queryConstraints(point, point, leeway, clickedConstraints);
+        if (clickedConstraints.empty()) return;
 
-            double x2 = ppConstraints[i]->getParticleB()->getPosition().x();
-            double y2 = ppConstraints[i]->getParticleB()->getPosition().y();
-
-            double leeway = 5;
-            
-            if (!isPointIntersectingLineSegment(x, y, x1, y1, x2, y2, leeway)) continue;
+        clickedConstraints.front()->disable();
+    }
 
-            ((VerletPhysics::Constraint*)ppConstraints[i])->disable();
-            return;
-        }
+    VerletPhysics::Vector2 renderPosition(const VerletPhysics::Particle* p)
+    {
+        return VerletPhysics::Vector2(renderX[p->getIndex()], renderY[p->getIndex()]);
     }
 
     void update(double deltaTime)
     {
-        simulation.update(deltaTime);
+        stepper.advance(deltaTime);
+        stepper.readInterpolatedPositions(renderX, renderY);
 
-        for (const VerletPhysics::PairedParticleConstraint* c : ppConstraints) displayer.drawPairedParticleConstraint(c);
-        for (size_t i = 0; i < ROWS; i++) for (size_t j = 0; j < COLUMNS; j++) displayer.drawParticle(particles[i][j]);
+        for (const VerletPhysics::PairedParticleConstraint* c : ppConstraints) {
+            if (((VerletPhysics::Constraint*)c)->isEnabled()) displayer.drawLine(renderPosition(c->getParticleA()), renderPosition(c->getParticleB()));
+        }
+        for (size_t i = 0; i < ROWS; i++) for (size_t j = 0; j < COLUMNS; j++) displayer.drawParticle(renderPosition(particles[i][j]), particles[i][j]->getRadius());
     }
 
     void generateCloth()
@@ -107,8 +92,7 @@ namespace ClothSimDemo
 
                 for (VerletPhysics::Particle* p : neighbors)
                 {
-                    VerletPhysics::PairedParticleConstraint* ppConstraint = new VerletPhysics::PairedParticleConstraint(particles[i][j], p, maxDistance);
-                    simulation.addConstraint(ppConstraint);
+                    VerletPhysics::PairedParticleConstraint* ppConstraint = simulation.emplaceConstraint<VerletPhysics::PairedParticleConstraint>(particles[i][j], p, maxDistance);
                     ppConstraints.push_back(ppConstraint);
                 }
             }
@@ -125,6 +109,10 @@ namespace ClothSimDemo
 
         simulation.addGenerator(&gravity);
 
+        // A resting cloth needs a single substep, a torn or swinging one up to the original three
+        simulation.setSubstepRange(1, 3);
+        simulation.setAdaptiveSubstepsEnabled(true);
+
         generateCloth();
         int t = 4;
         displayer.loop();
@@ -38,10 +38,14 @@ void DemoDisplayer::loop()
 
 void DemoDisplayer::drawParticle(const VerletPhysics::Particle* p)
 {
-    double r = p->getRadius();
-    sf::CircleShape circle(r);
+    drawParticle(p->getPosition(), p->getRadius());
+}
+
+void DemoDisplayer::drawParticle(VerletPhysics::Vector2 position, double radius)
+{
+    sf::CircleShape circle(radius);
 
-    circle.setPosition(p->getPosition().x() - r, p->getPosition().y() - r);
+    circle.setPosition(position.x() - radius, position.y() - radius);
 
     circle.setFillColor(sf::Color::Red);
     circle.setOutlineColor(sf::Color::White);
@@ -54,8 +58,13 @@ void DemoDisplayer::drawPairedParticleConstraint(const VerletPhysics::PairedPart
 {
     if (!((VerletPhysics::Constraint*)c)->isEnabled()) return;
     
-    sf::Vector2f point1(c->getParticleA()->getPosition().x(), c->getParticleA()->getPosition().y());
-    sf::Vector2f point2(c->getParticleB()->getPosition().x(), c->getParticleB()->getPosition().y());
+    drawLine(c->getParticleA()->getPosition(), c->getParticleB()->getPosition());
+}
+
+void DemoDisplayer::drawLine(VerletPhysics::Vector2 from, VerletPhysics::Vector2 to)
+{
+    sf::Vector2f point1(from.x(), from.y());
+    sf::Vector2f point2(to.x(), to.y());
     
     // Create a vertex array for the line
     sf::VertexArray line(sf::Lines, 2);
@@ -16,7 +16,9 @@ struct DemoDisplayer
     void loop();
 
     void drawParticle(const VerletPhysics::Particle* p);
+    void drawParticle(VerletPhysics::Vector2 position, double radius);
     void drawPairedParticleConstraint(const VerletPhysics::PairedParticleConstraint* c);
+    void drawLine(VerletPhysics::Vector2 from, VerletPhysics::Vector2 to);
 };
 
 
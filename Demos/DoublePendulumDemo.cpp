@@ -3,6 +3,7 @@
 #include "Contraint.h"
 #include "ForceGeneration.h"
 #include "Particle.h"
+#include "FixedStepper.h"
 
 #include "DemoDisplayer.h"
 
@@ -13,6 +14,11 @@ namespace DoublePendulumDemo {
     VerletPhysics::SimulationWorld simulation = VerletPhysics::SimulationWorld(10, false);
     VerletPhysics::ConstantAcceleration gravity = VerletPhysics::ConstantAcceleration(VerletPhysics::Vector2(0, 98.1));
 
+    // fixed steps keep the chaotic swing reproducible; drawing blends the last two steps
+    VerletPhysics::FixedStepper stepper = VerletPhysics::FixedStepper(simulation, 1.0 / 60);
+    std::vector<VerletPhysics::Real> renderX;
+    std::vector<VerletPhysics::Real> renderY;
+
     DemoDisplayer displayer = DemoDisplayer();
     std::vector<const VerletPhysics::Particle*> particles;
     std::vector<const VerletPhysics::PairedParticleConstraint*> ppConstraints;
@@ -21,12 +27,18 @@ namespace DoublePendulumDemo {
     {
     }
 
+    VerletPhysics::Vector2 renderPosition(const VerletPhysics::Particle* p)
+    {
+        return VerletPhysics::Vector2(renderX[p->getIndex()], renderY[p->getIndex()]);
+    }
+
     void update(double deltaTime)
     {
-        simulation.update(deltaTime);
+        stepper.advance(deltaTime);
+        stepper.readInterpolatedPositions(renderX, renderY);
 
-        for (const VerletPhysics::PairedParticleConstraint* c : ppConstraints) displayer.drawPairedParticleConstraint(c);
-        for (const VerletPhysics::Particle* p : particles) displayer.drawParticle(p);
+        for (const VerletPhysics::PairedParticleConstraint* c : ppConstraints) displayer.drawLine(renderPosition(c->getParticleA()), renderPosition(c->getParticleB()));
+        for (const VerletPhysics::Particle* p : particles) displayer.drawParticle(renderPosition(p), p->getRadius());
     }
 
     void runDemo()
@@ -39,6 +51,10 @@ namespace DoublePendulumDemo {
 
         simulation.addGenerator(&gravity);
 
+        // Fast swings get up to the original ten substeps, slow ones far fewer
+        simulation.setSubstepRange(2, 10);
+        simulation.setAdaptiveSubstepsEnabled(true);
+
         VerletPhysics::Particle* anchor = simulation.addParticle(VerletPhysics::Vector2(500, 250), 10);
         VerletPhysics::Particle* p1 = simulation.addParticle(VerletPhysics::Vector2(620, 280), 10);
         VerletPhysics::Particle* p2 = simulation.addParticle(VerletPhysics::Vector2(700, 376), 10);
@@ -47,14 +63,8 @@ namespace DoublePendulumDemo {
         gravity.subscribeParticle(p1);
         gravity.subscribeParticle(p2);
 
-        VerletPhysics::PairedParticleConstraint constraintA(anchor, p1, 150);
-        VerletPhysics::PairedParticleConstraint constraintB(p1, p2, 150);
-
-        ppConstraints.push_back(&constraintA);
-        ppConstraints.push_back(&constraintB);
-
-        simulation.addConstraint(&constraintA);
-        simulation.addConstraint(&constraintB);
+        ppConstraints.push_back(simulation.emplaceConstraint<VerletPhysics::PairedParticleConstraint>(anchor, p1, 150));
+        ppConstraints.push_back(simulation.emplaceConstraint<VerletPhysics::PairedParticleConstraint>(p1, p2, 150));
 
         particles.push_back(anchor);
         particles.push_back(p1);
@@ -0,0 +1,212 @@
+#include "BenchmarkScenes.h"
+#include "TrajectoryWriter.h"
+#include "WorldSnapshot.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+
+using namespace VerletPhysics;
+
+namespace {
+
+    /**
+     * Everything describing one headless run, filled from the command line.
+     */
+    struct RunDescription
+    {
+        std::string scene = "ballpit";      ///< Scene builder: ballpit, gravel, cloth or pendulum.
+        std::string snapshot;               ///< Snapshot to simulate instead of a built scene, empty to build one.
+        std::string saveSnapshot;           ///< Snapshot file to save the starting world to, empty to skip saving.
+        size_t particles = 1000;            ///< Particles in the scene.
+        size_t frames = 600;                ///< Frames to simulate.
+        double timestep = 1.0 / 60.0;       ///< Fixed time per frame, in seconds.
+        size_t threads = 1;                 ///< Simulation threads, zero for the hardware concurrency.
+        std::string output;                 ///< Trajectory file, empty to skip writing.
+        size_t every = 1;                   ///< Write one frame out of this many.
+        TrajectoryCompression compression = TrajectoryCompression::None; ///< Trajectory encoding.
+        double quantum = 0.01;              ///< Grid size of quantized encodings.
+        size_t chunkFrames = 64;            ///< Frames per trajectory chunk.
+        size_t minSubsteps = 0;             ///< Fewest adaptive substeps, zero to keep the scene's fixed count.
+        size_t maxSubsteps = 0;             ///< Most adaptive substeps.
+        BroadPhase broadPhase = BroadPhase::UniformGrid; ///< Collision broad phase.
+    };
+
+    void printUsage()
+    {
+        std::cerr <<
+            "Usage: VerletRunner [options]\n"
+            "  --scene ballpit|gravel|cloth|pendulum   Scene to simulate (default ballpit)\n"
+            "  --particles N                    Particles in the scene (default 1000)\n"
+            "  --snapshot PATH                  Simulate a world saved by WorldSnapshot instead of a scene\n"
+            "  --save-snapshot PATH             Save the starting world, for replaying it with --snapshot\n"
+            "  --frames N                       Frames to simulate (default 600)\n"
+            "  --dt SECONDS                     Fixed timestep per frame (default 1/60)\n"
+            "  --threads N                      Simulation threads, 0 for all cores (default 1)\n"
+            "  --output PATH                    Trajectory file to stream positions to\n"
+            "  --every N                        Write every Nth frame (default 1)\n"
+            "  --compression none|quantized|delta   Trajectory encoding (default none)\n"
+            "  --quantum SIZE                   Grid size of quantized encodings (default 0.01)\n"
+            "  --chunk-frames N                 Frames per trajectory chunk (default 64)\n"
+            "  --adaptive MIN:MAX               Adapt the substeps per frame within a range (default fixed)\n"
+            "  --broadphase grid|sap            Collision broad phase (default grid)\n";
+    }
+
+    bool parseArguments(int argc, char** argv, RunDescription& run)
+    {
+        for (int i = 1; i < argc; i++) {
+            const std::string option = argv[i];
+            if (option == "--help" || option == "-h") return false;
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << option << "\n";
+                return false;
+            }
+
+            const std::string value = argv[++i];
+            if (option == "--scene") run.scene = value;
+            else if (option == "--snapshot") run.snapshot = value;
+            else if (option == "--save-snapshot") run.saveSnapshot = value;
+            else if (option == "--particles") run.particles = std::strtoull(value.c_str(), nullptr, 10);
+            else if (option == "--frames") run.frames = std::strtoull(value.c_str(), nullptr, 10);
+            else if (option == "--dt") run.timestep = std::strtod(value.c_str(), nullptr);
+            else if (option == "--threads") run.threads = std::strtoull(value.c_str(), nullptr, 10);
+            else if (option == "--output") run.output = value;
+            else if (option == "--every") run.every = std::max<size_t>(1, std::strtoull(value.c_str(), nullptr, 10));
+            else if (option == "--quantum") run.quantum = std::strtod(value.c_str(), nullptr);
+            else if (option == "--chunk-frames") run.chunkFrames = std::strtoull(value.c_str(), nullptr, 10);
+            else if (option == "--adaptive") {
+                const size_t separator = value.find(':');
+                if (separator == std::string::npos) {
+                    std::cerr << "Expected MIN:MAX for --adaptive\n";
+                    return false;
+                }
+                run.minSubsteps = std::strtoull(value.substr(0, separator).c_str(), nullptr, 10);
+                run.maxSubsteps = std::strtoull(value.substr(separator + 1).c_str(), nullptr, 10);
+            }
+            else if (option == "--broadphase") {
+                if (value == "grid") run.broadPhase = BroadPhase::UniformGrid;
+                else if (value == "sap") run.broadPhase = BroadPhase::SweepAndPrune;
+                else {
+                    std::cerr << "Unknown broad phase " << value << "\n";
+                    return false;
+                }
+            }
+            else if (option == "--compression") {
+                if (value == "none") run.compression = TrajectoryCompression::None;
+                else if (value == "quantized") run.compression = TrajectoryCompression::Quantized;
+                else if (value == "delta") run.compression = TrajectoryCompression::QuantizedDelta;
+                else {
+                    std::cerr << "Unknown compression " << value << "\n";
+                    return false;
+                }
+            }
+            else {
+                std::cerr << "Unknown option " << option << "\n";
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool buildScene(const RunDescription& run, BenchmarkScenes::Scene& scene)
+    {
+        if (!run.snapshot.empty()) {
+            scene.world = WorldSnapshot::load(run.snapshot, run.threads);
+            return scene.world != nullptr;
+        }
+
+        if (run.scene == "ballpit") scene = BenchmarkScenes::buildBallpit(run.particles, run.threads);
+        else if (run.scene == "gravel") scene = BenchmarkScenes::buildGravel(run.particles, run.threads);
+        else if (run.scene == "cloth") scene = BenchmarkScenes::buildCloth(run.particles, run.threads);
+        else if (run.scene == "pendulum") scene = BenchmarkScenes::buildPendulumChains(run.particles, run.threads);
+        else return false;
+
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    RunDescription run;
+    if (!parseArguments(argc, argv, run)) {
+        printUsage();
+        return 1;
+    }
+
+    BenchmarkScenes::Scene scene;
+    if (!buildScene(run, scene)) {
+        if (!run.snapshot.empty()) {
+            std::cerr << "Could not load snapshot " << run.snapshot << "\n";
+            return 1;
+        }
+        std::cerr << "Unknown scene " << run.scene << "\n";
+        printUsage();
+        return 1;
+    }
+
+    SimulationWorld& world = *scene.world;
+    const std::string name = run.snapshot.empty() ? run.scene : run.snapshot;
+
+    if (!run.saveSnapshot.empty() && !WorldSnapshot::save(world, run.saveSnapshot)) {
+        std::cerr << "Could not save snapshot " << run.saveSnapshot << "\n";
+        return 1;
+    }
+
+    std::unique_ptr<TrajectoryWriter> writer;
+    if (!run.output.empty()) {
+        writer = std::make_unique<TrajectoryWriter>(run.output, world.getParticleCount(), run.timestep * run.every,
+            run.compression, run.quantum, run.chunkFrames);
+
+        if (!writer->isGood()) {
+            std::cerr << "Could not open " << run.output << "\n";
+            return 1;
+        }
+    }
+
+    world.setBroadPhase(run.broadPhase);
+
+    if (run.minSubsteps > 0) {
+        world.setSubstepRange(run.minSubsteps, run.maxSubsteps);
+        world.setAdaptiveSubstepsEnabled(true);
+    }
+
+    size_t substeps = 0;
+    size_t fewestSubsteps = SIZE_MAX;
+    size_t mostSubsteps = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (size_t frame = 0; frame < run.frames; frame++) {
+        world.update(run.timestep);
+        if (writer && frame % run.every == 0) writer->writeFrame(world.getParticles());
+
+        substeps += world.getLastSubstepCount();
+        fewestSubsteps = std::min(fewestSubsteps, world.getLastSubstepCount());
+        mostSubsteps = std::max(mostSubsteps, world.getLastSubstepCount());
+    }
+
+    const double simulated = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (writer && !writer->close()) {
+        std::cerr << "Failed to write " << run.output << "\n";
+        return 1;
+    }
+
+    const double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << name << ": " << world.getParticleCount() << " particles, " << run.frames << " frames in "
+        << simulated << " s (" << run.frames / simulated << " frames/s)";
+    if (writer) std::cout << ", " << writer->getFrameCount() << " frames written, flushed after " << total << " s";
+    if (run.frames > 0) {
+        std::cout << ", substeps " << fewestSubsteps << "-" << mostSubsteps << " (mean " << static_cast<double>(substeps) / run.frames << ")";
+    }
+    std::cout << "\n";
+
+    return 0;
+}
@@ -0,0 +1,169 @@
+#include "BenchmarkScenes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <vector>
+
+using namespace VerletPhysics;
+
+namespace BenchmarkScenes {
+
+    Scene buildBallpit(size_t particleCount, size_t threadCount, bool shuffled)
+    {
+        const double SPACING = 45;
+        const size_t COLUMNS = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(particleCount))));
+
+        Scene scene;
+        scene.steps = 1;
+        scene.world = std::make_unique<SimulationWorld>(scene.steps, true, threadCount);
+
+        ConstantAcceleration* gravity = scene.world->emplaceGenerator<ConstantAcceleration>(Vector2(0, 98.1));
+        gravity->subscribeAllParticles(scene.world->getParticles());
+        const double extent = COLUMNS * SPACING + SPACING;
+        BoxedPositionConstraint* box = scene.world->emplaceConstraint<BoxedPositionConstraint>(Vector2(0, 0), Vector2(extent, extent));
+        scene.constraintCount = 1;
+
+        std::mt19937 gen(42);
+        std::uniform_real_distribution<double> sizeDistribution(10.0, 20.0);
+        std::uniform_real_distribution<double> jitterDistribution(-2.0, 2.0);
+
+        std::vector<size_t> slots(particleCount);
+        std::iota(slots.begin(), slots.end(), size_t(0));
+        if (shuffled) std::shuffle(slots.begin(), slots.end(), gen);
+
+        for (size_t slot : slots) {
+            const double x = SPACING + (slot % COLUMNS) * SPACING + jitterDistribution(gen);
+            const double y = SPACING + (slot / COLUMNS) * SPACING + jitterDistribution(gen);
+
+            Particle* p = scene.world->addParticle(Vector2(x, y), sizeDistribution(gen));
+            box->subscribeParticle(p);
+        }
+
+        return scene;
+    }
+
+    Scene buildGravel(size_t particleCount, size_t threadCount)
+    {
+        const double GRIT_SPACING = 5;
+        const double BOULDER_SPACING = 300;
+        const double BOULDER_CLEARANCE = 3;
+
+        // Boulders take up part of the area, so the grit lattice is made larger than the particle count
+        const size_t COLUMNS = static_cast<size_t>(std::ceil(std::sqrt(1.5 * particleCount))) + 1;
+        const double extent = COLUMNS * GRIT_SPACING + GRIT_SPACING;
+        const size_t BOULDER_COLUMNS = std::max<size_t>(1, static_cast<size_t>(extent / BOULDER_SPACING));
+
+        Scene scene;
+        scene.steps = 1;
+        scene.world = std::make_unique<SimulationWorld>(scene.steps, true, threadCount);
+
+        ConstantAcceleration* gravity = scene.world->emplaceGenerator<ConstantAcceleration>(Vector2(0, 98.1));
+        gravity->subscribeAllParticles(scene.world->getParticles());
+        BoxedPositionConstraint* box = scene.world->emplaceConstraint<BoxedPositionConstraint>(Vector2(0, 0), Vector2(extent, extent));
+        scene.constraintCount = 1;
+
+        std::mt19937 gen(42);
+        std::uniform_real_distribution<double> gritDistribution(1.0, 2.0);
+        std::uniform_real_distribution<double> boulderDistribution(50.0, 100.0);
+        std::uniform_real_distribution<double> jitterDistribution(-1.0, 1.0);
+
+        // One boulder per lattice cell, for roughly one boulder per few thousand grains
+        std::vector<double> boulderRadius(BOULDER_COLUMNS * BOULDER_COLUMNS);
+        for (size_t i = 0; i < boulderRadius.size() && i < particleCount; i++) {
+            boulderRadius[i] = boulderDistribution(gen);
+            const Vector2 centre((i % BOULDER_COLUMNS + 0.5) * BOULDER_SPACING, (i / BOULDER_COLUMNS + 0.5) * BOULDER_SPACING);
+            box->subscribeParticle(scene.world->addParticle(centre, boulderRadius[i]));
+        }
+
+        for (size_t slot = 0; slot < COLUMNS * COLUMNS && scene.world->getParticleCount() < particleCount; slot++) {
+            const double x = GRIT_SPACING + (slot % COLUMNS) * GRIT_SPACING + jitterDistribution(gen);
+            const double y = GRIT_SPACING + (slot / COLUMNS) * GRIT_SPACING + jitterDistribution(gen);
+
+            // Skip grains that would start inside the boulder of their lattice cell
+            const size_t boulderColumn = std::min(static_cast<size_t>(x / BOULDER_SPACING), BOULDER_COLUMNS - 1);
+            const size_t boulderRow = std::min(static_cast<size_t>(y / BOULDER_SPACING), BOULDER_COLUMNS - 1);
+            const double offsetX = x - (boulderColumn + 0.5) * BOULDER_SPACING;
+            const double offsetY = y - (boulderRow + 0.5) * BOULDER_SPACING;
+            const double clearance = boulderRadius[boulderRow * BOULDER_COLUMNS + boulderColumn] + BOULDER_CLEARANCE;
+            if (offsetX * offsetX + offsetY * offsetY < clearance * clearance) continue;
+
+            box->subscribeParticle(scene.world->addParticle(Vector2(x, y), gritDistribution(gen)));
+        }
+
+        return scene;
+    }
+
+    Scene buildCloth(size_t particleCount, size_t threadCount)
+    {
+        const double OFFSET = 30;
+        const size_t SIDE = std::max<size_t>(2, static_cast<size_t>(std::sqrt(static_cast<double>(particleCount))));
+
+        Scene scene;
+        scene.steps = 3;
+        scene.world = std::make_unique<SimulationWorld>(scene.steps, true, threadCount);
+
+        ConstantAcceleration* gravity = scene.world->emplaceGenerator<ConstantAcceleration>(Vector2(0, 150));
+        std::vector<Particle*> particles(SIDE * SIDE);
+
+        for (size_t i = 0; i < SIDE; i++) {
+            for (size_t j = 0; j < SIDE; j++) {
+                Particle* p = scene.world->addParticle(Vector2(50 + j * OFFSET, 50 + i * OFFSET), 5);
+
+                if (i == 0) p->setStaticState(true);
+                else gravity->subscribeParticle(p);
+
+                particles[i * SIDE + j] = p;
+            }
+        }
+
+        const double maxDistance = std::sqrt(OFFSET * OFFSET + OFFSET * OFFSET) - 1;
+
+        for (size_t i = 0; i < SIDE; i++) {
+            for (size_t j = 0; j < SIDE; j++) {
+                if (i + 1 < SIDE) {
+                    scene.world->emplaceConstraint<PairedParticleConstraint>(particles[i * SIDE + j], particles[(i + 1) * SIDE + j], maxDistance);
+                    scene.constraintCount++;
+                }
+                if (j + 1 < SIDE) {
+                    scene.world->emplaceConstraint<PairedParticleConstraint>(particles[i * SIDE + j], particles[i * SIDE + j + 1], maxDistance);
+                    scene.constraintCount++;
+                }
+            }
+        }
+
+        return scene;
+    }
+
+    Scene buildPendulumChains(size_t particleCount, size_t threadCount)
+    {
+        const size_t CHAIN_LENGTH = 16;
+        const double LINK_LENGTH = 30;
+        const double CHAIN_SPACING = 40;
+
+        Scene scene;
+        scene.steps = 10;
+        scene.world = std::make_unique<SimulationWorld>(scene.steps, false, threadCount);
+
+        ConstantAcceleration* gravity = scene.world->emplaceGenerator<ConstantAcceleration>(Vector2(0, 98.1));
+
+        const size_t chains = std::max<size_t>(1, particleCount / CHAIN_LENGTH);
+        for (size_t chain = 0; chain < chains; chain++) {
+            Particle* previous = scene.world->addParticle(Vector2(chain * CHAIN_SPACING, 0), 10);
+            previous->setStaticState(true);
+
+            // Chains start horizontal so they swing through the whole run
+            for (size_t link = 1; link < CHAIN_LENGTH; link++) {
+                Particle* p = scene.world->addParticle(Vector2(chain * CHAIN_SPACING + link * LINK_LENGTH, 0), 10);
+                gravity->subscribeParticle(p);
+
+                scene.world->emplaceConstraint<PairedParticleConstraint>(previous, p, LINK_LENGTH);
+                scene.constraintCount++;
+                previous = p;
+            }
+        }
+
+        return scene;
+    }
+};
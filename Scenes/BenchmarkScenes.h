@@ -0,0 +1,45 @@
+#pragma once
+
+#include "SimulationWorld.h"
+
+#include <memory>
+
+namespace BenchmarkScenes {
+
+    /**
+     * A headless scene built for benchmarking.
+     *
+     * Every generator and constraint is created through the world, which owns them.
+     */
+    struct Scene
+    {
+        std::unique_ptr<VerletPhysics::SimulationWorld> world;
+        size_t constraintCount = 0; ///< Constraints created for the scene.
+        size_t steps = 1;           ///< Substeps per update, matching the demo the scene is modelled on.
+    };
+
+    /**
+     * Builds a ballpit: particles of radius 10 to 20 falling under gravity inside a box.
+     *
+     * Particles start on a jittered grid without overlaps, in a box sized to the particle count.
+     * When shuffled, they are added in random order, so neighbours in space are scattered through memory.
+     */
+    Scene buildBallpit(size_t particleCount, size_t threadCount, bool shuffled = false);
+
+    /**
+     * Builds a gravel bed: grit of radius 1 to 2 around scattered boulders of radius 50 to 100, inside a box.
+     *
+     * The mix of sizes is the case a uniform grid handles worst, as its cells are sized for the boulders.
+     */
+    Scene buildGravel(size_t particleCount, size_t threadCount);
+
+    /**
+     * Builds a square cloth hanging from its static top row, like `ClothSimDemo::generateCloth`.
+     */
+    Scene buildCloth(size_t particleCount, size_t threadCount);
+
+    /**
+     * Builds side-by-side pendulum chains of 16 particles, each hanging from a static anchor.
+     */
+    Scene buildPendulumChains(size_t particleCount, size_t threadCount);
+};
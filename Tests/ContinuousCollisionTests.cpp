@@ -0,0 +1,68 @@
+#include "SimulationWorld.h"
+#include "TestSupport.h"
+
+#include <cmath>
+
+using namespace VerletPhysics;
+
+namespace {
+
+    const double FRAME_TIME = 1.0 / 60;
+
+    /**
+     * A particle at rest at the origin, and one of the same size launched at it from the left fast
+     * enough to cross it entirely in a single substep.
+     */
+    struct Shot
+    {
+        SimulationWorld world;
+        Particle* target;
+        Particle* bullet;
+
+        Shot(bool continuous, Real offset) :
+            world(1, true)
+        {
+            world.setContinuousCollisionsEnabled(continuous);
+            target = world.addParticle(Vector2(0, 0), Real(0.5));
+            bullet = world.addParticle(Vector2(-30, offset), Real(0.5));
+            bullet->updatePosition(Vector2(-10, offset));
+        }
+    };
+}
+
+VERLET_TEST(ContinuousCollision, FastParticleTunnelsWithoutSweeping)
+{
+    Shot shot(false, 0);
+    shot.world.update(FRAME_TIME);
+
+    // Neither the previous nor the current position overlaps the target, so the discrete pass sees nothing
+    VERLET_CHECK(shot.bullet->getPosition().x() == Real(10));
+    VERLET_CHECK(shot.target->getPosition().x() == Real(0));
+}
+
+VERLET_TEST(ContinuousCollision, FastParticleStopsAtImpact)
+{
+    Shot shot(true, 0);
+    shot.world.update(FRAME_TIME);
+
+    // Moved back to where the two first touch, with the velocity into the target removed
+    VERLET_CHECK(std::abs(shot.bullet->getPosition().x() + 1) < Real(1e-4));
+    VERLET_CHECK(std::abs(shot.bullet->getPosition().x() - shot.bullet->getPreviousPosition().x()) < Real(1e-4));
+    VERLET_CHECK(shot.target->getPosition().x() == Real(0));
+
+    shot.world.update(FRAME_TIME);
+    VERLET_CHECK(shot.bullet->getPosition().x() < 0);
+}
+
+VERLET_TEST(ContinuousCollision, GlancingParticleSlidesOff)
+{
+    Shot shot(true, Real(0.5));
+    shot.world.update(FRAME_TIME);
+
+    // The impact normal points from the target to the bullet, which keeps only the velocity across it
+    const Vector2 position = shot.bullet->getPosition();
+    const Vector2 velocity = position - shot.bullet->getPreviousPosition();
+    VERLET_CHECK(std::abs(position.x() + std::sqrt(Real(0.75))) < Real(1e-4));
+    VERLET_CHECK(std::abs(velocity.x() * position.x() + velocity.y() * position.y()) < Real(1e-3));
+    VERLET_CHECK(velocity.x() > 0);
+}
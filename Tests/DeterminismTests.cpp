@@ -0,0 +1,134 @@
+#include "BenchmarkScenes.h"
+#include "SimdKernels.h"
+#include "TestSupport.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace VerletPhysics;
+
+namespace {
+
+    const double FRAME_TIME = 1.0 / 60;
+    const size_t PARTICLES = 1200;
+    const size_t FRAMES = 40;
+
+    /**
+     * Optional features that change which code paths an update takes.
+     */
+    enum class Mode
+    {
+        Default,
+        SweepAndPrune,
+        Sleeping,
+        Adaptive,
+        ContinuousCollisions,
+        Sorting
+    };
+
+    const char* modeName(Mode mode)
+    {
+        switch (mode) {
+        case Mode::Default: return "Default";
+        case Mode::SweepAndPrune: return "SweepAndPrune";
+        case Mode::Sleeping: return "Sleeping";
+        case Mode::Adaptive: return "Adaptive";
+        case Mode::ContinuousCollisions: return "ContinuousCollisions";
+        case Mode::Sorting: return "Sorting";
+        }
+        return "Unknown";
+    }
+
+    BenchmarkScenes::Scene buildScene(const std::string& scene, size_t threads)
+    {
+        if (scene == "ballpit") return BenchmarkScenes::buildBallpit(PARTICLES, threads);
+        if (scene == "gravel") return BenchmarkScenes::buildGravel(PARTICLES, threads);
+        if (scene == "cloth") return BenchmarkScenes::buildCloth(PARTICLES, threads);
+        return BenchmarkScenes::buildPendulumChains(PARTICLES, threads);
+    }
+
+    /**
+     * Simulates a scene and returns every particle's current and previous position, in the order
+     * the particles were added, so runs that sorted the store compare like for like.
+     */
+    std::vector<Real> simulate(const std::string& sceneName, Mode mode, size_t threads)
+    {
+        BenchmarkScenes::Scene scene = buildScene(sceneName, threads);
+        SimulationWorld& world = *scene.world;
+
+        switch (mode) {
+        case Mode::Default:
+            break;
+        case Mode::SweepAndPrune:
+            world.setBroadPhase(BroadPhase::SweepAndPrune);
+            break;
+        case Mode::Sleeping:
+            world.setSleepThreshold(Real(0.05), 5);
+            world.setSleepingEnabled(true);
+            break;
+        case Mode::Adaptive:
+            world.setSubstepRange(1, 6);
+            world.setAdaptiveSubstepsEnabled(true);
+            break;
+        case Mode::ContinuousCollisions:
+            world.setContinuousCollisionsEnabled(true);
+            world.setContinuousCollisionThreshold(Real(0.05));
+            break;
+        case Mode::Sorting:
+            world.setParticleSortInterval(5);
+            world.setParticleSortTolerance(0);
+            break;
+        }
+
+        for (size_t frame = 0; frame < FRAMES; frame++) world.update(FRAME_TIME);
+
+        const ParticleStore& particles = world.getParticles();
+        std::vector<Real> state;
+        state.reserve(particles.size() * 4);
+        for (size_t created = 0; created < particles.size(); created++) {
+            const size_t i = particles.getIndexOfCreated(created);
+            state.push_back(particles.positionX()[i]);
+            state.push_back(particles.positionY()[i]);
+            state.push_back(particles.previousX()[i]);
+            state.push_back(particles.previousY()[i]);
+        }
+        return state;
+    }
+
+    /**
+     * Checks that every feature mode of a scene reproduces the single threaded scalar run bit for
+     * bit on every thread count and every SIMD level the CPU supports.
+     */
+    void checkScene(const std::string& scene)
+    {
+        const SimdLevel detected = SimdKernels::detectSimdLevel();
+
+        for (Mode mode : { Mode::Default, Mode::SweepAndPrune, Mode::Sleeping, Mode::Adaptive, Mode::ContinuousCollisions, Mode::Sorting }) {
+            SimdKernels::setSimdLevel(SimdLevel::Scalar);
+            const std::vector<Real> reference = simulate(scene, mode, 1);
+
+            for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2 }) {
+                SimdKernels::setSimdLevel(level);
+                if (SimdKernels::getSimdLevel() != level) continue;
+
+                for (size_t threads : { 1, 2, 3, 8 }) {
+                    const std::vector<Real> state = simulate(scene, mode, threads);
+                    const bool identical = state.size() == reference.size() &&
+                        std::memcmp(state.data(), reference.data(), state.size() * sizeof(Real)) == 0;
+
+                    if (!identical) std::printf("%s, %s, SIMD level %d, %zu threads:\n", scene.c_str(), modeName(mode), static_cast<int>(level), threads);
+                    VERLET_CHECK(identical);
+                }
+            }
+        }
+
+        SimdKernels::setSimdLevel(detected);
+    }
+}
+
+VERLET_TEST(Determinism, Ballpit) { checkScene("ballpit"); }
+VERLET_TEST(Determinism, Gravel) { checkScene("gravel"); }
+VERLET_TEST(Determinism, Cloth) { checkScene("cloth"); }
+VERLET_TEST(Determinism, Pendulum) { checkScene("pendulum"); }
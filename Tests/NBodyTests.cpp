@@ -0,0 +1,163 @@
+#include "ForceGeneration.h"
+#include "TestSupport.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace VerletPhysics;
+
+namespace {
+
+    const double GRAVITATIONAL_CONSTANT = 2;
+    const double SOFTENING = 1;
+
+    /**
+     * Forces found by summing every pair directly, with the sum of the magnitudes of each body's
+     * terms to scale rounding and approximation errors by.
+     */
+    struct DirectSum
+    {
+        std::vector<double> forceX;
+        std::vector<double> forceY;
+        std::vector<double> scale;
+    };
+
+    /**
+     * Fills a store with a random cloud, a pile of coincident bodies deeper than the quadtree can
+     * split and a row of bodies closer together than its smallest cell.
+     */
+    void addBodies(ParticleStore& particles)
+    {
+        std::mt19937 random(7);
+        std::uniform_real_distribution<double> coordinate(-100, 100);
+        for (int i = 0; i < 2000; i++) {
+            particles.add(Vector2(Real(coordinate(random)), Real(coordinate(random))), Real(0.5 + (i % 5) * 0.3));
+        }
+        for (int i = 0; i < 100; i++) particles.add(Vector2(Real(12.5), Real(-40.25)), Real(0.7));
+        for (int i = 0; i < 50; i++) particles.add(Vector2(Real(-30 + i * 1e-5), Real(30)), Real(0.6));
+    }
+
+    DirectSum sumDirectly(const ParticleStore& particles)
+    {
+        const size_t count = particles.size();
+        DirectSum sum{ std::vector<double>(count), std::vector<double>(count), std::vector<double>(count) };
+
+        for (size_t i = 0; i < count; i++) {
+            double totalX = 0;
+            double totalY = 0;
+            double magnitude = 0;
+            for (size_t j = 0; j < count; j++) {
+                const double dx = double(particles.positionX()[j]) - particles.positionX()[i];
+                const double dy = double(particles.positionY()[j]) - particles.positionY()[i];
+                const double squared = dx * dx + dy * dy + SOFTENING * SOFTENING;
+                const double factor = 1 / particles.inverseMass()[j] / (squared * std::sqrt(squared));
+                totalX += factor * dx;
+                totalY += factor * dy;
+                magnitude += factor * std::sqrt(dx * dx + dy * dy);
+            }
+
+            const double scale = GRAVITATIONAL_CONSTANT / particles.inverseMass()[i];
+            sum.forceX[i] = totalX * scale;
+            sum.forceY[i] = totalY * scale;
+            sum.scale[i] = magnitude * scale;
+        }
+        return sum;
+    }
+
+    void clearForces(ParticleStore& particles)
+    {
+        std::fill(particles.forceX(), particles.forceX() + particles.size(), Real(0));
+        std::fill(particles.forceY(), particles.forceY() + particles.size(), Real(0));
+    }
+
+    /**
+     * Gets the largest error of any body, relative to the magnitudes summed into its force.
+     */
+    double largestError(const ParticleStore& particles, const DirectSum& direct)
+    {
+        double largest = 0;
+        for (size_t i = 0; i < particles.size(); i++) {
+            const double errorX = particles.forceX()[i] - direct.forceX[i];
+            const double errorY = particles.forceY()[i] - direct.forceY[i];
+            largest = std::max(largest, std::sqrt(errorX * errorX + errorY * errorY) / direct.scale[i]);
+        }
+        return largest;
+    }
+}
+
+VERLET_TEST(NBody, MatchesDirectSum)
+{
+    ParticleStore particles;
+    addBodies(particles);
+    const DirectSum direct = sumDirectly(particles);
+
+    for (double openingAngle : { 0.0, 0.2, 0.5, 1.0 }) {
+        NBodyGravity gravity(Real(GRAVITATIONAL_CONSTANT), static_cast<Real>(openingAngle), Real(SOFTENING));
+        gravity.subscribeAllParticles(particles);
+        clearForces(particles);
+        gravity.applyForces();
+
+        // Monopole errors shrink with the square of the opening angle, and vanish without one
+        const double rounding = 256 * std::numeric_limits<Real>::epsilon();
+        VERLET_CHECK(largestError(particles, direct) <= 0.05 * openingAngle * openingAngle + rounding);
+    }
+}
+
+VERLET_TEST(NBody, CoincidentBodiesStopAtMaximumDepth)
+{
+    ParticleStore particles;
+    addBodies(particles);
+
+    NBodyGravity gravity(Real(GRAVITATIONAL_CONSTANT), Real(0.5), Real(SOFTENING));
+    gravity.subscribeAllParticles(particles);
+    gravity.applyForces();
+
+    // Bodies the tree cannot tell apart share leaves of the deepest level beyond the usual leaf size
+    const std::vector<NBodyGravity::Node>& nodes = gravity.getNodes();
+    size_t bodies = 0;
+    size_t largestLeaf = 0;
+    size_t oversizedLeaves = 0;
+    for (const NBodyGravity::Node& node : nodes) {
+        if (node.childCount > 0) continue;
+
+        const size_t count = node.bodyEnd - node.bodyBegin;
+        bodies += count;
+        largestLeaf = std::max(largestLeaf, count);
+        if (count > 32) {
+            oversizedLeaves++;
+            VERLET_CHECK(node.size == nodes[0].size / 65536);
+        }
+    }
+    VERLET_CHECK(bodies == particles.size());
+    VERLET_CHECK(largestLeaf == 100);
+    VERLET_CHECK(oversizedLeaves == 2);
+
+    for (size_t i = 0; i < particles.size(); i++) {
+        VERLET_CHECK(std::isfinite(particles.forceX()[i]) && std::isfinite(particles.forceY()[i]));
+    }
+}
+
+VERLET_TEST(NBody, ThreadsDoNotChangeForces)
+{
+    ParticleStore particles;
+    addBodies(particles);
+
+    NBodyGravity gravity(Real(GRAVITATIONAL_CONSTANT), Real(0.5), Real(SOFTENING));
+    gravity.subscribeAllParticles(particles);
+    gravity.applyForces();
+    const std::vector<Real> serialX(particles.forceX(), particles.forceX() + particles.size());
+    const std::vector<Real> serialY(particles.forceY(), particles.forceY() + particles.size());
+
+    ThreadPool threadPool(4);
+    clearForces(particles);
+    gravity.prepare(threadPool);
+    gravity.applyForcesToRange(0, gravity.getParallelWorkSize());
+
+    VERLET_CHECK(std::equal(serialX.begin(), serialX.end(), particles.forceX()));
+    VERLET_CHECK(std::equal(serialY.begin(), serialY.end(), particles.forceY()));
+}
@@ -0,0 +1,128 @@
+#include "Contraint.h"
+#include "ForceGeneration.h"
+#include "SimulationWorld.h"
+#include "TestSupport.h"
+
+#include <vector>
+
+using namespace VerletPhysics;
+
+namespace {
+
+    const double FRAME_TIME = 1.0 / 60;
+
+    /**
+     * Adds a row of particles that do not touch, so nothing but the tested code moves them.
+     */
+    void addRow(SimulationWorld& world, std::vector<Particle*>& particles)
+    {
+        for (int i = 0; i < 8; i++) particles.push_back(world.addParticle(Vector2(Real(i), 0), Real(0.4)));
+    }
+}
+
+VERLET_TEST(Removal, EmptySpringForceSurvivesRemoval)
+{
+    SimulationWorld world(4, true);
+    SpringForce springs;
+    world.addGenerator(&springs);
+
+    std::vector<Particle*> particles;
+    addRow(world, particles);
+    world.removeParticles({ particles[2] });
+    world.update(FRAME_TIME);
+
+    VERLET_CHECK(world.getParticleCount() == particles.size() - 1);
+    VERLET_CHECK(springs.getSpringCount() == 0);
+}
+
+VERLET_TEST(Removal, EmptySpringForceSurvivesSorting)
+{
+    SimulationWorld world(4, true);
+    SpringForce springs;
+    world.addGenerator(&springs);
+
+    std::vector<Particle*> particles;
+    addRow(world, particles);
+    world.sortParticles();
+    world.update(FRAME_TIME);
+
+    VERLET_CHECK(world.getParticleCount() == particles.size());
+}
+
+VERLET_TEST(Removal, SpringsFollowMovedParticles)
+{
+    SimulationWorld world(4, true);
+    SpringForce springs;
+    world.addGenerator(&springs);
+
+    std::vector<Particle*> particles;
+    addRow(world, particles);
+    springs.addSpring(particles[0], particles[1], 1, 10, 0);
+    springs.addSpring(particles[6], particles[7], 1, 10, 0);
+
+    // Removing an end drops its spring, and the other spring keeps pointing at its moved particles
+    world.removeParticles({ particles[0], particles[3] });
+    world.update(FRAME_TIME);
+
+    VERLET_CHECK(springs.getSpringCount() == 1);
+    VERLET_CHECK(world.getParticleCount() == particles.size() - 2);
+}
+
+VERLET_TEST(Removal, BoxClampsMovedParticles)
+{
+    SimulationWorld world(4, false);
+    std::vector<Particle*> particles;
+    addRow(world, particles);
+
+    BoxedPositionConstraint box(Vector2(-1, -1), Vector2(10, 1));
+    world.addConstraint(&box);
+    for (Particle* particle : particles) box.subscribeParticle(particle);
+    world.update(FRAME_TIME);
+
+    // The last particle fills the gap, and the box keeps clamping it there
+    world.removeParticles({ particles[1] });
+    particles[7]->resetPosition(Vector2(7, 50));
+    world.update(FRAME_TIME);
+
+    VERLET_CHECK(particles[7]->getIndex() == 1);
+    VERLET_CHECK(particles[7]->getPosition().y() <= Real(1));
+    VERLET_CHECK(box.getSubscribers().size() == particles.size() - 1);
+}
+
+VERLET_TEST(Removal, DistanceConstraintsFollowMovedParticles)
+{
+    SimulationWorld world(8, false);
+    std::vector<Particle*> particles;
+    addRow(world, particles);
+
+    PairedParticleConstraint* dropped = world.emplaceConstraint<PairedParticleConstraint>(particles[0], particles[2], Real(3));
+    PairedParticleConstraint* kept = world.emplaceConstraint<PairedParticleConstraint>(particles[6], particles[7], Real(1.5));
+    world.update(FRAME_TIME);
+
+    // Both ends of the kept constraint move into the gaps, while the other constraint is dropped
+    world.removeParticles({ particles[0], particles[1] });
+    particles[7]->resetPosition(Vector2(7, 20));
+    world.update(FRAME_TIME);
+
+    VERLET_CHECK(!dropped->isEnabled());
+    VERLET_CHECK(kept->getIndexA() == particles[6]->getIndex());
+    VERLET_CHECK(kept->getIndexB() == particles[7]->getIndex());
+    VERLET_CHECK(VectorMath::magnitude(particles[7]->getPosition() - particles[6]->getPosition()) <= Real(1.5) + Real(1e-3));
+}
+
+VERLET_TEST(Removal, SweepAndPruneCollidesMovedParticles)
+{
+    SimulationWorld world(4, true);
+    world.setBroadPhase(BroadPhase::SweepAndPrune);
+    std::vector<Particle*> particles;
+    addRow(world, particles);
+    world.update(FRAME_TIME);
+
+    // After two removals the last two particles overlap, and the sweep has to find them at their new indices
+    world.removeParticles({ particles[0], particles[2] });
+    particles[6]->resetPosition(Vector2(3, Real(5.1)));
+    particles[7]->resetPosition(Vector2(3, Real(4.9)));
+    for (int frame = 0; frame < 10; frame++) world.update(FRAME_TIME);
+
+    VERLET_CHECK(VectorMath::magnitude(particles[7]->getPosition() - particles[6]->getPosition()) >= Real(0.8) - Real(1e-3));
+}
@@ -0,0 +1,206 @@
+#include "Contraint.h"
+#include "ForceGeneration.h"
+#include "SimulationWorld.h"
+#include "TestSupport.h"
+
+#include <cmath>
+#include <vector>
+
+using namespace VerletPhysics;
+
+namespace {
+
+    const double FRAME_TIME = 1.0 / 60;
+
+    /**
+     * A world with gravity and a floor, where resting piles fall asleep after a few frames.
+     */
+    struct Floor
+    {
+        SimulationWorld world;
+        ConstantAcceleration gravity;
+        BoxedPositionConstraint box;
+
+        Floor(BroadPhase broadPhase = BroadPhase::UniformGrid) :
+            world(4, true),
+            gravity(Vector2(0, 10)),
+            box(Vector2(-100, -100), Vector2(100, 10))
+        {
+            world.setBroadPhase(broadPhase);
+            world.addGenerator(&gravity);
+            world.addConstraint(&box);
+            world.setSleepThreshold(Real(0.05), 5);
+            world.setSleepingEnabled(true);
+        }
+
+        /**
+         * Adds a slab two particles high, resting on the floor from `left` on, its neighbours tied
+         * together so the whole slab forms one island.
+         */
+        void addPile(Real left, std::vector<Particle*>& particles)
+        {
+            const size_t first = particles.size();
+            for (int row = 0; row < 2; row++) {
+                for (int i = 0; i < 8; i++) {
+                    Particle* particle = world.addParticle(Vector2(left + Real(i), Real(9.5) - Real(row)), Real(0.5));
+                    gravity.subscribeParticle(particle);
+                    box.subscribeParticle(particle);
+                    particles.push_back(particle);
+
+                    if (i > 0) world.emplaceConstraint<PairedParticleConstraint>(particles[particles.size() - 2], particle, Real(1));
+                    if (row > 0) world.emplaceConstraint<PairedParticleConstraint>(particles[first + i], particle, Real(1));
+                }
+            }
+        }
+
+        void run(int frames)
+        {
+            for (int frame = 0; frame < frames; frame++) world.update(FRAME_TIME);
+        }
+    };
+
+    /**
+     * Checks that every awake particle is stored before every sleeping one.
+     */
+    bool sleepersStoredLast(SimulationWorld& world)
+    {
+        const ParticleStore& particles = world.getParticles();
+        for (size_t i = 0; i < particles.size(); i++) {
+            const bool sleeping = (particles.isStatic()[i] & ParticleStore::SLEEPING_FLAG) != 0;
+            if (sleeping != (i >= particles.getAwakeCount())) return false;
+        }
+        return true;
+    }
+}
+
+VERLET_TEST(Sleeping, SleepersAreSkipped)
+{
+    Floor floor;
+    std::vector<Particle*> particles;
+    floor.addPile(0, particles);
+    floor.run(30);
+
+    VERLET_CHECK(floor.world.getSleepingCount() == particles.size());
+
+    // Nothing integrates, collides or clamps a sleeping particle, so it stays exactly where it fell asleep
+    floor.run(1);
+    VERLET_CHECK(floor.world.getParticles().getAwakeCount() == 0);
+    const Vector2 resting = particles[3]->getPosition();
+    floor.run(10);
+    VERLET_CHECK(particles[3]->getPosition().x() == resting.x());
+    VERLET_CHECK(particles[3]->getPosition().y() == resting.y());
+}
+
+VERLET_TEST(Sleeping, MovingASleeperWakesItsIsland)
+{
+    Floor floor;
+    std::vector<Particle*> particles;
+    floor.addPile(0, particles);
+    floor.addPile(20, particles);
+    floor.run(30);
+    VERLET_CHECK(floor.world.getSleepingCount() == particles.size());
+
+    // Only the moved particle's pile wakes, and the moved particle falls back onto it
+    particles[12]->updatePosition(Vector2(4, 5));
+    floor.run(1);
+    VERLET_CHECK(floor.world.getSleepingCount() == particles.size() / 2);
+    VERLET_CHECK(!particles[0]->isSleeping());
+    VERLET_CHECK(particles[20]->isSleeping());
+    VERLET_CHECK(particles[12]->getPosition().y() > Real(5));
+    VERLET_CHECK(sleepersStoredLast(floor.world));
+}
+
+VERLET_TEST(Sleeping, UnpinningASleeperWakesItsIsland)
+{
+    Floor floor;
+    std::vector<Particle*> particles;
+    floor.addPile(0, particles);
+    floor.run(30);
+    VERLET_CHECK(floor.world.getSleepingCount() == particles.size());
+
+    particles[5]->setStaticState(false);
+    floor.run(1);
+    VERLET_CHECK(floor.world.getSleepingCount() == 0);
+    VERLET_CHECK(floor.world.getParticles().getAwakeCount() == particles.size());
+}
+
+VERLET_TEST(Sleeping, FallingParticleWakesPile)
+{
+    for (BroadPhase broadPhase : { BroadPhase::UniformGrid, BroadPhase::SweepAndPrune }) {
+        Floor floor(broadPhase);
+        std::vector<Particle*> particles;
+        floor.addPile(0, particles);
+        floor.run(30);
+        VERLET_CHECK(floor.world.getSleepingCount() == particles.size());
+
+        // The falling particle collides with the sleeping pile, which wakes rather than letting it through
+        Particle* falling = floor.world.addParticle(Vector2(Real(3.5), 0), Real(0.5));
+        floor.gravity.subscribeParticle(falling);
+        floor.box.subscribeParticle(falling);
+        floor.run(60);
+
+        VERLET_CHECK(falling->getPosition().y() < Real(8));
+        VERLET_CHECK(sleepersStoredLast(floor.world));
+    }
+}
+
+VERLET_TEST(Sleeping, RemovalKeepsSleepersLast)
+{
+    Floor floor;
+    std::vector<Particle*> particles;
+    floor.addPile(0, particles);
+    floor.addPile(20, particles);
+    PairedParticleConstraint* rope = floor.world.emplaceConstraint<PairedParticleConstraint>(particles[16], particles[26], Real(3));
+    floor.run(30);
+    VERLET_CHECK(floor.world.getSleepingCount() == particles.size());
+
+    // Wake the first pile, then remove particles from both piles
+    floor.world.wakeParticle(particles[0]);
+    floor.run(1);
+    floor.world.removeParticles({ particles[1], particles[9], particles[18], particles[30] });
+    VERLET_CHECK(sleepersStoredLast(floor.world));
+    VERLET_CHECK(floor.world.getSleepingCount() == particles.size() / 2 - 2);
+
+    // The second pile still holds its constraints, and wakes with them when moved
+    particles[16]->updatePosition(Vector2(20, 3));
+    floor.run(1);
+    VERLET_CHECK(floor.world.getSleepingCount() == 0);
+    VERLET_CHECK(rope->isEnabled());
+    VERLET_CHECK(particles[26]->getPosition().y() < Real(9));
+}
+
+VERLET_TEST(Sleeping, SleepingClusterStillAttracts)
+{
+    SimulationWorld world(4, false);
+    NBodyGravity gravity(Real(50));
+    world.addGenerator(&gravity);
+    world.setSleepThreshold(Real(1e-6), 3);
+    world.setSleepingEnabled(true);
+
+    // Each particle of the cluster is held in place by a box exactly its size, so it settles at once
+    std::vector<BoxedPositionConstraint> pins;
+    pins.reserve(4);
+    std::vector<Particle*> cluster;
+    for (int i = 0; i < 4; i++) {
+        const Vector2 position(Real(4 * (i % 2)), Real(4 * (i / 2)));
+        Particle* particle = world.addParticle(position, Real(2));
+        pins.emplace_back(position - Vector2(2, 2), position + Vector2(2, 2));
+        world.addConstraint(&pins.back());
+        pins.back().subscribeParticle(particle);
+        gravity.subscribeParticle(particle);
+        cluster.push_back(particle);
+    }
+
+    for (int frame = 0; frame < 10; frame++) world.update(FRAME_TIME);
+    VERLET_CHECK(world.getSleepingCount() == cluster.size());
+
+    // A body released next to the asleep cluster is pulled towards it
+    Particle* probe = world.addParticle(Vector2(40, 2), Real(0.5));
+    gravity.subscribeParticle(probe);
+    for (int frame = 0; frame < 60; frame++) world.update(FRAME_TIME);
+
+    VERLET_CHECK(!probe->isSleeping());
+    VERLET_CHECK(probe->getPosition().x() < Real(39.5));
+    VERLET_CHECK(std::abs(probe->getPosition().y() - 2) < Real(0.01));
+    VERLET_CHECK(world.getSleepingCount() == cluster.size());
+}
@@ -0,0 +1,210 @@
+#include "BenchmarkScenes.h"
+#include "TestSupport.h"
+#include "WorldSnapshot.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace VerletPhysics;
+
+namespace {
+
+    const double FRAME_TIME = 1.0 / 60;
+    const size_t PARTICLES = 600;
+
+    std::string snapshotPath(const char* name)
+    {
+        return (std::filesystem::temp_directory_path() / (std::string("verlet_") + name + ".snap")).string();
+    }
+
+    std::vector<char> readFile(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    void writeFile(const std::string& path, const std::vector<char>& bytes)
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(bytes.data(), bytes.size());
+    }
+
+    BenchmarkScenes::Scene buildScene(const std::string& scene)
+    {
+        if (scene == "ballpit") return BenchmarkScenes::buildBallpit(PARTICLES, 1);
+        if (scene == "gravel") return BenchmarkScenes::buildGravel(PARTICLES, 1);
+        if (scene == "cloth") return BenchmarkScenes::buildCloth(PARTICLES, 1);
+        return BenchmarkScenes::buildPendulumChains(PARTICLES, 1);
+    }
+
+    /**
+     * Adds one of every generator and constraint the snapshot format knows on top of a scene,
+     * including an all-particles generator and disabled constraints.
+     */
+    void addEverything(SimulationWorld& world)
+    {
+        ParticleStore& particles = world.getParticles();
+
+        DragForce* drag = world.emplaceGenerator<DragForce>(Real(0.01));
+        drag->subscribeAllParticles(particles);
+
+        RadialAttractor* attractor = world.emplaceGenerator<RadialAttractor>(Vector2(200, 200), Real(500), Real(10));
+        for (size_t i = 0; i < particles.size(); i += 3) attractor->subscribeParticle(particles.getHandle(i));
+
+        WindField* wind = world.emplaceGenerator<WindField>(Vector2(0, 0), Real(100), 4, 3);
+        wind->setForce(1, 1, Vector2(20, -5));
+        wind->setForce(3, 2, Vector2(-10, 15));
+        wind->subscribeAllParticles(particles);
+
+        SpringForce* springs = world.emplaceGenerator<SpringForce>();
+        for (size_t i = 0; i + 7 < particles.size(); i += 7) springs->addSpring(particles.getHandle(i), particles.getHandle(i + 7), Real(15), Real(20), Real(0.1));
+
+        world.emplaceConstraint<PairedParticleConstraint>(particles.getHandle(0), particles.getHandle(1), Real(5))->disable();
+
+        BoxedPositionConstraint* box = world.emplaceConstraint<BoxedPositionConstraint>(Vector2(-10, -10), Vector2(10, 10));
+        for (size_t i = 0; i < particles.size(); i += 5) box->subscribeParticle(particles.getHandle(i));
+        box->disable();
+
+        EncircledPositionConstraint* circle = world.emplaceConstraint<EncircledPositionConstraint>(Real(5000), Vector2(0, 0));
+        for (size_t i = 0; i < particles.size(); i += 2) circle->subscribeParticle(particles.getHandle(i));
+    }
+
+    bool sameState(const SimulationWorld& a, const SimulationWorld& b)
+    {
+        const ParticleStore& first = a.getParticles();
+        const ParticleStore& second = b.getParticles();
+        const size_t bytes = first.size() * sizeof(Real);
+
+        return first.size() == second.size()
+            && std::memcmp(first.positionX(), second.positionX(), bytes) == 0
+            && std::memcmp(first.positionY(), second.positionY(), bytes) == 0
+            && std::memcmp(first.previousX(), second.previousX(), bytes) == 0
+            && std::memcmp(first.previousY(), second.previousY(), bytes) == 0
+            && std::memcmp(first.isStatic(), second.isStatic(), first.size()) == 0;
+    }
+
+    /**
+     * Saves a scene partway through, restores it, and checks that both worlds stay identical.
+     *
+     * @param removeEvery If not zero, every particle at a multiple of it is removed before saving.
+     */
+    void checkRoundTrip(const std::string& sceneName, size_t removeEvery = 0)
+    {
+        BenchmarkScenes::Scene scene = buildScene(sceneName);
+        SimulationWorld& world = *scene.world;
+        addEverything(world);
+        for (int frame = 0; frame < 10; frame++) world.update(FRAME_TIME);
+
+        if (removeEvery > 0) {
+            std::vector<Particle*> removed;
+            for (size_t i = 0; i < world.getParticleCount(); i += removeEvery) removed.push_back(world.getParticles().getHandle(i));
+            world.removeParticles(removed);
+            for (int frame = 0; frame < 5; frame++) world.update(FRAME_TIME);
+        }
+
+        const std::string path = snapshotPath(sceneName.c_str());
+        VERLET_CHECK(WorldSnapshot::save(world, path));
+
+        std::unique_ptr<SimulationWorld> restored = WorldSnapshot::load(path);
+        std::filesystem::remove(path);
+        VERLET_CHECK(restored != nullptr);
+        if (!restored) return;
+
+        VERLET_CHECK(sameState(world, *restored));
+        for (int frame = 0; frame < 30; frame++) {
+            world.update(FRAME_TIME);
+            restored->update(FRAME_TIME);
+        }
+        VERLET_CHECK(sameState(world, *restored));
+    }
+
+    /**
+     * Saves a small world with subscribers and returns the bytes of its snapshot.
+     */
+    std::vector<char> saveSmallWorld(const std::string& path)
+    {
+        BenchmarkScenes::Scene scene = buildScene("ballpit");
+        addEverything(*scene.world);
+        WorldSnapshot::save(*scene.world, path);
+        return readFile(path);
+    }
+}
+
+VERLET_TEST(Snapshot, BallpitRoundTrip) { checkRoundTrip("ballpit"); }
+VERLET_TEST(Snapshot, GravelRoundTrip) { checkRoundTrip("gravel"); }
+VERLET_TEST(Snapshot, ClothRoundTrip) { checkRoundTrip("cloth"); }
+VERLET_TEST(Snapshot, PendulumRoundTrip) { checkRoundTrip("pendulum"); }
+VERLET_TEST(Snapshot, ClothRoundTripAfterRemoval) { checkRoundTrip("cloth", 11); }
+VERLET_TEST(Snapshot, PendulumRoundTripAfterRemoval) { checkRoundTrip("pendulum", 13); }
+
+VERLET_TEST(Snapshot, RejectsTruncatedFile)
+{
+    const std::string path = snapshotPath("truncated");
+    std::vector<char> bytes = saveSmallWorld(path);
+    VERLET_CHECK(WorldSnapshot::load(path) != nullptr);
+
+    bytes.resize(bytes.size() - 16);
+    writeFile(path, bytes);
+    VERLET_CHECK(WorldSnapshot::load(path) == nullptr);
+
+    bytes.resize(sizeof(WorldSnapshot::Header) / 2);
+    writeFile(path, bytes);
+    VERLET_CHECK(WorldSnapshot::load(path) == nullptr);
+    std::filesystem::remove(path);
+}
+
+VERLET_TEST(Snapshot, RejectsBadOffset)
+{
+    const std::string path = snapshotPath("offset");
+    const std::vector<char> original = saveSmallWorld(path);
+
+    WorldSnapshot::Header header;
+    std::memcpy(&header, original.data(), sizeof(header));
+    VERLET_CHECK(header.generatorCount > 0);
+
+    // An offset that wraps around once the section size is added, one past the end of the file, and a misaligned one
+    const uint64_t wrapping = UINT64_MAX - header.generatorCount * sizeof(WorldSnapshot::GeneratorRecord) + 2;
+    for (uint64_t offset : { wrapping, header.fileSize + 16, header.generatorOffset + 4 }) {
+        std::vector<char> bytes = original;
+        std::memcpy(bytes.data() + offsetof(WorldSnapshot::Header, generatorOffset), &offset, sizeof(offset));
+        writeFile(path, bytes);
+        VERLET_CHECK(WorldSnapshot::load(path) == nullptr);
+    }
+    std::filesystem::remove(path);
+}
+
+VERLET_TEST(Snapshot, RejectsWrongRealSize)
+{
+    const std::string path = snapshotPath("real_size");
+    std::vector<char> bytes = saveSmallWorld(path);
+
+    const uint32_t otherSize = sizeof(Real) == sizeof(float) ? sizeof(double) : sizeof(float);
+    std::memcpy(bytes.data() + offsetof(WorldSnapshot::Header, realSize), &otherSize, sizeof(otherSize));
+    writeFile(path, bytes);
+    VERLET_CHECK(WorldSnapshot::load(path) == nullptr);
+    std::filesystem::remove(path);
+}
+
+VERLET_TEST(Snapshot, RejectsBadSubscriberIndex)
+{
+    const std::string path = snapshotPath("subscriber");
+    std::vector<char> bytes = saveSmallWorld(path);
+
+    WorldSnapshot::Header header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    VERLET_CHECK(header.subscriptionCount > 0);
+
+    const uint32_t outOfRange = static_cast<uint32_t>(header.particleCount);
+    std::memcpy(bytes.data() + header.subscriptionOffset, &outOfRange, sizeof(outOfRange));
+    writeFile(path, bytes);
+    VERLET_CHECK(WorldSnapshot::load(path) == nullptr);
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,234 @@
+#include "Contraint.h"
+#include "ForceGeneration.h"
+#include "SimulationWorld.h"
+#include "TestSupport.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <vector>
+
+using namespace VerletPhysics;
+
+namespace {
+
+    const double FRAME_TIME = 1.0 / 60;
+
+    /**
+     * A box of randomly sized particles under gravity, a quarter of them tied to their nearest neighbour,
+     * checked against brute-force scans of every particle and constraint.
+     */
+    struct Scene
+    {
+        SimulationWorld world;
+        ConstantAcceleration gravity;
+        BoxedPositionConstraint box;
+        std::vector<Particle*> particles;
+        std::vector<PairedParticleConstraint*> constraints;
+        std::mt19937 random;
+
+        Scene() :
+            world(4, true),
+            gravity(Vector2(0, 10)),
+            box(Vector2(0, 0), Vector2(80, 80)),
+            random(11)
+        {
+            world.addGenerator(&gravity);
+            world.addConstraint(&box);
+
+            std::uniform_real_distribution<double> coordinate(1, 79);
+            std::uniform_real_distribution<double> radius(0.3, 1.0);
+            for (int i = 0; i < 800; i++) {
+                Particle* particle = world.addParticle(Vector2(Real(coordinate(random)), Real(coordinate(random))), Real(radius(random)));
+                gravity.subscribeParticle(particle);
+                box.subscribeParticle(particle);
+                particles.push_back(particle);
+            }
+
+            // Tie particles to their nearest neighbour, so constraint queries only reach a few cells
+            for (size_t i = 0; i < particles.size(); i += 4) {
+                Particle* nearest = nullptr;
+                Real nearestDistance = 0;
+                for (Particle* other : particles) {
+                    const Real distance = VectorMath::magnitude(other->getPosition() - particles[i]->getPosition());
+                    if (other == particles[i] || (nearest && distance >= nearestDistance)) continue;
+                    nearest = other;
+                    nearestDistance = distance;
+                }
+                constraints.push_back(world.emplaceConstraint<PairedParticleConstraint>(particles[i], nearest, nearestDistance));
+            }
+        }
+
+        Real uniform(double low, double high) { return Real(std::uniform_real_distribution<double>(low, high)(random)); }
+        Vector2 point() { return Vector2(uniform(-5, 85), uniform(-5, 85)); }
+
+        /**
+         * Removes every tenth particle still in the world.
+         */
+        void removeSome()
+        {
+            std::vector<Particle*> removed;
+            std::vector<Particle*> kept;
+            for (size_t i = 0; i < particles.size(); i++) (i % 10 == 3 ? removed : kept).push_back(particles[i]);
+            world.removeParticles(removed);
+            particles = kept;
+        }
+    };
+
+    std::vector<Particle*> sorted(std::vector<Particle*> particles)
+    {
+        std::sort(particles.begin(), particles.end());
+        return particles;
+    }
+
+    std::vector<Particle*> bruteForce(Scene& scene, const std::function<bool(Vector2, Real)>& overlaps)
+    {
+        std::vector<Particle*> found;
+        for (Particle* particle : scene.particles) {
+            if (overlaps(particle->getPosition(), particle->getRadius())) found.push_back(particle);
+        }
+        return sorted(found);
+    }
+
+    double pointSegmentDistanceSquared(Vector2 point, Vector2 a, Vector2 b)
+    {
+        const double abX = double(b.x()) - a.x();
+        const double abY = double(b.y()) - a.y();
+        const double lengthSquared = abX * abX + abY * abY;
+        const double t = lengthSquared > 0 ? std::clamp(((point.x() - a.x()) * abX + (point.y() - a.y()) * abY) / lengthSquared, 0.0, 1.0) : 0;
+        const double dx = a.x() + abX * t - point.x();
+        const double dy = a.y() + abY * t - point.y();
+        return dx * dx + dy * dy;
+    }
+
+    double segmentDistanceSquared(Vector2 a, Vector2 b, Vector2 c, Vector2 d)
+    {
+        auto side = [](Vector2 from, Vector2 to, Vector2 point) {
+            return (double(to.x()) - from.x()) * (double(point.y()) - from.y()) - (double(to.y()) - from.y()) * (double(point.x()) - from.x());
+        };
+        if (side(a, b, c) * side(a, b, d) < 0 && side(c, d, a) * side(c, d, b) < 0) return 0;
+
+        return std::min(std::min(pointSegmentDistanceSquared(a, c, d), pointSegmentDistanceSquared(b, c, d)),
+            std::min(pointSegmentDistanceSquared(c, a, b), pointSegmentDistanceSquared(d, a, b)));
+    }
+
+    /**
+     * Runs a batch of every kind of query at random places and compares each with a brute-force scan.
+     */
+    void checkQueries(Scene& scene)
+    {
+        SimulationWorld& world = scene.world;
+        std::vector<Particle*> results;
+
+        for (int query = 0; query < 40; query++) {
+            // Points are aimed at particles, so most of them hit one
+            const Vector2 point = scene.particles[query * 7 % scene.particles.size()]->getPosition() + Vector2(scene.uniform(-1, 1), scene.uniform(-1, 1));
+            world.queryPoint(point, results);
+            VERLET_CHECK(sorted(results) == bruteForce(scene, [&](Vector2 centre, Real radius) {
+                const Vector2 offset = centre - point;
+                return offset.x() * offset.x() + offset.y() * offset.y() <= radius * radius;
+            }));
+
+            const Vector2 centre = scene.point();
+            const Real reach = scene.uniform(0, 6);
+            world.queryRadius(centre, reach, results);
+            VERLET_CHECK(sorted(results) == bruteForce(scene, [&](Vector2 position, Real radius) {
+                const Vector2 offset = position - centre;
+                return offset.x() * offset.x() + offset.y() * offset.y() <= (reach + radius) * (reach + radius);
+            }));
+
+            const Vector2 corner = scene.point();
+            const Vector2 minimum = corner;
+            const Vector2 maximum = corner + Vector2(scene.uniform(0, 15), scene.uniform(0, 15));
+            world.queryBox(minimum, maximum, results);
+            VERLET_CHECK(sorted(results) == bruteForce(scene, [&](Vector2 position, Real radius) {
+                const Real offsetX = position.x() - std::min(std::max(position.x(), minimum.x()), maximum.x());
+                const Real offsetY = position.y() - std::min(std::max(position.y(), minimum.y()), maximum.y());
+                return offsetX * offsetX + offsetY * offsetY <= radius * radius;
+            }));
+
+            // The closest particle the ray enters within its length, or the one it starts inside
+            const Vector2 origin = scene.point();
+            const double angle = scene.uniform(0, 6.283185307179586);
+            const Vector2 direction(Real(std::cos(angle) * 3), Real(std::sin(angle) * 3));
+            const Real maxDistance = scene.uniform(5, 60);
+            Particle* closest = nullptr;
+            double closestDistance = maxDistance;
+            for (Particle* particle : scene.particles) {
+                const double offsetX = double(origin.x()) - particle->getPosition().x();
+                const double offsetY = double(origin.y()) - particle->getPosition().y();
+                const double along = (offsetX * direction.x() + offsetY * direction.y()) / 3;
+                const double outside = offsetX * offsetX + offsetY * offsetY - double(particle->getRadius()) * particle->getRadius();
+                const double discriminant = along * along - outside;
+                if (discriminant < 0) continue;
+
+                const double distance = outside <= 0 ? 0 : -along - std::sqrt(discriminant);
+                if (distance < 0 || distance > closestDistance || (closest && distance == closestDistance)) continue;
+                closest = particle;
+                closestDistance = distance;
+            }
+
+            RayHit hit;
+            VERLET_CHECK(world.rayCast(origin, direction, maxDistance, hit) == (closest != nullptr));
+            VERLET_CHECK(hit.particle == closest);
+            if (closest) VERLET_CHECK(std::abs(hit.distance - closestDistance) < 1e-3);
+
+            const Vector2 start = scene.point();
+            const Vector2 end = start + Vector2(scene.uniform(-10, 10), scene.uniform(-10, 10));
+            const Real leeway = scene.uniform(0, 2);
+            std::vector<PairedParticleConstraint*> links;
+            world.queryConstraints(start, end, leeway, links);
+
+            std::vector<PairedParticleConstraint*> expected;
+            for (PairedParticleConstraint* constraint : scene.constraints) {
+                if (!constraint->isEnabled()) continue;
+                const double distanceSquared = segmentDistanceSquared(constraint->getParticleA()->getPosition(),
+                    constraint->getParticleB()->getPosition(), start, end);
+                if (distanceSquared <= double(leeway) * leeway) expected.push_back(constraint);
+            }
+            std::sort(links.begin(), links.end());
+            std::sort(expected.begin(), expected.end());
+            VERLET_CHECK(links == expected);
+        }
+    }
+
+    void run(Scene& scene, int frames)
+    {
+        for (int frame = 0; frame < frames; frame++) scene.world.update(FRAME_TIME);
+    }
+}
+
+VERLET_TEST(SpatialQuery, MatchesBruteForce)
+{
+    Scene scene;
+    checkQueries(scene);
+    run(scene, 20);
+    checkQueries(scene);
+}
+
+VERLET_TEST(SpatialQuery, MatchesBruteForceAfterRemoval)
+{
+    Scene scene;
+    run(scene, 10);
+    checkQueries(scene);
+
+    // Queried again straight away, so the index has to notice the removal without an update
+    scene.removeSome();
+    checkQueries(scene);
+    run(scene, 5);
+    checkQueries(scene);
+}
+
+VERLET_TEST(SpatialQuery, MatchesBruteForceAfterSorting)
+{
+    Scene scene;
+    run(scene, 10);
+    checkQueries(scene);
+
+    scene.world.sortParticles();
+    checkQueries(scene);
+    scene.removeSome();
+    scene.world.sortParticles();
+    checkQueries(scene);
+}
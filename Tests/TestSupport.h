@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+/**
+ * Minimal test registry and checks, so the test suite needs nothing beyond the library itself.
+ *
+ * Tests are registered with `VERLET_TEST` and run by `TestSupport::runTests`, which takes an optional
+ * name prefix so ctest can run each group as its own test. A failed `VERLET_CHECK` reports the
+ * expression and location and marks the running test as failed without stopping it.
+ */
+namespace TestSupport {
+
+    using TestBody = void (*)();
+
+    /**
+     * A named test function.
+     */
+    struct TestCase
+    {
+        const char* name; ///< Name reported when the test runs, `Group.Case` by convention.
+        TestBody body;    ///< Function performing the checks.
+    };
+
+    inline std::vector<TestCase>& registry()
+    {
+        static std::vector<TestCase> tests;
+        return tests;
+    }
+
+    inline bool& currentTestFailed()
+    {
+        static bool failed = false;
+        return failed;
+    }
+
+    /**
+     * Adds a test to the registry when constructed at namespace scope.
+     */
+    struct Registrar
+    {
+        Registrar(const char* name, TestBody body) { registry().push_back({ name, body }); }
+    };
+
+    inline void reportFailure(const char* file, int line, const char* expression)
+    {
+        std::printf("%s:%d: check failed: %s\n", file, line, expression);
+        currentTestFailed() = true;
+    }
+
+    /**
+     * Runs every registered test whose name starts with a prefix.
+     *
+     * @param prefix Name prefix selecting the tests, or null to run all of them.
+     * @return Zero if every selected test passed and at least one was selected.
+     */
+    inline int runTests(const char* prefix)
+    {
+        size_t run = 0;
+        size_t failed = 0;
+
+        for (const TestCase& test : registry()) {
+            if (prefix && std::strncmp(test.name, prefix, std::strlen(prefix)) != 0) continue;
+
+            currentTestFailed() = false;
+            test.body();
+            run++;
+
+            std::printf("[%s] %s\n", currentTestFailed() ? "FAILED" : "passed", test.name);
+            if (currentTestFailed()) failed++;
+        }
+
+        std::printf("%zu of %zu tests passed\n", run - failed, run);
+        return failed == 0 && run > 0 ? 0 : 1;
+    }
+}
+
+#define VERLET_TEST(group, name) \
+    static void group##_##name(); \
+    static TestSupport::Registrar group##_##name##_registrar(#group "." #name, group##_##name); \
+    static void group##_##name()
+
+#define VERLET_CHECK(condition) \
+    do { if (!(condition)) TestSupport::reportFailure(__FILE__, __LINE__, #condition); } while (false)
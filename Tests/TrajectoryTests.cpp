@@ -0,0 +1,113 @@
+#include "SimulationWorld.h"
+#include "TestSupport.h"
+#include "TrajectoryWriter.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace VerletPhysics;
+
+namespace {
+
+    const size_t FILE_HEADER_SIZE = 36;
+    const size_t CHUNK_HEADER_SIZE = 16;
+
+    std::string trajectoryPath(const char* name)
+    {
+        return (std::filesystem::temp_directory_path() / (std::string("verlet_") + name + ".vtrj")).string();
+    }
+
+    std::vector<uint8_t> readFile(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    int32_t readI32(const std::vector<uint8_t>& bytes, size_t& offset)
+    {
+        uint32_t value = 0;
+        for (int shift = 0; shift < 32; shift += 8) value |= static_cast<uint32_t>(bytes[offset++]) << shift;
+        return static_cast<int32_t>(value);
+    }
+
+    int64_t readZigzagVarint(const std::vector<uint8_t>& bytes, size_t& offset)
+    {
+        uint64_t value = 0;
+        for (int shift = 0;; shift += 7) {
+            const uint8_t byte = bytes[offset++];
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) break;
+        }
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+}
+
+VERLET_TEST(Trajectory, DeltasWiderThanInt32RoundTrip)
+{
+    const std::string path = trajectoryPath("wide_delta");
+    SimulationWorld world(1, false);
+    Particle* particle = world.addParticle(Vector2(200000, 0), Real(1));
+
+    {
+        // Both positions fit in an int32 once quantized, but their difference does not
+        TrajectoryWriter writer(path, 1, 1, TrajectoryCompression::QuantizedDelta, 1e-4, 2);
+        writer.writeFrame(world.getParticles());
+        particle->resetPosition(Vector2(-200000, 0));
+        writer.writeFrame(world.getParticles());
+        VERLET_CHECK(writer.close());
+    }
+
+    const std::vector<uint8_t> bytes = readFile(path);
+    std::filesystem::remove(path);
+    VERLET_CHECK(bytes.size() > FILE_HEADER_SIZE + CHUNK_HEADER_SIZE);
+    if (bytes.size() <= FILE_HEADER_SIZE + CHUNK_HEADER_SIZE) return;
+
+    size_t offset = FILE_HEADER_SIZE + CHUNK_HEADER_SIZE;
+    const int64_t firstX = readI32(bytes, offset);
+    const int64_t firstY = readI32(bytes, offset);
+    const int64_t secondX = firstX + readZigzagVarint(bytes, offset);
+    const int64_t secondY = firstY + readZigzagVarint(bytes, offset);
+
+    VERLET_CHECK(firstX == 2000000000);
+    VERLET_CHECK(secondX == -2000000000);
+    VERLET_CHECK(firstY == 0 && secondY == 0);
+    VERLET_CHECK(offset == bytes.size());
+}
+
+VERLET_TEST(Trajectory, FailsOutsideQuantizedRange)
+{
+    const std::string path = trajectoryPath("out_of_range");
+    SimulationWorld world(1, false);
+    world.addParticle(Vector2(1000000, 0), Real(1));
+
+    TrajectoryWriter writer(path, 1, 1, TrajectoryCompression::Quantized, 1e-4);
+    writer.writeFrame(world.getParticles());
+    VERLET_CHECK(!writer.close());
+    std::filesystem::remove(path);
+}
+
+VERLET_TEST(Trajectory, FailsAfterRemoval)
+{
+    const std::string path = trajectoryPath("removal");
+    SimulationWorld world(1, false);
+    std::vector<Particle*> particles;
+    for (int i = 0; i < 4; i++) particles.push_back(world.addParticle(Vector2(Real(i), 0), Real(0.4)));
+
+    TrajectoryWriter writer(path, particles.size(), 1);
+    writer.writeFrame(world.getParticles());
+    VERLET_CHECK(writer.isGood());
+
+    // Adding a particle back restores the count, but the removed creation slot stays lost
+    world.removeParticles({ particles[1] });
+    world.addParticle(Vector2(1, 0), Real(0.4));
+    writer.writeFrame(world.getParticles());
+    VERLET_CHECK(!writer.isGood());
+    VERLET_CHECK(writer.getFrameCount() == 1);
+    VERLET_CHECK(!writer.close());
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,6 @@
+#include "TestSupport.h"
+
+int main(int argc, char** argv)
+{
+    return TestSupport::runTests(argc > 1 ? argv[1] : nullptr);
+}
@@ -0,0 +1,152 @@
+#include "ContinuousCollision.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+using namespace VerletPhysics;
+
+size_t ContinuousCollision::resolve(ParticleStore& particles, ThreadPool& threadPool)
+{
+    Real* positionX = particles.positionX();
+    Real* positionY = particles.positionY();
+    Real* previousX = particles.previousX();
+    Real* previousY = particles.previousY();
+    const Real* radius = particles.radius();
+    const uint8_t* isStatic = particles.isStatic();
+
+    // Squared displacements, so only the longest move needs a square root
+    const Real threshold = m_threshold;
+    Real longestSquared = 0;
+    std::mutex fastMutex;
+    m_fast.clear();
+
+    // Sleeping particles do not move, but fast ones still strike them
+    threadPool.parallelFor(0, particles.getAwakeCount(), 4096, [&](size_t begin, size_t end) {
+        std::vector<uint32_t> rangeFast;
+        Real rangeLongest = 0;
+
+        for (size_t i = begin; i < end; i++) {
+            if (isStatic[i]) continue;
+
+            const Real dx = positionX[i] - previousX[i];
+            const Real dy = positionY[i] - previousY[i];
+            const Real displacementSquared = dx * dx + dy * dy;
+            const Real limit = radius[i] * threshold;
+
+            rangeLongest = std::max(rangeLongest, displacementSquared);
+            if (displacementSquared > limit * limit) rangeFast.push_back(static_cast<uint32_t>(i));
+        }
+
+        std::lock_guard<std::mutex> lock(fastMutex);
+        longestSquared = std::max(longestSquared, rangeLongest);
+        m_fast.insert(m_fast.end(), rangeFast.begin(), rangeFast.end());
+    });
+
+    if (m_fast.empty()) return 0;
+
+    // Ranges finish in any order
+    std::sort(m_fast.begin(), m_fast.end());
+    m_grid.rebuild(particles);
+
+    // Any particle whose path comes within reach of a swept path lies in a cell near it now
+    const double longest = std::sqrt(static_cast<double>(longestSquared));
+    size_t impacts = 0;
+
+    for (uint32_t i : m_fast) {
+        const double reach = radius[i] + m_grid.getCellSize() * 0.5 + longest;
+
+        size_t firstColumn, lastColumn, firstRow, lastRow;
+        if (!m_grid.columnRange(std::min(previousX[i], positionX[i]) - reach, std::max(previousX[i], positionX[i]) + reach, firstColumn, lastColumn)) continue;
+        if (!m_grid.rowRange(std::min(previousY[i], positionY[i]) - reach, std::max(previousY[i], positionY[i]) + reach, firstRow, lastRow)) continue;
+
+        double earliest = 2;
+        size_t struck = i;
+
+        for (size_t row = firstRow; row <= lastRow; row++) {
+            for (size_t column = firstColumn; column <= lastColumn; column++) {
+                for (const size_t* entry = m_grid.cellBegin(column, row); entry != m_grid.cellEnd(column, row); entry++) {
+                    double time;
+                    if (*entry == i || !timeOfImpact(particles, i, *entry, time) || time >= earliest) continue;
+
+                    earliest = time;
+                    struck = *entry;
+                }
+            }
+        }
+
+        if (struck == i) continue;
+        impacts++;
+
+        const double moveX = positionX[i] - previousX[i];
+        const double moveY = positionY[i] - previousY[i];
+        const double contactX = previousX[i] + moveX * earliest;
+        const double contactY = previousY[i] + moveY * earliest;
+
+        const double otherMoveX = isStatic[struck] ? 0 : positionX[struck] - previousX[struck];
+        const double otherMoveY = isStatic[struck] ? 0 : positionY[struck] - previousY[struck];
+        double normalX = contactX - (previousX[struck] + otherMoveX * earliest);
+        double normalY = contactY - (previousY[struck] + otherMoveY * earliest);
+        const double normalLength = std::sqrt(normalX * normalX + normalY * normalY);
+
+        // Coincident centres have no normal, so the whole move is taken back
+        if (normalLength > 0) {
+            normalX /= normalLength;
+            normalY /= normalLength;
+        }
+        else {
+            normalX = -moveX;
+            normalY = -moveY;
+            const double moveLength = std::sqrt(moveX * moveX + moveY * moveY);
+            normalX /= moveLength;
+            normalY /= moveLength;
+        }
+
+        // Only the velocity heading into the other particle is lost, so glancing hits slide off
+        const double approach = std::min(moveX * normalX + moveY * normalY, 0.0);
+        const double keptX = moveX - normalX * approach;
+        const double keptY = moveY - normalY * approach;
+
+        positionX[i] = static_cast<Real>(contactX);
+        positionY[i] = static_cast<Real>(contactY);
+        previousX[i] = static_cast<Real>(contactX - keptX);
+        previousY[i] = static_cast<Real>(contactY - keptY);
+    }
+
+    return impacts;
+}
+
+bool ContinuousCollision::timeOfImpact(const ParticleStore& particles, size_t i, size_t j, double& time) const
+{
+    const Real* positionX = particles.positionX();
+    const Real* positionY = particles.positionY();
+    const Real* previousX = particles.previousX();
+    const Real* previousY = particles.previousY();
+    const Real* radius = particles.radius();
+    const uint8_t* isStatic = particles.isStatic();
+
+    // Relative motion of i seen from j, which stands still if it cannot move
+    const double startX = static_cast<double>(previousX[i]) - (isStatic[j] ? positionX[j] : previousX[j]);
+    const double startY = static_cast<double>(previousY[i]) - (isStatic[j] ? positionY[j] : previousY[j]);
+    const double moveX = static_cast<double>(positionX[i] - previousX[i]) - (isStatic[j] ? 0 : positionX[j] - previousX[j]);
+    const double moveY = static_cast<double>(positionY[i] - previousY[i]) - (isStatic[j] ? 0 : positionY[j] - previousY[j]);
+    const double radii = static_cast<double>(radius[i]) + radius[j];
+
+    // Solve |start + move * t| = radii for the first t in [0, 1]
+    const double a = moveX * moveX + moveY * moveY;
+    const double b = startX * moveX + startY * moveY;
+    const double c = startX * startX + startY * startY - radii * radii;
+    if (!(b < 0)) return false;
+
+    // Already touching and still closing in, so the particle may not move any closer
+    if (c <= 0) {
+        time = 0;
+        return true;
+    }
+
+    const double discriminant = b * b - a * c;
+    if (discriminant < 0) return false;
+
+    time = c / (-b + std::sqrt(discriminant));
+    return time <= 1;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "PhysicsMath.h"
+#include "Particle.h"
+#include "SpatialGrid.h"
+#include "ThreadPool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace VerletPhysics {
+
+    /**
+     * Stops fast particles from tunnelling through each other between substeps.
+     *
+     * After integration, every awake particle that moved further than a fraction of its radius is
+     * swept from its previous position to its current one. Both particles of a pair are assumed to
+     * move in a straight line over the substep, so the first time they touch is the smaller root of
+     * a quadratic. A fast particle that strikes another is moved back to the point of impact and
+     * loses the part of its velocity heading into the other particle, keeping the rest so it slides
+     * off. Candidates come from a `SpatialGrid` over the current positions, searched around each
+     * swept path grown by the longest move of any particle, so only the cells near the path are read.
+     *
+     * Fast particles are handled one after another in index order, each against the already
+     * corrected paths of those before it, which keeps the result independent of the thread count.
+     * When nothing moves fast, the pass costs a single parallel scan of the displacements.
+     *
+     * Box and circle constraints keep their particles inside and project escaped ones straight back,
+     * so they cannot be tunnelled through and are not swept.
+     */
+    class ContinuousCollision
+    {
+        bool m_enabled = false;          ///< Whether fast particles are swept at all.
+        Real m_threshold = Real(0.5);    ///< Displacement per substep, as a fraction of the radius, above which a particle is swept.
+
+        SpatialGrid m_grid;              ///< Current positions, rebuilt only in substeps with fast particles.
+        std::vector<uint32_t> m_fast;    ///< Particles swept in the current substep, in ascending order.
+
+    public:
+        /**
+         * Enables or disables sweeping fast particles.
+         *
+         * @param enabled `true` to sweep fast particles in every collision pass.
+         */
+        void setEnabled(bool enabled) { m_enabled = enabled; }
+
+        /**
+         * Checks whether fast particles are swept.
+         *
+         * @return `true` if continuous collision detection is enabled.
+         */
+        bool isEnabled() const { return m_enabled; }
+
+        /**
+         * Sets how far a particle has to move in one substep to be swept.
+         *
+         * @param threshold Displacement as a fraction of the particle's radius. Particles moving at
+         *                  most this far are left to the discrete collision pass.
+         */
+        void setThreshold(Real threshold) { m_threshold = threshold; }
+
+        /**
+         * Gets how far a particle has to move in one substep to be swept.
+         *
+         * @return The displacement threshold, as a fraction of the radius.
+         */
+        Real getThreshold() const { return m_threshold; }
+
+        /**
+         * Sweeps every fast particle and moves those that struck another back to the point of impact.
+         *
+         * @param particles The store holding the particles, after integration.
+         * @param threadPool Pool the displacement scan is split across.
+         * @return The number of impacts found.
+         */
+        size_t resolve(ParticleStore& particles, ThreadPool& threadPool);
+
+    private:
+        /**
+         * Finds the first time in a substep at which two particles touch.
+         *
+         * @param particles The store holding the particles.
+         * @param i Index of the swept particle.
+         * @param j Index of the other particle.
+         * @param time Receives the fraction of the substep at which they first touch.
+         * @return `true` if the particles approach each other and touch during the substep.
+         */
+        bool timeOfImpact(const ParticleStore& particles, size_t i, size_t j, double& time) const;
+    };
+}
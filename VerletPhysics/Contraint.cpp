@@ -1,5 +1,7 @@
 #include "Contraint.h"
 
+#include <algorithm>
+
 using namespace VerletPhysics;
 
 BoxedPositionConstraint::BoxedPositionConstraint(Vector2 cornorA, Vector2 cornorB)
@@ -13,34 +15,38 @@ BoxedPositionConstraint::BoxedPositionConstraint(Vector2 cornorA, Vector2 cornor
 
 void BoxedPositionConstraint::processConstraint()
 {
-	for (Particle* particle : m_particles) {
+	if (m_particles.empty()) return;
 
-		Vector2 minPos = particle->getPosition() - Vector2(particle->getRadius(), particle->getRadius());
-		Vector2 maxPos = particle->getPosition() + Vector2(particle->getRadius(), particle->getRadius());
+	Real* positionX = m_store->positionX();
+	Real* positionY = m_store->positionY();
+	const Real* radius = m_store->radius();
+	const uint8_t* isStatic = m_store->isStatic();
 
-		if (minPos.x() < m_minX) {
-			particle->updatePosition(Vector2(m_minX + particle->getRadius(), particle->getPosition().y()));
-		}
-		if (minPos.y() < m_minY) {
-			particle->updatePosition(Vector2(particle->getPosition().x(), m_minY + particle->getRadius()));
-		}
+	for (size_t i : m_particles) {
+		if (isStatic[i]) continue;
 
-		if (maxPos.x() > m_maxX) {
-			particle->updatePosition(Vector2(m_maxX - particle->getRadius(), particle->getPosition().y()));
-		}
-		if (maxPos.y() > m_maxY) {
-			particle->updatePosition(Vector2(particle->getPosition().x(), m_maxY - particle->getRadius()));
-		}
+		if (positionX[i] - radius[i] < m_minX) positionX[i] = m_minX + radius[i];
+		if (positionY[i] - radius[i] < m_minY) positionY[i] = m_minY + radius[i];
 
+		if (positionX[i] + radius[i] > m_maxX) positionX[i] = m_maxX - radius[i];
+		if (positionY[i] + radius[i] > m_maxY) positionY[i] = m_maxY - radius[i];
 	}
 }
 
 void WorldPositionConstraint::subscribeParticle(Particle* subscriber)
 {
-	m_particles.push_back(subscriber);
+	m_store = subscriber->getStore();
+	m_particles.add(subscriber->getIndex());
+	if (m_listener) m_listener->onConstraintStateChanged(this);
+}
+
+bool WorldPositionConstraint::remapParticles(const ParticleRemap& remap)
+{
+	m_particles.remap(remap);
+	return true;
 }
 
-EncircledPositionConstraint::EncircledPositionConstraint(double radius, Vector2 centerPoint)
+EncircledPositionConstraint::EncircledPositionConstraint(Real radius, Vector2 centerPoint)
 {
 	m_radius = radius;
 	m_centerPoint = centerPoint;
@@ -48,46 +54,102 @@ EncircledPositionConstraint::EncircledPositionConstraint(double radius, Vector2
 
 void EncircledPositionConstraint::processConstraint()
 {
-	for (Particle* particle : m_particles) {
-		Vector2 displacement = particle->getPosition() - m_centerPoint;
-		double distanceToCenter = VectorMath::magnitude(displacement) + particle->getRadius();
+	if (m_particles.empty()) return;
+
+	Real* positionX = m_store->positionX();
+	Real* positionY = m_store->positionY();
+	const Real* radius = m_store->radius();
+	const uint8_t* isStatic = m_store->isStatic();
+
+	for (size_t i : m_particles) {
+		Vector2 displacement = Vector2(positionX[i], positionY[i]) - m_centerPoint;
+		Real distanceToCenter = VectorMath::magnitude(displacement) + radius[i];
 
 		// If the particle is outside the circular boundary, reposition it on the circle's edge
-		if (distanceToCenter > m_radius) {
+		if (distanceToCenter > m_radius && !isStatic[i]) {
 
 			displacement = VectorMath::normalize(displacement);
-			Vector2 newPosition = m_centerPoint + displacement * (m_radius - particle->getRadius());
-			particle->updatePosition(newPosition);
+			Vector2 newPosition = m_centerPoint + displacement * (m_radius - radius[i]);
+			positionX[i] = newPosition.x();
+			positionY[i] = newPosition.y();
 		}
 	}
 }
 
 void PairedParticleConstraint::processConstraint()
 {
+	Real* positionX = c_store->positionX();
+	Real* positionY = c_store->positionY();
+	const uint8_t* isStatic = c_store->isStatic();
+
+	Vector2 positionA = Vector2(positionX[m_indexA], positionY[m_indexA]);
+	Vector2 positionB = Vector2(positionX[m_indexB], positionY[m_indexB]);
 
-	Vector2 displacement = c_particleB->getPosition() - c_particleA->getPosition();
-	double currentDistance = VectorMath::magnitude(displacement);
+	Vector2 displacement = positionB - positionA;
+	Real currentDistance = VectorMath::magnitude(displacement);
 
 	// If the current distance is greater than the maximum allowed distance, adjust their positions
 	if (currentDistance > c_maxDistance) {
 
 		displacement = VectorMath::normalize(displacement);
-		Vector2 newPositionA = c_particleA->getPosition() + displacement * (currentDistance - c_maxDistance) * 0.5;
-		Vector2 newPositionB = c_particleB->getPosition() - displacement * (currentDistance - c_maxDistance) * 0.5;
+		Vector2 newPositionA = positionA + displacement * (currentDistance - c_maxDistance) * 0.5;
+		Vector2 newPositionB = positionB - displacement * (currentDistance - c_maxDistance) * 0.5;
 
-		c_particleA->updatePosition(newPositionA);
-		c_particleB->updatePosition(newPositionB);
+		if (!isStatic[m_indexA]) {
+			positionX[m_indexA] = newPositionA.x();
+			positionY[m_indexA] = newPositionA.y();
+		}
+		if (!isStatic[m_indexB]) {
+			positionX[m_indexB] = newPositionB.x();
+			positionY[m_indexB] = newPositionB.y();
+		}
 	}
 }
 
-PairedParticleConstraint::PairedParticleConstraint(Particle* particleA, Particle* particleB, double maxDistance) :
-	c_particleA(particleA),
-	c_particleB(particleB),
+PairedParticleConstraint::PairedParticleConstraint(Particle* particleA, Particle* particleB, Real maxDistance) :
+	c_store(particleA->getStore()),
+	m_indexA(particleA->getIndex()),
+	m_indexB(particleB->getIndex()),
 	c_maxDistance(maxDistance)
 {}
 
+bool PairedParticleConstraint::remapParticles(const ParticleRemap& remap)
+{
+	if (std::binary_search(remap.removed.begin(), remap.removed.end(), m_indexA) ||
+		std::binary_search(remap.removed.begin(), remap.removed.end(), m_indexB)) {
+		disable();
+		return false;
+	}
+
+	// Moves happen at once, so both lookups use the previous indices
+	size_t indexA = m_indexA;
+	size_t indexB = m_indexB;
+	for (const ParticleMove& move : remap.moved) {
+		if (move.from == m_indexA) indexA = move.to;
+		if (move.from == m_indexB) indexB = move.to;
+	}
+
+	m_indexA = indexA;
+	m_indexB = indexB;
+	return true;
+}
+
 void VerletPhysics::Constraint::handleConstraint()
 {
 	if (!m_enabled) return;
 	processConstraint();
 }
+
+void VerletPhysics::Constraint::enable()
+{
+	if (m_enabled) return;
+	m_enabled = true;
+	if (m_listener) m_listener->onConstraintStateChanged(this);
+}
+
+void VerletPhysics::Constraint::disable()
+{
+	if (!m_enabled) return;
+	m_enabled = false;
+	if (m_listener) m_listener->onConstraintStateChanged(this);
+}
@@ -1,9 +1,26 @@
 #pragma once
 #include "Particle.h"
+#include "SubscriberList.h"
 #include <vector>
 
 namespace VerletPhysics {
 
+    class Constraint;
+
+    /**
+     * Interface for objects that need to know when a constraint is enabled, disabled or
+     * subscribes a new particle.
+     */
+    struct ConstraintListener
+    {
+        /**
+         * Called after a constraint's enabled state or subscribers have changed.
+         *
+         * @param constraint The constraint whose state changed.
+         */
+        virtual void onConstraintStateChanged(Constraint* constraint) = 0;
+    };
+
     /**
      * Base class for constraints in the Verlet physics simulation.
      *
@@ -15,9 +32,11 @@ namespace VerletPhysics {
     {
     protected:
         bool m_enabled = true; ///< Flag indicating whether the constraint is enabled.
+        ConstraintListener* m_listener = nullptr; ///< Notified when the constraint is enabled, disabled or changed.
         virtual void processConstraint() = 0; ///< Virtual method to process the constraint.
 
     public:
+        virtual ~Constraint() = default;
 
         /**
          * Handles the constraint.
@@ -29,19 +48,40 @@ namespace VerletPhysics {
         /**
          * Enables the constraint.
          */
-        void enable() { m_enabled = true; }
+        void enable();
 
         /**
          * Disables the constraint.
          */
-        void disable() { m_enabled = false; }
+        void disable();
+
+        /**
+         * Sets the listener notified whenever the constraint is enabled or disabled.
+         *
+         * @param listener Pointer to the listener, or `nullptr` to stop notifications.
+         */
+        void setListener(ConstraintListener* listener) { m_listener = listener; }
+
+        /**
+         * Points the constraint at the new indices of its particles after their store was reordered
+         * or particles were removed from it.
+         *
+         * Constraints that only reach their particles through `Particle` handles need not override
+         * this, as long as none of their particles are removed. Overrides should take time
+         * proportional to the remap rather than to the number of particles.
+         *
+         * @param remap The removed particles and every particle that changed index.
+         * @return `false` if the constraint cannot work without a removed particle and has to be
+         *         dropped from the world.
+         */
+        virtual bool remapParticles(const ParticleRemap& /*remap*/) { return true; }
 
         /**
          * Checks if the constraint is enabled.
          *
          * @return `true` if the constraint is enabled, `false` otherwise.
          */
-        bool isEnabled() { return m_enabled; }
+        bool isEnabled() const { return m_enabled; }
     };
 
 
@@ -55,7 +95,8 @@ namespace VerletPhysics {
     class WorldPositionConstraint : public Constraint
     {
     protected:
-        std::vector<Particle*> m_particles; ///< Collection of particles affected by the constraint.
+        ParticleStore* m_store = nullptr; ///< Store holding the subscribed particles.
+        SubscriberList m_particles;       ///< Indices of the particles affected by the constraint.
 
     public:
 
@@ -63,9 +104,33 @@ namespace VerletPhysics {
          * Subscribes a particle to be affected by the constraint.
          *
          * @param subscriber Pointer to the Particle object to be affected.
+         * @note Every subscriber must belong to the same simulation world. Subscribing a particle
+         *       twice has no effect.
          */
         void subscribeParticle(Particle* subscriber);
 
+        /**
+         * Gets the store indices of every subscribed particle.
+         *
+         * @return The subscribers, in subscription order until particles are removed or sorted.
+         */
+        const std::vector<size_t>& getSubscribers() const { return m_particles.indices(); }
+
+        /**
+         * Gets the subscribed particles along with where each sits in the list.
+         *
+         * @return The subscriber list.
+         */
+        const SubscriberList& getSubscriberList() const { return m_particles; }
+
+        /**
+         * Remaps the moved subscribers and unsubscribes removed ones, see `SubscriberList::remap`.
+         *
+         * @param remap The removed particles and every particle that changed index.
+         * @return `true`, as the constraint keeps working with any subset of its particles.
+         */
+        virtual bool remapParticles(const ParticleRemap& remap) override;
+
         /**
          * Processes the position-based constraint.
          */
@@ -81,10 +146,10 @@ namespace VerletPhysics {
      */
     class BoxedPositionConstraint : public WorldPositionConstraint
     {
-        double m_minX; ///< Minimum X-coordinate of the box.
-        double m_minY; ///< Minimum Y-coordinate of the box.
-        double m_maxX; ///< Maximum X-coordinate of the box.
-        double m_maxY; ///< Maximum Y-coordinate of the box.
+        Real m_minX; ///< Minimum X-coordinate of the box.
+        Real m_minY; ///< Minimum Y-coordinate of the box.
+        Real m_maxX; ///< Maximum X-coordinate of the box.
+        Real m_maxY; ///< Maximum Y-coordinate of the box.
 
     public:
 
@@ -96,6 +161,20 @@ namespace VerletPhysics {
          */
         BoxedPositionConstraint(Vector2 cornerA, Vector2 cornerB);
 
+        /**
+         * Gets the corner of the box with the smallest coordinates.
+         *
+         * @return The minimum corner.
+         */
+        Vector2 getMinCorner() const { return Vector2(m_minX, m_minY); }
+
+        /**
+         * Gets the corner of the box with the largest coordinates.
+         *
+         * @return The maximum corner.
+         */
+        Vector2 getMaxCorner() const { return Vector2(m_maxX, m_maxY); }
+
         /**
          * Processes the boxed position constraint, confining particles within the defined box.
          */
@@ -111,7 +190,7 @@ namespace VerletPhysics {
      */
     class EncircledPositionConstraint : public WorldPositionConstraint
     {
-        double m_radius;       ///< Radius of the circular area.
+        Real m_radius;         ///< Radius of the circular area.
         Vector2 m_centerPoint; ///< Center point of the circular area.
 
     public:
@@ -122,7 +201,21 @@ namespace VerletPhysics {
          * @param radius The radius of the circular area.
          * @param centerPoint The center point of the circular area.
          */
-        EncircledPositionConstraint(double radius, Vector2 centerPoint);
+        EncircledPositionConstraint(Real radius, Vector2 centerPoint);
+
+        /**
+         * Gets the radius of the circular area.
+         *
+         * @return The radius.
+         */
+        Real getRadius() const { return m_radius; }
+
+        /**
+         * Gets the center point of the circular area.
+         *
+         * @return The center point.
+         */
+        Vector2 getCenterPoint() const { return m_centerPoint; }
 
         /**
          * Processes the encircled position constraint, confining particles within the defined circle.
@@ -139,9 +232,12 @@ namespace VerletPhysics {
      */
     class PairedParticleConstraint : public Constraint
     {
-        Particle* const c_particleA; ///< Pointer to the first particle involved in the constraint.
-        Particle* const c_particleB; ///< Pointer to the second particle involved in the constraint.
-        const double c_maxDistance; ///< Maximum allowed distance between the particles.
+        ParticleStore* const c_store; ///< Store holding both particles.
+        size_t m_indexA;              ///< Index of the first particle involved in the constraint.
+        size_t m_indexB;              ///< Index of the second particle involved in the constraint.
+        const Real c_maxDistance;     ///< Maximum allowed distance between the particles.
+
+        friend class DistanceConstraintSolver;
 
     public:
 
@@ -152,25 +248,57 @@ namespace VerletPhysics {
          * @param particleB Pointer to the second particle involved in the constraint.
          * @param maxDistance The maximum allowed distance between the particles.
          */
-        PairedParticleConstraint(Particle* particleA, Particle* particleB, double maxDistance);
+        PairedParticleConstraint(Particle* particleA, Particle* particleB, Real maxDistance);
 
         /**
          * Processes the paired particle constraint, enforcing the maximum distance between the particles.
          */
         virtual void processConstraint() override;
 
+        /**
+         * Remaps both particles of the constraint, or disables it if either was removed.
+         *
+         * Looks through every move of the remap, so `DistanceConstraintSolver` remaps the
+         * constraints it holds itself, through the moved particles' constraints.
+         *
+         * @param remap The removed particles and every particle that changed index.
+         * @return `false` if either particle was removed.
+         */
+        virtual bool remapParticles(const ParticleRemap& remap) override;
+
         /**
          * Gets a pointer to the first particle involved in the constraint.
          *
          * @return Pointer to the first particle.
          */
-        Particle* getParticleA() const { return c_particleA; }
+        Particle* getParticleA() const { return c_store->getHandle(m_indexA); }
 
         /**
          * Gets a pointer to the second particle involved in the constraint.
          *
          * @return Pointer to the second particle.
          */
-        Particle* getParticleB() const { return c_particleB; }
+        Particle* getParticleB() const { return c_store->getHandle(m_indexB); }
+
+        /**
+         * Gets the store index of the first particle involved in the constraint.
+         *
+         * @return Index of the first particle.
+         */
+        size_t getIndexA() const { return m_indexA; }
+
+        /**
+         * Gets the store index of the second particle involved in the constraint.
+         *
+         * @return Index of the second particle.
+         */
+        size_t getIndexB() const { return m_indexB; }
+
+        /**
+         * Gets the maximum allowed distance between the particles.
+         *
+         * @return The maximum distance.
+         */
+        Real getMaxDistance() const { return c_maxDistance; }
     };
 }
@@ -0,0 +1,397 @@
+#include "DistanceConstraintSolver.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <mutex>
+
+using namespace VerletPhysics;
+
+namespace {
+
+    // A particle's colours fit in one 64-bit mask; anything beyond is solved serially
+    constexpr size_t MAX_COLOURS = DistanceConstraintSolver::SERIAL_COLOUR;
+
+    size_t lowestClearBit(uint64_t mask)
+    {
+        size_t bit = 0;
+        while (mask & 1) {
+            mask >>= 1;
+            bit++;
+        }
+        return bit;
+    }
+}
+
+void DistanceConstraintSolver::addConstraint(PairedParticleConstraint* constraint)
+{
+    const uint32_t id = static_cast<uint32_t>(m_constraints.size());
+    m_constraints.push_back(constraint);
+    m_colour.push_back(NO_COLOUR);
+    m_packedSlot.push_back(NO_SLOT);
+    m_nextEdge.resize(2 * m_constraints.size());
+    m_previousEdge.resize(2 * m_constraints.size());
+
+    const size_t largest = std::max(constraint->getIndexA(), constraint->getIndexB());
+    if (m_firstEdge.size() <= largest) m_firstEdge.resize(largest + 1, NO_EDGE);
+    linkEdge(2 * id, constraint->getIndexA());
+    linkEdge(2 * id + 1, constraint->getIndexB());
+
+    constraint->setListener(this);
+    m_dirty = true;
+}
+
+void DistanceConstraintSolver::setColour(size_t constraint, uint8_t colour)
+{
+    m_colour[constraint] = colour;
+    m_dirty = true;
+}
+
+void DistanceConstraintSolver::onConstraintStateChanged(Constraint* /*constraint*/)
+{
+    m_dirty = true;
+}
+
+void DistanceConstraintSolver::linkEdge(uint32_t edge, size_t particle)
+{
+    const uint32_t first = m_firstEdge[particle];
+    m_previousEdge[edge] = NO_EDGE;
+    m_nextEdge[edge] = first;
+    if (first != NO_EDGE) m_previousEdge[first] = edge;
+    m_firstEdge[particle] = edge;
+}
+
+void DistanceConstraintSolver::unlinkEdge(uint32_t edge, size_t particle)
+{
+    const uint32_t previous = m_previousEdge[edge];
+    const uint32_t next = m_nextEdge[edge];
+    if (previous != NO_EDGE) m_nextEdge[previous] = next;
+    else m_firstEdge[particle] = next;
+    if (next != NO_EDGE) m_previousEdge[next] = previous;
+}
+
+void DistanceConstraintSolver::remapParticles(const ParticleRemap& remap)
+{
+    bool serialChanged = false;
+    for (uint32_t removed : remap.removed) {
+        while (removed < m_firstEdge.size() && m_firstEdge[removed] != NO_EDGE) {
+            const uint32_t constraint = m_firstEdge[removed] / 2;
+            serialChanged |= m_colour[constraint] == SERIAL_COLOUR || m_colour.back() == SERIAL_COLOUR;
+            dropConstraint(constraint);
+        }
+    }
+
+    // Moves happen at once, so every list is walked before the heads are carried over
+    for (const ParticleMove& move : remap.moved) {
+        if (move.from >= m_firstEdge.size()) continue;
+
+        for (uint32_t edge = m_firstEdge[move.from]; edge != NO_EDGE; edge = m_nextEdge[edge]) {
+            PairedParticleConstraint* constraint = m_constraints[edge / 2];
+            const uint32_t slot = m_packedSlot[edge / 2];
+            if (edge & 1) {
+                constraint->m_indexB = move.to;
+                if (slot != NO_SLOT) m_indexB[slot] = move.to;
+            }
+            else {
+                constraint->m_indexA = move.to;
+                if (slot != NO_SLOT) m_indexA[slot] = move.to;
+            }
+        }
+    }
+    remap.apply(m_firstEdge, NO_EDGE);
+
+    // A moved particle may have crossed the awake count, taking its constraints along
+    if (!m_dirty) {
+        for (const ParticleMove& move : remap.moved) {
+            if (move.to >= m_firstEdge.size()) continue;
+            for (uint32_t edge = m_firstEdge[move.to]; edge != NO_EDGE; edge = m_nextEdge[edge]) classify(edge / 2);
+        }
+    }
+
+    // Serial constraints are solved one after the other in registration order, which dropping renumbers
+    if (serialChanged && !m_dirty) {
+        std::sort(m_packedConstraint.begin() + m_serialStart, m_packedConstraint.begin() + m_serialEnd);
+        for (size_t slot = m_serialStart; slot < m_serialEnd; slot++) {
+            const PairedParticleConstraint* constraint = m_constraints[m_packedConstraint[slot]];
+            m_indexA[slot] = static_cast<uint32_t>(constraint->getIndexA());
+            m_indexB[slot] = static_cast<uint32_t>(constraint->getIndexB());
+            m_maxDistance[slot] = constraint->getMaxDistance();
+            m_packedSlot[m_packedConstraint[slot]] = static_cast<uint32_t>(slot);
+        }
+    }
+}
+
+void DistanceConstraintSolver::dropConstraint(uint32_t id)
+{
+    PairedParticleConstraint* constraint = m_constraints[id];
+    unlinkEdge(2 * id, constraint->getIndexA());
+    unlinkEdge(2 * id + 1, constraint->getIndexB());
+    if (m_packedSlot[id] != NO_SLOT) unpack(m_packedSlot[id]);
+
+    // Dropped constraints are disabled and no longer notify the solver
+    constraint->setListener(nullptr);
+    constraint->disable();
+
+    // The last constraint takes the dropped one's place, along with both its ends
+    const uint32_t last = static_cast<uint32_t>(m_constraints.size() - 1);
+    if (id != last) {
+        PairedParticleConstraint* moved = m_constraints[last];
+        m_constraints[id] = moved;
+        m_colour[id] = m_colour[last];
+        m_packedSlot[id] = m_packedSlot[last];
+        if (m_packedSlot[id] != NO_SLOT) m_packedConstraint[m_packedSlot[id]] = id;
+
+        for (uint32_t side = 0; side < 2; side++) {
+            const uint32_t from = 2 * last + side;
+            const uint32_t to = 2 * id + side;
+            const uint32_t previous = m_previousEdge[from];
+            const uint32_t next = m_nextEdge[from];
+
+            m_previousEdge[to] = previous;
+            m_nextEdge[to] = next;
+            if (previous != NO_EDGE) m_nextEdge[previous] = to;
+            else m_firstEdge[side ? moved->getIndexB() : moved->getIndexA()] = to;
+            if (next != NO_EDGE) m_previousEdge[next] = to;
+        }
+    }
+
+    m_constraints.pop_back();
+    m_colour.pop_back();
+    m_packedSlot.pop_back();
+    m_nextEdge.resize(2 * m_constraints.size());
+    m_previousEdge.resize(2 * m_constraints.size());
+}
+
+void DistanceConstraintSolver::moveSlot(size_t from, size_t to)
+{
+    m_indexA[to] = m_indexA[from];
+    m_indexB[to] = m_indexB[from];
+    m_maxDistance[to] = m_maxDistance[from];
+    m_packedConstraint[to] = m_packedConstraint[from];
+    m_packedSlot[m_packedConstraint[to]] = static_cast<uint32_t>(to);
+}
+
+void DistanceConstraintSolver::unpack(uint32_t slot)
+{
+    size_t hole = slot;
+    size_t* end = &m_serialEnd;
+    if (slot < m_serialStart) {
+        // Colours lie in order, so the slot belongs to the last one starting at or before it
+        const size_t colour = std::upper_bound(m_colourStart.begin(), m_colourStart.end(), slot) - m_colourStart.begin() - 1;
+        end = &m_colourEnd[colour];
+
+        // The last awake constraint fills the hole, leaving one at the start of the sleeping ones
+        if (hole < m_colourAwakeEnd[colour]) {
+            const size_t lastAwake = --m_colourAwakeEnd[colour];
+            if (lastAwake != hole) moveSlot(lastAwake, hole);
+            hole = lastAwake;
+        }
+    }
+
+    const size_t last = --*end;
+    if (last != hole) moveSlot(last, hole);
+    m_packedConstraint[last] = NO_SLOT;
+}
+
+void DistanceConstraintSolver::classify(uint32_t constraint)
+{
+    const uint32_t slot = m_packedSlot[constraint];
+    if (slot == NO_SLOT || slot >= m_serialStart) return;
+
+    const size_t colour = std::upper_bound(m_colourStart.begin(), m_colourStart.end(), slot) - m_colourStart.begin() - 1;
+    size_t& awakeEnd = m_colourAwakeEnd[colour];
+    const bool awake = std::min(m_indexA[slot], m_indexB[slot]) < m_awakeBound;
+    if (awake == (slot < awakeEnd)) return;
+
+    // Swapping with the first constraint past the boundary, or the last before it, moves the boundary by one
+    const size_t other = awake ? awakeEnd++ : --awakeEnd;
+    std::swap(m_indexA[slot], m_indexA[other]);
+    std::swap(m_indexB[slot], m_indexB[other]);
+    std::swap(m_maxDistance[slot], m_maxDistance[other]);
+    std::swap(m_packedConstraint[slot], m_packedConstraint[other]);
+    m_packedSlot[m_packedConstraint[slot]] = slot;
+    m_packedSlot[m_packedConstraint[other]] = static_cast<uint32_t>(other);
+}
+
+void DistanceConstraintSolver::syncAwake(size_t awakeCount)
+{
+    if (awakeCount == m_awakeBound) return;
+
+    const size_t first = std::min(awakeCount, m_awakeBound);
+    const size_t last = std::min(std::max(awakeCount, m_awakeBound), m_firstEdge.size());
+    m_awakeBound = awakeCount;
+    for (size_t particle = first; particle < last; particle++) {
+        for (uint32_t edge = m_firstEdge[particle]; edge != NO_EDGE; edge = m_nextEdge[edge]) classify(edge / 2);
+    }
+}
+
+size_t DistanceConstraintSolver::solve(ParticleStore& particles, ThreadPool& threadPool)
+{
+    if (m_dirty) rebuild(particles);
+    else syncAwake(particles.getAwakeCount());
+
+    std::atomic<size_t> corrected(0);
+
+    // Constraints joining two sleeping particles would not move either
+    for (size_t colour = 0; colour < m_colourStart.size(); colour++) {
+        threadPool.parallelFor(m_colourStart[colour], m_colourAwakeEnd[colour], 1024, [this, &particles, &corrected](size_t begin, size_t end) {
+            [[maybe_unused]] const size_t rangeCorrected = solveRange(particles, begin, end);
+            VERLET_PROFILE(corrected.fetch_add(rangeCorrected, std::memory_order_relaxed));
+        });
+    }
+
+    [[maybe_unused]] const size_t serialCorrected = solveRange(particles, m_serialStart, m_serialEnd);
+    VERLET_PROFILE(corrected.fetch_add(serialCorrected, std::memory_order_relaxed));
+
+    return corrected.load(std::memory_order_relaxed);
+}
+
+Real DistanceConstraintSolver::measureError(const ParticleStore& particles, ThreadPool& threadPool)
+{
+    if (m_dirty) rebuild(particles);
+    else syncAwake(particles.getAwakeCount());
+
+    const Real* positionX = particles.positionX();
+    const Real* positionY = particles.positionY();
+    const uint8_t* isStatic = particles.isStatic();
+
+    Real error = 0;
+    std::mutex errorMutex;
+
+    auto measureRange = [&](size_t begin, size_t end) {
+        Real rangeError = 0;
+        for (size_t i = begin; i < end; i++) {
+            const uint32_t a = m_indexA[i];
+            const uint32_t b = m_indexB[i];
+            if ((isStatic[a] && isStatic[b]) || !(m_maxDistance[i] > 0)) continue;
+
+            const Real displacementX = positionX[b] - positionX[a];
+            const Real displacementY = positionY[b] - positionY[a];
+            const Real currentDistance = std::sqrt(displacementX * displacementX + displacementY * displacementY);
+            rangeError = std::max(rangeError, (currentDistance - m_maxDistance[i]) / m_maxDistance[i]);
+        }
+
+        std::lock_guard<std::mutex> lock(errorMutex);
+        error = std::max(error, rangeError);
+    };
+
+    // Dropped constraints leave gaps at the end of their colour, which are skipped along with sleeping ones
+    for (size_t colour = 0; colour < m_colourStart.size(); colour++) threadPool.parallelFor(m_colourStart[colour], m_colourAwakeEnd[colour], 4096, measureRange);
+    measureRange(m_serialStart, m_serialEnd);
+
+    return error;
+}
+
+void DistanceConstraintSolver::rebuild(const ParticleStore& particles)
+{
+    // Greedily give each constraint the colour it had before if neither of its particles uses it
+    // yet, otherwise the lowest colour neither uses
+    std::vector<uint64_t> usedColours(particles.size(), 0);
+    std::vector<size_t> colourCounts(MAX_COLOURS + 1, 0);
+    std::vector<size_t> awakeCounts(MAX_COLOURS + 1, 0);
+    m_awakeBound = particles.getAwakeCount();
+
+    for (size_t i = 0; i < m_constraints.size(); i++) {
+        const PairedParticleConstraint* constraint = m_constraints[i];
+        if (!constraint->isEnabled()) continue;
+
+        const size_t a = constraint->getIndexA();
+        const size_t b = constraint->getIndexB();
+        const uint64_t used = usedColours[a] | usedColours[b];
+
+        size_t colour = m_colour[i];
+        if (colour >= MAX_COLOURS || (used >> colour) & 1) colour = lowestClearBit(used);
+        if (colour < MAX_COLOURS) {
+            usedColours[a] |= uint64_t(1) << colour;
+            usedColours[b] |= uint64_t(1) << colour;
+        }
+
+        m_colour[i] = static_cast<uint8_t>(colour);
+        colourCounts[colour]++;
+        if (std::min(a, b) < m_awakeBound) awakeCounts[colour]++;
+    }
+
+    size_t colourCount = 0;
+    for (size_t colour = 0; colour < MAX_COLOURS; colour++) {
+        if (colourCounts[colour] > 0) colourCount = colour + 1;
+    }
+
+    // Counting sort into packed arrays, keeping insertion order within each side of each colour;
+    // serial constraints stay in insertion order, sleeping or not
+    std::vector<size_t> offsets(MAX_COLOURS + 2, 0);
+    for (size_t colour = 0; colour <= MAX_COLOURS; colour++) offsets[colour + 1] = offsets[colour] + colourCounts[colour];
+
+    m_colourStart.assign(offsets.begin(), offsets.begin() + colourCount);
+    m_colourEnd.assign(offsets.begin() + 1, offsets.begin() + colourCount + 1);
+    m_colourAwakeEnd.resize(colourCount);
+    m_serialStart = offsets[MAX_COLOURS];
+    m_serialEnd = offsets[MAX_COLOURS + 1];
+
+    std::vector<size_t> sleepingOffsets(MAX_COLOURS, 0);
+    for (size_t colour = 0; colour < MAX_COLOURS; colour++) sleepingOffsets[colour] = offsets[colour] + awakeCounts[colour];
+    for (size_t colour = 0; colour < colourCount; colour++) m_colourAwakeEnd[colour] = sleepingOffsets[colour];
+
+    const size_t enabled = m_serialEnd;
+    m_indexA.resize(enabled);
+    m_indexB.resize(enabled);
+    m_maxDistance.resize(enabled);
+    m_packedConstraint.resize(enabled);
+
+    for (size_t i = 0; i < m_constraints.size(); i++) {
+        const PairedParticleConstraint* constraint = m_constraints[i];
+        if (!constraint->isEnabled()) {
+            m_packedSlot[i] = NO_SLOT;
+            continue;
+        }
+
+        const size_t colour = m_colour[i];
+        const bool sleeping = colour < MAX_COLOURS && std::min(constraint->getIndexA(), constraint->getIndexB()) >= m_awakeBound;
+        const size_t slot = sleeping ? sleepingOffsets[colour]++ : offsets[colour]++;
+        m_indexA[slot] = static_cast<uint32_t>(constraint->getIndexA());
+        m_indexB[slot] = static_cast<uint32_t>(constraint->getIndexB());
+        m_maxDistance[slot] = constraint->getMaxDistance();
+        m_packedConstraint[slot] = static_cast<uint32_t>(i);
+        m_packedSlot[i] = static_cast<uint32_t>(slot);
+    }
+
+    m_dirty = false;
+}
+
+size_t DistanceConstraintSolver::solveRange(ParticleStore& particles, size_t begin, size_t end) const
+{
+    size_t corrected = 0;
+
+    Real* positionX = particles.positionX();
+    Real* positionY = particles.positionY();
+    const uint8_t* isStatic = particles.isStatic();
+
+    for (size_t i = begin; i < end; i++) {
+        const uint32_t a = m_indexA[i];
+        const uint32_t b = m_indexB[i];
+        if (isStatic[a] && isStatic[b]) continue;
+
+        const Real displacementX = positionX[b] - positionX[a];
+        const Real displacementY = positionY[b] - positionY[a];
+        const Real currentDistance = std::sqrt(displacementX * displacementX + displacementY * displacementY);
+
+        // Only stretched constraints are corrected, mirroring PairedParticleConstraint::processConstraint
+        if (!(currentDistance > m_maxDistance[i])) continue;
+
+        corrected++;
+
+        const Real correction = currentDistance - m_maxDistance[i];
+        const Real normalX = displacementX / currentDistance;
+        const Real normalY = displacementY / currentDistance;
+
+        if (!isStatic[a]) {
+            positionX[a] += normalX * correction * Real(0.5);
+            positionY[a] += normalY * correction * Real(0.5);
+        }
+        if (!isStatic[b]) {
+            positionX[b] -= normalX * correction * Real(0.5);
+            positionY[b] -= normalY * correction * Real(0.5);
+        }
+    }
+
+    return corrected;
+}
@@ -0,0 +1,208 @@
+#pragma once
+#include "Contraint.h"
+#include "Particle.h"
+#include "ThreadPool.h"
+#include "Profiling.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace VerletPhysics {
+
+    /**
+     * Solves every `PairedParticleConstraint` of a simulation world in parallel.
+     *
+     * The `DistanceConstraintSolver` packs the enabled constraints into flat arrays of particle
+     * indices and maximum distances, then greedily graph-colours them so that no two constraints of
+     * the same colour share a particle. Each colour is solved as one data-parallel pass, which keeps
+     * the result independent of the number of threads. Colouring is only recomputed when constraints
+     * are added, enabled or disabled, and every constraint keeps its previous colour if it is still
+     * free.
+     *
+     * The solver also links every constraint into lists per particle, so removing or moving particles
+     * only touches the constraints of those particles: their indices are patched in place, and
+     * constraints losing a particle leave their colour by swapping with its last constraint.
+     *
+     * Within each colour, constraints with at least one awake particle come before those joining
+     * two sleeping ones, which are not solved at all. Constraints only change sides when one of their
+     * particles moves or the store's awake count sweeps over one of them.
+     */
+    class DistanceConstraintSolver : public ConstraintListener
+    {
+        static constexpr uint32_t NO_SLOT = UINT32_MAX;
+        static constexpr uint32_t NO_EDGE = UINT32_MAX;
+
+    public:
+        static constexpr uint8_t NO_COLOUR = UINT8_MAX; ///< Colour of constraints that were never coloured.
+        static constexpr uint8_t SERIAL_COLOUR = 64;    ///< Colour of constraints solved serially, after every other colour.
+
+    private:
+        std::vector<PairedParticleConstraint*> m_constraints; ///< Every registered constraint, in insertion order until one is dropped.
+        std::vector<uint8_t> m_colour;                         ///< Colour of every registered constraint as of the last rebuild.
+        bool m_dirty = false;                                  ///< Set when the packed arrays need rebuilding.
+
+        std::vector<uint32_t> m_indexA;           ///< First particle of each enabled constraint, grouped by colour.
+        std::vector<uint32_t> m_indexB;           ///< Second particle of each enabled constraint, grouped by colour.
+        std::vector<Real> m_maxDistance;          ///< Maximum distance of each enabled constraint, grouped by colour.
+        std::vector<uint32_t> m_packedConstraint; ///< Registered constraint of each packed entry.
+        std::vector<uint32_t> m_packedSlot;       ///< Packed entry of every registered constraint, or `NO_SLOT`.
+        std::vector<size_t> m_colourStart;        ///< Offset of each colour in the packed arrays.
+        std::vector<size_t> m_colourAwakeEnd;     ///< One past the last constraint of each colour with an awake particle.
+        std::vector<size_t> m_colourEnd;          ///< One past the last constraint of each colour, lowered as constraints are dropped.
+        size_t m_serialStart = 0;                 ///< Offset of the constraints that did not fit in any colour.
+        size_t m_serialEnd = 0;                   ///< One past the last constraint solved serially.
+        size_t m_awakeBound = 0;                  ///< Awake particle count the colours are split at.
+
+        std::vector<uint32_t> m_firstEdge;    ///< First constraint end at every particle, or `NO_EDGE`.
+        std::vector<uint32_t> m_nextEdge;     ///< Next constraint end at the same particle, by constraint times two, plus one at the second particle.
+        std::vector<uint32_t> m_previousEdge; ///< Previous constraint end at the same particle, indexed like `m_nextEdge`.
+
+    public:
+        /**
+         * Registers a constraint with the solver and subscribes to its state changes.
+         *
+         * @param constraint Pointer to the constraint to be solved.
+         */
+        void addConstraint(PairedParticleConstraint* constraint);
+
+        /**
+         * Solves every enabled constraint once, recolouring first if anything changed.
+         *
+         * @param particles The store holding the constrained particles.
+         * @param threadPool Pool used to solve each colour in parallel.
+         * @return Number of stretched constraints that moved their particles, in profiling builds,
+         *         otherwise zero.
+         */
+        size_t solve(ParticleStore& particles, ThreadPool& threadPool);
+
+        /**
+         * Measures how far the enabled constraints remain stretched.
+         *
+         * @param particles The store holding the constrained particles.
+         * @param threadPool Pool used to split the constraints across threads.
+         * @return The largest amount by which any constraint exceeds its maximum distance, as a
+         *         fraction of that distance, or zero if none is stretched.
+         */
+        Real measureError(const ParticleStore& particles, ThreadPool& threadPool);
+
+        /**
+         * Marks the packed arrays for rebuilding when a constraint is enabled or disabled.
+         *
+         * @param constraint The constraint whose state changed.
+         */
+        virtual void onConstraintStateChanged(Constraint* constraint) override;
+
+        /**
+         * Remaps the constraints of every moved particle and drops those that lost a particle, in
+         * time proportional to the constraints of the particles concerned.
+         *
+         * Dropped constraints are disabled and no longer notify the solver. The last registered
+         * constraint takes the place of each dropped one.
+         *
+         * @param remap The removed particles and every particle that changed index.
+         */
+        void remapParticles(const ParticleRemap& remap);
+
+        /**
+         * Calls a function with both particles of every enabled constraint that has an awake
+         * particle, along with some joining two sleeping particles.
+         *
+         * @param function Called with the indices of both particles, as `uint32_t`.
+         */
+        template <typename Function>
+        void forEachAwake(Function function) const;
+
+        /**
+         * Gets every registered constraint, enabled or not.
+         *
+         * @return The constraints, in insertion order until particles are removed.
+         */
+        const std::vector<PairedParticleConstraint*>& getConstraints() const { return m_constraints; }
+
+        /**
+         * Gets the number of colours the enabled constraints were split into.
+         *
+         * @return The colour count of the last rebuild.
+         */
+        size_t getColourCount() const { return m_colourStart.size(); }
+
+        /**
+         * Gets the colour of a registered constraint.
+         *
+         * @param constraint Index of the constraint in `getConstraints()`.
+         * @return Its colour as of the last rebuild, `SERIAL_COLOUR` or `NO_COLOUR`.
+         */
+        uint8_t getColour(size_t constraint) const { return m_colour[constraint]; }
+
+        /**
+         * Sets the colour a registered constraint keeps at the next rebuild, as long as neither of
+         * its particles has an earlier constraint of that colour.
+         *
+         * @param constraint Index of the constraint in `getConstraints()`.
+         * @param colour The colour to keep, as returned by `getColour`.
+         */
+        void setColour(size_t constraint, uint8_t colour);
+
+    private:
+        /**
+         * Rebuilds the packed, colour-grouped constraint arrays from the enabled constraints.
+         *
+         * @param particles The store holding the constrained particles.
+         */
+        void rebuild(const ParticleStore& particles);
+
+        /**
+         * Moves the constraints whose side changes along with the store's awake count to their new
+         * side, in time proportional to the constraints of the particles the count swept over.
+         */
+        void syncAwake(size_t awakeCount);
+
+        /**
+         * Moves a packed constraint to the side of its colour its particles belong on.
+         */
+        void classify(uint32_t constraint);
+
+        /**
+         * Copies one packed constraint over another slot.
+         */
+        void moveSlot(size_t from, size_t to);
+
+        /**
+         * Removes a constraint from the solver, its particle lists and its colour.
+         */
+        void dropConstraint(uint32_t constraint);
+
+        /**
+         * Moves the last packed constraint of a slot's colour into the slot.
+         */
+        void unpack(uint32_t slot);
+
+        void linkEdge(uint32_t edge, size_t particle);
+        void unlinkEdge(uint32_t edge, size_t particle);
+
+        /**
+         * Solves a contiguous range of the packed constraints.
+         *
+         * @return Number of constraints in the range that were stretched and corrected.
+         */
+        size_t solveRange(ParticleStore& particles, size_t begin, size_t end) const;
+    };
+
+
+    template <typename Function>
+    void DistanceConstraintSolver::forEachAwake(Function function) const
+    {
+        if (m_dirty) {
+            for (const PairedParticleConstraint* constraint : m_constraints) {
+                if (constraint->isEnabled()) function(static_cast<uint32_t>(constraint->getIndexA()), static_cast<uint32_t>(constraint->getIndexB()));
+            }
+            return;
+        }
+
+        for (size_t colour = 0; colour < m_colourStart.size(); colour++) {
+            for (size_t slot = m_colourStart[colour]; slot < m_colourAwakeEnd[colour]; slot++) function(m_indexA[slot], m_indexB[slot]);
+        }
+        for (size_t slot = m_serialStart; slot < m_serialEnd; slot++) function(m_indexA[slot], m_indexB[slot]);
+    }
+}
@@ -0,0 +1,177 @@
+#include "FixedStepper.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace VerletPhysics;
+
+FixedStepper::FixedStepper(SimulationWorld& world, double timestep, size_t maxCatchUpSteps) :
+    m_world(world),
+    c_timestep(timestep),
+    c_maxCatchUpSteps(std::max<size_t>(maxCatchUpSteps, 1))
+{
+    std::lock_guard<std::mutex> lock(m_worldMutex);
+    publish(false);
+}
+
+FixedStepper::~FixedStepper()
+{
+    stop();
+}
+
+size_t FixedStepper::advance(double elapsedSeconds)
+{
+    std::lock_guard<std::mutex> lock(m_worldMutex);
+    const ParticleStore& particles = m_world.getParticles();
+
+    m_accumulator += std::max(elapsedSeconds, 0.0);
+
+    size_t steps = 0;
+    while (m_accumulator >= c_timestep && steps < c_maxCatchUpSteps) {
+        m_stagingX.assign(particles.positionX(), particles.positionX() + particles.size());
+        m_stagingY.assign(particles.positionY(), particles.positionY() + particles.size());
+        const uint64_t layout = particles.getLayoutVersion();
+
+        // Handles only change places with the layout, so they are captured again only then
+        if (m_stagingLayout != layout || m_stagingHandles.size() != particles.size()) {
+            m_stagingHandles.assign(particles.handles(), particles.handles() + particles.size());
+            m_stagingLayout = layout;
+        }
+
+        m_world.update(c_timestep);
+        if (particles.getLayoutVersion() != layout) reorderStaging(particles);
+        m_accumulator -= c_timestep;
+        steps++;
+    }
+
+    // Past the cap the backlog is dropped, so a slow machine runs the simulation slower rather than ever further behind
+    if (m_accumulator >= c_timestep) {
+        const double kept = std::fmod(m_accumulator, c_timestep);
+        m_droppedTime = m_droppedTime + (m_accumulator - kept);
+        m_accumulator = kept;
+    }
+
+    m_lastStepCount = steps;
+    publish(steps > 0);
+    return steps;
+}
+
+void FixedStepper::reorderStaging(const ParticleStore& particles)
+{
+    std::vector<Real> scratch(m_stagingX.size());
+
+    for (size_t i = 0; i < m_stagingHandles.size(); i++) scratch[m_stagingHandles[i]->getIndex()] = m_stagingX[i];
+    m_stagingX.swap(scratch);
+
+    for (size_t i = 0; i < m_stagingHandles.size(); i++) scratch[m_stagingHandles[i]->getIndex()] = m_stagingY[i];
+    m_stagingY.swap(scratch);
+
+    m_stagingHandles.assign(particles.handles(), particles.handles() + particles.size());
+    m_stagingLayout = particles.getLayoutVersion();
+}
+
+void FixedStepper::publish(bool stepped)
+{
+    const ParticleStore& particles = m_world.getParticles();
+    const size_t count = particles.size();
+
+    std::lock_guard<std::mutex> lock(m_stateMutex);
+
+    if (stepped) {
+        m_previousX.swap(m_stagingX);
+        m_previousY.swap(m_stagingY);
+        m_currentX.assign(particles.positionX(), particles.positionX() + count);
+        m_currentY.assign(particles.positionY(), particles.positionY() + count);
+    }
+    else if (particles.getLayoutVersion() != m_publishedLayout) {
+        // Particles were removed or sorted since publishing, so the old positions no longer line up
+        m_currentX.assign(particles.positionX(), particles.positionX() + count);
+        m_currentY.assign(particles.positionY(), particles.positionY() + count);
+        m_previousX = m_currentX;
+        m_previousY = m_currentY;
+    }
+    m_publishedLayout = particles.getLayoutVersion();
+
+    // Particles removed since the last update vanish, added ones start out at rest where they are
+    if (count < m_currentX.size()) {
+        m_currentX.resize(count);
+        m_currentY.resize(count);
+        m_previousX.resize(count);
+        m_previousY.resize(count);
+    }
+    for (size_t i = m_currentX.size(); i < count; i++) {
+        m_currentX.push_back(particles.positionX()[i]);
+        m_currentY.push_back(particles.positionY()[i]);
+    }
+    for (size_t i = m_previousX.size(); i < m_currentX.size(); i++) {
+        m_previousX.push_back(m_currentX[i]);
+        m_previousY.push_back(m_currentY[i]);
+    }
+
+    m_publishedAlpha = m_accumulator / c_timestep;
+    m_publishedAt = Clock::now();
+}
+
+double FixedStepper::getAlpha() const
+{
+    std::lock_guard<std::mutex> lock(m_stateMutex);
+    return alphaAt(Clock::now());
+}
+
+double FixedStepper::alphaAt(Clock::time_point now) const
+{
+    const double sincePublished = std::chrono::duration<double>(now - m_publishedAt).count();
+    return std::min(m_publishedAlpha + sincePublished / c_timestep, 1.0);
+}
+
+void FixedStepper::readInterpolatedPositions(std::vector<Real>& positionX, std::vector<Real>& positionY) const
+{
+    std::lock_guard<std::mutex> lock(m_stateMutex);
+
+    const Real alpha = static_cast<Real>(alphaAt(Clock::now()));
+    const size_t count = m_currentX.size();
+    positionX.resize(count);
+    positionY.resize(count);
+
+    for (size_t i = 0; i < count; i++) {
+        positionX[i] = m_previousX[i] + (m_currentX[i] - m_previousX[i]) * alpha;
+        positionY[i] = m_previousY[i] + (m_currentY[i] - m_previousY[i]) * alpha;
+    }
+}
+
+void FixedStepper::start()
+{
+    if (isRunning()) return;
+
+    m_stopping = false;
+    m_thread = std::thread(&FixedStepper::threadLoop, this);
+}
+
+void FixedStepper::stop()
+{
+    if (!isRunning()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_threadMutex);
+        m_stopping = true;
+    }
+    m_stopSignal.notify_all();
+    m_thread.join();
+}
+
+void FixedStepper::threadLoop()
+{
+    const Clock::duration interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(c_timestep));
+    Clock::time_point last = Clock::now();
+
+    std::unique_lock<std::mutex> lock(m_threadMutex);
+    while (!m_stopSignal.wait_until(lock, last + interval, [this] { return m_stopping; })) {
+        lock.unlock();
+
+        const Clock::time_point now = Clock::now();
+        advance(std::chrono::duration<double>(now - last).count());
+        last = now;
+
+        lock.lock();
+    }
+}
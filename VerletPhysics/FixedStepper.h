@@ -0,0 +1,180 @@
+#pragma once
+#include "PhysicsMath.h"
+#include "SimulationWorld.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace VerletPhysics {
+
+    /**
+     * Advances a simulation world in fixed time steps, decoupled from the rate it is displayed at.
+     *
+     * Elapsed real time is added to an accumulator and the world is updated once for every whole
+     * timestep it holds, so frame hitches never change the step the physics is integrated with. At
+     * most a fixed number of catch-up steps run per call; any time beyond that is dropped, which
+     * slows the simulation down instead of letting the catch-up spiral.
+     *
+     * After stepping, the positions before and after the last update are published for readers,
+     * which blend them by how far real time has moved past the last update. Rendering can therefore
+     * run at the display rate while the physics runs at a lower, fixed rate, either on the calling
+     * thread through `advance` or on a thread of its own started with `start`.
+     */
+    class FixedStepper
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+    private:
+        SimulationWorld& m_world;        ///< World being stepped.
+        const double c_timestep;         ///< Simulated time per update, in seconds.
+        const size_t c_maxCatchUpSteps;  ///< Most updates a single call to `advance` may perform.
+
+        double m_accumulator = 0;                 ///< Elapsed time not yet simulated, in seconds.
+        std::atomic<double> m_droppedTime{ 0 };   ///< Elapsed time discarded by the catch-up cap, in seconds.
+        std::atomic<size_t> m_lastStepCount{ 0 }; ///< Updates performed by the last call to `advance`.
+        std::vector<Real> m_stagingX;             ///< X-coordinates captured before the update in progress.
+        std::vector<Real> m_stagingY;             ///< Y-coordinates captured before the update in progress.
+        std::vector<const Particle*> m_stagingHandles; ///< Handle of the particle behind each captured position.
+        uint64_t m_stagingLayout = 0;             ///< Layout version of the store when the handles were captured.
+        std::mutex m_worldMutex;                  ///< Held while the world is updated.
+
+        std::vector<Real> m_previousX;   ///< Published X-coordinates before the last update.
+        std::vector<Real> m_previousY;   ///< Published Y-coordinates before the last update.
+        std::vector<Real> m_currentX;    ///< Published X-coordinates after the last update.
+        std::vector<Real> m_currentY;    ///< Published Y-coordinates after the last update.
+        double m_publishedAlpha = 0;     ///< Fraction of a timestep left in the accumulator when publishing.
+        uint64_t m_publishedLayout = 0;  ///< Layout version of the store when the positions were last published.
+        Clock::time_point m_publishedAt; ///< Time the published positions were last refreshed.
+        mutable std::mutex m_stateMutex; ///< Guards the published positions.
+
+        std::thread m_thread;                 ///< Physics thread, while running.
+        bool m_stopping = false;              ///< Set to stop the physics thread.
+        std::mutex m_threadMutex;             ///< Guards `m_stopping`.
+        std::condition_variable m_stopSignal; ///< Wakes the physics thread when it has to stop.
+
+    public:
+        /**
+         * Constructs a FixedStepper object.
+         *
+         * @param world The world to step. It must outlive the stepper.
+         * @param timestep Simulated time per update, in seconds.
+         * @param maxCatchUpSteps Most updates a single call to `advance` may perform, at least one.
+         */
+        FixedStepper(SimulationWorld& world, double timestep, size_t maxCatchUpSteps = 4);
+
+        /**
+         * Stops the physics thread, if running.
+         */
+        ~FixedStepper();
+
+        FixedStepper(const FixedStepper&) = delete;
+        FixedStepper& operator=(const FixedStepper&) = delete;
+
+        /**
+         * Adds elapsed real time and performs every whole update it makes up, up to the catch-up cap.
+         *
+         * @param elapsedSeconds Real time since the previous call.
+         * @return Number of updates performed.
+         */
+        size_t advance(double elapsedSeconds);
+
+        /**
+         * Starts stepping the world on a thread of its own, once per timestep of real time.
+         *
+         * While running, the world may only be modified from other threads while holding `lockWorld`.
+         */
+        void start();
+
+        /**
+         * Stops the physics thread and waits for it to finish. Does nothing if it is not running.
+         */
+        void stop();
+
+        /**
+         * Checks whether the physics thread is running.
+         *
+         * @return `true` between `start` and `stop`.
+         */
+        bool isRunning() const { return m_thread.joinable(); }
+
+        /**
+         * Locks the world against being updated, for modifying it while the physics thread runs.
+         *
+         * @return A lock held until it is destroyed.
+         */
+        std::unique_lock<std::mutex> lockWorld() { return std::unique_lock<std::mutex>(m_worldMutex); }
+
+        /**
+         * Blends the published positions by how far real time has moved past the last update.
+         *
+         * Safe to call from any thread while the world is being stepped. Particles added since the
+         * last update appear at their current position, as does every particle once particles were
+         * removed outside an update.
+         *
+         * @param positionX Receives the interpolated X-coordinate of every particle, by store index.
+         * @param positionY Receives the interpolated Y-coordinate of every particle, by store index.
+         */
+        void readInterpolatedPositions(std::vector<Real>& positionX, std::vector<Real>& positionY) const;
+
+        /**
+         * Gets how far real time has moved past the last update, as a fraction of the timestep.
+         *
+         * @return The blend factor between the previous and current positions, from 0 to 1.
+         */
+        double getAlpha() const;
+
+        /**
+         * Gets the simulated time per update.
+         *
+         * @return The timestep, in seconds.
+         */
+        double getTimestep() const { return c_timestep; }
+
+        /**
+         * Gets the number of updates performed by the last call to `advance`.
+         *
+         * @return The update count.
+         */
+        size_t getLastStepCount() const { return m_lastStepCount; }
+
+        /**
+         * Gets the real time discarded so far because catching up would have exceeded the cap.
+         *
+         * @return The dropped time, in seconds.
+         */
+        double getDroppedTime() const { return m_droppedTime; }
+
+    private:
+        /**
+         * Moves the positions captured before an update to the indices the update sorted the particles
+         * into, by following the captured handles.
+         *
+         * @param particles The store the positions were captured from.
+         */
+        void reorderStaging(const ParticleStore& particles);
+
+        /**
+         * Publishes the positions around the last update and the time left in the accumulator.
+         *
+         * @param stepped `true` if at least one update ran since the last publication.
+         */
+        void publish(bool stepped);
+
+        /**
+         * Computes the blend factor at a point in time. The state mutex must be held.
+         */
+        double alphaAt(Clock::time_point now) const;
+
+        /**
+         * Body of the physics thread.
+         */
+        void threadLoop();
+    };
+}
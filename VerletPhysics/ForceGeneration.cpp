@@ -1,18 +1,880 @@
 #include "ForceGeneration.h"
+#include "SimdKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <mutex>
+
+void VerletPhysics::BulkForceGenerator::subscribeParticle(Particle* subscriber)
+{
+	if (m_allParticles) return;
+
+	m_store = subscriber->getStore();
+	m_particles.add(subscriber->getIndex());
+}
+
+void VerletPhysics::BulkForceGenerator::subscribeAllParticles(ParticleStore& particles)
+{
+	m_store = &particles;
+	m_particles.clear();
+	m_allParticles = true;
+}
+
+void VerletPhysics::BulkForceGenerator::applyForces()
+{
+	partitionSubscribers();
+	applyForcesToRange(0, getParallelWorkSize());
+}
+
+void VerletPhysics::BulkForceGenerator::prepare(ThreadPool& /*threadPool*/)
+{
+	partitionSubscribers();
+}
+
+void VerletPhysics::BulkForceGenerator::partitionSubscribers()
+{
+	if (!m_allParticles && m_store) m_awakeSubscribers = m_particles.partition(m_store->getAwakeCount());
+}
+
+size_t VerletPhysics::BulkForceGenerator::getParallelWorkSize() const
+{
+	if (m_allParticles) return m_store->getAwakeCount();
+	return m_awakeSubscribers;
+}
+
+void VerletPhysics::BulkForceGenerator::applyForcesToRange(size_t begin, size_t end)
+{
+	if (begin >= end) return;
+
+	if (m_allParticles) applyToRange(begin, end);
+	else applyToIndices(m_particles.data() + begin, end - begin);
+}
+
+void VerletPhysics::BulkForceGenerator::remapParticles(const ParticleRemap& remap)
+{
+	m_particles.remap(remap);
+}
 
 VerletPhysics::ConstantAcceleration::ConstantAcceleration(Vector2 acceleration) :
 	m_accelerationFactor(acceleration)
 {}
 
-void VerletPhysics::ConstantAcceleration::subscribeParticle(Particle* subscriber)
+void VerletPhysics::ConstantAcceleration::applyToRange(size_t begin, size_t end)
+{
+	SimdKernels::accelerate(*m_store, begin, end, m_accelerationFactor.x(), m_accelerationFactor.y());
+}
+
+void VerletPhysics::ConstantAcceleration::applyToIndices(const size_t* indices, size_t count)
+{
+	SimdKernels::accelerate(*m_store, indices, count, m_accelerationFactor.x(), m_accelerationFactor.y());
+}
+
+VerletPhysics::DragForce::DragForce(Real coefficient) :
+	m_coefficient(coefficient)
+{}
+
+void VerletPhysics::DragForce::applyToRange(size_t begin, size_t end)
+{
+	SimdKernels::applyDrag(*m_store, begin, end, m_coefficient);
+}
+
+void VerletPhysics::DragForce::applyToIndices(const size_t* indices, size_t count)
+{
+	SimdKernels::applyDrag(*m_store, indices, count, m_coefficient);
+}
+
+VerletPhysics::RadialAttractor::RadialAttractor(Vector2 center, Real strength, Real softening) :
+	m_center(center),
+	m_strength(strength),
+	m_softening(softening)
+{}
+
+void VerletPhysics::RadialAttractor::applyToRange(size_t begin, size_t end)
+{
+	SimdKernels::attract(*m_store, begin, end, m_center.x(), m_center.y(), m_strength, m_softening);
+}
+
+void VerletPhysics::RadialAttractor::applyToIndices(const size_t* indices, size_t count)
+{
+	SimdKernels::attract(*m_store, indices, count, m_center.x(), m_center.y(), m_strength, m_softening);
+}
+
+VerletPhysics::WindField::WindField(Vector2 origin, Real cellSize, size_t columns, size_t rows) :
+	c_origin(origin),
+	c_cellSize(cellSize),
+	c_columns(std::max<size_t>(columns, 1)),
+	c_rows(std::max<size_t>(rows, 1)),
+	m_forceX(c_columns * c_rows, 0),
+	m_forceY(c_columns * c_rows, 0)
+{}
+
+void VerletPhysics::WindField::setForce(size_t column, size_t row, Vector2 force)
+{
+	m_forceX[row * c_columns + column] = force.x();
+	m_forceY[row * c_columns + column] = force.y();
+}
+
+VerletPhysics::Vector2 VerletPhysics::WindField::getForce(size_t column, size_t row) const
+{
+	return Vector2(m_forceX[row * c_columns + column], m_forceY[row * c_columns + column]);
+}
+
+namespace {
+
+	/**
+	 * Locates a coordinate on one axis of a grid, clamped to its edges.
+	 *
+	 * @param coordinate The coordinate in grid units.
+	 * @param count Number of grid points along the axis.
+	 * @param first Receives the grid point at or before the coordinate.
+	 * @param second Receives the grid point after it, equal to `first` at the far edge.
+	 * @return Weight of `second`, between zero and one.
+	 */
+	inline VerletPhysics::Real locate(VerletPhysics::Real coordinate, size_t count, size_t& first, size_t& second)
+	{
+		const VerletPhysics::Real last = static_cast<VerletPhysics::Real>(count - 1);
+		coordinate = std::min(std::max(coordinate, VerletPhysics::Real(0)), last);
+
+		first = std::min(static_cast<size_t>(coordinate), count - 1);
+		second = std::min(first + 1, count - 1);
+		return coordinate - static_cast<VerletPhysics::Real>(first);
+	}
+}
+
+VerletPhysics::Vector2 VerletPhysics::WindField::sample(Vector2 position) const
+{
+	size_t column0, column1, row0, row1;
+	const Real tx = locate((position.x() - c_origin.x()) / c_cellSize, c_columns, column0, column1);
+	const Real ty = locate((position.y() - c_origin.y()) / c_cellSize, c_rows, row0, row1);
+
+	const size_t i00 = row0 * c_columns + column0;
+	const size_t i01 = row0 * c_columns + column1;
+	const size_t i10 = row1 * c_columns + column0;
+	const size_t i11 = row1 * c_columns + column1;
+
+	const Real topX = m_forceX[i00] + (m_forceX[i01] - m_forceX[i00]) * tx;
+	const Real topY = m_forceY[i00] + (m_forceY[i01] - m_forceY[i00]) * tx;
+	const Real bottomX = m_forceX[i10] + (m_forceX[i11] - m_forceX[i10]) * tx;
+	const Real bottomY = m_forceY[i10] + (m_forceY[i11] - m_forceY[i10]) * tx;
+
+	return Vector2(topX + (bottomX - topX) * ty, topY + (bottomY - topY) * ty);
+}
+
+void VerletPhysics::WindField::applyToRange(size_t begin, size_t end)
+{
+	Real* forceX = m_store->forceX();
+	Real* forceY = m_store->forceY();
+	const Real* positionX = m_store->positionX();
+	const Real* positionY = m_store->positionY();
+
+	for (size_t i = begin; i < end; i++) {
+		const Vector2 force = sample(Vector2(positionX[i], positionY[i]));
+		forceX[i] += force.x();
+		forceY[i] += force.y();
+	}
+}
+
+void VerletPhysics::WindField::applyToIndices(const size_t* indices, size_t count)
+{
+	Real* forceX = m_store->forceX();
+	Real* forceY = m_store->forceY();
+	const Real* positionX = m_store->positionX();
+	const Real* positionY = m_store->positionY();
+
+	for (size_t n = 0; n < count; n++) {
+		const size_t i = indices[n];
+		const Vector2 force = sample(Vector2(positionX[i], positionY[i]));
+		forceX[i] += force.x();
+		forceY[i] += force.y();
+	}
+}
+
+size_t VerletPhysics::SpringForce::addSpring(Particle* particleA, Particle* particleB, Real restLength, Real stiffness, Real damping)
+{
+	m_store = particleA->getStore();
+	m_springA.push_back(static_cast<uint32_t>(particleA->getIndex()));
+	m_springB.push_back(static_cast<uint32_t>(particleB->getIndex()));
+	m_restLength.push_back(restLength);
+	m_stiffness.push_back(stiffness);
+	m_damping.push_back(damping);
+	m_dirty = true;
+	return m_springA.size() - 1;
+}
+
+void VerletPhysics::SpringForce::remapParticles(const ParticleRemap& remap)
+{
+	if (m_springA.empty()) return;
+
+	// Springs added since the last substep still use the previous numbering, so they are packed against it
+	if (m_dirty) pack(remap.particleCount + remap.removed.size());
+
+	for (uint32_t removed : remap.removed) {
+		if (removed >= m_itemOf.size()) continue;
+
+		// The particle's work item goes along with its last spring
+		while (m_itemOf[removed] != NO_ITEM) eraseSpring(m_endOwner[m_endStart[m_itemOf[removed]]] / 2);
+	}
+
+	for (const ParticleMove& move : remap.moved) {
+		if (move.from >= m_itemOf.size() || m_itemOf[move.from] == NO_ITEM) continue;
+
+		// Each spring of the particle is also seen from its far end, which has to follow the move
+		const uint32_t item = m_itemOf[move.from];
+		m_endParticle[item] = move.to;
+		for (size_t e = m_endStart[item]; e < m_endStart[item] + m_endCount[item]; e++) {
+			const uint32_t owner = m_endOwner[e];
+			m_ends[m_endSlot[owner ^ 1]].other = move.to;
+			if (owner & 1) m_springB[owner / 2] = move.to;
+			else m_springA[owner / 2] = move.to;
+		}
+	}
+
+	remap.apply(m_itemOf, NO_ITEM);
+
+	// A moved particle may have crossed the awake count, taking its work item along
+	for (const ParticleMove& move : remap.moved) {
+		if (move.to < m_itemOf.size() && m_itemOf[move.to] != NO_ITEM) classifyItem(m_itemOf[move.to]);
+	}
+}
+
+void VerletPhysics::SpringForce::swapItems(uint32_t a, uint32_t b)
+{
+	std::swap(m_endParticle[a], m_endParticle[b]);
+	std::swap(m_endStart[a], m_endStart[b]);
+	std::swap(m_endCount[a], m_endCount[b]);
+	m_itemOf[m_endParticle[a]] = a;
+	m_itemOf[m_endParticle[b]] = b;
+}
+
+void VerletPhysics::SpringForce::classifyItem(uint32_t item)
+{
+	// Swapping with the first item past the boundary, or the last before it, moves the boundary by one
+	const bool awake = m_endParticle[item] < m_awakeBound;
+	if (awake && item >= m_awakeItems) swapItems(item, static_cast<uint32_t>(m_awakeItems++));
+	else if (!awake && item < m_awakeItems) swapItems(item, static_cast<uint32_t>(--m_awakeItems));
+}
+
+void VerletPhysics::SpringForce::eraseSpring(uint32_t spring)
+{
+	eraseEnd(m_endSlot[2 * spring]);
+	eraseEnd(m_endSlot[2 * spring + 1]);
+
+	const uint32_t last = static_cast<uint32_t>(m_springA.size() - 1);
+	if (spring != last) {
+		m_springA[spring] = m_springA[last];
+		m_springB[spring] = m_springB[last];
+		m_restLength[spring] = m_restLength[last];
+		m_stiffness[spring] = m_stiffness[last];
+		m_damping[spring] = m_damping[last];
+
+		// The renumbered spring's ends move back among their particle's ends, which stay in spring
+		// order so that forces add up exactly as after a fresh pack
+		for (uint32_t side = 0; side < 2; side++) {
+			const uint32_t owner = 2 * spring + side;
+			const uint32_t particle = side ? m_springB[spring] : m_springA[spring];
+			const size_t start = m_endStart[m_itemOf[particle]];
+
+			size_t e = m_endSlot[2 * last + side];
+			m_endOwner[e] = owner;
+			while (e > start && m_endOwner[e - 1] > owner) {
+				std::swap(m_ends[e], m_ends[e - 1]);
+				m_endOwner[e] = m_endOwner[e - 1];
+				m_endSlot[m_endOwner[e]] = e;
+				e--;
+			}
+			m_endOwner[e] = owner;
+			m_endSlot[owner] = e;
+		}
+	}
+
+	m_springA.pop_back();
+	m_springB.pop_back();
+	m_restLength.pop_back();
+	m_stiffness.pop_back();
+	m_damping.pop_back();
+	m_endSlot.resize(2 * m_springA.size());
+}
+
+void VerletPhysics::SpringForce::eraseEnd(size_t end)
+{
+	const uint32_t owner = m_endOwner[end];
+	const uint32_t particle = (owner & 1) ? m_springB[owner / 2] : m_springA[owner / 2];
+	uint32_t item = m_itemOf[particle];
+	const size_t itemEnd = m_endStart[item] + m_endCount[item];
+
+	for (size_t e = end; e + 1 < itemEnd; e++) {
+		m_ends[e] = m_ends[e + 1];
+		m_endOwner[e] = m_endOwner[e + 1];
+		m_endSlot[m_endOwner[e]] = e;
+	}
+	if (--m_endCount[item] > 0) return;
+
+	// The last awake item fills an awake hole, then the last work item takes the place of the empty
+	// one, leaving its ends where they are
+	if (item < m_awakeItems) {
+		swapItems(item, static_cast<uint32_t>(--m_awakeItems));
+		item = static_cast<uint32_t>(m_awakeItems);
+	}
+	const uint32_t last = static_cast<uint32_t>(m_endParticle.size() - 1);
+	m_itemOf[particle] = NO_ITEM;
+	if (item != last) {
+		m_endParticle[item] = m_endParticle[last];
+		m_endStart[item] = m_endStart[last];
+		m_endCount[item] = m_endCount[last];
+		m_itemOf[m_endParticle[item]] = item;
+	}
+	m_endParticle.pop_back();
+	m_endStart.pop_back();
+	m_endCount.pop_back();
+}
+
+void VerletPhysics::SpringForce::prepare(ThreadPool& /*threadPool*/)
+{
+	update();
+}
+
+void VerletPhysics::SpringForce::update()
+{
+	// Without a spring there is no store to size the ends against, and nothing to pack
+	if (!m_store) return;
+	if (m_dirty) pack(m_store->size());
+
+	// Only work items of the particles the awake count swept over change sides
+	const size_t awakeCount = m_store->getAwakeCount();
+	if (awakeCount == m_awakeBound) return;
+
+	const size_t first = std::min(awakeCount, m_awakeBound);
+	const size_t last = std::min(std::max(awakeCount, m_awakeBound), m_itemOf.size());
+	m_awakeBound = awakeCount;
+	for (size_t particle = first; particle < last; particle++) {
+		if (m_itemOf[particle] != NO_ITEM) classifyItem(m_itemOf[particle]);
+	}
+}
+
+void VerletPhysics::SpringForce::pack(size_t particleCount)
+{
+	// Count the springs of every particle, then lay both ends of each spring out per particle
+	std::vector<uint32_t> springCount(particleCount, 0);
+	for (size_t s = 0; s < m_springA.size(); s++) {
+		springCount[m_springA[s]]++;
+		springCount[m_springB[s]]++;
+	}
+
+	std::vector<size_t> slot(springCount.size(), 0);
+	m_endParticle.clear();
+	m_endStart.clear();
+	m_endCount.clear();
+	m_itemOf.assign(particleCount, NO_ITEM);
+
+	size_t offset = 0;
+	for (size_t i = 0; i < springCount.size(); i++) {
+		if (springCount[i] == 0) continue;
+		slot[i] = offset;
+		m_itemOf[i] = static_cast<uint32_t>(m_endParticle.size());
+		m_endParticle.push_back(static_cast<uint32_t>(i));
+		m_endStart.push_back(offset);
+		m_endCount.push_back(springCount[i]);
+		offset += springCount[i];
+	}
+
+	// Every particle counts as awake until the next prepare sweeps the awake count down
+	m_awakeBound = particleCount;
+	m_awakeItems = m_endParticle.size();
+
+	m_ends.resize(offset);
+	m_endOwner.resize(offset);
+	m_endSlot.resize(2 * m_springA.size());
+	for (size_t s = 0; s < m_springA.size(); s++) {
+		const size_t endA = slot[m_springA[s]]++;
+		m_ends[endA] = { m_springB[s], m_restLength[s], m_stiffness[s], m_damping[s] };
+		m_endOwner[endA] = static_cast<uint32_t>(2 * s);
+		m_endSlot[2 * s] = endA;
+
+		const size_t endB = slot[m_springB[s]]++;
+		m_ends[endB] = { m_springA[s], m_restLength[s], m_stiffness[s], m_damping[s] };
+		m_endOwner[endB] = static_cast<uint32_t>(2 * s + 1);
+		m_endSlot[2 * s + 1] = endB;
+	}
+
+	m_dirty = false;
+}
+
+void VerletPhysics::SpringForce::applyForces()
 {
-	m_particles.push_back(subscriber);
+	update();
+	applyForcesToRange(0, getParallelWorkSize());
 }
 
-void VerletPhysics::ConstantAcceleration::applyForces()
+void VerletPhysics::SpringForce::applyForcesToRange(size_t begin, size_t end)
 {
-	for (Particle* particle : m_particles)
+	if (begin >= end) return;
+
+	Real* forceX = m_store->forceX();
+	Real* forceY = m_store->forceY();
+	const Real* positionX = m_store->positionX();
+	const Real* positionY = m_store->positionY();
+	const Real* previousX = m_store->previousX();
+	const Real* previousY = m_store->previousY();
+
+	for (size_t item = begin; item < end; item++) {
+		const size_t i = m_endParticle[item];
+		const Real velocityX = positionX[i] - previousX[i];
+		const Real velocityY = positionY[i] - previousY[i];
+
+		Real totalX = 0;
+		Real totalY = 0;
+		for (size_t e = m_endStart[item]; e < m_endStart[item] + m_endCount[item]; e++) {
+			const SpringEnd& spring = m_ends[e];
+			const uint32_t j = spring.other;
+
+			const Real dx = positionX[j] - positionX[i];
+			const Real dy = positionY[j] - positionY[i];
+			const Real length = std::sqrt(dx * dx + dy * dy);
+			if (length == 0) continue;
+
+			const Real normalX = dx / length;
+			const Real normalY = dy / length;
+
+			// Stretch pulls towards the far end, and closing speed along the spring is damped
+			const Real relativeSpeed = (positionX[j] - previousX[j] - velocityX) * normalX + (positionY[j] - previousY[j] - velocityY) * normalY;
+			const Real magnitude = spring.stiffness * (length - spring.restLength) + spring.damping * relativeSpeed;
+			totalX += normalX * magnitude;
+			totalY += normalY * magnitude;
+		}
+
+		forceX[i] += totalX;
+		forceY[i] += totalY;
+	}
+}
+
+namespace {
+
+	using VerletPhysics::Real;
+	using Node = VerletPhysics::NBodyGravity::Node;
+
+	constexpr uint32_t NBODY_MAX_DEPTH = 16;       // Morton codes hold 16 bits per axis
+	constexpr uint32_t NBODY_BUCKET_LEVELS = 4;    // Levels above the subtrees that are built in parallel
+	constexpr uint32_t NBODY_BUCKET_COUNT = 1u << (2 * NBODY_BUCKET_LEVELS);
+	constexpr uint32_t NBODY_LEAF_SIZE = 32;        // Bodies summed directly rather than split further
+
+	/**
+	 * Splits a range across a pool, or runs all of it on the calling thread without one.
+	 */
+	void forRange(VerletPhysics::ThreadPool* threadPool, size_t begin, size_t end, size_t grainSize, const std::function<void(size_t, size_t)>& task)
+	{
+		if (threadPool) threadPool->parallelFor(begin, end, grainSize, task);
+		else if (begin < end) task(begin, end);
+	}
+
+	/**
+	 * Gathers the even bits of a value into its low 16 bits.
+	 */
+	inline uint32_t compactBits(uint32_t value)
 	{
-		particle->addForce(m_accelerationFactor * particle->getMass());
+		value &= 0x55555555;
+		value = (value | (value >> 1)) & 0x33333333;
+		value = (value | (value >> 2)) & 0x0F0F0F0F;
+		value = (value | (value >> 4)) & 0x00FF00FF;
+		value = (value | (value >> 8)) & 0x0000FFFF;
+		return value;
+	}
+
+	/**
+	 * Gets the quadrant a sorted key falls into below a node of the given level.
+	 */
+	inline uint32_t quadrantAt(uint64_t key, uint32_t level)
+	{
+		return static_cast<uint32_t>(key >> (62 - 2 * level)) & 3;
+	}
+
+	/**
+	 * Sets a node's mass and center of mass from its children, or from its bodies if it is a leaf.
+	 */
+	void summarize(std::vector<Node>& nodes, uint32_t index, const Real* bodyX, const Real* bodyY, const Real* bodyMass)
+	{
+		Node& node = nodes[index];
+		Real mass = 0;
+		Real weightedX = 0;
+		Real weightedY = 0;
+
+		if (node.childCount > 0) {
+			for (uint32_t child = node.firstChild; child < node.firstChild + node.childCount; child++) {
+				mass += nodes[child].mass;
+				weightedX += nodes[child].centerX * nodes[child].mass;
+				weightedY += nodes[child].centerY * nodes[child].mass;
+			}
+		}
+		else {
+			for (uint32_t body = node.bodyBegin; body < node.bodyEnd; body++) {
+				mass += bodyMass[body];
+				weightedX += bodyX[body] * bodyMass[body];
+				weightedY += bodyY[body] * bodyMass[body];
+			}
+		}
+
+		node.mass = mass;
+		node.centerX = mass > 0 ? weightedX / mass : node.cellX + node.size / 2;
+		node.centerY = mass > 0 ? weightedY / mass : node.cellY + node.size / 2;
+	}
+
+	/**
+	 * Builds the subtree below a node whose square and body range are set, appending its descendants.
+	 */
+	void buildSubtree(std::vector<Node>& nodes, uint32_t index, const uint64_t* keys, const Real* bodyX, const Real* bodyY, const Real* bodyMass, uint32_t level)
+	{
+		const uint32_t begin = nodes[index].bodyBegin;
+		const uint32_t end = nodes[index].bodyEnd;
+		nodes[index].firstChild = 0;
+		nodes[index].childCount = 0;
+
+		if (end - begin > NBODY_LEAF_SIZE && level < NBODY_MAX_DEPTH) {
+			// Keys are sorted, so the bodies of each quadrant form a contiguous run
+			uint32_t split[5] = { begin, 0, 0, 0, end };
+			for (uint32_t quadrant = 1; quadrant < 4; quadrant++) {
+				split[quadrant] = static_cast<uint32_t>(std::partition_point(keys + split[quadrant - 1], keys + end,
+					[level, quadrant](uint64_t key) { return quadrantAt(key, level) < quadrant; }) - keys);
+			}
+
+			uint32_t childCount = 0;
+			for (uint32_t quadrant = 0; quadrant < 4; quadrant++) childCount += split[quadrant] < split[quadrant + 1];
+
+			const uint32_t firstChild = static_cast<uint32_t>(nodes.size());
+			nodes.resize(firstChild + childCount);
+			nodes[index].firstChild = firstChild;
+			nodes[index].childCount = childCount;
+
+			uint32_t child = firstChild;
+			for (uint32_t quadrant = 0; quadrant < 4; quadrant++) {
+				if (split[quadrant] == split[quadrant + 1]) continue;
+
+				const Real half = nodes[index].size / 2;
+				nodes[child].cellX = nodes[index].cellX + ((quadrant & 1) ? half : 0);
+				nodes[child].cellY = nodes[index].cellY + ((quadrant & 2) ? half : 0);
+				nodes[child].size = half;
+				nodes[child].bodyBegin = split[quadrant];
+				nodes[child].bodyEnd = split[quadrant + 1];
+				buildSubtree(nodes, child, keys, bodyX, bodyY, bodyMass, level + 1);
+				child++;
+			}
+		}
+
+		summarize(nodes, index, bodyX, bodyY, bodyMass);
+	}
+
+	/**
+	 * Builds the levels above the buckets, copying each non-empty bucket's root into its slot.
+	 */
+	void buildTop(std::vector<Node>& nodes, uint32_t index, uint32_t level, uint32_t firstBucket,
+		const std::vector<uint32_t>& bucketStart, const std::vector<std::vector<Node>>& bucketNodes, std::vector<uint32_t>& bucketSlot)
+	{
+		if (level == NBODY_BUCKET_LEVELS) {
+			nodes[index] = bucketNodes[firstBucket][0];
+			bucketSlot[firstBucket] = index;
+			return;
+		}
+
+		const uint32_t childSpan = 1u << (2 * (NBODY_BUCKET_LEVELS - level - 1));
+		const uint32_t lastBucket = firstBucket + 4 * childSpan;
+		nodes[index].bodyBegin = bucketStart[firstBucket];
+		nodes[index].bodyEnd = bucketStart[lastBucket];
+
+		uint32_t childCount = 0;
+		for (uint32_t quadrant = 0; quadrant < 4; quadrant++) {
+			childCount += bucketStart[firstBucket + quadrant * childSpan] < bucketStart[firstBucket + (quadrant + 1) * childSpan];
+		}
+
+		const uint32_t firstChild = static_cast<uint32_t>(nodes.size());
+		nodes.resize(firstChild + childCount);
+		nodes[index].firstChild = firstChild;
+		nodes[index].childCount = childCount;
+
+		uint32_t child = firstChild;
+		for (uint32_t quadrant = 0; quadrant < 4; quadrant++) {
+			const uint32_t childBucket = firstBucket + quadrant * childSpan;
+			if (bucketStart[childBucket] == bucketStart[childBucket + childSpan]) continue;
+
+			const Real half = nodes[index].size / 2;
+			nodes[child].cellX = nodes[index].cellX + ((quadrant & 1) ? half : 0);
+			nodes[child].cellY = nodes[index].cellY + ((quadrant & 2) ? half : 0);
+			nodes[child].size = half;
+			buildTop(nodes, child, level + 1, childBucket, bucketStart, bucketNodes, bucketSlot);
+			child++;
+		}
+
+		summarize(nodes, index, nullptr, nullptr, nullptr);
+	}
+}
+
+VerletPhysics::NBodyGravity::NBodyGravity(Real gravitationalConstant, Real openingAngle, Real softening) :
+	m_gravitationalConstant(gravitationalConstant),
+	m_openingAngle(openingAngle),
+	m_softening(softening)
+{}
+
+void VerletPhysics::NBodyGravity::prepare(ThreadPool& threadPool)
+{
+	build(&threadPool);
+}
+
+void VerletPhysics::NBodyGravity::build(ThreadPool* threadPool)
+{
+	partitionSubscribers();
+	m_nodes.clear();
+
+	// Sleeping bodies still exert attraction, so the tree holds every affected particle
+	const size_t count = m_allParticles ? m_store->size() : m_particles.size();
+	if (getParallelWorkSize() == 0) return;
+
+	const Real* positionX = m_store->positionX();
+	const Real* positionY = m_store->positionY();
+	const Real* inverseMass = m_store->inverseMass();
+	const size_t* subscribers = m_allParticles ? nullptr : m_particles.data();
+
+	// Bounding square of every body, reduced over chunks
+	Real minX = std::numeric_limits<Real>::max();
+	Real minY = std::numeric_limits<Real>::max();
+	Real maxX = std::numeric_limits<Real>::lowest();
+	Real maxY = std::numeric_limits<Real>::lowest();
+	std::mutex boundsMutex;
+
+	forRange(threadPool, 0, count, 4096, [&](size_t begin, size_t end) {
+		Real lowX = std::numeric_limits<Real>::max();
+		Real lowY = std::numeric_limits<Real>::max();
+		Real highX = std::numeric_limits<Real>::lowest();
+		Real highY = std::numeric_limits<Real>::lowest();
+
+		for (size_t body = begin; body < end; body++) {
+			const size_t i = subscribers ? subscribers[body] : body;
+			lowX = std::min(lowX, positionX[i]);
+			lowY = std::min(lowY, positionY[i]);
+			highX = std::max(highX, positionX[i]);
+			highY = std::max(highY, positionY[i]);
+		}
+
+		std::lock_guard<std::mutex> lock(boundsMutex);
+		minX = std::min(minX, lowX);
+		minY = std::min(minY, lowY);
+		maxX = std::max(maxX, highX);
+		maxY = std::max(maxY, highY);
+	});
+
+	const Real size = std::max(std::max(maxX - minX, maxY - minY), Real(1e-6));
+	const Real scale = Real(65536) / size;
+
+	// Morton code of every body, with its particle index in the low bits so sorting is deterministic
+	m_unsortedKeys.resize(count);
+	forRange(threadPool, 0, count, 4096, [&](size_t begin, size_t end) {
+		for (size_t body = begin; body < end; body++) {
+			const size_t i = subscribers ? subscribers[body] : body;
+			const uint32_t cellX = static_cast<uint32_t>(std::min(Real(65535), (positionX[i] - minX) * scale));
+			const uint32_t cellY = static_cast<uint32_t>(std::min(Real(65535), (positionY[i] - minY) * scale));
+			const uint32_t code = VerletPhysics::mortonCode(cellX, cellY);
+			m_unsortedKeys[body] = (static_cast<uint64_t>(code) << 32) | static_cast<uint32_t>(i);
+		}
+	});
+
+	// Counting sort into buckets by the top levels of the code
+	const uint32_t bucketShift = 64 - 2 * NBODY_BUCKET_LEVELS;
+	m_bucketStart.assign(NBODY_BUCKET_COUNT + 1, 0);
+	for (uint64_t key : m_unsortedKeys) m_bucketStart[(key >> bucketShift) + 1]++;
+	for (uint32_t bucket = 0; bucket < NBODY_BUCKET_COUNT; bucket++) m_bucketStart[bucket + 1] += m_bucketStart[bucket];
+
+	std::vector<uint32_t> fill(m_bucketStart.begin(), m_bucketStart.end() - 1);
+	m_keys.resize(count);
+	for (uint64_t key : m_unsortedKeys) m_keys[fill[key >> bucketShift]++] = key;
+
+	m_bodies.resize(count);
+	m_bodyX.resize(count);
+	m_bodyY.resize(count);
+	m_bodyMass.resize(count);
+	m_bodyAccelerationX.resize(count);
+	m_bodyAccelerationY.resize(count);
+	m_bucketNodes.resize(NBODY_BUCKET_COUNT);
+	m_bucketSlot.assign(NBODY_BUCKET_COUNT, 0);
+
+	// Each bucket is sorted and grown into its own subtree independently
+	const Real bucketSize = size / (1 << NBODY_BUCKET_LEVELS);
+	forRange(threadPool, 0, NBODY_BUCKET_COUNT, 1, [&](size_t firstBucket, size_t lastBucket) {
+		for (size_t bucket = firstBucket; bucket < lastBucket; bucket++) {
+			std::vector<Node>& nodes = m_bucketNodes[bucket];
+			nodes.clear();
+
+			const uint32_t begin = m_bucketStart[bucket];
+			const uint32_t end = m_bucketStart[bucket + 1];
+			if (begin == end) continue;
+
+			std::sort(m_keys.begin() + begin, m_keys.begin() + end);
+			for (uint32_t body = begin; body < end; body++) {
+				const uint32_t i = static_cast<uint32_t>(m_keys[body]);
+				m_bodies[body] = i;
+				m_bodyX[body] = positionX[i];
+				m_bodyY[body] = positionY[i];
+				m_bodyMass[body] = inverseMass[i] == 0 ? 0 : 1 / inverseMass[i];
+			}
+
+			nodes.resize(1);
+			nodes[0].cellX = minX + compactBits(static_cast<uint32_t>(bucket)) * bucketSize;
+			nodes[0].cellY = minY + compactBits(static_cast<uint32_t>(bucket) >> 1) * bucketSize;
+			nodes[0].size = bucketSize;
+			nodes[0].bodyBegin = begin;
+			nodes[0].bodyEnd = end;
+			buildSubtree(nodes, 0, m_keys.data(), m_bodyX.data(), m_bodyY.data(), m_bodyMass.data(), NBODY_BUCKET_LEVELS);
+		}
+	});
+
+	m_nodes.resize(1);
+	m_nodes[0].cellX = minX;
+	m_nodes[0].cellY = minY;
+	m_nodes[0].size = size;
+	buildTop(m_nodes, 0, 0, 0, m_bucketStart, m_bucketNodes, m_bucketSlot);
+
+	// Append every bucket's descendants after the top levels, shifting their child indices
+	std::vector<uint32_t> offset(NBODY_BUCKET_COUNT, 0);
+	uint32_t nodeCount = static_cast<uint32_t>(m_nodes.size());
+	for (uint32_t bucket = 0; bucket < NBODY_BUCKET_COUNT; bucket++) {
+		if (m_bucketNodes[bucket].empty()) continue;
+		offset[bucket] = nodeCount;
+		nodeCount += static_cast<uint32_t>(m_bucketNodes[bucket].size()) - 1;
+	}
+	m_nodes.resize(nodeCount);
+
+	forRange(threadPool, 0, NBODY_BUCKET_COUNT, 1, [&](size_t firstBucket, size_t lastBucket) {
+		for (size_t bucket = firstBucket; bucket < lastBucket; bucket++) {
+			const std::vector<Node>& nodes = m_bucketNodes[bucket];
+			if (nodes.empty()) continue;
+
+			// Local node k > 0 lands at offset + k - 1
+			const uint32_t shift = offset[bucket] - 1;
+			if (nodes[0].childCount > 0) m_nodes[m_bucketSlot[bucket]].firstChild = nodes[0].firstChild + shift;
+
+			for (size_t k = 1; k < nodes.size(); k++) {
+				Node node = nodes[k];
+				if (node.childCount > 0) node.firstChild += shift;
+				m_nodes[shift + k] = node;
+			}
+		}
+	});
+
+	// Walk the tree once per leaf, each leaf writing only the accelerations of its own bodies
+	m_leaves.clear();
+	for (uint32_t index = 0; index < m_nodes.size(); index++) {
+		if (m_nodes[index].childCount == 0) m_leaves.push_back(index);
+	}
+
+	m_accelerationX.resize(m_store->size());
+	m_accelerationY.resize(m_store->size());
+	forRange(threadPool, 0, m_leaves.size(), 16, [&](size_t firstLeaf, size_t lastLeaf) {
+		std::vector<Real> listX;
+		std::vector<Real> listY;
+		std::vector<Real> listMass;
+		for (size_t leaf = firstLeaf; leaf < lastLeaf; leaf++) accelerateLeaf(m_leaves[leaf], listX, listY, listMass);
+	});
+}
+
+void VerletPhysics::NBodyGravity::accelerateLeaf(uint32_t leaf, std::vector<Real>& listX, std::vector<Real>& listY, std::vector<Real>& listMass)
+{
+	const Node& target = m_nodes[leaf];
+
+	// Only awake bodies feel attraction, so leaves holding nothing but sleepers are not walked
+	const size_t awakeCount = m_store->getAwakeCount();
+	bool awake = false;
+	for (uint32_t body = target.bodyBegin; body < target.bodyEnd && !awake; body++) awake = m_bodies[body] < awakeCount;
+	if (!awake) return;
+
+	const Real openingSquared = m_openingAngle * m_openingAngle;
+
+	// Bounding box of the leaf's bodies, which every node is judged from
+	Real boxMinX = m_bodyX[target.bodyBegin];
+	Real boxMinY = m_bodyY[target.bodyBegin];
+	Real boxMaxX = boxMinX;
+	Real boxMaxY = boxMinY;
+	for (uint32_t body = target.bodyBegin + 1; body < target.bodyEnd; body++) {
+		boxMinX = std::min(boxMinX, m_bodyX[body]);
+		boxMinY = std::min(boxMinY, m_bodyY[body]);
+		boxMaxX = std::max(boxMaxX, m_bodyX[body]);
+		boxMaxY = std::max(boxMaxY, m_bodyY[body]);
+	}
+
+	listX.clear();
+	listY.clear();
+	listMass.clear();
+
+	// Each visit pushes at most four children, so the stack never exceeds 3 * depth + 1 entries
+	uint32_t stack[64];
+	size_t depth = 0;
+	stack[depth++] = 0;
+
+	while (depth > 0) {
+		const Node& node = m_nodes[stack[--depth]];
+
+		// Gap between the node's square and the box, zero when they overlap so the node is opened
+		const Real gapX = std::max(std::max(boxMinX - (node.cellX + node.size), node.cellX - boxMaxX), Real(0));
+		const Real gapY = std::max(std::max(boxMinY - (node.cellY + node.size), node.cellY - boxMaxY), Real(0));
+		if (node.size * node.size < openingSquared * (gapX * gapX + gapY * gapY)) {
+			listX.push_back(node.centerX);
+			listY.push_back(node.centerY);
+			listMass.push_back(node.mass);
+			continue;
+		}
+
+		// Leaves are summed body by body, the target's own bodies included since a body exerts no pull on itself
+		if (node.childCount == 0) {
+			listX.insert(listX.end(), m_bodyX.begin() + node.bodyBegin, m_bodyX.begin() + node.bodyEnd);
+			listY.insert(listY.end(), m_bodyY.begin() + node.bodyBegin, m_bodyY.begin() + node.bodyEnd);
+			listMass.insert(listMass.end(), m_bodyMass.begin() + node.bodyBegin, m_bodyMass.begin() + node.bodyEnd);
+			continue;
+		}
+
+		for (uint32_t child = 0; child < node.childCount; child++) stack[depth++] = node.firstChild + child;
+	}
+
+	SimdKernels::sumAttraction(m_bodyX.data() + target.bodyBegin, m_bodyY.data() + target.bodyBegin, target.bodyEnd - target.bodyBegin,
+		listX.data(), listY.data(), listMass.data(), listX.size(), m_softening,
+		m_bodyAccelerationX.data() + target.bodyBegin, m_bodyAccelerationY.data() + target.bodyBegin);
+
+	for (uint32_t body = target.bodyBegin; body < target.bodyEnd; body++) {
+		m_accelerationX[m_bodies[body]] = m_bodyAccelerationX[body] * m_gravitationalConstant;
+		m_accelerationY[m_bodies[body]] = m_bodyAccelerationY[body] * m_gravitationalConstant;
+	}
+}
+
+void VerletPhysics::NBodyGravity::applyForces()
+{
+	build(nullptr);
+	applyForcesToRange(0, getParallelWorkSize());
+}
+
+void VerletPhysics::NBodyGravity::applyToRange(size_t begin, size_t end)
+{
+	if (m_nodes.empty()) return;
+
+	Real* forceX = m_store->forceX();
+	Real* forceY = m_store->forceY();
+	const Real* inverseMass = m_store->inverseMass();
+
+	for (size_t i = begin; i < end; i++) {
+		if (inverseMass[i] == 0) continue;
+
+		forceX[i] += m_accelerationX[i] / inverseMass[i];
+		forceY[i] += m_accelerationY[i] / inverseMass[i];
+	}
+}
+
+void VerletPhysics::NBodyGravity::applyToIndices(const size_t* indices, size_t count)
+{
+	if (m_nodes.empty()) return;
+
+	Real* forceX = m_store->forceX();
+	Real* forceY = m_store->forceY();
+	const Real* inverseMass = m_store->inverseMass();
+
+	for (size_t n = 0; n < count; n++) {
+		const size_t i = indices[n];
+		if (inverseMass[i] == 0) continue;
+
+		forceX[i] += m_accelerationX[i] / inverseMass[i];
+		forceY[i] += m_accelerationY[i] / inverseMass[i];
 	}
 }
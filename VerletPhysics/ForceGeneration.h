@@ -1,7 +1,11 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 #include "Particle.h"
+#include "SubscriberList.h"
+#include "ThreadPool.h"
 
 namespace VerletPhysics {
 
@@ -14,12 +18,164 @@ namespace VerletPhysics {
      */
     struct ForceGenerator
     {
+        virtual ~ForceGenerator() = default;
+
         /**
          * Applies forces to particles.
          *
          * Derived classes should implement this method to apply specific forces to particles.
          */
         virtual void applyForces() = 0;
+
+        /**
+         * Prepares the generator for a substep.
+         *
+         * Called by the simulation world before `getParallelWorkSize`, so generators can rebuild
+         * data that `applyForcesToRange` then only reads.
+         *
+         * @param threadPool The world's threads, for generators whose preparation is worth splitting.
+         */
+        virtual void prepare(ThreadPool& /*threadPool*/) {}
+
+        /**
+         * Gets the number of independent work items the generator can be split into.
+         *
+         * Generators returning zero are applied serially through `applyForces`. Otherwise the
+         * simulation world spreads `[0, count)` over its threads with `applyForcesToRange`.
+         *
+         * @return The number of work items, or zero if the generator cannot run in parallel.
+         */
+        virtual size_t getParallelWorkSize() const { return 0; }
+
+        /**
+         * Applies forces for a subset of the generator's work items.
+         *
+         * Called concurrently for disjoint ranges, so two work items must never write to the same particle.
+         *
+         * @param begin First work item to process.
+         * @param end One past the last work item to process.
+         */
+        virtual void applyForcesToRange(size_t /*begin*/, size_t /*end*/) {}
+
+        /**
+         * Points the generator at the new indices of its particles after their store was reordered
+         * or particles were removed from it. Removed particles have to be dropped.
+         *
+         * Generators that only reach their particles through `Particle` handles need not override
+         * this, as long as none of their particles are removed. Overrides should take time
+         * proportional to the remap rather than to the number of particles.
+         *
+         * @param remap The removed particles and every particle that changed index.
+         */
+        virtual void remapParticles(const ParticleRemap& /*remap*/) {}
+    };
+
+    /**
+     * Base class for force generators that evaluate a force field over many particles at once.
+     *
+     * A bulk generator acts either on a list of subscribed particles or, without keeping any list,
+     * on every particle of a store, including particles added later. Each particle is an independent
+     * work item, so the simulation world spreads them over its threads. In the all-particles mode every
+     * thread receives a contiguous range of the store's arrays, which derived classes stream through
+     * the vectorised batch kernels of `SimdKernels`. Sleeping particles are left out in both modes:
+     * the store keeps them last, and the subscriber list is partitioned to match.
+     */
+    class BulkForceGenerator : public ForceGenerator
+    {
+    protected:
+        ParticleStore* m_store = nullptr; ///< Store holding the affected particles.
+        SubscriberList m_particles;       ///< Indices of the subscribed particles, unused when acting on all of them.
+        bool m_allParticles = false;      ///< Whether the generator acts on every particle of the store.
+        size_t m_awakeSubscribers = 0;    ///< Subscribers that were awake as of the last `prepare`, which lead the list.
+
+    public:
+        /**
+         * Subscribes a particle to be affected by the generator.
+         *
+         * @param subscriber Pointer to the Particle object to be affected.
+         * @note Every subscriber must belong to the same simulation world. Ignored once the generator
+         *       acts on every particle, or if the particle is already subscribed.
+         */
+        void subscribeParticle(Particle* subscriber);
+
+        /**
+         * Makes the generator act on every particle of a store, now and in the future.
+         *
+         * Replaces any individual subscriptions.
+         *
+         * @param particles The store whose particles are affected, usually `SimulationWorld::getParticles()`.
+         */
+        void subscribeAllParticles(ParticleStore& particles);
+
+        /**
+         * Checks whether the generator acts on every particle of its store.
+         *
+         * @return `true` after `subscribeAllParticles`.
+         */
+        bool isSubscribedToAll() const { return m_allParticles; }
+
+        /**
+         * Gets the store indices of every individually subscribed particle.
+         *
+         * @return The subscribers, in subscription order until particles are removed, sorted or fall
+         *         asleep. Empty when acting on every particle.
+         */
+        const std::vector<size_t>& getSubscribers() const { return m_particles.indices(); }
+
+        /**
+         * Applies the generator's force to every affected particle.
+         */
+        virtual void applyForces() override;
+
+        /**
+         * Moves the awake subscribers to the front of the list.
+         */
+        virtual void prepare(ThreadPool& threadPool) override;
+
+        /**
+         * Gets the number of awake affected particles, each of which is an independent work item.
+         *
+         * @return The awake particle count of the store in the all-particles mode, otherwise the
+         *         awake subscriber count.
+         */
+        virtual size_t getParallelWorkSize() const override;
+
+        /**
+         * Applies the generator's force to a range of the affected particles.
+         *
+         * @param begin Index of the first particle, or subscriber, to process.
+         * @param end One past the index of the last particle, or subscriber, to process.
+         */
+        virtual void applyForcesToRange(size_t begin, size_t end) override;
+
+        /**
+         * Remaps the moved subscribers and unsubscribes removed ones, see `SubscriberList::remap`.
+         *
+         * @param remap The removed particles and every particle that changed index.
+         */
+        virtual void remapParticles(const ParticleRemap& remap) override;
+
+    protected:
+        /**
+         * Applies the force to a contiguous range of the store's particles.
+         *
+         * @param begin Index of the first particle to process.
+         * @param end One past the index of the last particle to process.
+         */
+        virtual void applyToRange(size_t begin, size_t end) = 0;
+
+        /**
+         * Applies the force to a list of particles.
+         *
+         * @param indices Indices of the particles to process.
+         * @param count Number of indices.
+         */
+        virtual void applyToIndices(const size_t* indices, size_t count) = 0;
+
+        /**
+         * Partitions the subscribers at the store's awake count.
+         */
+        void partitionSubscribers();
     };
 
     /**
@@ -29,9 +185,8 @@ namespace VerletPhysics {
      * acceleration to a collection of particles. It is used to simulate gravity, wind, or any
      * other constant force affecting particles.
      */
-    class ConstantAcceleration : public ForceGenerator
+    class ConstantAcceleration : public BulkForceGenerator
     {
-        std::vector<Particle*> m_particles; ///< Collection of particles affected by the constant acceleration.
         const Vector2 m_accelerationFactor; ///< The constant acceleration to be applied.
 
     public:
@@ -43,18 +198,467 @@ namespace VerletPhysics {
         ConstantAcceleration(Vector2 acceleration);
 
         /**
-         * Subscribes a particle to be affected by the constant acceleration.
+         * Gets the constant acceleration applied to the subscribers.
          *
-         * @param subscriber Pointer to the Particle object to be affected.
+         * @return The acceleration vector.
          */
-        void subscribeParticle(Particle* subscriber);
+        Vector2 getAcceleration() const { return m_accelerationFactor; }
+
+    protected:
+        virtual void applyToRange(size_t begin, size_t end) override;
+        virtual void applyToIndices(const size_t* indices, size_t count) override;
+    };
+
+    /**
+     * Slows particles down with a force proportional to their velocity.
+     *
+     * The velocity is the displacement of the particle over the last substep, so the drag force is
+     * `-coefficient * (x - x_prev)` and the coefficient already accounts for the substep length.
+     */
+    class DragForce : public BulkForceGenerator
+    {
+        const Real m_coefficient; ///< Force per unit of displacement over a substep.
+
+    public:
+        /**
+         * Constructs a DragForce object.
+         *
+         * @param coefficient Force per unit of displacement over a substep.
+         */
+        DragForce(Real coefficient);
+
+        /**
+         * Gets the drag coefficient.
+         *
+         * @return The force per unit of displacement over a substep.
+         */
+        Real getCoefficient() const { return m_coefficient; }
+
+    protected:
+        virtual void applyToRange(size_t begin, size_t end) override;
+        virtual void applyToIndices(const size_t* indices, size_t count) override;
+    };
+
+    /**
+     * Pulls particles towards a point with a softened inverse-square law.
+     *
+     * Each particle with mass is accelerated by `strength * d / (|d|^2 + softening^2)^(3/2)`, where
+     * `d` points from the particle to the center. A negative strength pushes particles away.
+     */
+    class RadialAttractor : public BulkForceGenerator
+    {
+        Vector2 m_center; ///< The attracting point.
+        Real m_strength;  ///< Acceleration at unit distance without softening.
+        Real m_softening; ///< Length added in quadrature to every distance.
+
+    public:
+        /**
+         * Constructs a RadialAttractor object.
+         *
+         * @param center The attracting point.
+         * @param strength Acceleration at unit distance without softening, negative to repel.
+         * @param softening Length added in quadrature to every distance, keeping the force finite near the center.
+         */
+        RadialAttractor(Vector2 center, Real strength, Real softening);
+
+        /**
+         * Moves the attracting point.
+         *
+         * @param center The new attracting point.
+         */
+        void setCenter(Vector2 center) { m_center = center; }
+
+        /**
+         * Changes the strength of the attraction.
+         *
+         * @param strength Acceleration at unit distance without softening, negative to repel.
+         */
+        void setStrength(Real strength) { m_strength = strength; }
+
+        /**
+         * Gets the attracting point.
+         *
+         * @return The attracting point.
+         */
+        Vector2 getCenter() const { return m_center; }
+
+        /**
+         * Gets the acceleration at unit distance.
+         *
+         * @return The acceleration at unit distance.
+         */
+        Real getStrength() const { return m_strength; }
+
+        /**
+         * Gets the softening length.
+         *
+         * @return The softening length.
+         */
+        Real getSoftening() const { return m_softening; }
+
+    protected:
+        virtual void applyToRange(size_t begin, size_t end) override;
+        virtual void applyToIndices(const size_t* indices, size_t count) override;
+    };
+
+    /**
+     * Pushes particles with forces sampled from a grid, such as a wind map.
+     *
+     * The grid stores a force at each of its points, `cellSize` apart starting at `origin`. Particles
+     * receive the bilinear interpolation of the four surrounding points; outside the grid the nearest
+     * edge is used. The force is not scaled by mass, so lighter particles are blown further.
+     */
+    class WindField : public BulkForceGenerator
+    {
+        const Vector2 c_origin;      ///< Position of the first grid point.
+        const Real c_cellSize;       ///< Distance between neighbouring grid points.
+        const size_t c_columns;      ///< Number of grid points along X.
+        const size_t c_rows;         ///< Number of grid points along Y.
+        std::vector<Real> m_forceX;  ///< X-component of the force at every grid point, row by row.
+        std::vector<Real> m_forceY;  ///< Y-component of the force at every grid point, row by row.
+
+        friend struct WorldSnapshot;
+
+    public:
+        /**
+         * Constructs a WindField with no force anywhere.
+         *
+         * @param origin Position of the first grid point.
+         * @param cellSize Distance between neighbouring grid points.
+         * @param columns Number of grid points along X, at least one.
+         * @param rows Number of grid points along Y, at least one.
+         */
+        WindField(Vector2 origin, Real cellSize, size_t columns, size_t rows);
+
+        /**
+         * Sets the force at one grid point.
+         *
+         * @param column Column of the grid point.
+         * @param row Row of the grid point.
+         * @param force The force exerted at that point.
+         */
+        void setForce(size_t column, size_t row, Vector2 force);
+
+        /**
+         * Gets the force at one grid point.
+         *
+         * @param column Column of the grid point.
+         * @param row Row of the grid point.
+         * @return The force exerted at that point.
+         */
+        Vector2 getForce(size_t column, size_t row) const;
+
+        /**
+         * Samples the field at a position.
+         *
+         * @param position The position to sample.
+         * @return The interpolated force.
+         */
+        Vector2 sample(Vector2 position) const;
+
+        /**
+         * Gets the position of the first grid point.
+         *
+         * @return The position of the first grid point.
+         */
+        Vector2 getOrigin() const { return c_origin; }
+
+        /**
+         * Gets the distance between grid points.
+         *
+         * @return The distance between grid points.
+         */
+        Real getCellSize() const { return c_cellSize; }
+
+        /**
+         * Gets the number of grid points along X.
+         *
+         * @return The number of grid points along X.
+         */
+        size_t getColumns() const { return c_columns; }
+
+        /**
+         * Gets the number of grid points along Y.
+         *
+         * @return The number of grid points along Y.
+         */
+        size_t getRows() const { return c_rows; }
+
+    protected:
+        virtual void applyToRange(size_t begin, size_t end) override;
+        virtual void applyToIndices(const size_t* indices, size_t count) override;
+    };
+
+    /**
+     * Applies damped Hookean springs between pairs of particles.
+     *
+     * Unlike `PairedParticleConstraint`, which only stops particles from drifting apart, a spring
+     * pushes and pulls towards its rest length. Springs are packed per particle, so each particle with
+     * springs is one work item that adds the forces of all its springs to itself alone. Every spring
+     * is therefore evaluated once from each end, which keeps threads from writing to the same particle.
+     * Work items of awake particles come first, so sleeping particles feel no spring at all.
+     */
+    class SpringForce : public ForceGenerator
+    {
+        /**
+         * One end of a spring, as seen from the particle it is attached to.
+         */
+        struct SpringEnd
+        {
+            uint32_t other;  ///< The particle at the far end.
+            Real restLength; ///< Length at which the spring exerts no force.
+            Real stiffness;  ///< Force per unit of stretch.
+            Real damping;    ///< Force per unit of relative displacement along the spring over a substep.
+        };
+
+        static constexpr uint32_t NO_ITEM = UINT32_MAX;
+
+        ParticleStore* m_store = nullptr;   ///< Store holding the connected particles.
+        std::vector<uint32_t> m_springA;    ///< First particle of every spring.
+        std::vector<uint32_t> m_springB;    ///< Second particle of every spring.
+        std::vector<Real> m_restLength;     ///< Rest length of every spring.
+        std::vector<Real> m_stiffness;      ///< Stiffness of every spring.
+        std::vector<Real> m_damping;        ///< Damping of every spring.
+        bool m_dirty = false;               ///< Set when the packed ends need rebuilding.
+
+        std::vector<uint32_t> m_endParticle; ///< Particle of each work item.
+        std::vector<size_t> m_endStart;      ///< Offset of each work item's ends.
+        std::vector<uint32_t> m_endCount;    ///< Number of ends of each work item.
+        std::vector<SpringEnd> m_ends;       ///< Both ends of every spring, grouped by particle and ordered by spring within each group.
+        std::vector<uint32_t> m_endOwner;    ///< Spring of every end times two, plus one for ends attached to the spring's second particle.
+        std::vector<size_t> m_endSlot;       ///< Position in `m_ends` of both ends of every spring, indexed like `m_endOwner`.
+        std::vector<uint32_t> m_itemOf;      ///< Work item of every particle, or `NO_ITEM`.
+        size_t m_awakeBound = 0;             ///< Awake particle count the work items are split at.
+        size_t m_awakeItems = 0;             ///< Work items of particles below `m_awakeBound`, which come first.
+
+        friend struct WorldSnapshot;
+
+    public:
+        /**
+         * Connects two particles with a spring.
+         *
+         * @param particleA The first particle.
+         * @param particleB The second particle, from the same simulation world.
+         * @param restLength Length at which the spring exerts no force.
+         * @param stiffness Force per unit of stretch or compression.
+         * @param damping Force per unit of relative displacement along the spring over a substep.
+         * @return Index of the new spring, until a spring is dropped by a removal.
+         */
+        size_t addSpring(Particle* particleA, Particle* particleB, Real restLength, Real stiffness, Real damping = 0);
 
         /**
-         * Applies the constant acceleration to the subscribed particles.
+         * Gets the number of springs.
          *
-         * Overrides the base class's `applyForces` method to apply the constant acceleration
-         * to the particles in the subscription list.
+         * @return The spring count.
+         */
+        size_t getSpringCount() const { return m_springA.size(); }
+
+        /**
+         * Applies every spring.
          */
         virtual void applyForces() override;
+
+        /**
+         * Packs the spring ends per particle if springs were added since the last substep, and moves
+         * the work items of awake particles to the front.
+         */
+        virtual void prepare(ThreadPool& threadPool) override;
+
+        /**
+         * Gets the number of awake particles with at least one spring, each of which is a work item.
+         *
+         * @return The awake work item count.
+         */
+        virtual size_t getParallelWorkSize() const override { return m_awakeItems; }
+
+        /**
+         * Applies the springs of a range of particles to those particles.
+         *
+         * @param begin First work item to process.
+         * @param end One past the last work item to process.
+         */
+        virtual void applyForcesToRange(size_t begin, size_t end) override;
+
+        /**
+         * Remaps the springs and packed ends of every moved particle. Springs with a removed end are
+         * dropped, the last spring taking the index of each dropped one.
+         *
+         * @param remap The removed particles and every particle that changed index.
+         */
+        virtual void remapParticles(const ParticleRemap& remap) override;
+
+    private:
+        /**
+         * Packs the spring ends if needed and moves the work items of awake particles to the front,
+         * everything `prepare` and `applyForces` do before applying the springs.
+         */
+        void update();
+
+        /**
+         * Lays both ends of every spring out per particle.
+         *
+         * @param particleCount Number of particles the spring ends are numbered against.
+         */
+        void pack(size_t particleCount);
+
+        /**
+         * Drops a spring and its two ends, moving the last spring into its place.
+         */
+        void eraseSpring(uint32_t spring);
+
+        /**
+         * Drops one packed end, keeping the other ends of its work item in spring order.
+         */
+        void eraseEnd(size_t end);
+
+        /**
+         * Moves the work item of a particle to the side of the awake items it belongs on.
+         */
+        void classifyItem(uint32_t item);
+
+        /**
+         * Exchanges two work items.
+         */
+        void swapItems(uint32_t a, uint32_t b);
+    };
+
+    /**
+     * Mutual gravitational attraction between particles, approximated with a Barnes-Hut quadtree.
+     *
+     * Every substep the affected particles are sorted along a Morton curve and grouped into a
+     * quadtree whose nodes store the mass and center of mass of everything inside them. A particle
+     * then treats any node that looks smaller than the opening angle from where it stands as a single
+     * body, which brings the cost down from O(n^2) to O(n log n). The tree is built in parallel over
+     * 256 buckets of the Morton curve. It is then walked once per leaf rather than once per particle,
+     * with the opening angle measured from the gap between the node and the leaf's bounding box, and the resulting interaction
+     * list is summed for each body of the leaf. Leaves are walked in parallel during `prepare`, so
+     * applying the forces only adds the stored accelerations.
+     *
+     * Each particle with mass is accelerated by `G * m_j * d / (|d|^2 + softening^2)^(3/2)` towards
+     * every other particle, or node, `j`.
+     */
+    class NBodyGravity : public BulkForceGenerator
+    {
+    public:
+        /**
+         * A node of the quadtree, either internal with up to four children or a leaf holding a few bodies.
+         */
+        struct Node
+        {
+            Real centerX;        ///< X-coordinate of the center of mass of everything in the node.
+            Real centerY;        ///< Y-coordinate of the center of mass of everything in the node.
+            Real mass;           ///< Total mass in the node.
+            Real cellX;          ///< Minimum X-coordinate of the node's square.
+            Real cellY;          ///< Minimum Y-coordinate of the node's square.
+            Real size;           ///< Side length of the node's square.
+            uint32_t firstChild; ///< Index of the first child, children being stored next to each other.
+            uint32_t childCount; ///< Number of non-empty children, zero for leaves.
+            uint32_t bodyBegin;  ///< First body of the node in Morton order.
+            uint32_t bodyEnd;    ///< One past the last body of the node in Morton order.
+        };
+
+    private:
+        Real m_gravitationalConstant; ///< Scales every attraction.
+        Real m_openingAngle;          ///< Largest ratio of node size to distance treated as a single body.
+        Real m_softening;             ///< Length added in quadrature to every distance.
+
+        std::vector<Node> m_nodes;            ///< Quadtree nodes, the root first.
+        std::vector<uint32_t> m_leaves;       ///< Index of every leaf node.
+        std::vector<uint64_t> m_unsortedKeys; ///< Morton code and particle index of every body, in subscription order.
+        std::vector<uint64_t> m_keys;         ///< Morton code and particle index of every body, sorted.
+        std::vector<uint32_t> m_bodies;       ///< Particle index of every body, in Morton order.
+        std::vector<Real> m_bodyX;            ///< X-coordinate of every body, in Morton order.
+        std::vector<Real> m_bodyY;            ///< Y-coordinate of every body, in Morton order.
+        std::vector<Real> m_bodyMass;         ///< Mass of every body, in Morton order.
+        std::vector<Real> m_bodyAccelerationX; ///< X-component of the unscaled acceleration of every body, in Morton order.
+        std::vector<Real> m_bodyAccelerationY; ///< Y-component of the unscaled acceleration of every body, in Morton order.
+        std::vector<Real> m_accelerationX;    ///< X-component of the acceleration of every particle, by store index.
+        std::vector<Real> m_accelerationY;    ///< Y-component of the acceleration of every particle, by store index.
+
+        std::vector<uint32_t> m_bucketStart;          ///< First body of each Morton bucket, plus a trailing end offset.
+        std::vector<std::vector<Node>> m_bucketNodes; ///< Subtree of each bucket, its root first.
+        std::vector<uint32_t> m_bucketSlot;           ///< Index in `m_nodes` taken by each bucket's root.
+
+    public:
+        /**
+         * Constructs an NBodyGravity object.
+         *
+         * @param gravitationalConstant Scales every attraction.
+         * @param openingAngle Largest ratio of node size to distance treated as a single body. Zero
+         *                     sums every pair exactly, around 0.5 is a common trade-off.
+         * @param softening Length added in quadrature to every distance, keeping close encounters finite.
+         */
+        NBodyGravity(Real gravitationalConstant, Real openingAngle = Real(0.5), Real softening = Real(1));
+
+        /**
+         * Changes the opening angle, trading accuracy for speed.
+         *
+         * @param openingAngle Largest ratio of node size to distance treated as a single body.
+         */
+        void setOpeningAngle(Real openingAngle) { m_openingAngle = openingAngle; }
+
+        /**
+         * Gets the gravitational constant.
+         *
+         * @return The factor scaling every attraction.
+         */
+        Real getGravitationalConstant() const { return m_gravitationalConstant; }
+
+        /**
+         * Gets the opening angle.
+         *
+         * @return The largest ratio of node size to distance treated as a single body.
+         */
+        Real getOpeningAngle() const { return m_openingAngle; }
+
+        /**
+         * Gets the softening length.
+         *
+         * @return The length added in quadrature to every distance.
+         */
+        Real getSoftening() const { return m_softening; }
+
+        /**
+         * Gets the quadtree built for the current substep.
+         *
+         * @return The nodes, the root first, or nothing if no particle is affected.
+         */
+        const std::vector<Node>& getNodes() const { return m_nodes; }
+
+        /**
+         * Evaluates the attraction over the current positions and then applies it.
+         */
+        virtual void applyForces() override;
+
+        /**
+         * Builds the quadtree over the current positions of every affected particle and walks it to
+         * find the accelerations of the awake ones. Sleeping particles still exert attraction, so a
+         * settled clump keeps holding what orbits it, but feel none.
+         *
+         * @param threadPool Threads the Morton codes, bucket sorts, subtrees and leaf walks are split across.
+         */
+        virtual void prepare(ThreadPool& threadPool) override;
+
+    protected:
+        virtual void applyToRange(size_t begin, size_t end) override;
+        virtual void applyToIndices(const size_t* indices, size_t count) override;
+
+    private:
+        /**
+         * Builds the quadtree and finds the accelerations of the awake bodies, as `prepare` describes.
+         *
+         * @param threadPool Threads to split the work across, or null to do all of it on the calling thread.
+         */
+        void build(ThreadPool* threadPool);
+
+        /**
+         * Walks the quadtree once for a leaf and finds the acceleration of each of its bodies.
+         *
+         * @param leaf Index of the leaf node.
+         * @param listX Scratch storage for the X-coordinates of the interaction list.
+         * @param listY Scratch storage for the Y-coordinates of the interaction list.
+         * @param listMass Scratch storage for the masses of the interaction list.
+         */
+        void accelerateLeaf(uint32_t leaf, std::vector<Real>& listX, std::vector<Real>& listY, std::vector<Real>& listMass);
     };
 };
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace VerletPhysics {
+
+    /**
+     * Owns objects of arbitrary types, bump-allocated from typed pools.
+     *
+     * Every type gets its own pool of geometrically growing blocks, so objects of the same type sit
+     * next to each other in memory and never move once created. Objects cannot be freed one by one;
+     * the arena destroys every object and releases every block together when it is destroyed.
+     */
+    class ObjectArena
+    {
+        /**
+         * Type-erased interface letting the arena destroy pools of any type.
+         */
+        struct PoolBase
+        {
+            virtual ~PoolBase() = default;
+        };
+
+        /**
+         * Contiguous storage for objects of a single type.
+         */
+        template <typename T>
+        class Pool : public PoolBase
+        {
+            struct alignas(T) Slot
+            {
+                unsigned char bytes[sizeof(T)];
+            };
+
+            static constexpr size_t FIRST_BLOCK_SIZE = 64;     ///< Objects in the first block.
+            static constexpr size_t MAX_BLOCK_SIZE = 65536;    ///< Objects in the largest blocks.
+
+            std::vector<std::unique_ptr<Slot[]>> m_blocks; ///< Blocks in allocation order.
+            std::vector<size_t> m_blockSizes;              ///< Capacity of each block.
+            size_t m_used = 0;                             ///< Objects constructed in the last block.
+
+        public:
+            ~Pool() override
+            {
+                if (std::is_trivially_destructible<T>::value) return;
+
+                for (size_t block = 0; block < m_blocks.size(); block++) {
+                    const size_t count = block + 1 == m_blocks.size() ? m_used : m_blockSizes[block];
+                    for (size_t i = 0; i < count; i++) reinterpret_cast<T*>(&m_blocks[block][i])->~T();
+                }
+            }
+
+            template <typename... Args>
+            T* create(Args&&... args)
+            {
+                if (m_blocks.empty() || m_used == m_blockSizes.back()) {
+                    const size_t size = m_blocks.empty() ? FIRST_BLOCK_SIZE : std::min(m_blockSizes.back() * 2, MAX_BLOCK_SIZE);
+                    m_blocks.emplace_back(new Slot[size]);
+                    m_blockSizes.push_back(size);
+                    m_used = 0;
+                }
+
+                T* object = new (&m_blocks.back()[m_used]) T(std::forward<Args>(args)...);
+                m_used++;
+                return object;
+            }
+        };
+
+        std::unordered_map<std::type_index, std::unique_ptr<PoolBase>> m_pools; ///< One pool per created type.
+
+    public:
+        ObjectArena() = default;
+        ObjectArena(const ObjectArena&) = delete;
+        ObjectArena& operator=(const ObjectArena&) = delete;
+
+        /**
+         * Constructs an object in the pool of its type.
+         *
+         * @param args Arguments forwarded to the object's constructor.
+         * @return Pointer to the new object, valid until the arena is destroyed.
+         */
+        template <typename T, typename... Args>
+        T* create(Args&&... args)
+        {
+            std::unique_ptr<PoolBase>& pool = m_pools[std::type_index(typeid(T))];
+            if (!pool) pool = std::make_unique<Pool<T>>();
+
+            return static_cast<Pool<T>*>(pool.get())->create(std::forward<Args>(args)...);
+        }
+    };
+}
@@ -1,37 +1,285 @@
 #include "Particle.h"
 #include "PhysicsMath.h"
 
-#include <iostream>
-
+#include <algorithm>
 
 using namespace VerletPhysics;
 
-Particle::Particle(Vector2 initialPosition, double radius)
+Particle* ParticleStore::add(Vector2 initialPosition, Real radius)
+{
+	const Real mass = 3.1415 * radius * radius;
+
+	m_positionX.push_back(initialPosition.x());
+	m_positionY.push_back(initialPosition.y());
+	m_previousX.push_back(initialPosition.x());
+	m_previousY.push_back(initialPosition.y());
+	m_forceX.push_back(0.0);
+	m_forceY.push_back(0.0);
+	m_inverseMass.push_back(mass == 0.0 ? 0.0 : 1.0 / mass);
+	m_radius.push_back(radius);
+	m_isStatic.push_back(false);
+
+	m_positionVersion++;
+	Particle* handle = acquireHandle(size() - 1);
+
+	// Behind sleeping particles the new one has to be moved in front of them first
+	if (m_awakeCount == size() - 1) m_awakeCount++;
+	else m_sleepChanged.push_back(handle);
+	return handle;
+}
+
+bool ParticleStore::add(const std::vector<Vector2>& positions, const std::vector<Real>& radii, std::vector<Particle*>& handles)
+{
+	if (positions.size() != radii.size()) return false;
+
+	const size_t count = positions.size();
+	const size_t total = size() + count;
+
+	m_positionX.reserve(total);
+	m_positionY.reserve(total);
+	m_previousX.reserve(total);
+	m_previousY.reserve(total);
+	m_forceX.reserve(total);
+	m_forceY.reserve(total);
+	m_inverseMass.reserve(total);
+	m_radius.reserve(total);
+	m_isStatic.reserve(total);
+	m_handleAt.reserve(total);
+	handles.reserve(handles.size() + count);
+
+	for (size_t i = 0; i < count; i++) handles.push_back(add(positions[i], radii[i]));
+	return true;
+}
+
+void ParticleStore::grow(size_t count)
+{
+	if (count <= size()) return;
+
+	m_positionX.resize(count);
+	m_positionY.resize(count);
+	m_previousX.resize(count);
+	m_previousY.resize(count);
+	m_forceX.resize(count, 0.0);
+	m_forceY.resize(count, 0.0);
+	m_inverseMass.resize(count);
+	m_radius.resize(count);
+	m_isStatic.resize(count, false);
+
+	m_positionVersion++;
+	const bool partitioned = m_awakeCount == m_handleAt.size();
+	for (size_t i = m_handleAt.size(); i < count; i++) {
+		Particle* handle = acquireHandle(i);
+		if (!partitioned) m_sleepChanged.push_back(handle);
+	}
+	if (partitioned) m_awakeCount = count;
+}
+
+size_t ParticleStore::remove(const std::vector<Particle*>& handles, ParticleRemap& remap)
+{
+	const size_t count = size();
+	remap.removed.clear();
+	remap.moved.clear();
+
+	// Retire the handles of the removed particles, which also skips duplicates
+	for (Particle* handle : handles) {
+		if (handle->m_store != this || handle->m_index >= count) continue;
+
+		remap.removed.push_back(static_cast<uint32_t>(handle->m_index));
+		handle->m_index = SIZE_MAX;
+		m_freeHandles.push_back(handle);
+	}
+	remap.particleCount = count - remap.removed.size();
+	if (remap.removed.empty()) return 0;
+	m_removedCount += remap.removed.size();
+
+	// Awake particles fill the gaps below the new awake count from the awake survivors above it,
+	// then sleeping particles fill what is left below the new size from the end of the store, so
+	// both sides stay contiguous
+	std::sort(remap.removed.begin(), remap.removed.end());
+	const size_t remaining = remap.particleCount;
+	const size_t removedAwake = std::lower_bound(remap.removed.begin(), remap.removed.end(), static_cast<uint32_t>(m_awakeCount)) - remap.removed.begin();
+	const size_t awakeCount = m_awakeCount - removedAwake;
+
+	size_t tail = removedAwake;
+	size_t last = m_awakeCount;
+	for (size_t i = 0; i < removedAwake && remap.removed[i] < awakeCount; i++) {
+		last--;
+		while (tail > 0 && remap.removed[tail - 1] == last) {
+			tail--;
+			last--;
+		}
+		moveParticle(last, remap.removed[i], remap);
+	}
+
+	// Every index from the new awake count up to the old one is free now
+	tail = remap.removed.size();
+	last = count;
+	auto fill = [&](size_t gap) {
+		last--;
+		while (tail > removedAwake && remap.removed[tail - 1] == last) {
+			tail--;
+			last--;
+		}
+		moveParticle(last, gap, remap);
+	};
+	for (size_t gap = awakeCount; gap < std::min(m_awakeCount, remaining); gap++) fill(gap);
+	for (size_t i = removedAwake; i < remap.removed.size() && remap.removed[i] < remaining; i++) fill(remap.removed[i]);
+	m_awakeCount = awakeCount;
+
+	m_positionX.resize(remaining);
+	m_positionY.resize(remaining);
+	m_previousX.resize(remaining);
+	m_previousY.resize(remaining);
+	m_forceX.resize(remaining);
+	m_forceY.resize(remaining);
+	m_inverseMass.resize(remaining);
+	m_radius.resize(remaining);
+	m_isStatic.resize(remaining);
+	m_handleAt.resize(remaining);
+
+	m_layoutVersion++;
+	m_positionVersion++;
+	return remap.removed.size();
+}
+
+void ParticleStore::moveParticle(size_t from, size_t to, ParticleRemap& remap)
+{
+	m_positionX[to] = m_positionX[from];
+	m_positionY[to] = m_positionY[from];
+	m_previousX[to] = m_previousX[from];
+	m_previousY[to] = m_previousY[from];
+	m_forceX[to] = m_forceX[from];
+	m_forceY[to] = m_forceY[from];
+	m_inverseMass[to] = m_inverseMass[from];
+	m_radius[to] = m_radius[from];
+	m_isStatic[to] = m_isStatic[from];
+	m_handleAt[to] = m_handleAt[from];
+	m_handleAt[to]->m_index = to;
+	remap.moved.push_back({ static_cast<uint32_t>(from), static_cast<uint32_t>(to) });
+}
+
+void ParticleStore::setSleeping(size_t index, bool sleeping)
+{
+	uint8_t& flags = m_isStatic[index];
+	flags = static_cast<uint8_t>(sleeping ? (flags | SLEEPING_FLAG) : (flags & ~SLEEPING_FLAG));
+	m_sleepChanged.push_back(m_handleAt[index]);
+}
+
+bool ParticleStore::partitionSleeping(ParticleRemap& remap)
 {
-	m_positionCurrent = initialPosition;
-	m_positionPrevious = initialPosition;
-	m_radius = radius;
-	m_mass = 3.1415 * radius * radius;
+	remap.removed.clear();
+	remap.moved.clear();
+	remap.particleCount = size();
+	if (m_sleepChanged.empty()) return false;
+
+	// Only particles that changed, and those the boundary sweeps over, can be on the wrong side
+	std::vector<uint32_t> candidates;
+	candidates.reserve(m_sleepChanged.size());
+	size_t awakeCount = m_awakeCount;
+	for (const Particle* handle : m_sleepChanged) {
+		if (handle->m_store == this && handle->m_index < size()) candidates.push_back(static_cast<uint32_t>(handle->m_index));
+	}
+	m_sleepChanged.clear();
+
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+	for (uint32_t index : candidates) {
+		const bool sleeping = (m_isStatic[index] & SLEEPING_FLAG) != 0;
+		if (sleeping && index < m_awakeCount) awakeCount--;
+		else if (!sleeping && index >= m_awakeCount) awakeCount++;
+	}
+	for (size_t index = std::min(awakeCount, m_awakeCount); index < std::max(awakeCount, m_awakeCount); index++) candidates.push_back(static_cast<uint32_t>(index));
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
 
-    m_isStatic = false;
+	std::vector<uint32_t> sleepers;
+	std::vector<uint32_t> wakers;
+	for (uint32_t index : candidates) {
+		const bool sleeping = (m_isStatic[index] & SLEEPING_FLAG) != 0;
+		if (sleeping && index < awakeCount) sleepers.push_back(index);
+		else if (!sleeping && index >= awakeCount) wakers.push_back(index);
+	}
+	m_awakeCount = awakeCount;
 
-	m_forces = Vector2(0, 0);
+	for (size_t i = 0; i < sleepers.size(); i++) {
+		const size_t a = sleepers[i];
+		const size_t b = wakers[i];
+		std::swap(m_positionX[a], m_positionX[b]);
+		std::swap(m_positionY[a], m_positionY[b]);
+		std::swap(m_previousX[a], m_previousX[b]);
+		std::swap(m_previousY[a], m_previousY[b]);
+		std::swap(m_forceX[a], m_forceX[b]);
+		std::swap(m_forceY[a], m_forceY[b]);
+		std::swap(m_inverseMass[a], m_inverseMass[b]);
+		std::swap(m_radius[a], m_radius[b]);
+		std::swap(m_isStatic[a], m_isStatic[b]);
+		std::swap(m_handleAt[a], m_handleAt[b]);
+		m_handleAt[a]->m_index = a;
+		m_handleAt[b]->m_index = b;
+		remap.moved.push_back({ static_cast<uint32_t>(a), static_cast<uint32_t>(b) });
+		remap.moved.push_back({ static_cast<uint32_t>(b), static_cast<uint32_t>(a) });
+	}
+	if (remap.moved.empty()) return false;
+
+	m_layoutVersion++;
+	m_positionVersion++;
+	return true;
 }
 
-void Particle::integrate(double deltaTime)
+Particle* ParticleStore::acquireHandle(size_t index)
 {
-    if (!m_isStatic) {
-        // Calculate the new position using Verlet integration
-        const Vector2 acceleration = m_forces / m_mass;
-        const Vector2 newPosition = (m_positionCurrent * 2) - m_positionPrevious + acceleration * deltaTime * deltaTime;
+	Particle* handle;
+	if (m_freeHandles.empty()) {
+		m_handles.emplace_back(this, index);
+		handle = &m_handles.back();
+	}
+	else {
+		handle = m_freeHandles.back();
+		m_freeHandles.pop_back();
+		handle->m_index = index;
+	}
 
-        m_positionPrevious = m_positionCurrent;
-        m_positionCurrent = newPosition;
-    }
-    m_forces = Vector2(0, 0);
+	m_handleAt.push_back(handle);
+	return handle;
 }
 
-void Particle::addForce(Vector2 force)
+namespace {
+
+	template <typename T>
+	void permute(std::vector<T>& values, const std::vector<uint32_t>& order, std::vector<T>& scratch)
+	{
+		scratch.resize(values.size());
+		for (size_t i = 0; i < order.size(); i++) scratch[i] = values[order[i]];
+		values.swap(scratch);
+	}
+}
+
+void ParticleStore::reorder(const std::vector<uint32_t>& order, ParticleRemap& remap)
 {
-	m_forces = m_forces + force;
+	std::vector<Real> scratch;
+	permute(m_positionX, order, scratch);
+	permute(m_positionY, order, scratch);
+	permute(m_previousX, order, scratch);
+	permute(m_previousY, order, scratch);
+	permute(m_forceX, order, scratch);
+	permute(m_forceY, order, scratch);
+	permute(m_inverseMass, order, scratch);
+	permute(m_radius, order, scratch);
+
+	std::vector<uint8_t> flagScratch;
+	permute(m_isStatic, order, flagScratch);
+
+	std::vector<Particle*> handleScratch;
+	permute(m_handleAt, order, handleScratch);
+	for (size_t i = 0; i < m_handleAt.size(); i++) m_handleAt[i]->m_index = i;
+
+	remap.removed.clear();
+	remap.moved.clear();
+	remap.particleCount = order.size();
+	for (size_t i = 0; i < order.size(); i++) {
+		if (order[i] != i) remap.moved.push_back({ order[i], static_cast<uint32_t>(i) });
+	}
+
+	m_layoutVersion++;
+	m_positionVersion++;
 }
@@ -1,40 +1,41 @@
 #pragma once
 #include "PhysicsMath.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
 namespace VerletPhysics {
 
+    class ParticleStore;
+
     /**
      * Represents a particle in the Verlet physics simulation.
      *
-     * The `Particle` class is used to simulate a particle in the Verlet physics framework.
-     * It stores information about the particle's position, forces acting on it, mass, radius, and
-     * whether it is static or movable.
+     * The `Particle` class is a lightweight handle onto one entry of a `ParticleStore`. The
+     * particle's position, forces acting on it, mass, radius, and whether it is static or movable
+     * live in the store's contiguous arrays; the handle only remembers where to find them, so its
+     * address stays valid for the lifetime of the store that created it. The index it remembers
+     * changes when the store is reordered or other particles are removed, see `ParticleStore::reorder`
+     * and `ParticleStore::remove`. Handles of removed particles are recycled by later additions.
      */
     class Particle {
+        friend class ParticleStore;
 
     private:
-        Vector2 m_positionCurrent;    ///< Current position of the particle.
-        Vector2 m_positionPrevious;   ///< Previous position of the particle.
-        Vector2 m_forces;            ///< Accumulated forces acting on the particle.
-        double m_mass;               ///< Mass of the particle.
-        double m_radius;             ///< Radius of the particle.
-        bool m_isStatic;             ///< Flag indicating whether the particle is static.
+        ParticleStore* m_store; ///< Store holding the particle's state.
+        size_t m_index;         ///< Index of the particle within the store.
 
     public:
         /**
-         * Constructs a Particle object.
-         *
-         * @param initialPosition The initial position of the particle.
-         * @param radius The radius of the particle.
-         */
-        Particle(Vector2 initialPosition, double radius);
-
-        /**
-         * Integrates the particle's position over time.
+         * Constructs a Particle handle.
          *
-         * @param deltaTime The time step for the integration.
+         * @param store The store holding the particle's state.
+         * @param index The index of the particle within the store.
          */
-        void integrate(double deltaTime);
+        Particle(ParticleStore* store, size_t index) : m_store(store), m_index(index) {}
 
         /**
          * Adds a force to the particle.
@@ -47,50 +48,431 @@ namespace VerletPhysics {
          * Updates the current position of the particle.
          *
          * @param newPosition The new position to set for the particle.
-         * @note If the particle is static, this operation is ignored.
+         * @note If the particle is static, this operation is ignored. Moving a sleeping particle
+         *       wakes its island at the start of the next update.
          */
-        void updatePosition(Vector2 newPosition) { if (m_isStatic) return; m_positionCurrent = newPosition; }
+        void updatePosition(Vector2 newPosition);
 
         /**
          * Resets the particle's position to a new position.
          *
          * @param newPosition The new position to set for both current and previous positions.
+         * @note Moving a sleeping particle wakes its island at the start of the next update.
          */
-        void resetPosition(Vector2 newPosition) { m_positionCurrent = newPosition; m_positionPrevious = newPosition; }
+        void resetPosition(Vector2 newPosition);
 
         /**
          * Sets the static state of the particle.
          *
          * @param newState `true` if the particle should be static, `false` if it should be movable.
+         *                 Making a sleeping particle movable wakes its island at the start of the next update.
          */
-        void setStaticState(bool newState) { m_isStatic = newState; }
+        void setStaticState(bool newState);
+
+        /**
+         * Checks whether the particle belongs to a sleeping island.
+         *
+         * @return `true` if the particle is asleep.
+         */
+        bool isSleeping() const;
 
         /**
          * Gets the radius of the particle.
          *
          * @return The radius of the particle.
          */
-        double getRadius() const { return m_radius; }
+        Real getRadius() const;
 
         /**
          * Gets the mass of the particle.
          *
          * @return The mass of the particle.
          */
-        double getMass() const { return m_mass; }
+        Real getMass() const;
 
         /**
          * Gets the current position of the particle.
          *
          * @return The current position of the particle.
          */
-        Vector2 getPosition() const { return m_positionCurrent; }
+        Vector2 getPosition() const;
 
         /**
          * Gets the previous position of the particle.
          *
          * @return The previous position of the particle.
          */
-        Vector2 getPreviousPosition() const { return m_positionPrevious; }
+        Vector2 getPreviousPosition() const;
+
+        /**
+         * Gets the store holding the particle's state.
+         *
+         * @return Pointer to the owning ParticleStore.
+         */
+        ParticleStore* getStore() const { return m_store; }
+
+        /**
+         * Gets the index of the particle within its store.
+         *
+         * @return The particle's index, valid until the store is next reordered or particles are removed.
+         */
+        size_t getIndex() const { return m_index; }
+    };
+
+
+    /**
+     * A particle that changed index.
+     */
+    struct ParticleMove
+    {
+        uint32_t from; ///< Index of the particle before the change.
+        uint32_t to;   ///< Index of the particle after the change.
+    };
+
+    /**
+     * Describes how a change to a `ParticleStore` renumbered its particles.
+     *
+     * Only the particles that were removed or changed index are listed, so anything holding
+     * particle indices can follow a change in time proportional to its size rather than to the
+     * number of particles. The removals come first, in the previous numbering; the moves then all
+     * happen at once, so a particle may move to an index another particle moved away from.
+     */
+    struct ParticleRemap
+    {
+        std::vector<uint32_t> removed;   ///< Previous index of every removed particle, in ascending order.
+        std::vector<ParticleMove> moved; ///< Every surviving particle whose index changed.
+        size_t particleCount = 0;        ///< Number of particles in the store after the change.
+
+        /**
+         * Carries the entries of an array indexed by particle along with their particles.
+         *
+         * Entries of removed particles are dropped and the array is cut down to the new particle
+         * count. Arrays may be shorter than the store, missing entries counting as `empty`.
+         *
+         * @param values The array to update.
+         * @param empty Value of entries the array does not hold.
+         */
+        template <typename T>
+        void apply(std::vector<T>& values, const T& empty) const;
+    };
+
+
+    /**
+     * Structure-of-arrays storage for every particle in a simulation world.
+     *
+     * The `ParticleStore` keeps each particle attribute in its own contiguous array so that the
+     * integration, collision and constraint passes stream linearly through memory. Callers address
+     * particles through `Particle` handles, which the store allocates once and never moves. The
+     * arrays themselves may be reordered to keep neighbouring particles close in memory, in which
+     * case every handle is pointed at its particle's new index.
+     *
+     * Removed particles are filled in by particles from the end of the arrays, so removal moves as
+     * few particles as possible, and their handles go on a free list to be reused by later additions.
+     * Both removal and reordering describe what they did as a `ParticleRemap`.
+     *
+     * Sleeping particles are kept after every awake one, so passes that skip them simply stop at
+     * `getAwakeCount()`. Particles that fall asleep, wake up or are added while others sleep are
+     * only moved to their side by `partitionSleeping`, which the simulation world calls at the start
+     * of every update.
+     */
+    class ParticleStore
+    {
+        std::vector<Real> m_positionX;    ///< Current X-coordinate of every particle.
+        std::vector<Real> m_positionY;    ///< Current Y-coordinate of every particle.
+        std::vector<Real> m_previousX;    ///< Previous X-coordinate of every particle.
+        std::vector<Real> m_previousY;    ///< Previous Y-coordinate of every particle.
+        std::vector<Real> m_forceX;       ///< Accumulated X-force acting on every particle.
+        std::vector<Real> m_forceY;       ///< Accumulated Y-force acting on every particle.
+        std::vector<Real> m_inverseMass;  ///< Inverse mass of every particle, zero for massless particles.
+        std::vector<Real> m_radius;       ///< Radius of every particle.
+        std::vector<uint8_t> m_isStatic;  ///< Non-zero for particles that do not move, see `STATIC_FLAG` and `SLEEPING_FLAG`.
+
+        std::deque<Particle> m_handles;   ///< Every handle ever given out, in creation order.
+        std::vector<Particle*> m_handleAt; ///< Handle of the particle at every index.
+        std::vector<Particle*> m_freeHandles; ///< Handles of removed particles, waiting to be reused.
+        size_t m_awakeCount = 0;          ///< Particles before the first sleeping one, as of the last partition.
+        std::vector<Particle*> m_sleepChanged; ///< Particles that may sit on the wrong side of `m_awakeCount`.
+        std::vector<Particle*> m_wakeRequests; ///< Sleeping particles moved or made movable through their handles.
+        uint64_t m_positionVersion = 0;   ///< Bumped whenever particles are added or moved outside the raw accessors.
+        uint64_t m_layoutVersion = 0;     ///< Bumped whenever the store is reordered or particles are removed.
+        uint64_t m_removedCount = 0;      ///< Particles removed over the lifetime of the store.
+
+    public:
+        static constexpr uint8_t STATIC_FLAG = 1;   ///< Set in `isStatic()` for particles made static by the user.
+        static constexpr uint8_t SLEEPING_FLAG = 2; ///< Set in `isStatic()` for particles of a sleeping island.
+
+        ParticleStore() = default;
+        ParticleStore(const ParticleStore&) = delete;
+        ParticleStore& operator=(const ParticleStore&) = delete;
+
+        /**
+         * Adds a particle to the store.
+         *
+         * @param initialPosition The initial position of the particle.
+         * @param radius The radius of the particle.
+         * @return Pointer to the handle of the created particle.
+         */
+        Particle* add(Vector2 initialPosition, Real radius);
+
+        /**
+         * Adds a batch of particles to the end of the store.
+         *
+         * @param positions The initial position of every particle.
+         * @param radii The radius of every particle, exactly one per position.
+         * @param handles Receives the handle of every created particle, appended in the order given.
+         * @return `false`, adding nothing, if `positions` and `radii` differ in size.
+         */
+        bool add(const std::vector<Vector2>& positions, const std::vector<Real>& radii, std::vector<Particle*>& handles);
+
+        /**
+         * Removes a batch of particles, moving particles from the end of the store into the gaps.
+         *
+         * Anything else holding particle indices has to be remapped as well, which
+         * `SimulationWorld::removeParticles` does for everything the world owns. The removed handles
+         * are reused by later additions, so they must not be used afterwards. Takes time proportional
+         * to the number of particles removed. Awake and sleeping particles each fill the gaps on their
+         * own side, so at most twice that many particles are moved.
+         *
+         * @param handles Handles of the particles to remove. Duplicates are ignored.
+         * @param remap Receives the removed particles and the particles moved into their place.
+         * @return The number of particles removed.
+         */
+        size_t remove(const std::vector<Particle*>& handles, ParticleRemap& remap);
+
+        /**
+         * Grows the store to the given number of particles without initialising the new ones.
+         *
+         * Meant for filling the attribute arrays in bulk through the raw accessors, for example when
+         * restoring a snapshot. Handles are created for every new particle.
+         *
+         * @param count The new particle count, no smaller than the current one.
+         */
+        void grow(size_t count);
+
+        /**
+         * Gets the number of particles in the store.
+         *
+         * @return The particle count.
+         */
+        size_t size() const { return m_positionX.size(); }
+
+        /**
+         * Gets the handle of the particle at the given index.
+         *
+         * @param index The index of the particle.
+         * @return Pointer to the particle's handle.
+         */
+        Particle* getHandle(size_t index) { return m_handleAt[index]; }
+
+        /**
+         * Gets the current index of a particle from the order particles were added in.
+         *
+         * Only meaningful while no particle has been removed, as removed handles are reused.
+         *
+         * @param creationIndex Number of particles added before it.
+         * @return The particle's index, which equals `creationIndex` until the store is first reordered.
+         */
+        size_t getIndexOfCreated(size_t creationIndex) const { return m_handles[creationIndex].m_index; }
+
+        /**
+         * Gets the number of particles removed since the store was created.
+         *
+         * @return The removal count, zero while `getIndexOfCreated` is meaningful.
+         */
+        uint64_t getRemovedCount() const { return m_removedCount; }
+
+        /**
+         * Moves every particle to a new index, keeping each handle pointed at its particle.
+         *
+         * Anything else holding particle indices has to be remapped as well, which
+         * `SimulationWorld::sortParticles` does for everything the world owns.
+         *
+         * @param order Previous index of the particle to store at every index, a permutation of
+         *              `[0, size())` that maps `[0, getAwakeCount())` onto itself.
+         * @param remap Receives every particle whose index changed.
+         */
+        void reorder(const std::vector<uint32_t>& order, ParticleRemap& remap);
+
+        /**
+         * Gets the number of particles stored before the first sleeping one.
+         *
+         * @return The awake particle count as of the last `partitionSleeping`, counting static ones.
+         */
+        size_t getAwakeCount() const { return m_awakeCount; }
+
+        /**
+         * Puts a particle to sleep or wakes it, leaving it where it is until the next `partitionSleeping`.
+         *
+         * @param index The index of the particle.
+         * @param sleeping `true` to set `SLEEPING_FLAG`, `false` to clear it.
+         */
+        void setSleeping(size_t index, bool sleeping);
+
+        /**
+         * Moves every particle that fell asleep behind every awake one, and every particle that woke
+         * up or was added in front of every sleeping one, by swapping them in pairs.
+         *
+         * Takes time proportional to the number of particles that changed sides.
+         *
+         * @param remap Receives every particle that changed index.
+         * @return `true` if any particle changed index, in which case anything else holding particle
+         *         indices has to be remapped.
+         */
+        bool partitionSleeping(ParticleRemap& remap);
+
+        /**
+         * Asks for the island of a sleeping particle to be woken.
+         *
+         * @param index The index of the particle.
+         */
+        void requestWake(size_t index) { m_wakeRequests.push_back(m_handleAt[index]); }
+
+        /**
+         * Gets the particles whose islands were asked to wake since the requests were last cleared.
+         *
+         * @return Their handles, which may have been removed and reused since.
+         */
+        const std::vector<Particle*>& getWakeRequests() const { return m_wakeRequests; }
+
+        /**
+         * Forgets every wake request, once they have been handled.
+         */
+        void clearWakeRequests() { m_wakeRequests.clear(); }
+
+        /**
+         * Gets a counter that changes whenever the store is reordered or particles are removed.
+         *
+         * @return The current layout version.
+         */
+        uint64_t getLayoutVersion() const { return m_layoutVersion; }
+
+        /**
+         * Records that particle positions changed, so structures built from them know to rebuild.
+         *
+         * Adding particles and moving them through their handles already does this; code writing
+         * positions through the raw accessors has to call it once it is done.
+         */
+        void touchPositions() { m_positionVersion++; }
+
+        /**
+         * Gets a counter that changes whenever particle positions may have changed.
+         *
+         * @return The current position version.
+         */
+        uint64_t getPositionVersion() const { return m_positionVersion; }
+
+        /**
+         * Raw access to the attribute arrays, each indexed by particle index.
+         *
+         * Writes through these bypass the static check made by `Particle::updatePosition`. Every pass
+         * treats a particle with any `isStatic()` flag set as immovable, whether it is static or asleep.
+         * Position writes are only noticed by spatial queries after `touchPositions`.
+         */
+        Real* positionX() { return m_positionX.data(); }
+        Real* positionY() { return m_positionY.data(); }
+        Real* previousX() { return m_previousX.data(); }
+        Real* previousY() { return m_previousY.data(); }
+        Real* forceX() { return m_forceX.data(); }
+        Real* forceY() { return m_forceY.data(); }
+        Real* inverseMass() { return m_inverseMass.data(); }
+        Real* radius() { return m_radius.data(); }
+        uint8_t* isStatic() { return m_isStatic.data(); }
+
+        const Real* positionX() const { return m_positionX.data(); }
+        const Real* positionY() const { return m_positionY.data(); }
+        const Real* previousX() const { return m_previousX.data(); }
+        const Real* previousY() const { return m_previousY.data(); }
+        const Real* forceX() const { return m_forceX.data(); }
+        const Real* forceY() const { return m_forceY.data(); }
+        const Real* inverseMass() const { return m_inverseMass.data(); }
+        const Real* radius() const { return m_radius.data(); }
+        const uint8_t* isStatic() const { return m_isStatic.data(); }
+        const Particle* const* handles() const { return m_handleAt.data(); }
+
+    private:
+        /**
+         * Points a free handle, or a new one, at the particle stored at an index.
+         */
+        Particle* acquireHandle(size_t index);
+
+        /**
+         * Copies every attribute and the handle of one particle over another, recording the move.
+         */
+        void moveParticle(size_t from, size_t to, ParticleRemap& remap);
     };
+
+
+    template <typename T>
+    void ParticleRemap::apply(std::vector<T>& values, const T& empty) const
+    {
+        // Read every moving entry before writing any, as a move may land where another one left
+        std::vector<T> moving;
+        moving.reserve(moved.size());
+        size_t size = std::min(values.size(), particleCount);
+        for (const ParticleMove& move : moved) {
+            moving.push_back(move.from < values.size() ? values[move.from] : empty);
+            if (move.to >= size && !(moving.back() == empty)) size = move.to + 1;
+        }
+
+        values.resize(size, empty);
+        for (size_t i = 0; i < moved.size(); i++) {
+            if (moved[i].to < size) values[moved[i].to] = moving[i];
+        }
+    }
+
+
+    inline void Particle::addForce(Vector2 force)
+    {
+        m_store->forceX()[m_index] += force.x();
+        m_store->forceY()[m_index] += force.y();
+    }
+
+    inline void Particle::updatePosition(Vector2 newPosition)
+    {
+        const uint8_t flags = m_store->isStatic()[m_index];
+        if (flags & ParticleStore::STATIC_FLAG) return;
+        if (flags & ParticleStore::SLEEPING_FLAG) m_store->requestWake(m_index);
+
+        m_store->positionX()[m_index] = newPosition.x();
+        m_store->positionY()[m_index] = newPosition.y();
+        m_store->touchPositions();
+    }
+
+    inline void Particle::resetPosition(Vector2 newPosition)
+    {
+        if (isSleeping()) m_store->requestWake(m_index);
+
+        m_store->positionX()[m_index] = newPosition.x();
+        m_store->positionY()[m_index] = newPosition.y();
+        m_store->previousX()[m_index] = newPosition.x();
+        m_store->previousY()[m_index] = newPosition.y();
+        m_store->touchPositions();
+    }
+
+    inline void Particle::setStaticState(bool newState)
+    {
+        uint8_t& flags = m_store->isStatic()[m_index];
+        if (!newState && (flags & ParticleStore::SLEEPING_FLAG)) m_store->requestWake(m_index);
+        flags = static_cast<uint8_t>(newState ? (flags | ParticleStore::STATIC_FLAG) : (flags & ~ParticleStore::STATIC_FLAG));
+    }
+
+    inline bool Particle::isSleeping() const { return (m_store->isStatic()[m_index] & ParticleStore::SLEEPING_FLAG) != 0; }
+
+    inline Real Particle::getRadius() const { return m_store->radius()[m_index]; }
+
+    inline Real Particle::getMass() const
+    {
+        const Real inverseMass = m_store->inverseMass()[m_index];
+        return inverseMass == 0.0 ? 0.0 : 1.0 / inverseMass;
+    }
+
+    inline Vector2 Particle::getPosition() const
+    {
+        return Vector2(m_store->positionX()[m_index], m_store->positionY()[m_index]);
+    }
+
+    inline Vector2 Particle::getPreviousPosition() const
+    {
+        return Vector2(m_store->previousX()[m_index], m_store->previousY()[m_index]);
+    }
 }
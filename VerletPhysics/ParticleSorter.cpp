@@ -0,0 +1,78 @@
+#include "ParticleSorter.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace VerletPhysics;
+
+bool ParticleSorter::update(const ParticleStore& particles)
+{
+    if (m_interval == 0 || ++m_updatesSinceCheck < m_interval) return false;
+    m_updatesSinceCheck = 0;
+
+    return measureScattering(particles, nullptr) > m_sortedScattering + m_tolerance;
+}
+
+void ParticleSorter::computeOrder(const ParticleStore& particles, ThreadPool& threadPool, std::vector<uint32_t>& order)
+{
+    const size_t count = particles.size();
+    const Real* positionX = particles.positionX();
+    const Real* positionY = particles.positionY();
+
+    Real minX = std::numeric_limits<Real>::max();
+    Real minY = std::numeric_limits<Real>::max();
+    Real maxX = std::numeric_limits<Real>::lowest();
+    Real maxY = std::numeric_limits<Real>::lowest();
+    for (size_t i = 0; i < count; i++) {
+        minX = std::min(minX, positionX[i]);
+        minY = std::min(minY, positionY[i]);
+        maxX = std::max(maxX, positionX[i]);
+        maxY = std::max(maxY, positionY[i]);
+    }
+
+    const Real size = std::max(std::max(maxX - minX, maxY - minY), Real(1e-6));
+    const Real scale = Real(65536) / size;
+
+    // Morton code of every particle, with its index in the low bits so equal codes keep their order
+    m_keys.resize(count);
+    threadPool.parallelFor(0, count, 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const uint32_t cellX = static_cast<uint32_t>(std::min(Real(65535), (positionX[i] - minX) * scale));
+            const uint32_t cellY = static_cast<uint32_t>(std::min(Real(65535), (positionY[i] - minY) * scale));
+            m_keys[i] = (static_cast<uint64_t>(mortonCode(cellX, cellY)) << 32) | static_cast<uint32_t>(i);
+        }
+    });
+    const auto firstSleeping = m_keys.begin() + static_cast<std::ptrdiff_t>(particles.getAwakeCount());
+    std::sort(m_keys.begin(), firstSleeping);
+    std::sort(firstSleeping, m_keys.end());
+
+    order.resize(count);
+    for (size_t i = 0; i < count; i++) order[i] = static_cast<uint32_t>(m_keys[i]);
+
+    m_sortedScattering = measureScattering(particles, order.data());
+    m_updatesSinceCheck = 0;
+}
+
+Real ParticleSorter::measureScattering(const ParticleStore& particles, const uint32_t* order)
+{
+    const size_t count = particles.getAwakeCount();
+    if (count < 2) return 0;
+
+    const Real* positionX = particles.positionX();
+    const Real* positionY = particles.positionY();
+    const Real* radius = particles.radius();
+
+    size_t scattered = 0;
+    size_t previous = order ? order[0] : 0;
+    for (size_t n = 1; n < count; n++) {
+        const size_t i = order ? order[n] : n;
+        const Real dx = positionX[i] - positionX[previous];
+        const Real dy = positionY[i] - positionY[previous];
+        const Real reach = (radius[i] + radius[previous]) * 2;
+
+        if (dx * dx + dy * dy > reach * reach) scattered++;
+        previous = i;
+    }
+
+    return static_cast<Real>(scattered) / static_cast<Real>(count - 1);
+}
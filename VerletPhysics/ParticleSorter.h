@@ -0,0 +1,88 @@
+#pragma once
+#include "PhysicsMath.h"
+#include "Particle.h"
+#include "ThreadPool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace VerletPhysics {
+
+    /**
+     * Decides when and how to reorder a particle store so neighbours in space sit close in memory.
+     *
+     * Particles are sorted along a Morton curve over the bounding square of the store, so the
+     * collision passes, which visit neighbours cell by cell, mostly touch memory that is already
+     * cached. Sorting costs a few full passes over the store, so it only happens when locality has
+     * degraded: every few updates the sorter measures how many particles are far from the particle
+     * stored before them, and asks for a sort once that fraction has grown by more than a tolerance
+     * since the last sort. Motion within a pile barely changes the fraction, whereas particles added
+     * in scattered order, or a scene that has mixed itself up, raise it quickly.
+     *
+     * Only the awake particles are measured, as the sleeping ones are skipped by every pass. Awake
+     * and sleeping particles are sorted separately, so sleeping ones stay behind the awake ones.
+     */
+    class ParticleSorter
+    {
+        size_t m_interval = 0;           ///< Updates between locality checks, zero to never sort on its own.
+        Real m_tolerance = Real(0.1);    ///< Growth of the scattered fraction since the last sort that triggers a sort.
+        size_t m_updatesSinceCheck = 0;  ///< Updates since locality was last checked.
+        Real m_sortedScattering = 0;     ///< Scattered fraction measured right after the last sort.
+
+        std::vector<uint64_t> m_keys;    ///< Morton code and index of every particle, sorted.
+
+    public:
+        /**
+         * Sets how often locality is checked.
+         *
+         * @param updates Updates between checks, or zero to only sort when asked to.
+         */
+        void setInterval(size_t updates) { m_interval = updates; m_updatesSinceCheck = 0; }
+
+        /**
+         * Gets how often locality is checked.
+         *
+         * @return Updates between checks, zero if particles are never sorted on their own.
+         */
+        size_t getInterval() const { return m_interval; }
+
+        /**
+         * Sets how much locality has to degrade before a check sorts the particles.
+         *
+         * @param tolerance Growth of the fraction of particles stored far from their predecessor,
+         *                  since the last sort, above which a check sorts.
+         */
+        void setTolerance(Real tolerance) { m_tolerance = tolerance; }
+
+        /**
+         * Counts an update and checks locality when one is due.
+         *
+         * @param particles The store to check.
+         * @return `true` if the particles should be sorted now.
+         */
+        bool update(const ParticleStore& particles);
+
+        /**
+         * Finds the Morton order of the particles and remembers how scattered that order is.
+         *
+         * @param particles The store to sort.
+         * @param threadPool Threads the Morton codes are computed across.
+         * @param order Receives the current index of the particle to store at every index, which maps
+         *              the awake particles onto themselves.
+         */
+        void computeOrder(const ParticleStore& particles, ThreadPool& threadPool, std::vector<uint32_t>& order);
+
+    private:
+        /**
+         * Measures the fraction of awake particles stored far from the particle stored before them.
+         *
+         * A particle counts as far once the two centres are further apart than both diameters together.
+         *
+         * @param particles The store to measure.
+         * @param order Index of the particle at every position of the order to measure, or null for the store's own order.
+         * @return The scattered fraction, from 0 to 1.
+         */
+        static Real measureScattering(const ParticleStore& particles, const uint32_t* order);
+    };
+}
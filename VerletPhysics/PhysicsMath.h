@@ -1,34 +1,81 @@
 #pragma once
 
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+
 namespace VerletPhysics {
 
+    /**
+     * Scalar type used for all simulation state.
+     *
+     * Defaults to `double`. Defining `VERLET_SINGLE_PRECISION` when building the library and
+     * everything that includes it switches every world to `float`, halving the memory each
+     * substep streams through and doubling the lanes of every SIMD kernel.
+     */
+#ifdef VERLET_SINGLE_PRECISION
+    using Real = float;
+#else
+    using Real = double;
+#endif
+
     constexpr static double PI = 3.1415;
     constexpr static double TWO_PI = 2 * PI;
 
+    /**
+     * Spreads the low 16 bits of a value out to its even bits.
+     */
+    constexpr uint32_t spreadBits(uint32_t value)
+    {
+        value &= 0xFFFF;
+        value = (value | (value << 8)) & 0x00FF00FF;
+        value = (value | (value << 4)) & 0x0F0F0F0F;
+        value = (value | (value << 2)) & 0x33333333;
+        value = (value | (value << 1)) & 0x55555555;
+        return value;
+    }
+
+    /**
+     * Interleaves two 16-bit cell coordinates into their Morton, or Z-order, code.
+     *
+     * Cells close together mostly get codes close together, so sorting by the code groups neighbours.
+     */
+    constexpr uint32_t mortonCode(uint32_t cellX, uint32_t cellY) { return (spreadBits(cellY) << 1) | spreadBits(cellX); }
+
 
     /**
     * A representation a 2D vector with x and y components.
     *
     * Provides a representation of a 2D vector with x and y coordinates.
     * It offers basic mathematical operations for vector addition, subtraction, scalar
-    * multiplication, and scalar division.
+    * multiplication, and scalar division. Every operation is defined inline and `constexpr`
+    * so it can be inlined into the hot loops of any translation unit.
+    *
+    * @tparam T The scalar type of the components, `float` or `double`.
     */
-    struct Vector2
+    template <typename T>
+    struct BasicVector2
     {
 
     private:
-        double m_x;
-        double m_y;
+        T m_x;
+        T m_y;
 
     public:
 
-        Vector2() : m_x(0.0), m_y(0.0) {}
-        Vector2(double x, double y) : m_x(x), m_y(y) {}
+        constexpr BasicVector2() : m_x(0), m_y(0) {}
+        constexpr BasicVector2(T x, T y) : m_x(x), m_y(y) {}
 
-        double x() const { return m_x; }
-        double y() const { return m_y; }
+        /**
+         * Converts a vector of another scalar type.
+         *
+         * @param other The vector to convert.
+         */
+        template <typename U>
+        constexpr explicit BasicVector2(const BasicVector2<U>& other) : m_x(static_cast<T>(other.x())), m_y(static_cast<T>(other.y())) {}
 
-        Vector2& operator=(const Vector2& other);
+        constexpr T x() const { return m_x; }
+        constexpr T y() const { return m_y; }
 
         /**
          * Overloads the + operator to perform vector addition.
@@ -39,7 +86,7 @@ namespace VerletPhysics {
          * @param other The Vector2 to be added.
          * @return A new Vector2 representing the result of the addition.
          */
-        Vector2 operator+(const Vector2& other) const;
+        constexpr BasicVector2 operator+(const BasicVector2& other) const { return BasicVector2(m_x + other.m_x, m_y + other.m_y); }
 
         /**
          * Overloads the - operator to perform vector subtraction.
@@ -50,7 +97,7 @@ namespace VerletPhysics {
          * @param other The Vector2 to be subtracted.
          * @return A new Vector2 representing the result of the subtraction.
          */
-        Vector2 operator-(const Vector2& other) const;
+        constexpr BasicVector2 operator-(const BasicVector2& other) const { return BasicVector2(m_x - other.m_x, m_y - other.m_y); }
 
         /**
          * Overloads the * operator to perform scalar multiplication.
@@ -61,7 +108,7 @@ namespace VerletPhysics {
          * @param scalar The scalar value to multiply the vector by.
          * @return A new Vector2 representing the result of the multiplication.
          */
-        Vector2 operator*(double scalar) const;
+        constexpr BasicVector2 operator*(T scalar) const { return BasicVector2(m_x * scalar, m_y * scalar); }
 
         /**
          * Overloads the / operator to perform scalar division.
@@ -74,11 +121,61 @@ namespace VerletPhysics {
          *
          * @note Any division by zero will return a zerod Vector2.
          */
-        Vector2 operator/(double scalar) const;
+        constexpr BasicVector2 operator/(T scalar) const
+        {
+            if (scalar == T(0)) return BasicVector2(0, 0);
+            return BasicVector2(m_x / scalar, m_y / scalar);
+        }
+
+        /**
+         * Adds another vector to this one in place.
+         *
+         * @param other The Vector2 to be added.
+         * @return A reference to this vector.
+         */
+        constexpr BasicVector2& operator+=(const BasicVector2& other)
+        {
+            m_x += other.m_x;
+            m_y += other.m_y;
+            return *this;
+        }
+
+        /**
+         * Subtracts another vector from this one in place.
+         *
+         * @param other The Vector2 to be subtracted.
+         * @return A reference to this vector.
+         */
+        constexpr BasicVector2& operator-=(const BasicVector2& other)
+        {
+            m_x -= other.m_x;
+            m_y -= other.m_y;
+            return *this;
+        }
+
+        /**
+         * Multiplies this vector by a scalar in place.
+         *
+         * @param scalar The scalar value to multiply the vector by.
+         * @return A reference to this vector.
+         */
+        constexpr BasicVector2& operator*=(T scalar)
+        {
+            m_x *= scalar;
+            m_y *= scalar;
+            return *this;
+        }
 
 
     };
 
+    using Vector2 = BasicVector2<Real>;    ///< Vector used throughout the simulation, in the configured precision.
+    using Vector2f = BasicVector2<float>;  ///< Single precision vector.
+    using Vector2d = BasicVector2<double>; ///< Double precision vector.
+
+    static_assert(std::is_trivially_copyable<Vector2f>::value, "Vector2f must stay trivially copyable");
+    static_assert(std::is_trivially_copyable<Vector2d>::value, "Vector2d must stay trivially copyable");
+
     struct VectorMath
     {
         /**
@@ -87,7 +184,8 @@ namespace VerletPhysics {
          * @param vec The Vector2D whose magnitude is to be calculated.
          * @return The magnitude of the Vector2D.
          */
-        static double magnitude(const Vector2& vec);
+        template <typename T>
+        static T magnitude(const BasicVector2<T>& vec) { return std::sqrt(magnitudeSquared(vec)); }
 
         /**
          * Calculate the squared magnitude of a Vector2D.
@@ -98,7 +196,8 @@ namespace VerletPhysics {
          * @param vec The Vector2D whose squared magnitude is to be calculated.
          * @return The squared magnitude of the Vector2D.
          */
-        static double magnitudeSquared(const Vector2& vec);
+        template <typename T>
+        static constexpr T magnitudeSquared(const BasicVector2<T>& vec) { return vec.x() * vec.x() + vec.y() * vec.y(); }
 
         /**
          * Normalize a Vector2D (make it a unit vector with magnitude 1).
@@ -106,7 +205,14 @@ namespace VerletPhysics {
          * @param vec The Vector2D to be normalized.
          * @return A new normalized Vector2D.
          */
-        static Vector2 normalize(const Vector2& vec);
+        template <typename T>
+        static BasicVector2<T> normalize(const BasicVector2<T>& vec)
+        {
+            T magnitude = VectorMath::magnitude(vec);
+            if (magnitude == T(0)) return BasicVector2<T>(0, 0);
+
+            return BasicVector2<T>(vec.x() / magnitude, vec.y() / magnitude);
+        }
 
         /**
          * Calculate the dot product of two Vector2D objects.
@@ -115,7 +221,8 @@ namespace VerletPhysics {
          * @param vec2 The second Vector2D.
          * @return The dot product of the two vectors.
          */
-        static double dotProduct(const Vector2& vec1, const Vector2& vec2);
+        template <typename T>
+        static constexpr T dotProduct(const BasicVector2<T>& vec1, const BasicVector2<T>& vec2) { return vec1.x() * vec2.x() + vec1.y() * vec2.y(); }
 
 
 
@@ -0,0 +1,289 @@
+#include "PositionConstraintSolver.h"
+#include "SimdKernels.h"
+
+#include <algorithm>
+
+using namespace VerletPhysics;
+
+namespace {
+
+    // Shorter runs of consecutive subscribers are not worth a kernel call of their own
+    constexpr size_t MIN_RUN_LENGTH = 16;
+}
+
+void PositionConstraintSolver::PackedSubscribers::assign(const std::vector<size_t>& subscribers)
+{
+    runBegin.clear();
+    runEnd.clear();
+    scattered.clear();
+    scatteredSlot.clear();
+    awakeScattered = 0;
+
+    size_t first = 0;
+    while (first < subscribers.size()) {
+        size_t last = first + 1;
+        while (last < subscribers.size() && subscribers[last] == subscribers[last - 1] + 1) last++;
+
+        if (last - first >= MIN_RUN_LENGTH) {
+            runBegin.push_back(static_cast<uint32_t>(subscribers[first]));
+            runEnd.push_back(static_cast<uint32_t>(subscribers[last - 1] + 1));
+        }
+        else {
+            for (size_t i = first; i < last; i++) scatter(static_cast<uint32_t>(subscribers[i]));
+        }
+
+        first = last;
+    }
+}
+
+void PositionConstraintSolver::PackedSubscribers::erase(uint32_t particle)
+{
+    // Runs are disjoint and sorted, so only the last one starting at or before the particle can hold it
+    const size_t run = std::upper_bound(runBegin.begin(), runBegin.end(), particle) - runBegin.begin();
+    if (run > 0 && particle < runEnd[run - 1]) {
+        const size_t holder = run - 1;
+        if (particle == runBegin[holder]) {
+            runBegin[holder]++;
+        }
+        else if (particle + 1 == runEnd[holder]) {
+            runEnd[holder]--;
+        }
+        else {
+            const uint32_t end = runEnd[holder];
+            runBegin.insert(runBegin.begin() + run, particle + 1);
+            runEnd.insert(runEnd.begin() + run, end);
+            runEnd[holder] = particle;
+            scatterIfShort(run);
+        }
+        scatterIfShort(holder);
+        return;
+    }
+
+    if (particle >= scatteredSlot.size() || scatteredSlot[particle] == NO_SLOT) return;
+
+    // The last awake subscriber fills an awake hole, leaving one at the start of the others
+    size_t hole = scatteredSlot[particle];
+    if (hole < awakeScattered) {
+        moveScattered(--awakeScattered, hole);
+        hole = awakeScattered;
+    }
+    if (hole + 1 != scattered.size()) moveScattered(scattered.size() - 1, hole);
+    scattered.pop_back();
+    scatteredSlot[particle] = NO_SLOT;
+}
+
+void PositionConstraintSolver::PackedSubscribers::syncAwake(size_t awakeCount)
+{
+    if (awakeCount == awakeBound) return;
+
+    // Only subscribers the awake count swept over change sides
+    const size_t first = std::min(awakeCount, awakeBound);
+    const size_t last = std::min(std::max(awakeCount, awakeBound), scatteredSlot.size());
+    const bool waking = awakeCount > awakeBound;
+    awakeBound = awakeCount;
+
+    for (size_t particle = first; particle < last; particle++) {
+        const uint32_t slot = scatteredSlot[particle];
+        if (slot == NO_SLOT) continue;
+
+        if (waking && slot >= awakeScattered) swapScattered(slot, awakeScattered++);
+        else if (!waking && slot < awakeScattered) swapScattered(slot, --awakeScattered);
+    }
+}
+
+void PositionConstraintSolver::PackedSubscribers::moveScattered(size_t from, size_t to)
+{
+    scattered[to] = scattered[from];
+    scatteredSlot[scattered[to]] = static_cast<uint32_t>(to);
+}
+
+void PositionConstraintSolver::PackedSubscribers::swapScattered(size_t a, size_t b)
+{
+    std::swap(scattered[a], scattered[b]);
+    scatteredSlot[scattered[a]] = static_cast<uint32_t>(a);
+    scatteredSlot[scattered[b]] = static_cast<uint32_t>(b);
+}
+
+void PositionConstraintSolver::PackedSubscribers::insert(uint32_t particle)
+{
+    const size_t run = std::upper_bound(runBegin.begin(), runBegin.end(), particle) - runBegin.begin();
+    const bool extendsPrevious = run > 0 && runEnd[run - 1] == particle;
+    const bool extendsNext = run < runBegin.size() && runBegin[run] == particle + 1;
+
+    if (extendsPrevious && extendsNext) {
+        runEnd[run - 1] = runEnd[run];
+        runBegin.erase(runBegin.begin() + run);
+        runEnd.erase(runEnd.begin() + run);
+    }
+    else if (extendsPrevious) {
+        runEnd[run - 1]++;
+    }
+    else if (extendsNext) {
+        runBegin[run]--;
+    }
+    else {
+        scatter(particle);
+    }
+}
+
+void PositionConstraintSolver::PackedSubscribers::scatter(uint32_t particle)
+{
+    if (scatteredSlot.size() <= particle) scatteredSlot.resize(particle + 1, NO_SLOT);
+    scatteredSlot[particle] = static_cast<uint32_t>(scattered.size());
+    scattered.push_back(particle);
+    if (particle < awakeBound) swapScattered(scattered.size() - 1, awakeScattered++);
+}
+
+void PositionConstraintSolver::PackedSubscribers::scatterIfShort(size_t run)
+{
+    if (runEnd[run] - runBegin[run] >= MIN_RUN_LENGTH) return;
+
+    for (uint32_t i = runBegin[run]; i < runEnd[run]; i++) scatter(i);
+    runBegin.erase(runBegin.begin() + run);
+    runEnd.erase(runEnd.begin() + run);
+}
+
+void PositionConstraintSolver::addConstraint(BoxedPositionConstraint* constraint)
+{
+    m_boxes.push_back(constraint);
+    constraint->setListener(this);
+    m_dirty = true;
+}
+
+void PositionConstraintSolver::addConstraint(EncircledPositionConstraint* constraint)
+{
+    m_circles.push_back(constraint);
+    constraint->setListener(this);
+    m_dirty = true;
+}
+
+void PositionConstraintSolver::onConstraintStateChanged(Constraint* /*constraint*/)
+{
+    m_dirty = true;
+}
+
+void PositionConstraintSolver::remapParticles(const ParticleRemap& remap)
+{
+    // Boxes and circles keep working with any subset of their particles, so none are dropped.
+    // The enabled ones are packed in registration order, which pairs them up with their packing.
+    size_t packed = 0;
+    for (size_t box = 0; box < m_boxes.size(); box++) {
+        const bool isPacked = !m_dirty && packed < m_boxIndex.size() && m_boxIndex[packed] == box;
+        remapConstraint(*m_boxes[box], isPacked ? &m_boxSubscribers[packed++] : nullptr, remap);
+    }
+
+    packed = 0;
+    for (size_t circle = 0; circle < m_circles.size(); circle++) {
+        const bool isPacked = !m_dirty && packed < m_circleIndex.size() && m_circleIndex[packed] == circle;
+        remapConstraint(*m_circles[circle], isPacked ? &m_circleSubscribers[packed++] : nullptr, remap);
+    }
+}
+
+void PositionConstraintSolver::remapConstraint(WorldPositionConstraint& constraint, PackedSubscribers* packed, const ParticleRemap& remap)
+{
+    const SubscriberList& subscribers = constraint.getSubscriberList();
+    if (!packed) {
+        constraint.remapParticles(remap);
+        return;
+    }
+
+    // A remap moving most subscribers, such as a sort, is followed by packing them afresh
+    if (subscribers.resortsOn(remap)) {
+        constraint.remapParticles(remap);
+        packed->assign(subscribers.indices());
+        return;
+    }
+
+    // Every leaving particle is taken out before any arriving one is put back, as moves happen at once
+    for (uint32_t removed : remap.removed) {
+        if (subscribers.contains(removed)) packed->erase(removed);
+    }
+
+    m_arrived.clear();
+    for (const ParticleMove& move : remap.moved) {
+        if (!subscribers.contains(move.from)) continue;
+        packed->erase(move.from);
+        m_arrived.push_back(move.to);
+    }
+
+    constraint.remapParticles(remap);
+    for (uint32_t arrived : m_arrived) packed->insert(arrived);
+}
+
+void PositionConstraintSolver::rebuild()
+{
+    m_boxMinX.clear();
+    m_boxMinY.clear();
+    m_boxMaxX.clear();
+    m_boxMaxY.clear();
+    m_boxIndex.clear();
+    m_boxSubscribers.clear();
+
+    for (size_t i = 0; i < m_boxes.size(); i++) {
+        const BoxedPositionConstraint* box = m_boxes[i];
+        if (!box->isEnabled() || box->getSubscribers().empty()) continue;
+
+        m_boxMinX.push_back(box->getMinCorner().x());
+        m_boxMinY.push_back(box->getMinCorner().y());
+        m_boxMaxX.push_back(box->getMaxCorner().x());
+        m_boxMaxY.push_back(box->getMaxCorner().y());
+        m_boxIndex.push_back(i);
+        m_boxSubscribers.emplace_back();
+        m_boxSubscribers.back().assign(box->getSubscribers());
+    }
+
+    m_circleCenterX.clear();
+    m_circleCenterY.clear();
+    m_circleRadius.clear();
+    m_circleIndex.clear();
+    m_circleSubscribers.clear();
+
+    for (size_t i = 0; i < m_circles.size(); i++) {
+        const EncircledPositionConstraint* circle = m_circles[i];
+        if (!circle->isEnabled() || circle->getSubscribers().empty()) continue;
+
+        m_circleCenterX.push_back(circle->getCenterPoint().x());
+        m_circleCenterY.push_back(circle->getCenterPoint().y());
+        m_circleRadius.push_back(circle->getRadius());
+        m_circleIndex.push_back(i);
+        m_circleSubscribers.emplace_back();
+        m_circleSubscribers.back().assign(circle->getSubscribers());
+    }
+
+    m_dirty = false;
+}
+
+void PositionConstraintSolver::solve(ParticleStore& particles)
+{
+    if (m_dirty) rebuild();
+
+    // Sleeping particles are stored last, so runs are cut short at the awake count
+    const size_t awakeCount = particles.getAwakeCount();
+
+    for (size_t box = 0; box < m_boxMinX.size(); box++) {
+        PackedSubscribers& subscribers = m_boxSubscribers[box];
+        subscribers.syncAwake(awakeCount);
+        const Real minX = m_boxMinX[box];
+        const Real minY = m_boxMinY[box];
+        const Real maxX = m_boxMaxX[box];
+        const Real maxY = m_boxMaxY[box];
+
+        for (size_t run = 0; run < subscribers.runBegin.size() && subscribers.runBegin[run] < awakeCount; run++) {
+            SimdKernels::clampToBox(particles, subscribers.runBegin[run], std::min<size_t>(subscribers.runEnd[run], awakeCount), minX, minY, maxX, maxY);
+        }
+        SimdKernels::clampToBox(particles, subscribers.scattered.data(), subscribers.awakeScattered, minX, minY, maxX, maxY);
+    }
+
+    for (size_t circle = 0; circle < m_circleRadius.size(); circle++) {
+        PackedSubscribers& subscribers = m_circleSubscribers[circle];
+        subscribers.syncAwake(awakeCount);
+        const Real centerX = m_circleCenterX[circle];
+        const Real centerY = m_circleCenterY[circle];
+        const Real radius = m_circleRadius[circle];
+
+        for (size_t run = 0; run < subscribers.runBegin.size() && subscribers.runBegin[run] < awakeCount; run++) {
+            SimdKernels::clampToCircle(particles, subscribers.runBegin[run], std::min<size_t>(subscribers.runEnd[run], awakeCount), centerX, centerY, radius);
+        }
+        SimdKernels::clampToCircle(particles, subscribers.scattered.data(), subscribers.awakeScattered, centerX, centerY, radius);
+    }
+}
@@ -0,0 +1,138 @@
+#pragma once
+#include "Contraint.h"
+#include "Particle.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace VerletPhysics {
+
+    /**
+     * Solves every `BoxedPositionConstraint` and `EncircledPositionConstraint` of a simulation world
+     * in homogeneous batches.
+     *
+     * The `PositionConstraintSolver` packs the bounds and subscribers of the enabled constraints of each
+     * type into flat arrays and clamps them with the batch kernels of `SimdKernels`. Subscribers with
+     * consecutive indices, such as a whole scene subscribed in creation order, are stored as runs and
+     * clamped straight over the contiguous position arrays with SIMD. Disabled constraints are left
+     * out of the packed arrays entirely. Packing is only redone when constraints are added, enabled,
+     * disabled or subscribe new particles; removing or moving particles patches the packed
+     * subscribers of the particles concerned. Sleeping particles, which the store keeps behind the
+     * awake ones, are not clamped at all.
+     */
+    class PositionConstraintSolver : public ConstraintListener
+    {
+        /**
+         * The subscribers of one constraint, split into runs of consecutive particle indices and the
+         * scattered indices left over.
+         *
+         * Particles can be taken out and put back one at a time: taking one out of a run trims or
+         * splits it, and putting one back next to a run extends it. Scattered subscribers below the
+         * store's awake count are kept before the others.
+         */
+        struct PackedSubscribers
+        {
+            static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+            std::vector<uint32_t> runBegin;      ///< First particle of each run, in ascending order.
+            std::vector<uint32_t> runEnd;        ///< One past the last particle of each run.
+            std::vector<uint32_t> scattered;     ///< Subscribers outside any run.
+            std::vector<uint32_t> scatteredSlot; ///< Position in `scattered` of every particle, or `NO_SLOT`, as far as the largest scattered subscriber.
+            size_t awakeBound = 0;               ///< Awake particle count the scattered subscribers are split at.
+            size_t awakeScattered = 0;           ///< Number of scattered subscribers below `awakeBound`, which come first.
+
+            void assign(const std::vector<size_t>& subscribers);
+            void erase(uint32_t particle);
+            void insert(uint32_t particle);
+            void syncAwake(size_t awakeCount);
+
+        private:
+            void scatter(uint32_t particle);
+            void moveScattered(size_t from, size_t to);
+            void swapScattered(size_t a, size_t b);
+            void scatterIfShort(size_t run);
+        };
+
+        std::vector<BoxedPositionConstraint*> m_boxes;       ///< Every registered box, in insertion order.
+        std::vector<EncircledPositionConstraint*> m_circles; ///< Every registered circle, in insertion order.
+        bool m_dirty = false;                                ///< Set when the packed arrays need rebuilding.
+
+        std::vector<Real> m_boxMinX;                     ///< Minimum X of each enabled box.
+        std::vector<Real> m_boxMinY;                     ///< Minimum Y of each enabled box.
+        std::vector<Real> m_boxMaxX;                     ///< Maximum X of each enabled box.
+        std::vector<Real> m_boxMaxY;                     ///< Maximum Y of each enabled box.
+        std::vector<size_t> m_boxIndex;                  ///< Index in `m_boxes` of each enabled box.
+        std::vector<PackedSubscribers> m_boxSubscribers; ///< Subscribers of each enabled box.
+
+        std::vector<Real> m_circleCenterX;                  ///< Center X of each enabled circle.
+        std::vector<Real> m_circleCenterY;                  ///< Center Y of each enabled circle.
+        std::vector<Real> m_circleRadius;                   ///< Radius of each enabled circle.
+        std::vector<size_t> m_circleIndex;                  ///< Index in `m_circles` of each enabled circle.
+        std::vector<PackedSubscribers> m_circleSubscribers; ///< Subscribers of each enabled circle.
+
+        std::vector<uint32_t> m_arrived; ///< Scratch new index of every moved subscriber during a remap.
+
+    public:
+        /**
+         * Registers a box constraint with the solver and subscribes to its changes.
+         *
+         * @param constraint Pointer to the constraint to be solved.
+         */
+        void addConstraint(BoxedPositionConstraint* constraint);
+
+        /**
+         * Registers a circle constraint with the solver and subscribes to its changes.
+         *
+         * @param constraint Pointer to the constraint to be solved.
+         */
+        void addConstraint(EncircledPositionConstraint* constraint);
+
+        /**
+         * Solves every enabled box, then every enabled circle, repacking first if anything changed.
+         *
+         * @param particles The store holding the constrained particles.
+         */
+        void solve(ParticleStore& particles);
+
+        /**
+         * Marks the packed arrays for rebuilding when a constraint changes.
+         *
+         * @param constraint The constraint that changed.
+         */
+        virtual void onConstraintStateChanged(Constraint* constraint) override;
+
+        /**
+         * Remaps the subscribers of every box and circle to new particle indices, patching the
+         * packed subscribers of the removed and moved particles.
+         *
+         * @param remap The removed particles and every particle that changed index.
+         */
+        void remapParticles(const ParticleRemap& remap);
+
+        /**
+         * Gets every registered box constraint, enabled or not.
+         *
+         * @return The box constraints, in insertion order.
+         */
+        const std::vector<BoxedPositionConstraint*>& getBoxes() const { return m_boxes; }
+
+        /**
+         * Gets every registered circle constraint, enabled or not.
+         *
+         * @return The circle constraints, in insertion order.
+         */
+        const std::vector<EncircledPositionConstraint*>& getCircles() const { return m_circles; }
+
+    private:
+        /**
+         * Rebuilds the packed arrays from the enabled constraints.
+         */
+        void rebuild();
+
+        /**
+         * Remaps one constraint's subscribers and, if it is packed, its packed subscribers.
+         */
+        void remapConstraint(WorldPositionConstraint& constraint, PackedSubscribers* packed, const ParticleRemap& remap);
+    };
+}
@@ -0,0 +1,75 @@
+#include "Profiling.h"
+
+#include <fstream>
+
+using namespace VerletPhysics;
+
+const char* VerletPhysics::getPhaseName(SimulationPhase phase)
+{
+    switch (phase) {
+    case SimulationPhase::Generators: return "Generators";
+    case SimulationPhase::Integration: return "Integration";
+    case SimulationPhase::Collisions: return "Collisions";
+    case SimulationPhase::Constraints: return "Constraints";
+    case SimulationPhase::Substepping: return "Substepping";
+    case SimulationPhase::Sleeping: return "Sleeping";
+    case SimulationPhase::Sorting: return "Sorting";
+    }
+    return "Unknown";
+}
+
+double PhaseTimings::getTotal() const
+{
+    double total = 0;
+    for (double phase : seconds) total += phase;
+    return total;
+}
+
+void SimulationStats::reset(size_t substepCount)
+{
+    substeps.assign(substepCount, PhaseTimings());
+    total = PhaseTimings();
+    pairTests = 0;
+    collisionsResolved = 0;
+    sweptImpacts = 0;
+    constraintsCorrected = 0;
+}
+
+TraceRecorder::TraceRecorder() :
+    m_origin(Clock::now())
+{
+}
+
+void TraceRecorder::record(const char* name, Clock::time_point start, Clock::time_point end, size_t substep)
+{
+    using Microseconds = std::chrono::duration<double, std::micro>;
+    m_events.push_back({ name, Microseconds(start - m_origin).count(), Microseconds(end - start).count(), substep });
+}
+
+void TraceRecorder::writeJson(std::ostream& stream) const
+{
+    stream << "{\"traceEvents\":[";
+
+    for (size_t i = 0; i < m_events.size(); i++) {
+        const Event& event = m_events[i];
+        if (i > 0) stream << ',';
+
+        // Every phase runs on the calling thread, so all events share one track
+        stream << "\n{\"name\":\"" << event.name << "\",\"cat\":\"simulation\",\"ph\":\"X\",\"pid\":0,\"tid\":0"
+            << ",\"ts\":" << event.start << ",\"dur\":" << event.duration
+            << ",\"args\":{\"substep\":" << event.substep << "}}";
+    }
+
+    stream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+bool TraceRecorder::writeJsonFile(const std::string& path) const
+{
+    std::ofstream file(path);
+    if (!file) return false;
+
+    file.precision(3);
+    file << std::fixed;
+    writeJson(file);
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * Wraps a statement that only exists in profiling builds.
+ *
+ * Profiling is compiled in by defining `VERLET_ENABLE_PROFILING`. Without it every timer and counter
+ * is compiled out, the statistics stay zeroed and no trace events are recorded.
+ */
+#ifdef VERLET_ENABLE_PROFILING
+#define VERLET_PROFILE(statement) statement
+#else
+#define VERLET_PROFILE(statement)
+#endif
+
+namespace VerletPhysics {
+
+    /**
+     * The phases a simulation substep is made of, in the order they run.
+     */
+    enum class SimulationPhase
+    {
+        Generators,  ///< Force generators.
+        Integration, ///< Verlet integration.
+        Collisions,  ///< Broad and narrow phase collision handling.
+        Constraints, ///< Constraint solving.
+        Substepping, ///< Error measurements for adaptive substepping, when enabled.
+        Sleeping,    ///< Island building and sleeping, once per update and counted in its last substep.
+        Sorting      ///< Reordering particles for locality, when due, counted in the last substep.
+    };
+
+    constexpr size_t SIMULATION_PHASE_COUNT = 7;
+
+    /**
+     * Gets a readable name for a simulation phase.
+     *
+     * @param phase The phase to name.
+     * @return A static string naming the phase.
+     */
+    const char* getPhaseName(SimulationPhase phase);
+
+    /**
+     * Wall time spent in each phase, in seconds.
+     */
+    struct PhaseTimings
+    {
+        double seconds[SIMULATION_PHASE_COUNT] = {}; ///< Time per phase, indexed by `SimulationPhase`.
+
+        double get(SimulationPhase phase) const { return seconds[static_cast<size_t>(phase)]; }
+        double& get(SimulationPhase phase) { return seconds[static_cast<size_t>(phase)]; }
+
+        /**
+         * Gets the time spent in all phases together.
+         *
+         * @return The sum of every phase, in seconds.
+         */
+        double getTotal() const;
+    };
+
+    /**
+     * Collision counters accumulated by one thread before being merged.
+     */
+    struct CollisionCounters
+    {
+        size_t pairTests = 0; ///< Pairs whose distance was tested.
+        size_t resolved = 0;  ///< Pairs found overlapping and pushed apart.
+    };
+
+    /**
+     * Statistics gathered by a single `SimulationWorld::update` call.
+     */
+    struct SimulationStats
+    {
+        std::vector<PhaseTimings> substeps; ///< Phase times of each substep.
+        PhaseTimings total;                 ///< Phase times summed over every substep.
+
+        size_t pairTests = 0;            ///< Particle pairs tested for overlap by the narrow phase.
+        size_t collisionsResolved = 0;   ///< Particle pairs that overlapped and were resolved.
+        size_t sweptImpacts = 0;         ///< Fast particles stopped by continuous collision detection.
+        size_t constraintsCorrected = 0; ///< Distance constraints that were stretched and moved their particles.
+
+        /**
+         * Zeroes every counter and sizes the substep list.
+         *
+         * @param substepCount Number of substeps the next update performs.
+         */
+        void reset(size_t substepCount);
+    };
+
+    /**
+     * Collects phase events and writes them in the Chrome trace event format.
+     *
+     * The resulting JSON can be loaded into `chrome://tracing` or Perfetto to see every phase of
+     * every substep on a timeline.
+     */
+    class TraceRecorder
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+    private:
+        /**
+         * A single complete ("X") trace event.
+         */
+        struct Event
+        {
+            const char* name;   ///< Static name of the event.
+            double start;       ///< Start time in microseconds since the recorder was created.
+            double duration;    ///< Duration in microseconds.
+            size_t substep;     ///< Substep the event belongs to.
+        };
+
+        Clock::time_point m_origin; ///< Time all event timestamps are relative to.
+        std::vector<Event> m_events; ///< Recorded events, in the order they finished.
+
+    public:
+        /**
+         * Constructs an empty TraceRecorder whose timeline starts now.
+         */
+        TraceRecorder();
+
+        /**
+         * Records a completed event.
+         *
+         * @param name Static name of the event.
+         * @param start Time the event started.
+         * @param end Time the event finished.
+         * @param substep Substep the event belongs to.
+         */
+        void record(const char* name, Clock::time_point start, Clock::time_point end, size_t substep);
+
+        /**
+         * Discards every recorded event.
+         */
+        void clear() { m_events.clear(); }
+
+        /**
+         * Gets the number of recorded events.
+         *
+         * @return The event count.
+         */
+        size_t getEventCount() const { return m_events.size(); }
+
+        /**
+         * Writes every recorded event as a Chrome trace event JSON document.
+         *
+         * @param stream The stream to write to.
+         */
+        void writeJson(std::ostream& stream) const;
+
+        /**
+         * Writes every recorded event to a Chrome trace event JSON file.
+         *
+         * @param path Path of the file to create or overwrite.
+         * @return True if the file was written successfully.
+         */
+        bool writeJsonFile(const std::string& path) const;
+    };
+}
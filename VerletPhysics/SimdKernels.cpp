@@ -0,0 +1,1185 @@
+#include "SimdKernels.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define VERLET_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(VERLET_X86) && (defined(__GNUC__) || defined(__clang__))
+#define VERLET_TARGET_SSE2 __attribute__((target("sse2")))
+#define VERLET_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define VERLET_TARGET_SSE2
+#define VERLET_TARGET_AVX2
+#endif
+
+using namespace VerletPhysics;
+
+namespace {
+
+    SimdLevel s_simdLevel = SimdKernels::detectSimdLevel();
+
+    void integrateScalar(ParticleStore& particles, size_t begin, size_t end, Real deltaTimeSquared)
+    {
+        Real* positionX = particles.positionX();
+        Real* positionY = particles.positionY();
+        Real* previousX = particles.previousX();
+        Real* previousY = particles.previousY();
+        Real* forceX = particles.forceX();
+        Real* forceY = particles.forceY();
+        const Real* inverseMass = particles.inverseMass();
+        const uint8_t* isStatic = particles.isStatic();
+
+        for (size_t i = begin; i < end; i++) {
+            if (!isStatic[i]) {
+                const Real newX = (positionX[i] * 2) - previousX[i] + forceX[i] * inverseMass[i] * deltaTimeSquared;
+                const Real newY = (positionY[i] * 2) - previousY[i] + forceY[i] * inverseMass[i] * deltaTimeSquared;
+
+                previousX[i] = positionX[i];
+                previousY[i] = positionY[i];
+                positionX[i] = newX;
+                positionY[i] = newY;
+            }
+            forceX[i] = 0;
+            forceY[i] = 0;
+        }
+    }
+
+    // Particles closer to the rim than this fraction of the circle's radius take the exact test
+    constexpr double CIRCLE_REJECT_MARGIN = 1e-5;
+
+    inline void clampParticleToBox(Real* positionX, Real* positionY, const Real* radius, const uint8_t* isStatic, size_t i,
+        Real minX, Real minY, Real maxX, Real maxY)
+    {
+        if (isStatic[i]) return;
+
+        Real x = positionX[i];
+        Real y = positionY[i];
+        const Real r = radius[i];
+
+        x = x - r < minX ? minX + r : x;
+        y = y - r < minY ? minY + r : y;
+        x = x + r > maxX ? maxX - r : x;
+        y = y + r > maxY ? maxY - r : y;
+
+        positionX[i] = x;
+        positionY[i] = y;
+    }
+
+    /**
+     * Exact circle clamp, matching EncircledPositionConstraint for every particle.
+     */
+    inline void clampParticleToCircleExact(Real* positionX, Real* positionY, const Real* radius, const uint8_t* isStatic, size_t i,
+        Real centerX, Real centerY, Real circleRadius)
+    {
+        const Real displacementX = positionX[i] - centerX;
+        const Real displacementY = positionY[i] - centerY;
+        const Real distance = std::sqrt(displacementX * displacementX + displacementY * displacementY);
+
+        // If the particle is outside the circular boundary, reposition it on the circle's edge
+        if (!(distance + radius[i] > circleRadius) || isStatic[i] || distance == 0) return;
+
+        positionX[i] = centerX + displacementX / distance * (circleRadius - radius[i]);
+        positionY[i] = centerY + displacementY / distance * (circleRadius - radius[i]);
+    }
+
+    /**
+     * Circle clamp that first rejects particles well inside the circle by their squared distance.
+     *
+     * The rejection radius sits a margin inside the rim, far more than rounding could move the
+     * exact test, so rejected particles are exactly those the exact test would leave alone.
+     */
+    inline void clampParticleToCircle(Real* positionX, Real* positionY, const Real* radius, const uint8_t* isStatic, size_t i,
+        Real centerX, Real centerY, Real circleRadius, Real innerRadius)
+    {
+        const Real displacementX = positionX[i] - centerX;
+        const Real displacementY = positionY[i] - centerY;
+        const Real inside = innerRadius - radius[i];
+        if (inside > 0 && displacementX * displacementX + displacementY * displacementY < inside * inside) return;
+
+        clampParticleToCircleExact(positionX, positionY, radius, isStatic, i, centerX, centerY, circleRadius);
+    }
+
+    inline void accelerateParticle(Real* forceX, Real* forceY, const Real* inverseMass, size_t i, Real accelerationX, Real accelerationY)
+    {
+        if (inverseMass[i] == 0) return;
+
+        forceX[i] += accelerationX / inverseMass[i];
+        forceY[i] += accelerationY / inverseMass[i];
+    }
+
+    inline void dragParticle(ParticleStore& particles, size_t i, Real coefficient)
+    {
+        particles.forceX()[i] -= coefficient * (particles.positionX()[i] - particles.previousX()[i]);
+        particles.forceY()[i] -= coefficient * (particles.positionY()[i] - particles.previousY()[i]);
+    }
+
+    inline void attractParticle(ParticleStore& particles, size_t i, Real centerX, Real centerY, Real strength, Real softeningSquared)
+    {
+        const Real inverseMass = particles.inverseMass()[i];
+        const Real dx = centerX - particles.positionX()[i];
+        const Real dy = centerY - particles.positionY()[i];
+        const Real distanceSquared = dx * dx + dy * dy + softeningSquared;
+        if (inverseMass == 0 || distanceSquared == 0) return;
+
+        const Real scale = strength / (inverseMass * (distanceSquared * std::sqrt(distanceSquared)));
+        particles.forceX()[i] += dx * scale;
+        particles.forceY()[i] += dy * scale;
+    }
+
+    inline void sumAttractionAt(const Real* targetX, const Real* targetY, size_t i, const Real* sourceX, const Real* sourceY, const Real* sourceMass, size_t sourceCount,
+        Real softeningSquared, Real* accelerationX, Real* accelerationY)
+    {
+        Real sumX = 0;
+        Real sumY = 0;
+
+        for (size_t k = 0; k < sourceCount; k++) {
+            const Real dx = sourceX[k] - targetX[i];
+            const Real dy = sourceY[k] - targetY[i];
+            const Real distanceSquared = dx * dx + dy * dy + softeningSquared;
+            if (distanceSquared == 0) continue;
+
+            const Real scale = sourceMass[k] / (distanceSquared * std::sqrt(distanceSquared));
+            sumX += dx * scale;
+            sumY += dy * scale;
+        }
+
+        accelerationX[i] = sumX;
+        accelerationY[i] = sumY;
+    }
+
+#if defined(VERLET_X86) && defined(VERLET_SINGLE_PRECISION)
+
+    VERLET_TARGET_SSE2 size_t integrateSSE2(ParticleStore& particles, size_t begin, size_t end, float deltaTimeSquared)
+    {
+        float* positionX = particles.positionX();
+        float* positionY = particles.positionY();
+        float* previousX = particles.previousX();
+        float* previousY = particles.previousY();
+        float* forceX = particles.forceX();
+        float* forceY = particles.forceY();
+        const float* inverseMass = particles.inverseMass();
+        const uint8_t* isStatic = particles.isStatic();
+
+        const __m128 two = _mm_set1_ps(2.0f);
+        const __m128 dt2 = _mm_set1_ps(deltaTimeSquared);
+        const __m128 zero = _mm_setzero_ps();
+
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4) {
+            // All bits set in the lanes of movable particles
+            const __m128 movable = _mm_castsi128_ps(_mm_set_epi32(isStatic[i + 3] ? 0 : -1, isStatic[i + 2] ? 0 : -1, isStatic[i + 1] ? 0 : -1, isStatic[i] ? 0 : -1));
+            const __m128 invMass = _mm_loadu_ps(inverseMass + i);
+
+            const __m128 x = _mm_loadu_ps(positionX + i);
+            const __m128 px = _mm_loadu_ps(previousX + i);
+            const __m128 nx = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(x, two), px), _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(forceX + i), invMass), dt2));
+
+            const __m128 y = _mm_loadu_ps(positionY + i);
+            const __m128 py = _mm_loadu_ps(previousY + i);
+            const __m128 ny = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(y, two), py), _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(forceY + i), invMass), dt2));
+
+            _mm_storeu_ps(previousX + i, _mm_or_ps(_mm_and_ps(movable, x), _mm_andnot_ps(movable, px)));
+            _mm_storeu_ps(previousY + i, _mm_or_ps(_mm_and_ps(movable, y), _mm_andnot_ps(movable, py)));
+            _mm_storeu_ps(positionX + i, _mm_or_ps(_mm_and_ps(movable, nx), _mm_andnot_ps(movable, x)));
+            _mm_storeu_ps(positionY + i, _mm_or_ps(_mm_and_ps(movable, ny), _mm_andnot_ps(movable, y)));
+            _mm_storeu_ps(forceX + i, zero);
+            _mm_storeu_ps(forceY + i, zero);
+        }
+        return i;
+    }
+
+    VERLET_TARGET_AVX2 size_t integrateAVX2(ParticleStore& particles, size_t begin, size_t end, float deltaTimeSquared)
+    {
+        float* positionX = particles.positionX();
+        float* positionY = particles.positionY();
+        float* previousX = particles.previousX();
+        float* previousY = particles.previousY();
+        float* forceX = particles.forceX();
+        float* forceY = particles.forceY();
+        const float* inverseMass = particles.inverseMass();
+        const uint8_t* isStatic = particles.isStatic();
+
+        const __m256 two = _mm256_set1_ps(2.0f);
+        const __m256 dt2 = _mm256_set1_ps(deltaTimeSquared);
+        const __m256 zero = _mm256_setzero_ps();
+
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            // Widen eight static flags to 32-bit lanes, all bits set for movable particles
+            const __m256i wide = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(isStatic + i)));
+            const __m256 movable = _mm256_castsi256_ps(_mm256_cmpeq_epi32(wide, _mm256_setzero_si256()));
+            const __m256 invMass = _mm256_loadu_ps(inverseMass + i);
+
+            const __m256 x = _mm256_loadu_ps(positionX + i);
+            const __m256 px = _mm256_loadu_ps(previousX + i);
+            const __m256 nx = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(x, two), px), _mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps(forceX + i), invMass), dt2));
+
+            const __m256 y = _mm256_loadu_ps(positionY + i);
+            const __m256 py = _mm256_loadu_ps(previousY + i);
+            const __m256 ny = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(y, two), py), _mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps(forceY + i), invMass), dt2));
+
+            _mm256_storeu_ps(previousX + i, _mm256_blendv_ps(px, x, movable));
+            _mm256_storeu_ps(previousY + i, _mm256_blendv_ps(py, y, movable));
+            _mm256_storeu_ps(positionX + i, _mm256_blendv_ps(x, nx, movable));
+            _mm256_storeu_ps(positionY + i, _mm256_blendv_ps(y, ny, movable));
+            _mm256_storeu_ps(forceX + i, zero);
+            _mm256_storeu_ps(forceY + i, zero);
+        }
+        return i;
+    }
+
+    VERLET_TARGET_SSE2 inline __m128 selectSSE2(__m128 mask, __m128 a, __m128 b)
+    {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+
+    VERLET_TARGET_SSE2 size_t clampToBoxSSE2(ParticleStore& particles, size_t begin, size_t end, float minX, float minY, float maxX, float maxY)
+    {
+        float* positionX = particles.positionX();
+        float* positionY = particles.positionY();
+        const float* radius = particles.radius();
+        const uint8_t* isStatic = particles.isStatic();
+
+        const __m128 lowX = _mm_set1_ps(minX);
+        const __m128 lowY = _mm_set1_ps(minY);
+        const __m128 highX = _mm_set1_ps(maxX);
+        const __m128 highY = _mm_set1_ps(maxY);
+
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4) {
+            const __m128 movable = _mm_castsi128_ps(_mm_set_epi32(isStatic[i + 3] ? 0 : -1, isStatic[i + 2] ? 0 : -1, isStatic[i + 1] ? 0 : -1, isStatic[i] ? 0 : -1));
+            const __m128 r = _mm_loadu_ps(radius + i);
+            const __m128 x = _mm_loadu_ps(positionX + i);
+            const __m128 y = _mm_loadu_ps(positionY + i);
+
+            __m128 cx = selectSSE2(_mm_cmplt_ps(_mm_sub_ps(x, r), lowX), _mm_add_ps(lowX, r), x);
+            __m128 cy = selectSSE2(_mm_cmplt_ps(_mm_sub_ps(y, r), lowY), _mm_add_ps(lowY, r), y);
+            cx = selectSSE2(_mm_cmpgt_ps(_mm_add_ps(cx, r), highX), _mm_sub_ps(highX, r), cx);
+            cy = selectSSE2(_mm_cmpgt_ps(_mm_add_ps(cy, r), highY), _mm_sub_ps(highY, r), cy);
+
+            _mm_storeu_ps(positionX + i, selectSSE2(movable, cx, x));
+            _mm_storeu_ps(positionY + i, selectSSE2(movable, cy, y));
+        }
+        return i;
+    }
+
+    VERLET_TARGET_AVX2 size_t clampToBoxAVX2(ParticleStore& particles, size_t begin, size_t end, float minX, float minY, float maxX, float maxY)
+    {
+        float* positionX = particles.positionX();
+        float* positionY = particles.positionY();
+        const float* radius = particles.radius();
+        const uint8_t* isStatic = particles.isStatic();
+
+        const __m256 lowX = _mm256_set1_ps(minX);
+        const __m256 lowY = _mm256_set1_ps(minY);
+        const __m256 highX = _mm256_set1_ps(maxX);
+        const __m256 highY = _mm256_set1_ps(maxY);
+
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            const __m256i wide = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(isStatic + i)));
+            const __m256 movable = _mm256_castsi256_ps(_mm256_cmpeq_epi32(wide, _mm256_setzero_si256()));
+            const __m256 r = _mm256_loadu_ps(radius + i);
+            const __m256 x = _mm256_loadu_ps(positionX + i);
+            const __m256 y = _mm256_loadu_ps(positionY + i);
+
+            __m256 cx = _mm256_blendv_ps(x, _mm256_add_ps(lowX, r), _mm256_cmp_ps(_mm256_sub_ps(x, r), lowX, _CMP_LT_OQ));
+            __m256 cy = _mm256_blendv_ps(y, _mm256_add_ps(lowY, r), _mm256_cmp_ps(_mm256_sub_ps(y, r), lowY, _CMP_LT_OQ));
+            cx = _mm256_blendv_ps(cx, _mm256_sub_ps(highX, r), _mm256_cmp_ps(_mm256_add_ps(cx, r), highX, _CMP_GT_OQ));
+            cy = _mm256_blendv_ps(cy, _mm256_sub_ps(highY, r), _mm256_cmp_ps(_mm256_add_ps(cy, r), highY, _CMP_GT_OQ));
+
+            _mm256_storeu_ps(positionX + i, _mm256_blendv_ps(x, cx, movable));
+            _mm256_storeu_ps(positionY + i, _mm256_blendv_ps(y, cy, movable));
+        }
+        return i;
+    }
+
+    VERLET_TARGET_SSE2 size_t clampToCircleSSE2(ParticleStore& particles, size_t begin, size_t end, float centerX, float centerY, float circleRadius, float innerRadius)
+    {
+        float* positionX = particles.positionX();
+        float* positionY = particles.positionY();
+        const float* radius = particles.radius();
+        const uint8_t* isStatic = particles.isStatic();
+
+        const __m128 cx = _mm_set1_ps(centerX);
+        const __m128 cy = _mm_set1_ps(centerY);
+        const __m128 inner = _mm_set1_ps(innerRadius);
+        const __m128 zero = _mm_setzero_ps();
+
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4) {
+            const __m128 dx = _mm_sub_ps(_mm_loadu_ps(positionX + i), cx);
+            const __m128 dy = _mm_sub_ps(_mm_loadu_ps(positionY + i), cy);
+            const __m128 inside = _mm_sub_ps(inner, _mm_loadu_ps(radius + i));
+            const __m128 rejected = _mm_and_ps(_mm_cmpgt_ps(inside, zero),
+                _mm_cmplt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(inside, inside)));
+
+            // Only lanes near or beyond the rim take the exact scalar test
+            const int mask = _mm_movemask_ps(rejected);
+            if (mask == 0xF) continue;
+            for (size_t lane = 0; lane < 4; lane++) {
+                if (!(mask & (1 << lane))) clampParticleToCircleExact(positionX, positionY, radius, isStatic, i + lane, centerX, centerY, circleRadius);
+            }
+        }
+        return i;
+    }
+
+    VERLET_TARGET_AVX2 size_t clampToCircleAVX2(ParticleStore& particles, size_t begin, size_t end, float centerX, float centerY, float circleRadius, float innerRadius)
+    {
+        float* positionX = particles.positionX();
+        float* positionY = particles.positionY();
+        const float* radius = particles.radius();
+        const uint8_t* isStatic = particles.isStatic();
+
+        const __m256 cx = _mm256_set1_ps(centerX);
+        const __m256 cy = _mm256_set1_ps(centerY);
+        const __m256 inner = _mm256_set1_ps(innerRadius);
+        const __m256 zero = _mm256_setzero_ps();
+
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(positionX + i), cx);
+            const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(positionY + i), cy);
+            const __m256 inside = _mm256_sub_ps(inner, _mm256_loadu_ps(radius + i));
+            const __m256 rejected = _mm256_and_ps(_mm256_cmp_ps(inside, zero, _CMP_GT_OQ),
+                _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(inside, inside), _CMP_LT_OQ));
+
+            // Only lanes near or beyond the rim take the exact scalar test
+            const int mask = _mm256_movemask_ps(rejected);
+            if (mask == 0xFF) continue;
+            for (size_t lane = 0; lane < 8; lane++) {
+                if (!(mask & (1 << lane))) clampParticleToCircleExact(positionX, positionY, radius, isStatic, i + lane, centerX, centerY, circleRadius);
+            }
+        }
+        return i;
+    }
+
+    VERLET_TARGET_SSE2 size_t accelerateSSE2(ParticleStore& particles, size_t begin, size_t end, float accelerationX, float accelerationY)
+    {
+        float* forceX = particles.forceX();
+        float* forceY = particles.forceY();
+        const float* inverseMass = particles.inverseMass();
+
+        const __m128 ax = _mm_set1_ps(accelerationX);
+        const __m128 ay = _mm_set1_ps(accelerationY);
+        const __m128 zero = _mm_setzero_ps();
+
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4) {
+            // Lanes of massless particles divide by zero and are discarded
+            const __m128 invMass = _mm_loadu_ps(inverseMass + i);
+            const __m128 massive = _mm_cmpneq_ps(invMass, zero);
+            const __m128 fx = _mm_loadu_ps(forceX + i);
+            const __m128 fy = _mm_loadu_ps(forceY + i);
+
+            _mm_storeu_ps(forceX + i, selectSSE2(massive, _mm_add_ps(fx, _mm_div_ps(ax, invMass)), fx));
+            _mm_storeu_ps(forceY + i, selectSSE2(massive, _mm_add_ps(fy, _mm_div_ps(ay, invMass)), fy));
+        }
+        return i;
+    }
+
+    VERLET_TARGET_SSE2 size_t applyDragSSE2(ParticleStore& particles, size_t begin, size_t end, float coefficient)
+    {
+        float* forceX = particles.forceX();
+        float* forceY = particles.forceY();
+        const float* positionX = particles.positionX();
+        const float* positionY = particles.positionY();
+        const float* previousX = particles.previousX();
+        const float* previousY = particles.previousY();
+
+        const __m128 c = _mm_set1_ps(coefficient);
+
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4) {
+            const __m128 vx = _mm_sub_ps(_mm_loadu_ps(positionX + i), _mm_loadu_ps(previousX + i));
+            const __m128 vy = _mm_sub_ps(_mm_loadu_ps(positionY + i), _mm_loadu_ps(previousY + i));
+
+            _mm_storeu_ps(forceX + i, _mm_sub_ps(_mm_loadu_ps(forceX + i), _mm_mul_ps(c, vx)));
+            _mm_storeu_ps(forceY + i, _mm_sub_ps(_mm_loadu_ps(forceY + i), _mm_mul_ps(c, vy)));
+        }
+        return i;
+    }
+
+    VERLET_TARGET_SSE2 size_t attractSSE2(ParticleStore& particles, size_t begin, size_t end, float centerX, float centerY, float strength, float softeningSquared)
+    {
+        float* forceX = particles.forceX();
+        float* forceY = particles.forceY();
+        const float* positionX = particles.positionX();
+        const float* positionY = particles.positionY();
+        const float* inverseMass = particles.inverseMass();
+
+        const __m128 cx = _mm_set1_ps(centerX);
+        const __m128 cy = _mm_set1_ps(centerY);
+        const __m128 k = _mm_set1_ps(strength);
+        const __m128 soft = _mm_set1_ps(softeningSquared);
+        const __m128 zero = _mm_setzero_ps();
+
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4) {
+            const __m128 invMass = _mm_loadu_ps(inverseMass + i);
+            const __m128 dx = _mm_sub_ps(cx, _mm_loadu_ps(positionX + i));
+            const __m128 dy = _mm_sub_ps(cy, _mm_loadu_ps(positionY + i));
+            const __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), soft);
+
+            // Lanes of massless particles, or of particles sitting on an unsoftened center, are discarded
+            const __m128 valid = _mm_and_ps(_mm_cmpneq_ps(invMass, zero), _mm_cmpneq_ps(d2, zero));
+            const __m128 scale = _mm_div_ps(k, _mm_mul_ps(invMass, _mm_mul_ps(d2, _mm_sqrt_ps(d2))));
+            const __m128 fx = _mm_loadu_ps(forceX + i);
+            const __m128 fy = _mm_loadu_ps(forceY + i);
+
+            _mm_storeu_ps(forceX + i, selectSSE2(valid, _mm_add_ps(fx, _mm_mul_ps(dx, scale)), fx));
+            _mm_storeu_ps(forceY + i, selectSSE2(valid, _mm_add_ps(fy, _mm_mul_ps(dy, scale)), fy));
+        }
+        return i;
+    }
+
+    VERLET_TARGET_SSE2 size_t sumAttractionSSE2(const float* targetX, const float* targetY, size_t begin, size_t end, const float* sourceX, const float* sourceY, const float* sourceMass, size_t sourceCount,
+        float softeningSquared, float* accelerationX, float* accelerationY)
+    {
+        const __m128 soft = _mm_set1_ps(softeningSquared);
+        const __m128 zero = _mm_setzero_ps();
+
+        // Each lane is a different target walking the sources in order, exactly like the scalar loop
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4) {
+            const __m128 x = _mm_loadu_ps(targetX + i);
+            const __m128 y = _mm_loadu_ps(targetY + i);
+            __m128 sumX = zero;
+            __m128 sumY = zero;
+
+            for (size_t k = 0; k < sourceCount; k++) {
+                const __m128 dx = _mm_sub_ps(_mm_set1_ps(sourceX[k]), x);
+                const __m128 dy = _mm_sub_ps(_mm_set1_ps(sourceY[k]), y);
+                const __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), soft);
+
+                // Lanes sitting on an unsoftened source are discarded
+                const __m128 valid = _mm_cmpneq_ps(d2, zero);
+                const __m128 scale = _mm_div_ps(_mm_set1_ps(sourceMass[k]), _mm_mul_ps(d2, _mm_sqrt_ps(d2)));
+                sumX = selectSSE2(valid, _mm_add_ps(sumX, _mm_mul_ps(dx, scale)), sumX);
+                sumY = selectSSE2(valid, _mm_add_ps(sumY, _mm_mul_ps(dy, scale)), sumY);
+            }
+
+            _mm_storeu_ps(accelerationX + i, sumX);
+            _mm_storeu_ps(accelerationY + i, sumY);
+        }
+        return i;
+    }
+
+    VERLET_TARGET_AVX2 size_t accelerateAVX2(ParticleStore& particles, size_t begin, size_t end, float accelerationX, float accelerationY)
+    {
+        float* forceX = particles.forceX();
+        float* forceY = particles.forceY();
+        const float* inverseMass = particles.inverseMass();
+
+        const __m256 ax = _mm256_set1_ps(accelerationX);
+        const __m256 ay = _mm256_set1_ps(accelerationY);
+        const __m256 zero = _mm256_setzero_ps();
+
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            // Lanes of massless particles divide by zero and are discarded
+            const __m256 invMass = _mm256_loadu_ps(inverseMass + i);
+            const __m256 massive = _mm256_cmp_ps(invMass, zero, _CMP_NEQ_UQ);
+            const __m256 fx = _mm256_loadu_ps(forceX + i);
+            const __m256 fy = _mm256_loadu_ps(forceY + i);
+
+            _mm256_storeu_ps(forceX + i, _mm256_blendv_ps(fx, _mm256_add_ps(fx, _mm256_div_ps(ax, invMass)), massive));
+            _mm256_storeu_ps(forceY + i, _mm256_blendv_ps(fy, _mm256_add_ps(fy, _mm256_div_ps(ay, invMass)), massive));
+        }
+        return i;
+    }
+
+    VERLET_TARGET_AVX2 size_t applyDragAVX2(ParticleStore& particles, size_t begin, size_t end, float coefficient)
+    {
+        float* forceX = particles.forceX();
+        float* forceY = particles.forceY();
+        const float* positionX = particles.positionX();
+        const float* positionY = particles.positionY();
+        const float* previousX = particles.previousX();
+        const float* previousY = particles.previousY();
+
+        const __m256 c = _mm256_set1_ps(coefficient);
+
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            const __m256 vx = _mm256_sub_ps(_mm256_loadu_ps(positionX + i), _mm256_loadu_ps(previousX + i));
+            const __m256 vy = _mm256_sub_ps(_mm256_loadu_ps(positionY + i), _mm256_loadu_ps(previousY + i));
+
+            _mm256_storeu_ps(forceX + i, _mm256_sub_ps(_mm256_loadu_ps(forceX + i), _mm256_mul_ps(c, vx)));
+            _mm256_storeu_ps(forceY + i, _mm256_sub_ps(_mm256_loadu_ps(forceY + i), _mm256_mul_ps(c, vy)));
+        }
+        return i;
+    }
+
+    VERLET_TARGET_AVX2 size_t attractAVX2(ParticleStore& particles, size_t begin, size_t end, float centerX, float centerY, float strength, float softeningSquared)
+    {
+        float* forceX = particles.forceX();
+        float* forceY = particles.forceY();
+        const float* positionX = particles.positionX();
+        const float* positionY = particles.positionY();
+        const float* inverseMass = particles.inverseMass();
+
+        const __m256 cx = _mm256_set1_ps(centerX);
+        const __m256 cy = _mm256_set1_ps(centerY);
+        const __m256 k = _mm256_set1_ps(strength);
+        const __m256 soft = _mm256_set1_ps(softeningSquared);
+        const __m256 zero = _mm256_setzero_ps();
+
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            const __m256 invMass = _mm256_loadu_ps(inverseMass + i);
+            const __m256 dx = _mm256_sub_ps(cx, _mm256_loadu_ps(positionX + i));
+            const __m256 dy = _mm256_sub_ps(cy, _mm256_loadu_ps(positionY + i));
+            const __m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), soft);
+
+            // Lanes of massless particles, or of particles sitting on an unsoftened center, are discarded
+            const __m256 valid = _mm256_and_ps(_mm256_cmp_ps(invMass, zero, _CMP_NEQ_UQ), _mm256_cmp_ps(d2, zero, _CMP_NEQ_UQ));
+            const __m256 scale = _mm256_div_ps(k, _mm256_mul_ps(invMass, _mm256_mul_ps(d2, _mm256_sqrt_ps(d2))));
+            const __m256 fx = _mm256_loadu_ps(forceX + i);
+            const __m256 fy = _mm256_loadu_ps(forceY + i);
+
+            _mm256_storeu_ps(forceX + i, _mm256_blendv_ps(fx, _mm256_add_ps(fx, _mm256_mul_ps(dx, scale)), valid));
+            _mm256_storeu_ps(forceY + i, _mm256_blendv_ps(fy, _mm256_add_ps(fy, _mm256_mul_ps(dy, scale)), valid));
+        }
+        return i;
+    }
+
+    VERLET_TARGET_AVX2 size_t sumAttractionAVX2(const float* targetX, const float* targetY, size_t begin, size_t end, const float* sourceX, const float* sourceY, const float* sourceMass, size_t sourceCount,
+        float softeningSquared, float* accelerationX, float* accelerationY)
+    {
+        const __m256 soft = _mm256_set1_ps(softeningSquared);
+        const __m256 zero = _mm256_setzero_ps();
+
+        // Each lane is a different target walking the sources in order, exactly like the scalar loop
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            const __m256 x = _mm256_loadu_ps(targetX + i);
+            const __m256 y = _mm256_loadu_ps(targetY + i);
+            __m256 sumX = zero;
+            __m256 sumY = zero;
+
+            for (size_t k = 0; k < sourceCount; k++) {
+                const __m256 dx = _mm256_sub_ps(_mm256_set1_ps(sourceX[k]), x);
+                const __m256 dy = _mm256_sub_ps(_mm256_set1_ps(sourceY[k]), y);
+                const __m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), soft);
+
+                // Lanes sitting on an unsoftened source are discarded
+                const __m256 valid = _mm256_cmp_ps(d2, zero, _CMP_NEQ_UQ);
+                const __m256 scale = _mm256_div_ps(_mm256_set1_ps(sourceMass[k]), _mm256_mul_ps(d2, _mm256_sqrt_ps(d2)));
+                sumX = _mm256_blendv_ps(sumX, _mm256_add_ps(sumX, _mm256_mul_ps(dx, scale)), valid);
+                sumY = _mm256_blendv_ps(sumY, _mm256_add_ps(sumY, _mm256_mul_ps(dy, scale)), valid);
+            }
+
+            _mm256_storeu_ps(accelerationX + i, sumX);
+            _mm256_storeu_ps(accelerationY + i, sumY);
+        }
+        return i;
+    }
+
+#elif defined(VERLET_X86)
+
+    VERLET_TARGET_SSE2 size_t integrateSSE2(ParticleStore& particles, size_t begin, size_t end, double deltaTimeSquared)
+    {
+        double* positionX = particles.positionX();
+        double* positionY = particles.positionY();
+        double* previousX = particles.previousX();
+        double* previousY = particles.previousY();
+        double* forceX = particles.forceX();
+        double* forceY = particles.forceY();
+        const double* inverseMass = particles.inverseMass();
+        const uint8_t* isStatic = particles.isStatic();
+
+        const __m128d two = _mm_set1_pd(2.0);
+        const __m128d dt2 = _mm_set1_pd(deltaTimeSquared);
+        const __m128d zero = _mm_setzero_pd();
+
+        size_t i = begin;
+        for (; i + 2 <= end; i += 2) {
+            // All bits set in the lanes of movable particles
+            const __m128d movable = _mm_castsi128_pd(_mm_set_epi64x(isStatic[i + 1] ? 0 : -1, isStatic[i] ? 0 : -1));
+            const __m128d invMass = _mm_loadu_pd(inverseMass + i);
+
+            const __m128d x = _mm_loadu_pd(positionX + i);
+            const __m128d px = _mm_loadu_pd(previousX + i);
+            const __m128d nx = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(x, two), px), _mm_mul_pd(_mm_mul_pd(_mm_loadu_pd(forceX + i), invMass), dt2));
+
+            const __m128d y = _mm_loadu_pd(positionY + i);
+            const __m128d py = _mm_loadu_pd(previousY + i);
+            const __m128d ny = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(y, two), py), _mm_mul_pd(_mm_mul_pd(_mm_loadu_pd(forceY + i), invMass), dt2));
+
+            _mm_storeu_pd(previousX + i, _mm_or_pd(_mm_and_pd(movable, x), _mm_andnot_pd(movable, px)));
+            _mm_storeu_pd(previousY + i, _mm_or_pd(_mm_and_pd(movable, y), _mm_andnot_pd(movable, py)));
+            _mm_storeu_pd(positionX + i, _mm_or_pd(_mm_and_pd(movable, nx), _mm_andnot_pd(movable, x)));
+            _mm_storeu_pd(positionY + i, _mm_or_pd(_mm_and_pd(movable, ny), _mm_andnot_pd(movable, y)));
+            _mm_storeu_pd(forceX + i, zero);
+            _mm_storeu_pd(forceY + i, zero);
+        }
+        return i;
+    }
+
+    VERLET_TARGET_AVX2 size_t integrateAVX2(ParticleStore& particles, size_t begin, size_t end, double deltaTimeSquared)
+    {
+        double* positionX = particles.positionX();
+        double* positionY = particles.positionY();
+        double* previousX = particles.previousX();
+        double* previousY = particles.previousY();
+        double* forceX = particles.forceX();
+        double* forceY = particles.forceY();
+        const double* inverseMass = particles.inverseMass();
+        const uint8_t* isStatic = particles.isStatic();
+
+        const __m256d two = _mm256_set1_pd(2.0);
+        const __m256d dt2 = _mm256_set1_pd(deltaTimeSquared);
+        const __m256d zero = _mm256_setzero_pd();
+
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4) {
+            // Widen four static flags to 64-bit lanes, all bits set for movable particles
+            int flags;
+            std::memcpy(&flags, isStatic + i, sizeof(flags));
+            const __m256i wide = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(flags));
+            const __m256d movable = _mm256_castsi256_pd(_mm256_cmpeq_epi64(wide, _mm256_setzero_si256()));
+            const __m256d invMass = _mm256_loadu_pd(inverseMass + i);
+
+            const __m256d x = _mm256_loadu_pd(positionX + i);
+            const __m256d px = _mm256_loadu_pd(previousX + i);
+            const __m256d nx = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(x, two), px), _mm256_mul_pd(_mm256_mul_pd(_mm256_loadu_pd(forceX + i), invMass), dt2));
+
+            const __m256d y = _mm256_loadu_pd(positionY + i);
+            const __m256d py = _mm256_loadu_pd(previousY + i);
+            const __m256d ny = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(y, two), py), _mm256_mul_pd(_mm256_mul_pd(_mm256_loadu_pd(forceY + i), invMass), dt2));
+
+            _mm256_storeu_pd(previousX + i, _mm256_blendv_pd(px, x, movable));
+            _mm256_storeu_pd(previousY + i, _mm256_blendv_pd(py, y, movable));
+            _mm256_storeu_pd(positionX + i, _mm256_blendv_pd(x, nx, movable));
+            _mm256_storeu_pd(positionY + i, _mm256_blendv_pd(y, ny, movable));
+            _mm256_storeu_pd(forceX + i, zero);
+            _mm256_storeu_pd(forceY + i, zero);
+        }
+        return i;
+    }
+
+    VERLET_TARGET_SSE2 inline __m128d selectSSE2(__m128d mask, __m128d a, __m128d b)
+    {
+        return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+    }
+
+    VERLET_TARGET_SSE2 size_t clampToBoxSSE2(ParticleStore& particles, size_t begin, size_t end, double minX, double minY, double maxX, double maxY)
+    {
+        double* positionX = particles.positionX();
+        double* positionY = particles.positionY();
+        const double* radius = particles.radius();
+        const uint8_t* isStatic = particles.isStatic();
+
+        const __m128d lowX = _mm_set1_pd(minX);
+        const __m128d lowY = _mm_set1_pd(minY);
+        const __m128d highX = _mm_set1_pd(maxX);
+        const __m128d highY = _mm_set1_pd(maxY);
+
+        size_t i = begin;
+        for (; i + 2 <= end; i += 2) {
+            const __m128d movable = _mm_castsi128_pd(_mm_set_epi64x(isStatic[i + 1] ? 0 : -1, isStatic[i] ? 0 : -1));
+            const __m128d r = _mm_loadu_pd(radius + i);
+            const __m128d x = _mm_loadu_pd(positionX + i);
+            const __m128d y = _mm_loadu_pd(positionY + i);
+
+            __m128d cx = selectSSE2(_mm_cmplt_pd(_mm_sub_pd(x, r), lowX), _mm_add_pd(lowX, r), x);
+            __m128d cy = selectSSE2(_mm_cmplt_pd(_mm_sub_pd(y, r), lowY), _mm_add_pd(lowY, r), y);
+            cx = selectSSE2(_mm_cmpgt_pd(_mm_add_pd(cx, r), highX), _mm_sub_pd(highX, r), cx);
+            cy = selectSSE2(_mm_cmpgt_pd(_mm_add_pd(cy, r), highY), _mm_sub_pd(highY, r), cy);
+
+            _mm_storeu_pd(positionX + i, selectSSE2(movable, cx, x));
+            _mm_storeu_pd(positionY + i, selectSSE2(movable, cy, y));
+        }
+        return i;
+    }
+
+    VERLET_TARGET_AVX2 size_t clampToBoxAVX2(ParticleStore& particles, size_t begin, size_t end, double minX, double minY, double maxX, double maxY)
+    {
+        double* positionX = particles.positionX();
+        double* positionY = particles.positionY();
+        const double* radius = particles.radius();
+        const uint8_t* isStatic = particles.isStatic();
+
+        const __m256d lowX = _mm256_set1_pd(minX);
+        const __m256d lowY = _mm256_set1_pd(minY);
+        const __m256d highX = _mm256_set1_pd(maxX);
+        const __m256d highY = _mm256_set1_pd(maxY);
+
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4) {
+            int flags;
+            std::memcpy(&flags, isStatic + i, sizeof(flags));
+            const __m256i wide = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(flags));
+            const __m256d movable = _mm256_castsi256_pd(_mm256_cmpeq_epi64(wide, _mm256_setzero_si256()));
+            const __m256d r = _mm256_loadu_pd(radius + i);
+            const __m256d x = _mm256_loadu_pd(positionX + i);
+            const __m256d y = _mm256_loadu_pd(positionY + i);
+
+            __m256d cx = _mm256_blendv_pd(x, _mm256_add_pd(lowX, r), _mm256_cmp_pd(_mm256_sub_pd(x, r), lowX, _CMP_LT_OQ));
+            __m256d cy = _mm256_blendv_pd(y, _mm256_add_pd(lowY, r), _mm256_cmp_pd(_mm256_sub_pd(y, r), lowY, _CMP_LT_OQ));
+            cx = _mm256_blendv_pd(cx, _mm256_sub_pd(highX, r), _mm256_cmp_pd(_mm256_add_pd(cx, r), highX, _CMP_GT_OQ));
+            cy = _mm256_blendv_pd(cy, _mm256_sub_pd(highY, r), _mm256_cmp_pd(_mm256_add_pd(cy, r), highY, _CMP_GT_OQ));
+
+            _mm256_storeu_pd(positionX + i, _mm256_blendv_pd(x, cx, movable));
+            _mm256_storeu_pd(positionY + i, _mm256_blendv_pd(y, cy, movable));
+        }
+        return i;
+    }
+
+    VERLET_TARGET_SSE2 size_t clampToCircleSSE2(ParticleStore& particles, size_t begin, size_t end, double centerX, double centerY, double circleRadius, double innerRadius)
+    {
+        double* positionX = particles.positionX();
+        double* positionY = particles.positionY();
+        const double* radius = particles.radius();
+        const uint8_t* isStatic = particles.isStatic();
+
+        const __m128d cx = _mm_set1_pd(centerX);
+        const __m128d cy = _mm_set1_pd(centerY);
+        const __m128d inner = _mm_set1_pd(innerRadius);
+        const __m128d zero = _mm_setzero_pd();
+
+        size_t i = begin;
+        for (; i + 2 <= end; i += 2) {
+            const __m128d dx = _mm_sub_pd(_mm_loadu_pd(positionX + i), cx);
+            const __m128d dy = _mm_sub_pd(_mm_loadu_pd(positionY + i), cy);
+            const __m128d inside = _mm_sub_pd(inner, _mm_loadu_pd(radius + i));
+            const __m128d rejected = _mm_and_pd(_mm_cmpgt_pd(inside, zero),
+                _mm_cmplt_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)), _mm_mul_pd(inside, inside)));
+
+            // Only lanes near or beyond the rim take the exact scalar test
+            const int mask = _mm_movemask_pd(rejected);
+            if (mask == 0x3) continue;
+            for (size_t lane = 0; lane < 2; lane++) {
+                if (!(mask & (1 << lane))) clampParticleToCircleExact(positionX, positionY, radius, isStatic, i + lane, centerX, centerY, circleRadius);
+            }
+        }
+        return i;
+    }
+
+    VERLET_TARGET_AVX2 size_t clampToCircleAVX2(ParticleStore& particles, size_t begin, size_t end, double centerX, double centerY, double circleRadius, double innerRadius)
+    {
+        double* positionX = particles.positionX();
+        double* positionY = particles.positionY();
+        const double* radius = particles.radius();
+        const uint8_t* isStatic = particles.isStatic();
+
+        const __m256d cx = _mm256_set1_pd(centerX);
+        const __m256d cy = _mm256_set1_pd(centerY);
+        const __m256d inner = _mm256_set1_pd(innerRadius);
+        const __m256d zero = _mm256_setzero_pd();
+
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4) {
+            const __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(positionX + i), cx);
+            const __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(positionY + i), cy);
+            const __m256d inside = _mm256_sub_pd(inner, _mm256_loadu_pd(radius + i));
+            const __m256d rejected = _mm256_and_pd(_mm256_cmp_pd(inside, zero, _CMP_GT_OQ),
+                _mm256_cmp_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), _mm256_mul_pd(inside, inside), _CMP_LT_OQ));
+
+            // Only lanes near or beyond the rim take the exact scalar test
+            const int mask = _mm256_movemask_pd(rejected);
+            if (mask == 0xF) continue;
+            for (size_t lane = 0; lane < 4; lane++) {
+                if (!(mask & (1 << lane))) clampParticleToCircleExact(positionX, positionY, radius, isStatic, i + lane, centerX, centerY, circleRadius);
+            }
+        }
+        return i;
+    }
+
+    VERLET_TARGET_SSE2 size_t accelerateSSE2(ParticleStore& particles, size_t begin, size_t end, double accelerationX, double accelerationY)
+    {
+        double* forceX = particles.forceX();
+        double* forceY = particles.forceY();
+        const double* inverseMass = particles.inverseMass();
+
+        const __m128d ax = _mm_set1_pd(accelerationX);
+        const __m128d ay = _mm_set1_pd(accelerationY);
+        const __m128d zero = _mm_setzero_pd();
+
+        size_t i = begin;
+        for (; i + 2 <= end; i += 2) {
+            // Lanes of massless particles divide by zero and are discarded
+            const __m128d invMass = _mm_loadu_pd(inverseMass + i);
+            const __m128d massive = _mm_cmpneq_pd(invMass, zero);
+            const __m128d fx = _mm_loadu_pd(forceX + i);
+            const __m128d fy = _mm_loadu_pd(forceY + i);
+
+            _mm_storeu_pd(forceX + i, selectSSE2(massive, _mm_add_pd(fx, _mm_div_pd(ax, invMass)), fx));
+            _mm_storeu_pd(forceY + i, selectSSE2(massive, _mm_add_pd(fy, _mm_div_pd(ay, invMass)), fy));
+        }
+        return i;
+    }
+
+    VERLET_TARGET_SSE2 size_t applyDragSSE2(ParticleStore& particles, size_t begin, size_t end, double coefficient)
+    {
+        double* forceX = particles.forceX();
+        double* forceY = particles.forceY();
+        const double* positionX = particles.positionX();
+        const double* positionY = particles.positionY();
+        const double* previousX = particles.previousX();
+        const double* previousY = particles.previousY();
+
+        const __m128d c = _mm_set1_pd(coefficient);
+
+        size_t i = begin;
+        for (; i + 2 <= end; i += 2) {
+            const __m128d vx = _mm_sub_pd(_mm_loadu_pd(positionX + i), _mm_loadu_pd(previousX + i));
+            const __m128d vy = _mm_sub_pd(_mm_loadu_pd(positionY + i), _mm_loadu_pd(previousY + i));
+
+            _mm_storeu_pd(forceX + i, _mm_sub_pd(_mm_loadu_pd(forceX + i), _mm_mul_pd(c, vx)));
+            _mm_storeu_pd(forceY + i, _mm_sub_pd(_mm_loadu_pd(forceY + i), _mm_mul_pd(c, vy)));
+        }
+        return i;
+    }
+
+    VERLET_TARGET_SSE2 size_t attractSSE2(ParticleStore& particles, size_t begin, size_t end, double centerX, double centerY, double strength, double softeningSquared)
+    {
+        double* forceX = particles.forceX();
+        double* forceY = particles.forceY();
+        const double* positionX = particles.positionX();
+        const double* positionY = particles.positionY();
+        const double* inverseMass = particles.inverseMass();
+
+        const __m128d cx = _mm_set1_pd(centerX);
+        const __m128d cy = _mm_set1_pd(centerY);
+        const __m128d k = _mm_set1_pd(strength);
+        const __m128d soft = _mm_set1_pd(softeningSquared);
+        const __m128d zero = _mm_setzero_pd();
+
+        size_t i = begin;
+        for (; i + 2 <= end; i += 2) {
+            const __m128d invMass = _mm_loadu_pd(inverseMass + i);
+            const __m128d dx = _mm_sub_pd(cx, _mm_loadu_pd(positionX + i));
+            const __m128d dy = _mm_sub_pd(cy, _mm_loadu_pd(positionY + i));
+            const __m128d d2 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)), soft);
+
+            // Lanes of massless particles, or of particles sitting on an unsoftened center, are discarded
+            const __m128d valid = _mm_and_pd(_mm_cmpneq_pd(invMass, zero), _mm_cmpneq_pd(d2, zero));
+            const __m128d scale = _mm_div_pd(k, _mm_mul_pd(invMass, _mm_mul_pd(d2, _mm_sqrt_pd(d2))));
+            const __m128d fx = _mm_loadu_pd(forceX + i);
+            const __m128d fy = _mm_loadu_pd(forceY + i);
+
+            _mm_storeu_pd(forceX + i, selectSSE2(valid, _mm_add_pd(fx, _mm_mul_pd(dx, scale)), fx));
+            _mm_storeu_pd(forceY + i, selectSSE2(valid, _mm_add_pd(fy, _mm_mul_pd(dy, scale)), fy));
+        }
+        return i;
+    }
+
+    VERLET_TARGET_SSE2 size_t sumAttractionSSE2(const double* targetX, const double* targetY, size_t begin, size_t end, const double* sourceX, const double* sourceY, const double* sourceMass, size_t sourceCount,
+        double softeningSquared, double* accelerationX, double* accelerationY)
+    {
+        const __m128d soft = _mm_set1_pd(softeningSquared);
+        const __m128d zero = _mm_setzero_pd();
+
+        // Each lane is a different target walking the sources in order, exactly like the scalar loop
+        size_t i = begin;
+        for (; i + 2 <= end; i += 2) {
+            const __m128d x = _mm_loadu_pd(targetX + i);
+            const __m128d y = _mm_loadu_pd(targetY + i);
+            __m128d sumX = zero;
+            __m128d sumY = zero;
+
+            for (size_t k = 0; k < sourceCount; k++) {
+                const __m128d dx = _mm_sub_pd(_mm_set1_pd(sourceX[k]), x);
+                const __m128d dy = _mm_sub_pd(_mm_set1_pd(sourceY[k]), y);
+                const __m128d d2 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)), soft);
+
+                // Lanes sitting on an unsoftened source are discarded
+                const __m128d valid = _mm_cmpneq_pd(d2, zero);
+                const __m128d scale = _mm_div_pd(_mm_set1_pd(sourceMass[k]), _mm_mul_pd(d2, _mm_sqrt_pd(d2)));
+                sumX = selectSSE2(valid, _mm_add_pd(sumX, _mm_mul_pd(dx, scale)), sumX);
+                sumY = selectSSE2(valid, _mm_add_pd(sumY, _mm_mul_pd(dy, scale)), sumY);
+            }
+
+            _mm_storeu_pd(accelerationX + i, sumX);
+            _mm_storeu_pd(accelerationY + i, sumY);
+        }
+        return i;
+    }
+
+    VERLET_TARGET_AVX2 size_t accelerateAVX2(ParticleStore& particles, size_t begin, size_t end, double accelerationX, double accelerationY)
+    {
+        double* forceX = particles.forceX();
+        double* forceY = particles.forceY();
+        const double* inverseMass = particles.inverseMass();
+
+        const __m256d ax = _mm256_set1_pd(accelerationX);
+        const __m256d ay = _mm256_set1_pd(accelerationY);
+        const __m256d zero = _mm256_setzero_pd();
+
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4) {
+            // Lanes of massless particles divide by zero and are discarded
+            const __m256d invMass = _mm256_loadu_pd(inverseMass + i);
+            const __m256d massive = _mm256_cmp_pd(invMass, zero, _CMP_NEQ_UQ);
+            const __m256d fx = _mm256_loadu_pd(forceX + i);
+            const __m256d fy = _mm256_loadu_pd(forceY + i);
+
+            _mm256_storeu_pd(forceX + i, _mm256_blendv_pd(fx, _mm256_add_pd(fx, _mm256_div_pd(ax, invMass)), massive));
+            _mm256_storeu_pd(forceY + i, _mm256_blendv_pd(fy, _mm256_add_pd(fy, _mm256_div_pd(ay, invMass)), massive));
+        }
+        return i;
+    }
+
+    VERLET_TARGET_AVX2 size_t applyDragAVX2(ParticleStore& particles, size_t begin, size_t end, double coefficient)
+    {
+        double* forceX = particles.forceX();
+        double* forceY = particles.forceY();
+        const double* positionX = particles.positionX();
+        const double* positionY = particles.positionY();
+        const double* previousX = particles.previousX();
+        const double* previousY = particles.previousY();
+
+        const __m256d c = _mm256_set1_pd(coefficient);
+
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4) {
+            const __m256d vx = _mm256_sub_pd(_mm256_loadu_pd(positionX + i), _mm256_loadu_pd(previousX + i));
+            const __m256d vy = _mm256_sub_pd(_mm256_loadu_pd(positionY + i), _mm256_loadu_pd(previousY + i));
+
+            _mm256_storeu_pd(forceX + i, _mm256_sub_pd(_mm256_loadu_pd(forceX + i), _mm256_mul_pd(c, vx)));
+            _mm256_storeu_pd(forceY + i, _mm256_sub_pd(_mm256_loadu_pd(forceY + i), _mm256_mul_pd(c, vy)));
+        }
+        return i;
+    }
+
+    VERLET_TARGET_AVX2 size_t attractAVX2(ParticleStore& particles, size_t begin, size_t end, double centerX, double centerY, double strength, double softeningSquared)
+    {
+        double* forceX = particles.forceX();
+        double* forceY = particles.forceY();
+        const double* positionX = particles.positionX();
+        const double* positionY = particles.positionY();
+        const double* inverseMass = particles.inverseMass();
+
+        const __m256d cx = _mm256_set1_pd(centerX);
+        const __m256d cy = _mm256_set1_pd(centerY);
+        const __m256d k = _mm256_set1_pd(strength);
+        const __m256d soft = _mm256_set1_pd(softeningSquared);
+        const __m256d zero = _mm256_setzero_pd();
+
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4) {
+            const __m256d invMass = _mm256_loadu_pd(inverseMass + i);
+            const __m256d dx = _mm256_sub_pd(cx, _mm256_loadu_pd(positionX + i));
+            const __m256d dy = _mm256_sub_pd(cy, _mm256_loadu_pd(positionY + i));
+            const __m256d d2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), soft);
+
+            // Lanes of massless particles, or of particles sitting on an unsoftened center, are discarded
+            const __m256d valid = _mm256_and_pd(_mm256_cmp_pd(invMass, zero, _CMP_NEQ_UQ), _mm256_cmp_pd(d2, zero, _CMP_NEQ_UQ));
+            const __m256d scale = _mm256_div_pd(k, _mm256_mul_pd(invMass, _mm256_mul_pd(d2, _mm256_sqrt_pd(d2))));
+            const __m256d fx = _mm256_loadu_pd(forceX + i);
+            const __m256d fy = _mm256_loadu_pd(forceY + i);
+
+            _mm256_storeu_pd(forceX + i, _mm256_blendv_pd(fx, _mm256_add_pd(fx, _mm256_mul_pd(dx, scale)), valid));
+            _mm256_storeu_pd(forceY + i, _mm256_blendv_pd(fy, _mm256_add_pd(fy, _mm256_mul_pd(dy, scale)), valid));
+        }
+        return i;
+    }
+
+    VERLET_TARGET_AVX2 size_t sumAttractionAVX2(const double* targetX, const double* targetY, size_t begin, size_t end, const double* sourceX, const double* sourceY, const double* sourceMass, size_t sourceCount,
+        double softeningSquared, double* accelerationX, double* accelerationY)
+    {
+        const __m256d soft = _mm256_set1_pd(softeningSquared);
+        const __m256d zero = _mm256_setzero_pd();
+
+        // Each lane is a different target walking the sources in order, exactly like the scalar loop
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4) {
+            const __m256d x = _mm256_loadu_pd(targetX + i);
+            const __m256d y = _mm256_loadu_pd(targetY + i);
+            __m256d sumX = zero;
+            __m256d sumY = zero;
+
+            for (size_t k = 0; k < sourceCount; k++) {
+                const __m256d dx = _mm256_sub_pd(_mm256_set1_pd(sourceX[k]), x);
+                const __m256d dy = _mm256_sub_pd(_mm256_set1_pd(sourceY[k]), y);
+                const __m256d d2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), soft);
+
+                // Lanes sitting on an unsoftened source are discarded
+                const __m256d valid = _mm256_cmp_pd(d2, zero, _CMP_NEQ_UQ);
+                const __m256d scale = _mm256_div_pd(_mm256_set1_pd(sourceMass[k]), _mm256_mul_pd(d2, _mm256_sqrt_pd(d2)));
+                sumX = _mm256_blendv_pd(sumX, _mm256_add_pd(sumX, _mm256_mul_pd(dx, scale)), valid);
+                sumY = _mm256_blendv_pd(sumY, _mm256_add_pd(sumY, _mm256_mul_pd(dy, scale)), valid);
+            }
+
+            _mm256_storeu_pd(accelerationX + i, sumX);
+            _mm256_storeu_pd(accelerationY + i, sumY);
+        }
+        return i;
+    }
+
+#endif
+}
+
+void SimdKernels::integrate(ParticleStore& particles, size_t begin, size_t end, double deltaTime)
+{
+    const Real deltaTimeSquared = static_cast<Real>(deltaTime * deltaTime);
+
+#ifdef VERLET_X86
+    if (s_simdLevel == SimdLevel::AVX2) begin = integrateAVX2(particles, begin, end, deltaTimeSquared);
+    if (s_simdLevel >= SimdLevel::SSE2) begin = integrateSSE2(particles, begin, end, deltaTimeSquared);
+#endif
+
+    // Remainder that does not fill a whole vector
+    integrateScalar(particles, begin, end, deltaTimeSquared);
+}
+
+void SimdKernels::clampToBox(ParticleStore& particles, size_t begin, size_t end, Real minX, Real minY, Real maxX, Real maxY)
+{
+#ifdef VERLET_X86
+    if (s_simdLevel == SimdLevel::AVX2) begin = clampToBoxAVX2(particles, begin, end, minX, minY, maxX, maxY);
+    if (s_simdLevel >= SimdLevel::SSE2) begin = clampToBoxSSE2(particles, begin, end, minX, minY, maxX, maxY);
+#endif
+
+    for (size_t i = begin; i < end; i++) {
+        clampParticleToBox(particles.positionX(), particles.positionY(), particles.radius(), particles.isStatic(), i, minX, minY, maxX, maxY);
+    }
+}
+
+void SimdKernels::clampToBox(ParticleStore& particles, const uint32_t* indices, size_t count, Real minX, Real minY, Real maxX, Real maxY)
+{
+    Real* positionX = particles.positionX();
+    Real* positionY = particles.positionY();
+    const Real* radius = particles.radius();
+    const uint8_t* isStatic = particles.isStatic();
+
+    for (size_t i = 0; i < count; i++) clampParticleToBox(positionX, positionY, radius, isStatic, indices[i], minX, minY, maxX, maxY);
+}
+
+void SimdKernels::clampToCircle(ParticleStore& particles, size_t begin, size_t end, Real centerX, Real centerY, Real radius)
+{
+    const Real innerRadius = static_cast<Real>(radius * (1 - CIRCLE_REJECT_MARGIN));
+
+#ifdef VERLET_X86
+    if (s_simdLevel == SimdLevel::AVX2) begin = clampToCircleAVX2(particles, begin, end, centerX, centerY, radius, innerRadius);
+    if (s_simdLevel >= SimdLevel::SSE2) begin = clampToCircleSSE2(particles, begin, end, centerX, centerY, radius, innerRadius);
+#endif
+
+    for (size_t i = begin; i < end; i++) {
+        clampParticleToCircle(particles.positionX(), particles.positionY(), particles.radius(), particles.isStatic(), i, centerX, centerY, radius, innerRadius);
+    }
+}
+
+void SimdKernels::clampToCircle(ParticleStore& particles, const uint32_t* indices, size_t count, Real centerX, Real centerY, Real radius)
+{
+    const Real innerRadius = static_cast<Real>(radius * (1 - CIRCLE_REJECT_MARGIN));
+
+    Real* positionX = particles.positionX();
+    Real* positionY = particles.positionY();
+    const Real* particleRadius = particles.radius();
+    const uint8_t* isStatic = particles.isStatic();
+
+    for (size_t i = 0; i < count; i++) clampParticleToCircle(positionX, positionY, particleRadius, isStatic, indices[i], centerX, centerY, radius, innerRadius);
+}
+
+void SimdKernels::accelerate(ParticleStore& particles, size_t begin, size_t end, Real accelerationX, Real accelerationY)
+{
+#ifdef VERLET_X86
+    if (s_simdLevel == SimdLevel::AVX2) begin = accelerateAVX2(particles, begin, end, accelerationX, accelerationY);
+    if (s_simdLevel >= SimdLevel::SSE2) begin = accelerateSSE2(particles, begin, end, accelerationX, accelerationY);
+#endif
+
+    for (size_t i = begin; i < end; i++) accelerateParticle(particles.forceX(), particles.forceY(), particles.inverseMass(), i, accelerationX, accelerationY);
+}
+
+void SimdKernels::accelerate(ParticleStore& particles, const size_t* indices, size_t count, Real accelerationX, Real accelerationY)
+{
+    Real* forceX = particles.forceX();
+    Real* forceY = particles.forceY();
+    const Real* inverseMass = particles.inverseMass();
+
+    for (size_t i = 0; i < count; i++) accelerateParticle(forceX, forceY, inverseMass, indices[i], accelerationX, accelerationY);
+}
+
+void SimdKernels::applyDrag(ParticleStore& particles, size_t begin, size_t end, Real coefficient)
+{
+#ifdef VERLET_X86
+    if (s_simdLevel == SimdLevel::AVX2) begin = applyDragAVX2(particles, begin, end, coefficient);
+    if (s_simdLevel >= SimdLevel::SSE2) begin = applyDragSSE2(particles, begin, end, coefficient);
+#endif
+
+    for (size_t i = begin; i < end; i++) dragParticle(particles, i, coefficient);
+}
+
+void SimdKernels::applyDrag(ParticleStore& particles, const size_t* indices, size_t count, Real coefficient)
+{
+    for (size_t i = 0; i < count; i++) dragParticle(particles, indices[i], coefficient);
+}
+
+void SimdKernels::attract(ParticleStore& particles, size_t begin, size_t end, Real centerX, Real centerY, Real strength, Real softening)
+{
+    const Real softeningSquared = softening * softening;
+
+#ifdef VERLET_X86
+    if (s_simdLevel == SimdLevel::AVX2) begin = attractAVX2(particles, begin, end, centerX, centerY, strength, softeningSquared);
+    if (s_simdLevel >= SimdLevel::SSE2) begin = attractSSE2(particles, begin, end, centerX, centerY, strength, softeningSquared);
+#endif
+
+    for (size_t i = begin; i < end; i++) attractParticle(particles, i, centerX, centerY, strength, softeningSquared);
+}
+
+void SimdKernels::attract(ParticleStore& particles, const size_t* indices, size_t count, Real centerX, Real centerY, Real strength, Real softening)
+{
+    const Real softeningSquared = softening * softening;
+
+    for (size_t i = 0; i < count; i++) attractParticle(particles, indices[i], centerX, centerY, strength, softeningSquared);
+}
+
+void SimdKernels::sumAttraction(const Real* targetX, const Real* targetY, size_t count, const Real* sourceX, const Real* sourceY, const Real* sourceMass, size_t sourceCount,
+    Real softening, Real* accelerationX, Real* accelerationY)
+{
+    const Real softeningSquared = softening * softening;
+    size_t begin = 0;
+
+#ifdef VERLET_X86
+    if (s_simdLevel == SimdLevel::AVX2) begin = sumAttractionAVX2(targetX, targetY, begin, count, sourceX, sourceY, sourceMass, sourceCount, softeningSquared, accelerationX, accelerationY);
+    if (s_simdLevel >= SimdLevel::SSE2) begin = sumAttractionSSE2(targetX, targetY, begin, count, sourceX, sourceY, sourceMass, sourceCount, softeningSquared, accelerationX, accelerationY);
+#endif
+
+    for (size_t i = begin; i < count; i++) sumAttractionAt(targetX, targetY, i, sourceX, sourceY, sourceMass, sourceCount, softeningSquared, accelerationX, accelerationY);
+}
+
+SimdLevel SimdKernels::getSimdLevel()
+{
+    return s_simdLevel;
+}
+
+void SimdKernels::setSimdLevel(SimdLevel level)
+{
+    const SimdLevel supported = detectSimdLevel();
+    s_simdLevel = level > supported ? supported : level;
+}
+
+SimdLevel SimdKernels::detectSimdLevel()
+{
+#if defined(VERLET_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    const int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+
+    if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6) {
+        __cpuidex(info, 7, 0);
+        if (info[1] & (1 << 5)) return SimdLevel::AVX2;
+    }
+    return SimdLevel::SSE2;
+#elif defined(VERLET_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse2")) return SimdLevel::SSE2;
+    return SimdLevel::Scalar;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
@@ -0,0 +1,205 @@
+#pragma once
+#include "Particle.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace VerletPhysics {
+
+    /**
+     * Instruction set levels the batch kernels can be dispatched to.
+     */
+    enum class SimdLevel
+    {
+        Scalar, ///< Portable scalar loop.
+        SSE2,   ///< 128-bit SSE2 vectors.
+        AVX2    ///< 256-bit AVX2 vectors.
+    };
+
+    /**
+     * Batch kernels that stream over the arrays of a `ParticleStore`.
+     *
+     * Every kernel has a scalar fallback and x86 SSE2/AVX2 variants, processing two or four doubles at a
+     * time, or four or eight floats in single precision builds. The widest level supported by the
+     * running CPU is detected once and used by default. All variants perform the same floating point
+     * operations in the same order, so results are identical whichever level is selected.
+     */
+    struct SimdKernels
+    {
+        /**
+         * Integrates a range of particles with Verlet integration.
+         *
+         * Applies `x' = 2x - x_prev + F * invMass * dt^2` to every non-static particle in the
+         * range, shifts the current positions into the previous ones, and clears the accumulated
+         * forces of every particle in the range, static or not.
+         *
+         * @param particles The store holding the particles.
+         * @param begin Index of the first particle to integrate.
+         * @param end One past the index of the last particle to integrate.
+         * @param deltaTime The time step for the integration.
+         */
+        static void integrate(ParticleStore& particles, size_t begin, size_t end, double deltaTime);
+
+        /**
+         * Clamps a contiguous range of particles inside an axis-aligned box.
+         *
+         * Every non-static particle whose edge lies outside the box is moved back so it touches the
+         * matching side, exactly like `BoxedPositionConstraint`.
+         *
+         * @param particles The store holding the particles.
+         * @param begin Index of the first particle to clamp.
+         * @param end One past the index of the last particle to clamp.
+         * @param minX Minimum X-coordinate of the box.
+         * @param minY Minimum Y-coordinate of the box.
+         * @param maxX Maximum X-coordinate of the box.
+         * @param maxY Maximum Y-coordinate of the box.
+         */
+        static void clampToBox(ParticleStore& particles, size_t begin, size_t end, Real minX, Real minY, Real maxX, Real maxY);
+
+        /**
+         * Clamps an arbitrary list of particles inside an axis-aligned box, one particle at a time.
+         *
+         * @param particles The store holding the particles.
+         * @param indices Indices of the particles to clamp.
+         * @param count Number of indices.
+         */
+        static void clampToBox(ParticleStore& particles, const uint32_t* indices, size_t count, Real minX, Real minY, Real maxX, Real maxY);
+
+        /**
+         * Clamps a contiguous range of particles inside a circle.
+         *
+         * Every non-static particle whose edge lies outside the circle is moved back onto its rim,
+         * exactly like `EncircledPositionConstraint`. Particles comfortably inside are rejected by
+         * comparing squared distances, so only those near or beyond the rim pay for a square root.
+         *
+         * @param particles The store holding the particles.
+         * @param begin Index of the first particle to clamp.
+         * @param end One past the index of the last particle to clamp.
+         * @param centerX X-coordinate of the circle's center.
+         * @param centerY Y-coordinate of the circle's center.
+         * @param radius Radius of the circle.
+         */
+        static void clampToCircle(ParticleStore& particles, size_t begin, size_t end, Real centerX, Real centerY, Real radius);
+
+        /**
+         * Clamps an arbitrary list of particles inside a circle, one particle at a time.
+         *
+         * @param particles The store holding the particles.
+         * @param indices Indices of the particles to clamp.
+         * @param count Number of indices.
+         */
+        static void clampToCircle(ParticleStore& particles, const uint32_t* indices, size_t count, Real centerX, Real centerY, Real radius);
+
+        /**
+         * Adds a constant acceleration to a contiguous range of particles.
+         *
+         * Every particle with mass receives the force `a / invMass`, exactly like `ConstantAcceleration`.
+         *
+         * @param particles The store holding the particles.
+         * @param begin Index of the first particle to accelerate.
+         * @param end One past the index of the last particle to accelerate.
+         * @param accelerationX X-component of the acceleration.
+         * @param accelerationY Y-component of the acceleration.
+         */
+        static void accelerate(ParticleStore& particles, size_t begin, size_t end, Real accelerationX, Real accelerationY);
+
+        /**
+         * Adds a constant acceleration to an arbitrary list of particles, one particle at a time.
+         *
+         * @param particles The store holding the particles.
+         * @param indices Indices of the particles to accelerate.
+         * @param count Number of indices.
+         */
+        static void accelerate(ParticleStore& particles, const size_t* indices, size_t count, Real accelerationX, Real accelerationY);
+
+        /**
+         * Adds a linear drag force to a contiguous range of particles.
+         *
+         * Every particle receives the force `-coefficient * (x - x_prev)`, opposing its displacement
+         * over the last substep.
+         *
+         * @param particles The store holding the particles.
+         * @param begin Index of the first particle to slow down.
+         * @param end One past the index of the last particle to slow down.
+         * @param coefficient Force per unit of displacement.
+         */
+        static void applyDrag(ParticleStore& particles, size_t begin, size_t end, Real coefficient);
+
+        /**
+         * Adds a linear drag force to an arbitrary list of particles, one particle at a time.
+         *
+         * @param particles The store holding the particles.
+         * @param indices Indices of the particles to slow down.
+         * @param count Number of indices.
+         */
+        static void applyDrag(ParticleStore& particles, const size_t* indices, size_t count, Real coefficient);
+
+        /**
+         * Pulls a contiguous range of particles towards a point with a softened inverse-square law.
+         *
+         * Every particle with mass receives the force `strength * m * d / (|d|^2 + softening^2)^(3/2)`,
+         * where `d` points from the particle to the center. A negative strength repels.
+         *
+         * @param particles The store holding the particles.
+         * @param begin Index of the first particle to attract.
+         * @param end One past the index of the last particle to attract.
+         * @param centerX X-coordinate of the attracting point.
+         * @param centerY Y-coordinate of the attracting point.
+         * @param strength Acceleration at unit distance without softening.
+         * @param softening Length added in quadrature to every distance, keeping the force finite near the center.
+         */
+        static void attract(ParticleStore& particles, size_t begin, size_t end, Real centerX, Real centerY, Real strength, Real softening);
+
+        /**
+         * Pulls an arbitrary list of particles towards a point, one particle at a time.
+         *
+         * @param particles The store holding the particles.
+         * @param indices Indices of the particles to attract.
+         * @param count Number of indices.
+         */
+        static void attract(ParticleStore& particles, const size_t* indices, size_t count, Real centerX, Real centerY, Real strength, Real softening);
+
+        /**
+         * Sums the softened inverse-square attraction of a list of sources on a list of targets.
+         *
+         * Each target receives `sum_k m_k * d / (|d|^2 + softening^2)^(3/2)` over every source `k`,
+         * where `d` points from the target to the source. Sources sitting exactly on an unsoftened
+         * target are skipped. Targets are spread across the vector lanes while every lane walks the
+         * sources in order, so the sums match the scalar loop exactly.
+         *
+         * @param targetX X-coordinates of the targets.
+         * @param targetY Y-coordinates of the targets.
+         * @param count Number of targets.
+         * @param sourceX X-coordinates of the sources.
+         * @param sourceY Y-coordinates of the sources.
+         * @param sourceMass Masses of the sources.
+         * @param sourceCount Number of sources.
+         * @param softening Length added in quadrature to every distance.
+         * @param accelerationX Receives the X-component of every target's sum.
+         * @param accelerationY Receives the Y-component of every target's sum.
+         */
+        static void sumAttraction(const Real* targetX, const Real* targetY, size_t count, const Real* sourceX, const Real* sourceY, const Real* sourceMass, size_t sourceCount,
+            Real softening, Real* accelerationX, Real* accelerationY);
+
+        /**
+         * Gets the instruction set level the kernels currently dispatch to.
+         *
+         * @return The active SIMD level.
+         */
+        static SimdLevel getSimdLevel();
+
+        /**
+         * Selects the instruction set level the kernels dispatch to.
+         *
+         * @param level The requested level, lowered to the widest level the CPU supports.
+         */
+        static void setSimdLevel(SimdLevel level);
+
+        /**
+         * Detects the widest instruction set level supported by the running CPU.
+         *
+         * @return The supported SIMD level.
+         */
+        static SimdLevel detectSimdLevel();
+    };
+}
@@ -1,27 +1,38 @@
 #include "SimulationWorld.h"
+#include "SimdKernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <mutex>
 
 using namespace VerletPhysics;
 
-SimulationWorld::SimulationWorld(size_t steps, bool handleCollisions) :
-    c_handleCollisions(handleCollisions)
+SimulationWorld::SimulationWorld(size_t steps, bool handleCollisions, size_t threadCount) :
+    c_handleCollisions(handleCollisions),
+    m_threadPool(threadCount)
 {
     m_steps = steps;
 }
 
 VerletPhysics::SimulationWorld::~SimulationWorld()
 {
-    for (Particle* ptr : m_particles) {
-        delete ptr;
-    }
-    m_particles.clear();
 }
 
-Particle* SimulationWorld::addParticle(Vector2 initalPosition, double radius)
+Particle* SimulationWorld::addParticle(Vector2 initalPosition, Real radius)
+{
+    return m_particles.add(initalPosition, radius);
+}
+
+bool SimulationWorld::addParticles(const std::vector<Vector2>& positions, const std::vector<Real>& radii, std::vector<Particle*>& handles)
 {
-    Particle* particle = new Particle(initalPosition, radius);
-    m_particles.push_back(particle);
+    return m_particles.add(positions, radii, handles);
+}
 
-    return particle;
+void SimulationWorld::removeParticles(const std::vector<Particle*>& handles)
+{
+    if (m_particles.remove(handles, m_remap) == 0) return;
+    remapParticles();
 }
 
 void VerletPhysics::SimulationWorld::addGenerator(ForceGenerator* generator)
@@ -31,55 +42,456 @@ void VerletPhysics::SimulationWorld::addGenerator(ForceGenerator* generator)
 
 void VerletPhysics::SimulationWorld::addConstraint(Constraint* constraint)
 {
+    if (PairedParticleConstraint* paired = dynamic_cast<PairedParticleConstraint*>(constraint)) {
+        m_distanceSolver.addConstraint(paired);
+        return;
+    }
+    if (BoxedPositionConstraint* box = dynamic_cast<BoxedPositionConstraint*>(constraint)) {
+        m_positionSolver.addConstraint(box);
+        return;
+    }
+    if (EncircledPositionConstraint* circle = dynamic_cast<EncircledPositionConstraint*>(constraint)) {
+        m_positionSolver.addConstraint(circle);
+        return;
+    }
+
     m_constraints.push_back(constraint);
 }
 
 void SimulationWorld::update(double deltaTime)
 {
-    for (size_t i = 0; i < m_steps; i++) {
+    const size_t steps = m_steps;
+    const double substepTime = deltaTime / steps;
+    const bool adaptive = m_substepController.isEnabled();
+
+    VERLET_PROFILE(m_stats.reset(steps));
+
+    // Islands disturbed through particle handles wake first, then every phase skips what still sleeps
+    m_sleepManager.processWakeRequests(m_particles);
+    if (m_particles.partitionSleeping(m_remap)) remapParticles();
+
+    if (adaptive) {
+        // Verlet velocities are implied by the last displacement, so they follow the substep length
+        if (m_substepTime > 0 && substepTime != m_substepTime) rescaleVelocities(substepTime / m_substepTime);
+        m_substepTime = substepTime;
+        m_substepController.beginUpdate();
+    }
+
+    for (size_t i = 0; i < steps; i++) {
     
-        for (ForceGenerator* generator : m_generators) generator->applyForces();
+        runPhase(i, SimulationPhase::Generators, [this] { applyGenerators(); });
+
+        runPhase(i, SimulationPhase::Integration, [this, substepTime] { integrateParticles(substepTime); });
 
-        for (Particle* particle : m_particles)         particle->integrate(deltaTime / m_steps);
+        if (c_handleCollisions) runPhase(i, SimulationPhase::Collisions, [this] { handleCollisions(); });
 
-        if (c_handleCollisions) handleCollisions();
+        runPhase(i, SimulationPhase::Constraints, [this] { solveConstraints(); });
 
-        for (Constraint* constraint : m_constraints)   constraint->handleConstraint();
+        if (adaptive) {
+            runPhase(i, SimulationPhase::Substepping, [this] {
+                m_substepController.addSubstep(m_distanceSolver.measureError(m_particles, m_threadPool), measureDisplacement());
+            });
+        }
 
     }
 
+    if (m_sleepManager.isEnabled() && steps > 0) {
+        runPhase(steps - 1, SimulationPhase::Sleeping, [this] { m_sleepManager.update(m_particles, m_distanceSolver); });
+    }
+
+    if (steps > 0 && m_particleSorter.update(m_particles)) {
+        runPhase(steps - 1, SimulationPhase::Sorting, [this] { sortParticles(); });
+    }
+
+    m_lastSteps = steps;
+    if (adaptive) m_steps = m_substepController.chooseNext(steps);
+
+    m_particles.touchPositions();
+
+}
+
+void SimulationWorld::queryPoint(Vector2 point, std::vector<Particle*>& results)
+{
+    queryRadius(point, 0, results);
+}
+
+void SimulationWorld::queryBox(Vector2 minimum, Vector2 maximum, std::vector<Particle*>& results)
+{
+    m_spatialIndex.refresh(m_particles, m_distanceSolver.getConstraints());
+    m_spatialIndex.queryBox(m_particles, minimum, maximum, results);
+}
+
+void SimulationWorld::queryRadius(Vector2 centre, Real radius, std::vector<Particle*>& results)
+{
+    m_spatialIndex.refresh(m_particles, m_distanceSolver.getConstraints());
+    m_spatialIndex.queryCircle(m_particles, centre, radius, results);
+}
+
+bool SimulationWorld::rayCast(Vector2 origin, Vector2 direction, Real maxDistance, RayHit& hit)
+{
+    m_spatialIndex.refresh(m_particles, m_distanceSolver.getConstraints());
+    return m_spatialIndex.rayCast(m_particles, origin, direction, maxDistance, hit);
+}
+
+void SimulationWorld::queryConstraints(Vector2 start, Vector2 end, Real leeway, std::vector<PairedParticleConstraint*>& results)
+{
+    m_spatialIndex.refresh(m_particles, m_distanceSolver.getConstraints());
+    m_spatialIndex.queryConstraints(m_particles, m_distanceSolver.getConstraints(), start, end, leeway, results);
+}
+
+void SimulationWorld::sortParticles()
+{
+    m_particleSorter.computeOrder(m_particles, m_threadPool, m_sortOrder);
+    m_particles.reorder(m_sortOrder, m_remap);
+    remapParticles();
+}
+
+void SimulationWorld::remapParticles()
+{
+    // Each of these patches only what the removed and moved particles touch
+    for (ForceGenerator* generator : m_generators) generator->remapParticles(m_remap);
+    m_distanceSolver.remapParticles(m_remap);
+    m_positionSolver.remapParticles(m_remap);
+
+    m_constraints.erase(std::remove_if(m_constraints.begin(), m_constraints.end(),
+        [this](Constraint* constraint) { return !constraint->remapParticles(m_remap); }), m_constraints.end());
+
+    m_sleepManager.remapParticles(m_remap);
+    m_sweepAndPrune.remapParticles(m_remap);
+}
+
+void SimulationWorld::setAdaptiveSubstepsEnabled(bool enabled)
+{
+    m_substepController.setEnabled(enabled);
+    m_substepTime = 0;
+    if (enabled) m_steps = m_substepController.clamp(m_steps);
+}
+
+void SimulationWorld::setSubstepRange(size_t minSteps, size_t maxSteps)
+{
+    m_substepController.setRange(minSteps, maxSteps);
+    if (m_substepController.isEnabled()) m_steps = m_substepController.clamp(m_steps);
+}
+
+Real SimulationWorld::measureDisplacement()
+{
+    const Real* positionX = m_particles.positionX();
+    const Real* positionY = m_particles.positionY();
+    const Real* previousX = m_particles.previousX();
+    const Real* previousY = m_particles.previousY();
+    const Real* radius = m_particles.radius();
+    const uint8_t* isStatic = m_particles.isStatic();
+
+    // Squared displacement over squared radius, so only the final result needs a square root
+    Real largest = 0;
+    std::mutex largestMutex;
+
+    m_threadPool.parallelFor(0, m_particles.getAwakeCount(), 4096, [&](size_t begin, size_t end) {
+        Real rangeLargest = 0;
+        for (size_t i = begin; i < end; i++) {
+            if (isStatic[i] || !(radius[i] > 0)) continue;
+
+            const Real dx = positionX[i] - previousX[i];
+            const Real dy = positionY[i] - previousY[i];
+            rangeLargest = std::max(rangeLargest, (dx * dx + dy * dy) / (radius[i] * radius[i]));
+        }
+
+        std::lock_guard<std::mutex> lock(largestMutex);
+        largest = std::max(largest, rangeLargest);
+    });
+
+    return std::sqrt(largest);
+}
+
+void SimulationWorld::rescaleVelocities(double factor)
+{
+    const Real scale = static_cast<Real>(factor);
+    Real* positionX = m_particles.positionX();
+    Real* positionY = m_particles.positionY();
+    Real* previousX = m_particles.previousX();
+    Real* previousY = m_particles.previousY();
+
+    m_threadPool.parallelFor(0, m_particles.getAwakeCount(), 4096, [=](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            previousX[i] = positionX[i] - (positionX[i] - previousX[i]) * scale;
+            previousY[i] = positionY[i] - (positionY[i] - previousY[i]) * scale;
+        }
+    });
+}
+
+void SimulationWorld::recordPhase(size_t substep, SimulationPhase phase, TraceRecorder::Clock::time_point start, TraceRecorder::Clock::time_point end)
+{
+    const double seconds = std::chrono::duration<double>(end - start).count();
+    m_stats.substeps[substep].get(phase) += seconds;
+    m_stats.total.get(phase) += seconds;
+
+    if (m_traceRecorder) m_traceRecorder->record(getPhaseName(phase), start, end, substep);
+}
+
+void SimulationWorld::applyGenerators()
+{
+    // Generators run one after another since two of them may push the same particle
+    for (ForceGenerator* generator : m_generators) {
+        generator->prepare(m_threadPool);
+        const size_t workSize = generator->getParallelWorkSize();
+
+        if (workSize == 0) {
+            generator->applyForces();
+            continue;
+        }
+
+        m_threadPool.parallelFor(0, workSize, 2048, [generator](size_t begin, size_t end) {
+            generator->applyForcesToRange(begin, end);
+        });
+    }
+}
+
+void SimulationWorld::integrateParticles(double deltaTime)
+{
+    // Sleeping particles are stored after every awake one
+    m_threadPool.parallelFor(0, m_particles.getAwakeCount(), 4096, [this, deltaTime](size_t begin, size_t end) {
+        SimdKernels::integrate(m_particles, begin, end, deltaTime);
+    });
 }
 
 void SimulationWorld::handleCollisions()
 {
-    for (size_t i = 0; i < m_particles.size(); i++)
+    if (m_continuousCollision.isEnabled()) {
+        [[maybe_unused]] const size_t impacts = m_continuousCollision.resolve(m_particles, m_threadPool);
+        VERLET_PROFILE(m_stats.sweptImpacts += impacts);
+    }
+
+    if (m_broadPhase == BroadPhase::SweepAndPrune) {
+        sweepCollisions();
+        return;
+    }
+
+    m_grid.rebuild(m_particles, 0, m_particles.getAwakeCount());
+
+    const size_t columns = m_grid.getColumns();
+    const size_t rows = m_grid.getRows();
+
+    std::atomic<size_t> pairTests(0);
+    std::atomic<size_t> resolved(0);
+
+    // Only the contacts of the last substep are used to build islands
+    const bool collectContacts = m_sleepManager.isEnabled();
+    if (collectContacts) m_sleepManager.clearContacts();
+
+    // A cell touches its own row and the next, and its own column and both neighbours, so cells
+    // three columns or two rows apart never share a particle and can be processed concurrently
+    for (size_t pass = 0; pass < 6; pass++)
+    {
+        const size_t firstColumn = pass % 3;
+        const size_t firstRow = pass / 3;
+        if (firstRow >= rows) continue;
+
+        m_threadPool.parallelFor(0, (rows - firstRow + 1) / 2, 1, [this, columns, firstColumn, firstRow, collectContacts, &pairTests, &resolved](size_t begin, size_t end) {
+            CollisionCounters counters;
+            std::vector<SleepManager::Contact> contacts;
+            for (size_t i = begin; i < end; i++) {
+                for (size_t column = firstColumn; column < columns; column += 3) collideCell(column, firstRow + i * 2, counters, collectContacts ? &contacts : nullptr);
+            }
+            if (!contacts.empty()) m_sleepManager.addContacts(contacts);
+
+            VERLET_PROFILE(pairTests.fetch_add(counters.pairTests, std::memory_order_relaxed));
+            VERLET_PROFILE(resolved.fetch_add(counters.resolved, std::memory_order_relaxed));
+        });
+    }
+
+    VERLET_PROFILE(m_stats.pairTests += pairTests.load());
+    VERLET_PROFILE(m_stats.collisionsResolved += resolved.load());
+
+    collideSleeping(collectContacts);
+}
+
+void SimulationWorld::setBroadPhase(BroadPhase broadPhase)
+{
+    m_broadPhase = broadPhase;
+
+    // The kept order is stale once the other strategy has run for a while
+    m_sweepAndPrune.invalidate();
+}
+
+void SimulationWorld::sweepCollisions()
+{
+    m_sweepAndPrune.update(m_particles, m_threadPool);
+
+    const Real* positionX = m_particles.positionX();
+    const Real* positionY = m_particles.positionY();
+    const Real* radius = m_particles.radius();
+
+    const bool collectContacts = m_sleepManager.isEnabled();
+    if (collectContacts) m_sleepManager.clearContacts();
+    std::vector<SleepManager::Contact> contacts;
+
+    // Pairs share particles, so they are resolved one after another; positions may have moved since the sweep
+    for (const SweepAndPrune::Pair& pair : m_sweepAndPrune.getPairs()) {
+        const size_t i = pair.first;
+        const size_t j = pair.second;
+
+        Real radii = radius[i] + radius[j];
+        Real offsetX = positionX[j] - positionX[i];
+        Real offsetY = positionY[j] - positionY[i];
+        if (offsetX * offsetX + offsetY * offsetY >= radii * radii) continue;
+
+        if (collectContacts) contacts.emplace_back(pair);
+        resolveCollision(i, j);
+        VERLET_PROFILE(m_stats.collisionsResolved++);
+    }
+    if (!contacts.empty()) m_sleepManager.addContacts(contacts);
+
+    VERLET_PROFILE(m_stats.pairTests += m_sweepAndPrune.getPairs().size());
+
+    collideSleeping(collectContacts);
+}
+
+void SimulationWorld::collideSleeping(bool collectContacts)
+{
+    const size_t awakeCount = m_particles.getAwakeCount();
+    if (awakeCount == m_particles.size()) return;
+
+    if (m_particles.getLayoutVersion() != m_sleepingLayout || awakeCount != m_sleepingBegin || m_particles.size() != m_sleepingEnd) {
+        m_sleepingGrid.rebuild(m_particles, awakeCount, m_particles.size());
+        m_sleepingLayout = m_particles.getLayoutVersion();
+        m_sleepingBegin = awakeCount;
+        m_sleepingEnd = m_particles.size();
+    }
+
+    const Real* positionX = m_particles.positionX();
+    const Real* positionY = m_particles.positionY();
+    const Real* radius = m_particles.radius();
+    const uint8_t* isStatic = m_particles.isStatic();
+
+    std::atomic<size_t> pairTests(0);
+    std::atomic<size_t> resolved(0);
+
+    // Only the awake particle of each pair moves, so every one can be handled on its own thread
+    m_threadPool.parallelFor(0, awakeCount, 1024, [&](size_t begin, size_t end) {
+        CollisionCounters counters;
+        std::vector<SleepManager::Contact> contacts;
+
+        for (size_t i = begin; i < end; i++) {
+            if (isStatic[i]) continue;
+
+            // Sleeping particles sit in the cell of their centre and are no wider than a cell
+            const double reach = radius[i] + m_sleepingGrid.getCellSize() * 0.5;
+            size_t firstColumn, lastColumn, firstRow, lastRow;
+            if (!m_sleepingGrid.columnRange(positionX[i] - reach, positionX[i] + reach, firstColumn, lastColumn)) continue;
+            if (!m_sleepingGrid.rowRange(positionY[i] - reach, positionY[i] + reach, firstRow, lastRow)) continue;
+
+            for (size_t row = firstRow; row <= lastRow; row++) {
+                for (size_t column = firstColumn; column <= lastColumn; column++) {
+                    for (const size_t* entry = m_sleepingGrid.cellBegin(column, row); entry != m_sleepingGrid.cellEnd(column, row); entry++) {
+                        const size_t j = *entry;
+                        VERLET_PROFILE(counters.pairTests++);
+
+                        Real radii = radius[i] + radius[j];
+                        Real offsetX = positionX[j] - positionX[i];
+                        Real offsetY = positionY[j] - positionY[i];
+                        if (offsetX * offsetX + offsetY * offsetY >= radii * radii) continue;
+
+                        VERLET_PROFILE(counters.resolved++);
+                        if (collectContacts) contacts.emplace_back(static_cast<uint32_t>(i), static_cast<uint32_t>(j));
+                        resolveCollision(i, j);
+                    }
+                }
+            }
+        }
+        if (!contacts.empty()) m_sleepManager.addContacts(contacts);
+
+        VERLET_PROFILE(pairTests.fetch_add(counters.pairTests, std::memory_order_relaxed));
+        VERLET_PROFILE(resolved.fetch_add(counters.resolved, std::memory_order_relaxed));
+    });
+
+    VERLET_PROFILE(m_stats.pairTests += pairTests.load());
+    VERLET_PROFILE(m_stats.collisionsResolved += resolved.load());
+}
+
+void SimulationWorld::collideCell(size_t column, size_t row, [[maybe_unused]] CollisionCounters& counters, std::vector<SleepManager::Contact>* contacts)
+{
+    const Real* positionX = m_particles.positionX();
+    const Real* positionY = m_particles.positionY();
+    const Real* radius = m_particles.radius();
+    const uint8_t* isStatic = m_particles.isStatic();
+
+    const size_t* cellEnd = m_grid.cellEnd(column, row);
+
+    // Forward neighbours, so every pair of adjacent cells is visited exactly once
+    const long long offsets[4][2] = { { 1, 0 }, { -1, 1 }, { 0, 1 }, { 1, 1 } };
+
+    for (const size_t* a = m_grid.cellBegin(column, row); a != cellEnd; a++)
     {
-        for (size_t j = i+1; j < m_particles.size(); j++)
+        const size_t i = *a;
+
+        for (size_t neighbour = 0; neighbour <= 4; neighbour++)
         {
-            Particle* particleA = m_particles[i];
-            Particle* particleB = m_particles[j];
+            const size_t* begin = a + 1;
+            const size_t* end = cellEnd;
+
+            if (neighbour > 0) {
+                const long long x = static_cast<long long>(column) + offsets[neighbour - 1][0];
+                const long long y = static_cast<long long>(row) + offsets[neighbour - 1][1];
+                if (x < 0 || y < 0 || x >= static_cast<long long>(m_grid.getColumns()) || y >= static_cast<long long>(m_grid.getRows())) continue;
+
+                begin = m_grid.cellBegin(static_cast<size_t>(x), static_cast<size_t>(y));
+                end = m_grid.cellEnd(static_cast<size_t>(x), static_cast<size_t>(y));
+            }
+
+            for (const size_t* b = begin; b != end; b++)
+            {
+                const size_t j = *b;
 
-            // if the two particles are colliding then resolve collision
-            double distance = VectorMath::magnitude(particleB->getPosition() - particleA->getPosition());
-            if (distance >= particleA->getRadius() + particleB->getRadius()) continue;
+                // Neither particle can move, which skips most pairs inside a sleeping pile
+                if (isStatic[i] && isStatic[j]) continue;
+                VERLET_PROFILE(counters.pairTests++);
 
-            resolveCollision(particleA, particleB);
-        
+                // if the two particles are colliding then resolve collision
+                Real radii = radius[i] + radius[j];
+                Real offsetX = positionX[j] - positionX[i];
+                Real offsetY = positionY[j] - positionY[i];
+                if (offsetX * offsetX + offsetY * offsetY >= radii * radii) continue;
+
+                VERLET_PROFILE(counters.resolved++);
+                if (contacts) contacts->emplace_back(static_cast<uint32_t>(i), static_cast<uint32_t>(j));
+                resolveCollision(i, j);
+            }
         }
     }
 }
 
-void SimulationWorld::resolveCollision(Particle* particleA, Particle* particleB)
+void SimulationWorld::solveConstraints()
 {
-    Vector2 particleVector = particleB->getPosition() - particleA->getPosition();
-    double distance = VectorMath::magnitude(particleVector);
-    double overlap = distance - particleA->getRadius() - particleB->getRadius();
+    [[maybe_unused]] const size_t corrected = m_distanceSolver.solve(m_particles, m_threadPool);
+    VERLET_PROFILE(m_stats.constraintsCorrected += corrected);
+
+    m_positionSolver.solve(m_particles);
+
+    for (Constraint* constraint : m_constraints)   constraint->handleConstraint();
+}
+
+void SimulationWorld::resolveCollision(size_t particleA, size_t particleB)
+{
+    Real* positionX = m_particles.positionX();
+    Real* positionY = m_particles.positionY();
+    const Real* radius = m_particles.radius();
+    const uint8_t* isStatic = m_particles.isStatic();
+
+    Vector2 particleVector = Vector2(positionX[particleB] - positionX[particleA], positionY[particleB] - positionY[particleA]);
+    Real distance = VectorMath::magnitude(particleVector);
+    Real overlap = distance - radius[particleA] - radius[particleB];
 
     Vector2 collisionNormal = VectorMath::normalize(particleVector);
-    double correctionAmount = overlap * 0.5;
+    Real correctionAmount = overlap * Real(0.5);
 
     // Move particleA and particleB away from each other along the collision normal
-    particleA->updatePosition(particleA->getPosition() + collisionNormal * correctionAmount);
-    particleB->updatePosition(particleB->getPosition() - collisionNormal * correctionAmount);
+    if (!isStatic[particleA]) {
+        positionX[particleA] += collisionNormal.x() * correctionAmount;
+        positionY[particleA] += collisionNormal.y() * correctionAmount;
+    }
+    if (!isStatic[particleB]) {
+        positionX[particleB] -= collisionNormal.x() * correctionAmount;
+        positionY[particleB] -= collisionNormal.y() * correctionAmount;
+    }
 
 }
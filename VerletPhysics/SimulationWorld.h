@@ -3,10 +3,34 @@
 #include "Particle.h"
 #include "ForceGeneration.h"
 #include "Contraint.h"
+#include "DistanceConstraintSolver.h"
+#include "PositionConstraintSolver.h"
+#include "SleepManager.h"
+#include "ContinuousCollision.h"
+#include "ParticleSorter.h"
+#include "SubstepController.h"
+#include "SpatialGrid.h"
+#include "SweepAndPrune.h"
+#include "SpatialIndex.h"
+#include "ThreadPool.h"
+#include "Profiling.h"
+#include "ObjectArena.h"
 
+#include <cstddef>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace VerletPhysics {
+    /**
+     * Strategies for finding the particle pairs that may collide.
+     */
+    enum class BroadPhase
+    {
+        UniformGrid,   ///< Buckets particles into cells sized for the largest one. Best when radii are similar.
+        SweepAndPrune  ///< Sorts particles along one axis and sweeps for overlaps. Best when radii vary widely.
+    };
+
     /**
      * Represents a simulation world for Verlet physics.
      *
@@ -15,12 +39,39 @@ namespace VerletPhysics {
      */
     class SimulationWorld
     {
-        std::vector<Particle*> m_particles;        ///< Collection of particles in the simulation.
+        ParticleStore m_particles;                 ///< Structure-of-arrays storage for the particles in the simulation.
         std::vector<ForceGenerator*> m_generators; ///< Collection of force generators.
-        std::vector<Constraint*> m_constraints;    ///< Collection of constraints.
+        std::vector<Constraint*> m_constraints;    ///< Constraints of types without a batched solver.
+        DistanceConstraintSolver m_distanceSolver; ///< Graph-coloured solver for every paired particle constraint.
+        PositionConstraintSolver m_positionSolver; ///< Batched solver for every box and circle constraint.
 
         const bool c_handleCollisions; ///< Flag indicating whether collision handling is enabled.
-        size_t m_steps;                ///< Number of simulation steps.
+        size_t m_steps;                ///< Number of simulation steps the next update performs.
+        size_t m_lastSteps = 0;        ///< Number of simulation steps the last update performed.
+        double m_substepTime = 0;      ///< Length of the last substep, while adaptive substepping is enabled.
+
+        ThreadPool m_threadPool;                   ///< Persistent workers shared by every phase of every substep.
+        BroadPhase m_broadPhase = BroadPhase::UniformGrid; ///< Strategy used to find colliding pairs.
+        SpatialGrid m_grid;                        ///< Broad phase grid of the awake particles, rebuilt once per substep.
+        SpatialGrid m_sleepingGrid;                ///< Grid of the sleeping particles, rebuilt when they change.
+        uint64_t m_sleepingLayout = UINT64_MAX;    ///< Layout version of the store when `m_sleepingGrid` was built.
+        size_t m_sleepingBegin = 0;                ///< Awake particle count when `m_sleepingGrid` was built.
+        size_t m_sleepingEnd = 0;                  ///< Particle count when `m_sleepingGrid` was built.
+        SweepAndPrune m_sweepAndPrune;             ///< Sorted broad phase, re-sorted once per substep.
+        SpatialIndex m_spatialIndex;               ///< Index answering spatial queries, rebuilt on demand.
+        ContinuousCollision m_continuousCollision; ///< Sweeps fast particles before the discrete collision pass.
+        SleepManager m_sleepManager;               ///< Tracks islands of particles and puts settled ones to sleep.
+        SubstepController m_substepController;     ///< Chooses the substep count of each update when adaptive.
+        ParticleSorter m_particleSorter;           ///< Decides when particles are reordered along a Morton curve.
+        std::vector<uint32_t> m_sortOrder;         ///< Scratch order of the last sort.
+        ParticleRemap m_remap;                     ///< Scratch description of the last sort or removal.
+
+        SimulationStats m_stats;                   ///< Statistics of the last update, filled in profiling builds.
+        TraceRecorder* m_traceRecorder = nullptr;  ///< Optional recorder receiving an event per phase per substep.
+
+        ObjectArena m_arena;                       ///< Owns every generator and constraint created through the world.
+
+        friend struct WorldSnapshot;
 
     public:
         /**
@@ -28,8 +79,10 @@ namespace VerletPhysics {
          *
          * @param steps Number of simulation steps to perform per update.
          * @param handleCollisions Flag indicating whether collision handling should be enabled.
+         * @param threadCount Number of threads to simulate with, including the calling thread.
+         *                    Zero selects the hardware concurrency.
          */
-        SimulationWorld(size_t steps, bool handleCollisions);
+        SimulationWorld(size_t steps, bool handleCollisions, size_t threadCount = 1);
 
         /**
          * Destroys the SimulationWorld object and cleans up allocated resources.
@@ -43,7 +96,32 @@ namespace VerletPhysics {
          * @param radius The radius of the particle.
          * @return Pointer to the created Particle object.
          */
-        Particle* addParticle(Vector2 initialPosition, double radius);
+        Particle* addParticle(Vector2 initialPosition, Real radius);
+
+        /**
+         * Adds a batch of particles to the simulation world, growing the store once for all of them.
+         *
+         * @param positions The initial position of every particle.
+         * @param radii The radius of every particle, exactly one per position.
+         * @param handles Receives the handle of every created particle, appended in the order given.
+         * @return `false`, adding nothing, if `positions` and `radii` differ in size.
+         */
+        bool addParticles(const std::vector<Vector2>& positions, const std::vector<Real>& radii, std::vector<Particle*>& handles);
+
+        /**
+         * Removes a batch of particles from the simulation world.
+         *
+         * Particles from the end of the store move into the gaps, so other particles' indices change.
+         * The removed particles are unsubscribed from every generator and constraint owned by the
+         * world, and paired particle constraints that lose a particle are disabled and dropped. The
+         * cost grows with the number of particles removed and the subscriptions and constraints they
+         * and the particles moved into their place have, not with the size of the world. Custom
+         * generators and constraints are remapped through their `remapParticles` override. Handles of
+         * removed particles are reused by later additions and must not be used afterwards.
+         *
+         * @param handles Handles of the particles to remove. Duplicates are ignored.
+         */
+        void removeParticles(const std::vector<Particle*>& handles);
 
         /**
          * Adds a force generator to the simulation world.
@@ -55,10 +133,55 @@ namespace VerletPhysics {
         /**
          * Adds a constraint to the simulation world.
          *
+         * Constraints are solved in batches of their concrete type: paired particle constraints first,
+         * by a parallel, graph-coloured solver, then box constraints, then circle constraints. Constraints
+         * of any other type are processed last, in insertion order.
+         *
          * @param constraint Pointer to the Constraint object to be added.
          */
         void addConstraint(Constraint* constraint);
 
+        /**
+         * Creates a force generator owned by the world and adds it to the simulation.
+         *
+         * Generators are bump-allocated next to others of the same type and all released together
+         * when the world is destroyed.
+         *
+         * @param args Arguments forwarded to the generator's constructor.
+         * @return Pointer to the new generator, valid for the lifetime of the world.
+         */
+        template <typename T, typename... Args>
+        T* emplaceGenerator(Args&&... args)
+        {
+            static_assert(std::is_base_of<ForceGenerator, T>::value, "emplaceGenerator requires a ForceGenerator");
+
+            T* generator = m_arena.create<T>(std::forward<Args>(args)...);
+            m_generators.push_back(generator);
+            return generator;
+        }
+
+        /**
+         * Creates a constraint owned by the world and adds it to the simulation.
+         *
+         * Constraints are bump-allocated next to others of the same type and all released together
+         * when the world is destroyed.
+         *
+         * @param args Arguments forwarded to the constraint's constructor.
+         * @return Pointer to the new constraint, valid for the lifetime of the world.
+         */
+        template <typename T, typename... Args>
+        T* emplaceConstraint(Args&&... args)
+        {
+            static_assert(std::is_base_of<Constraint, T>::value, "emplaceConstraint requires a Constraint");
+
+            T* constraint = m_arena.create<T>(std::forward<Args>(args)...);
+            if constexpr (std::is_base_of<PairedParticleConstraint, T>::value) m_distanceSolver.addConstraint(constraint);
+            else if constexpr (std::is_base_of<BoxedPositionConstraint, T>::value) m_positionSolver.addConstraint(constraint);
+            else if constexpr (std::is_base_of<EncircledPositionConstraint, T>::value) m_positionSolver.addConstraint(constraint);
+            else m_constraints.push_back(constraint);
+            return constraint;
+        }
+
         /**
          * Updates the simulation world for a given time step.
          *
@@ -66,19 +189,387 @@ namespace VerletPhysics {
          */
         void update(double deltaTime);
 
-    private:
+        /**
+         * Applies every force generator, splitting those that support it across threads.
+         *
+         * This and the following phase methods make up a single substep of `update`, which runs
+         * them in order. They are public so individual phases can be driven and measured on their own.
+         */
+        void applyGenerators();
+
+        /**
+         * Integrates every particle, split into ranges across threads.
+         *
+         * @param deltaTime The time step for the integration.
+         */
+        void integrateParticles(double deltaTime);
+
         /**
          * Handles collisions between particles in the simulation world.
+         *
+         * With the uniform grid, rebuilds the grid and then only tests pairs of particles in neighbouring
+         * cells. Cells are visited in six interleaved passes whose cells never share a particle, so each
+         * pass runs across threads. With sweep and prune, the candidate pairs are found across threads
+         * and resolved in sweep order. Either way the result is identical for any thread count.
+         * With continuous collision detection enabled, fast particles are swept first.
          */
         void handleCollisions();
 
+        /**
+         * Enables or disables continuous collision detection for fast particles.
+         *
+         * A particle moving further than a fraction of its radius in one substep can pass straight
+         * through another between two collision passes. With this enabled, such particles are swept
+         * along their path before every collision pass, stopped where they first touch another
+         * particle and keep only the part of their velocity that slides past it. This lets fast
+         * scenes run with far fewer substeps. Disabled by default, and only used when collisions are.
+         *
+         * @param enabled `true` to sweep fast particles.
+         */
+        void setContinuousCollisionsEnabled(bool enabled) { m_continuousCollision.setEnabled(enabled); }
+
+        /**
+         * Sets how far a particle has to move in one substep to be swept.
+         *
+         * @param threshold Displacement as a fraction of the particle's radius. Lower values sweep
+         *                  more particles; half the radius by default.
+         */
+        void setContinuousCollisionThreshold(Real threshold) { m_continuousCollision.setThreshold(threshold); }
+
+        /**
+         * Selects the strategy used to find the particle pairs that may collide.
+         *
+         * The uniform grid is the default and the faster choice while particle radii are similar.
+         * Sweep and prune does not depend on particle size, so it wins once a few large particles
+         * would force grid cells far larger than most particles.
+         *
+         * @param broadPhase The strategy to use from the next substep on.
+         */
+        void setBroadPhase(BroadPhase broadPhase);
+
+        /**
+         * Gets the strategy used to find the particle pairs that may collide.
+         *
+         * @return The selected broad phase.
+         */
+        BroadPhase getBroadPhase() const { return m_broadPhase; }
+
+        /**
+         * Solves every enabled constraint once, one batch per constraint type.
+         */
+        void solveConstraints();
+
+        /**
+         * Enables or disables putting settled islands of particles to sleep.
+         *
+         * Particles in contact or joined by paired constraints form islands. Once every particle of an
+         * island has rested for long enough, the island is skipped by every phase until a moving
+         * particle touches it, one of its particles is moved through its handle or it is woken
+         * explicitly. Disabling sleeping wakes every island.
+         * Sleeping is disabled by default.
+         *
+         * @param enabled `true` to let settled islands fall asleep.
+         */
+        void setSleepingEnabled(bool enabled) { m_sleepManager.setEnabled(m_particles, enabled); }
+
+        /**
+         * Sets when an island is considered settled enough to sleep.
+         *
+         * @param threshold Distance a particle may move per substep and still count as resting.
+         * @param frames Number of consecutive updates every particle of an island has to rest for.
+         */
+        void setSleepThreshold(Real threshold, size_t frames) { m_sleepManager.setThreshold(threshold, frames); }
+
+        /**
+         * Wakes the island a particle belongs to.
+         *
+         * Moving or unpinning a sleeping particle through its handle wakes its island at the start of
+         * the next update, but pushing it does not; call this first.
+         *
+         * @param particle The particle to wake, along with the rest of its island.
+         */
+        void wakeParticle(Particle* particle) { m_sleepManager.wakeIsland(m_particles, particle->getIndex()); }
+
+        /**
+         * Wakes every sleeping island.
+         */
+        void wakeAll() { m_sleepManager.wakeAll(m_particles); }
+
+        /**
+         * Gets the number of particles currently asleep.
+         *
+         * @return The sleeping particle count.
+         */
+        size_t getSleepingCount() const { return m_sleepManager.getSleepingCount(); }
+
+        /**
+         * Enables or disables choosing the substep count of every update adaptively.
+         *
+         * After each substep the world measures the residual stretch of its distance constraints and
+         * the largest distance a particle moved. Once an update finishes, the next one gets more
+         * substeps if either exceeded its tolerance, or one fewer if both stayed well below, always
+         * within the substep range. Particle velocities are rescaled whenever the substep length
+         * changes, so the count can change between updates without disturbing the motion.
+         * Disabled by default, in which case every update performs the substeps given at construction.
+         *
+         * @param enabled `true` to adapt the substep count.
+         */
+        void setAdaptiveSubstepsEnabled(bool enabled);
+
+        /**
+         * Sets the bounds adaptive substepping keeps the substep count within.
+         *
+         * @param minSteps Fewest substeps an update may use, at least one.
+         * @param maxSteps Most substeps an update may use.
+         */
+        void setSubstepRange(size_t minSteps, size_t maxSteps);
+
+        /**
+         * Sets the error levels that make adaptive substepping use more substeps.
+         *
+         * @param constraintError Largest acceptable residual stretch of a distance constraint after a
+         *                        substep, as a fraction of its maximum distance. Zero ignores constraints.
+         * @param displacement Largest acceptable distance a particle moves in one substep, as a
+         *                     fraction of its radius. Zero ignores displacement.
+         */
+        void setAdaptiveTolerances(Real constraintError, Real displacement) { m_substepController.setTolerances(constraintError, displacement); }
+
+        /**
+         * Gets the number of substeps the next update will perform.
+         *
+         * @return The substep count.
+         */
+        size_t getSubstepCount() const { return m_steps; }
+
+        /**
+         * Gets the number of substeps the last update performed.
+         *
+         * @return The substep count, or zero before the first update.
+         */
+        size_t getLastSubstepCount() const { return m_lastSteps; }
+
+        /**
+         * Gets the worst residual constraint stretch measured during the last update.
+         *
+         * Only measured while adaptive substepping is enabled.
+         *
+         * @return The largest stretch of any distance constraint as a fraction of its maximum distance.
+         */
+        Real getConstraintError() const { return m_substepController.getConstraintError(); }
+
+        /**
+         * Gets the worst substep displacement measured during the last update.
+         *
+         * Only measured while adaptive substepping is enabled.
+         *
+         * @return The largest distance any particle moved in a substep, as a fraction of its radius.
+         */
+        Real getMaxDisplacement() const { return m_substepController.getDisplacement(); }
+
+        /**
+         * Finds every particle containing a point.
+         *
+         * Like every spatial query, this rebuilds the query index first if particles were added or
+         * moved since the last query, then only visits the grid cells around the answer.
+         *
+         * @param point The point to test.
+         * @param results Replaced with the particles whose circle contains the point.
+         */
+        void queryPoint(Vector2 point, std::vector<Particle*>& results);
+
+        /**
+         * Finds every particle overlapping an axis-aligned box, for example for area triggers.
+         *
+         * @param minimum Corner of the box with the smallest coordinates.
+         * @param maximum Corner of the box with the largest coordinates.
+         * @param results Replaced with the particles whose circle overlaps the box.
+         */
+        void queryBox(Vector2 minimum, Vector2 maximum, std::vector<Particle*>& results);
+
+        /**
+         * Finds every particle within a distance of a point, for example for sensors.
+         *
+         * @param centre The point to search around.
+         * @param radius Largest distance between the point and a particle's surface.
+         * @param results Replaced with the particles whose circle comes within `radius` of the point.
+         */
+        void queryRadius(Vector2 centre, Real radius, std::vector<Particle*>& results);
+
+        /**
+         * Finds the first particle a ray strikes.
+         *
+         * @param origin Start of the ray.
+         * @param direction Direction of the ray, of any non-zero length.
+         * @param maxDistance Length of the ray.
+         * @param hit Receives the particle struck, the distance, point and surface normal of the impact.
+         * @return `true` if a particle was struck.
+         */
+        bool rayCast(Vector2 origin, Vector2 direction, Real maxDistance, RayHit& hit);
+
+        /**
+         * Finds every enabled paired constraint whose link passes close to a segment.
+         *
+         * Passing the same point as both ends picks the links under a cursor.
+         *
+         * @param start Start of the segment.
+         * @param end End of the segment.
+         * @param leeway Largest distance between a link and the segment that still counts as a hit.
+         * @param results Replaced with the constraints hit, in the order they were added.
+         */
+        void queryConstraints(Vector2 start, Vector2 end, Real leeway, std::vector<PairedParticleConstraint*>& results);
+
+        /**
+         * Sets how often the particles are checked for being scattered through memory.
+         *
+         * Particles added in an order unrelated to where they are, or that have mixed over time, make
+         * every collision pass jump around memory. At the end of every given number of updates the
+         * world measures how many particles are stored far from their predecessor and, if that has
+         * grown past the sort tolerance since the last sort, calls `sortParticles`. Zero, the default,
+         * never sorts on its own.
+         *
+         * Sorting changes `Particle::getIndex` and the order of the store's arrays, so indices must not
+         * be held across updates, or read from other threads while the world is updated, once enabled.
+         *
+         * @param updates Updates between checks, or zero to disable automatic sorting.
+         */
+        void setParticleSortInterval(size_t updates) { m_particleSorter.setInterval(updates); }
+
+        /**
+         * Sets how much locality has to degrade before a periodic check sorts the particles.
+         *
+         * @param tolerance Growth, since the last sort, of the fraction of particles stored far from
+         *                  their predecessor. A tenth by default.
+         */
+        void setParticleSortTolerance(Real tolerance) { m_particleSorter.setTolerance(tolerance); }
+
+        /**
+         * Reorders the particle store along a Morton curve, so particles close in space are close in memory.
+         *
+         * Every handle, generator subscription, constraint, sleeping island and cached broad phase
+         * owned by the world is remapped to the new indices. Generators and constraints of other types
+         * are remapped through their `remapParticles` override. Handles stay valid; only their index changes.
+         */
+        void sortParticles();
+
+        /**
+         * Gets the statistics gathered by the last call to `update`.
+         *
+         * Phase times and counters are only gathered when the library is built with
+         * `VERLET_ENABLE_PROFILING`; otherwise every value stays zero.
+         *
+         * @return The statistics of the last update.
+         */
+        const SimulationStats& getStats() const { return m_stats; }
+
+        /**
+         * Sets a recorder that receives a trace event for every phase of every substep.
+         *
+         * Events are only recorded in profiling builds.
+         *
+         * @param recorder The recorder to use, or null to stop recording. It is not owned by the world.
+         */
+        void setTraceRecorder(TraceRecorder* recorder) { m_traceRecorder = recorder; }
+
+        /**
+         * Gets the number of particles in the simulation world.
+         *
+         * @return The particle count.
+         */
+        size_t getParticleCount() const { return m_particles.size(); }
+
+        /**
+         * Gets the store holding every particle of the simulation world.
+         *
+         * @return The particle store, for reading positions in bulk.
+         */
+        const ParticleStore& getParticles() const { return m_particles; }
+
+        /**
+         * Gets the store holding every particle of the simulation world.
+         *
+         * @return The particle store, for example to subscribe a generator to every particle.
+         */
+        ParticleStore& getParticles() { return m_particles; }
+
+    private:
+        /**
+         * Runs one phase of a substep, timing it in profiling builds.
+         *
+         * @param substep Index of the substep within the current update.
+         * @param phase The phase being run.
+         * @param body Callable performing the phase.
+         */
+        template <typename Body>
+        void runPhase(size_t substep, SimulationPhase phase, const Body& body)
+        {
+#ifdef VERLET_ENABLE_PROFILING
+            const TraceRecorder::Clock::time_point start = TraceRecorder::Clock::now();
+            body();
+            recordPhase(substep, phase, start, TraceRecorder::Clock::now());
+#else
+            (void)substep;
+            (void)phase;
+            body();
+#endif
+        }
+
+        /**
+         * Points everything the world owns at the new particle indices described by `m_remap`.
+         */
+        void remapParticles();
+
+        /**
+         * Adds a timed phase to the statistics and the trace recorder, if any.
+         */
+        void recordPhase(size_t substep, SimulationPhase phase, TraceRecorder::Clock::time_point start, TraceRecorder::Clock::time_point end);
+
+        /**
+         * Measures the largest distance any awake particle moved during the last substep.
+         *
+         * @return The largest distance between a particle's current and previous position, as a fraction of its radius.
+         */
+        Real measureDisplacement();
+
+        /**
+         * Scales the velocity of every awake particle, keeping its current position.
+         *
+         * @param factor Ratio of the new substep length to the old one.
+         */
+        void rescaleVelocities(double factor);
+
+        /**
+         * Resolves collisions of the particles in one cell with each other and with the particles
+         * in the cells to its east, south-west, south and south-east.
+         *
+         * @param column The cell's column.
+         * @param row The cell's row.
+         * @param counters Counters of the calling thread, updated in profiling builds.
+         * @param contacts Receives every overlapping pair when sleeping is enabled, otherwise null.
+         */
+        void collideCell(size_t column, size_t row, CollisionCounters& counters, std::vector<SleepManager::Contact>* contacts);
+
+        /**
+         * Resolves the candidate pairs found by sweep and prune, in sweep order.
+         */
+        void sweepCollisions();
+
+        /**
+         * Pushes every awake particle out of the sleeping particles it overlaps, which stay put.
+         *
+         * Sleeping particles only move when woken, so their grid is only rebuilt when the store's
+         * layout or awake count changed. Each awake particle looks up the cells it reaches into.
+         *
+         * @param collectContacts Whether to hand every overlapping pair to the sleep manager.
+         */
+        void collideSleeping(bool collectContacts);
+
         /**
          * Resolves a collision between two particles.
          *
-         * @param particleA Pointer to the first particle involved in the collision.
-         * @param particleB Pointer to the second particle involved in the collision.
+         * @param particleA Index of the first particle involved in the collision.
+         * @param particleB Index of the second particle involved in the collision.
          */
-        void resolveCollision(Particle* particleA, Particle* particleB);
+        void resolveCollision(size_t particleA, size_t particleB);
 
     };
 
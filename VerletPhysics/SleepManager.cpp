@@ -0,0 +1,200 @@
+#include "SleepManager.h"
+
+#include <algorithm>
+
+using namespace VerletPhysics;
+
+void SleepManager::setEnabled(ParticleStore& particles, bool enabled)
+{
+    if (!enabled) {
+        wakeAll(particles);
+        m_restFrames.clear();
+    }
+    m_enabled = enabled;
+}
+
+void SleepManager::setThreshold(Real threshold, size_t frames)
+{
+    m_threshold = threshold;
+    m_frames = static_cast<uint32_t>(std::max<size_t>(frames, 1));
+}
+
+void SleepManager::clearContacts()
+{
+    m_contacts.clear();
+}
+
+void SleepManager::addContacts(const std::vector<Contact>& contacts)
+{
+    std::lock_guard<std::mutex> lock(m_contactMutex);
+    m_contacts.insert(m_contacts.end(), contacts.begin(), contacts.end());
+}
+
+uint32_t SleepManager::findRoot(uint32_t index)
+{
+    while (m_parent[index] != index) {
+        m_parent[index] = m_parent[m_parent[index]];
+        index = m_parent[index];
+    }
+    return index;
+}
+
+void SleepManager::link(const uint8_t* flags, uint32_t a, uint32_t b)
+{
+    // Static particles anchor islands without joining them
+    if ((flags[a] | flags[b]) & ParticleStore::STATIC_FLAG) return;
+
+    const bool sleepingA = (flags[a] & ParticleStore::SLEEPING_FLAG) != 0;
+    const bool sleepingB = (flags[b] & ParticleStore::SLEEPING_FLAG) != 0;
+
+    if (!sleepingA && !sleepingB) {
+        // Rooting every island at its smallest index keeps the islands independent of contact order
+        const uint32_t rootA = findRoot(a);
+        const uint32_t rootB = findRoot(b);
+        if (rootA < rootB) m_parent[rootB] = rootA;
+        else if (rootB < rootA) m_parent[rootA] = rootB;
+    }
+    else if (sleepingA && !sleepingB) {
+        if (m_moving[b]) m_waking.push_back(m_islandOf[a]);
+    }
+    else if (sleepingB && !sleepingA) {
+        if (m_moving[a]) m_waking.push_back(m_islandOf[b]);
+    }
+}
+
+void SleepManager::processWakeRequests(ParticleStore& particles)
+{
+    for (const Particle* handle : particles.getWakeRequests()) {
+        // The handle of a particle removed since points past the end, or at an awake particle added since
+        if (handle->getIndex() < particles.size()) wakeIsland(particles, handle->getIndex());
+    }
+    particles.clearWakeRequests();
+}
+
+void SleepManager::update(ParticleStore& particles, const DistanceConstraintSolver& constraints)
+{
+    if (!m_enabled) return;
+
+    // Sleeping particles are stored last, so only the awake ones are visited
+    const size_t count = particles.getAwakeCount();
+    Real* positionX = particles.positionX();
+    Real* positionY = particles.positionY();
+    Real* previousX = particles.previousX();
+    Real* previousY = particles.previousY();
+    const uint8_t* flags = particles.isStatic();
+
+    m_restFrames.resize(particles.size(), 0);
+    m_islandOf.resize(particles.size(), NO_ISLAND);
+    m_memberSlot.resize(particles.size());
+    m_parent.resize(count);
+    m_islandRest.assign(count, UINT32_MAX);
+    m_rootIsland.assign(count, NO_ISLAND);
+    m_moving.assign(count, 0);
+
+    const Real thresholdSquared = m_threshold * m_threshold;
+    for (size_t i = 0; i < count; i++) {
+        m_parent[i] = static_cast<uint32_t>(i);
+        if (flags[i]) continue;
+
+        const Real velocityX = positionX[i] - previousX[i];
+        const Real velocityY = positionY[i] - previousY[i];
+        if (velocityX * velocityX + velocityY * velocityY < thresholdSquared) {
+            m_restFrames[i] = std::min(m_restFrames[i] + 1, m_frames);
+        }
+        else {
+            m_restFrames[i] = 0;
+            m_moving[i] = 1;
+        }
+    }
+
+    for (const Contact& contact : m_contacts) link(flags, contact.first, contact.second);
+    m_contacts.clear();
+
+    constraints.forEachAwake([this, flags](uint32_t a, uint32_t b) { link(flags, a, b); });
+
+    // Woken particles start resting from zero, so they stay awake at least until the next update
+    for (uint32_t island : m_waking) wake(particles, island);
+    m_waking.clear();
+
+    for (size_t i = 0; i < count; i++) {
+        if (flags[i]) continue;
+        uint32_t& rest = m_islandRest[findRoot(static_cast<uint32_t>(i))];
+        rest = std::min(rest, m_restFrames[i]);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (flags[i]) continue;
+
+        const uint32_t root = findRoot(static_cast<uint32_t>(i));
+        if (m_islandRest[root] < m_frames) continue;
+
+        // Islands are keyed by a counter rather than a member, as members change index
+        uint32_t& island = m_rootIsland[root];
+        if (island == NO_ISLAND) island = m_nextIsland++;
+
+        std::vector<uint32_t>& members = m_islands[island];
+        particles.setSleeping(i, true);
+        previousX[i] = positionX[i];
+        previousY[i] = positionY[i];
+        m_islandOf[i] = island;
+        m_memberSlot[i] = static_cast<uint32_t>(members.size());
+        members.push_back(static_cast<uint32_t>(i));
+        m_sleepingCount++;
+    }
+}
+
+void SleepManager::wake(ParticleStore& particles, uint32_t island)
+{
+    // An island touched by several moving particles is queued more than once
+    auto found = m_islands.find(island);
+    if (found == m_islands.end()) return;
+
+    for (uint32_t i : found->second) {
+        particles.setSleeping(i, false);
+        m_islandOf[i] = NO_ISLAND;
+        m_restFrames[i] = 0;
+    }
+
+    m_sleepingCount -= found->second.size();
+    m_islands.erase(found);
+}
+
+void SleepManager::wakeIsland(ParticleStore& particles, size_t index)
+{
+    if (index < m_islandOf.size() && m_islandOf[index] != NO_ISLAND) wake(particles, m_islandOf[index]);
+}
+
+void SleepManager::remapParticles(const ParticleRemap& remap)
+{
+    for (uint32_t removed : remap.removed) {
+        if (removed >= m_islandOf.size() || m_islandOf[removed] == NO_ISLAND) continue;
+
+        // The island's last member takes the removed one's place, and an island left empty is gone
+        auto island = m_islands.find(m_islandOf[removed]);
+        std::vector<uint32_t>& members = island->second;
+        const uint32_t last = members.back();
+        members[m_memberSlot[removed]] = last;
+        m_memberSlot[last] = m_memberSlot[removed];
+        members.pop_back();
+        if (members.empty()) m_islands.erase(island);
+
+        m_islandOf[removed] = NO_ISLAND;
+        m_sleepingCount--;
+    }
+
+    for (const ParticleMove& move : remap.moved) {
+        if (move.from < m_islandOf.size() && m_islandOf[move.from] != NO_ISLAND) {
+            m_islands[m_islandOf[move.from]][m_memberSlot[move.from]] = move.to;
+        }
+    }
+
+    // Particles added since the last update are not tracked yet and start from zero
+    remap.apply(m_restFrames, 0u);
+    remap.apply(m_islandOf, NO_ISLAND);
+    remap.apply(m_memberSlot, NO_ISLAND);
+}
+
+void SleepManager::wakeAll(ParticleStore& particles)
+{
+    while (!m_islands.empty()) wake(particles, m_islands.begin()->first);
+}
@@ -0,0 +1,164 @@
+#pragma once
+#include "DistanceConstraintSolver.h"
+#include "Particle.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace VerletPhysics {
+
+    /**
+     * Puts settled islands of particles to sleep and wakes them again.
+     *
+     * Particles that overlap, or that are joined by an enabled `PairedParticleConstraint`, form an
+     * island. Once every particle of an island has moved less than the sleep threshold per substep
+     * for a number of consecutive updates, the whole island falls asleep: its velocity is zeroed and
+     * `ParticleStore::SLEEPING_FLAG` is set on its particles, and the store moves them behind every
+     * awake particle at the start of the next update, so every phase skips them. Sleeping particles
+     * feel no forces but still exert them, so springs and N-body attraction keep pulling on awake
+     * particles. A sleeping island wakes up as a whole
+     * when a particle moving faster than the threshold touches it or is constrained to it, when one of
+     * its particles is moved or made movable through its handle, or when it is woken explicitly.
+     *
+     * Static particles never join an island, so separate piles resting on the same static floor
+     * sleep and wake independently.
+     */
+    class SleepManager
+    {
+    public:
+        using Contact = std::pair<uint32_t, uint32_t>; ///< Indices of two overlapping particles.
+
+    private:
+        static constexpr uint32_t NO_ISLAND = UINT32_MAX;
+
+        bool m_enabled = false;         ///< Whether islands are tracked and put to sleep at all.
+        Real m_threshold = Real(0.01);  ///< Largest distance a resting particle moves in a substep.
+        uint32_t m_frames = 60;         ///< Updates an island has to rest before it falls asleep.
+
+        std::vector<uint32_t> m_restFrames; ///< Consecutive updates each particle has been resting.
+        std::vector<uint32_t> m_parent;     ///< Union-find parent of each awake particle, rebuilt every update.
+        std::vector<uint32_t> m_islandRest; ///< Fewest rest frames of any member, indexed by island root.
+        std::vector<uint8_t> m_moving;      ///< Non-zero for awake particles moving faster than the threshold.
+
+        std::vector<Contact> m_contacts;    ///< Overlapping pairs found by the last collision pass.
+        std::mutex m_contactMutex;          ///< Guards `m_contacts` while collision threads add to it.
+
+        std::vector<uint32_t> m_islandOf;                              ///< Sleeping island of each particle, or `NO_ISLAND`.
+        std::vector<uint32_t> m_memberSlot;                            ///< Position of each sleeping particle among its island's members.
+        std::unordered_map<uint32_t, std::vector<uint32_t>> m_islands; ///< Members of every sleeping island, keyed by island.
+        std::vector<uint32_t> m_rootIsland;                            ///< Island given to each awake root falling asleep in the current update.
+        uint32_t m_nextIsland = 0;                                     ///< Key given to the next island to fall asleep.
+        std::vector<uint32_t> m_waking;                                ///< Islands to wake at the end of the current update.
+        size_t m_sleepingCount = 0;                                    ///< Particles currently asleep.
+
+    public:
+        /**
+         * Enables or disables sleeping. Disabling wakes every sleeping island.
+         *
+         * @param particles The store holding the particles.
+         * @param enabled `true` to let settled islands fall asleep.
+         */
+        void setEnabled(ParticleStore& particles, bool enabled);
+
+        /**
+         * Checks whether sleeping is enabled.
+         *
+         * @return `true` if settled islands are put to sleep.
+         */
+        bool isEnabled() const { return m_enabled; }
+
+        /**
+         * Sets when an island is considered settled.
+         *
+         * @param threshold Distance below which a particle moving between its previous and current
+         *                  position counts as resting.
+         * @param frames Number of consecutive updates every particle of an island has to rest for
+         *               the island to fall asleep.
+         */
+        void setThreshold(Real threshold, size_t frames);
+
+        /**
+         * Forgets the contacts of the previous collision pass.
+         */
+        void clearContacts();
+
+        /**
+         * Records overlapping pairs found by one collision thread. Safe to call concurrently.
+         *
+         * @param contacts The overlapping pairs.
+         */
+        void addContacts(const std::vector<Contact>& contacts);
+
+        /**
+         * Builds the islands of the awake particles, wakes sleeping islands disturbed by a moving
+         * particle and puts every island that has rested long enough to sleep.
+         *
+         * Called once at the end of every update, after the last substep, while every sleeping
+         * particle is still stored behind the awake ones.
+         *
+         * @param particles The store holding the particles.
+         * @param constraints The solver holding every paired constraint of the world.
+         */
+        void update(ParticleStore& particles, const DistanceConstraintSolver& constraints);
+
+        /**
+         * Wakes the islands of the particles moved or made movable through their handles.
+         *
+         * Called at the start of every update, before the store moves woken particles.
+         *
+         * @param particles The store holding the particles and their wake requests.
+         */
+        void processWakeRequests(ParticleStore& particles);
+
+        /**
+         * Wakes the island a particle belongs to, if it is asleep.
+         *
+         * @param particles The store holding the particles.
+         * @param index Index of the particle.
+         */
+        void wakeIsland(ParticleStore& particles, size_t index);
+
+        /**
+         * Wakes every sleeping island.
+         *
+         * @param particles The store holding the particles.
+         */
+        void wakeAll(ParticleStore& particles);
+
+        /**
+         * Gets the number of particles currently asleep.
+         *
+         * @return The sleeping particle count.
+         */
+        size_t getSleepingCount() const { return m_sleepingCount; }
+
+        /**
+         * Carries rest counts and sleeping islands over to the new particle indices after the store
+         * was reordered or particles were removed. Islands keep sleeping without their removed members.
+         *
+         * @param remap The removed particles and every particle that changed index.
+         */
+        void remapParticles(const ParticleRemap& remap);
+
+    private:
+        /**
+         * Finds the root of a particle's island, halving the path on the way.
+         */
+        uint32_t findRoot(uint32_t index);
+
+        /**
+         * Joins two awake particles into one island, or marks a sleeping island to be woken if one
+         * of them is asleep and the other is moving.
+         */
+        void link(const uint8_t* flags, uint32_t a, uint32_t b);
+
+        /**
+         * Wakes one sleeping island, restoring its particles' flags and restarting their rest count.
+         */
+        void wake(ParticleStore& particles, uint32_t island);
+    };
+}
@@ -0,0 +1,94 @@
+#include "SpatialGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace VerletPhysics;
+
+void SpatialGrid::rebuild(const ParticleStore& particles, size_t begin, size_t end)
+{
+    const size_t count = end - begin;
+    m_particleCell.resize(count);
+    m_cellEntries.resize(count);
+
+    if (count == 0) {
+        m_columns = 0;
+        m_rows = 0;
+        m_cellStart.assign(1, 0);
+        return;
+    }
+
+    const Real* positionX = particles.positionX();
+    const Real* positionY = particles.positionY();
+    const Real* radius = particles.radius();
+
+    double maxRadius = 0.0;
+    double minX = positionX[begin];
+    double minY = positionY[begin];
+    double maxX = minX;
+    double maxY = minY;
+
+    for (size_t i = begin; i < end; i++) {
+        minX = std::min<double>(minX, positionX[i]);
+        minY = std::min<double>(minY, positionY[i]);
+        maxX = std::max<double>(maxX, positionX[i]);
+        maxY = std::max<double>(maxY, positionY[i]);
+        maxRadius = std::max<double>(maxRadius, radius[i]);
+    }
+
+    // Overlapping particles are never further apart than the largest diameter
+    m_cellSize = std::max(maxRadius * 2, 1e-6);
+    m_originX = minX;
+    m_originY = minY;
+
+    double columns = std::floor((maxX - minX) / m_cellSize) + 1;
+    double rows = std::floor((maxY - minY) / m_cellSize) + 1;
+
+    // Sparse scenes would otherwise allocate far more cells than particles
+    const double maxCells = 4.0 * count + 64;
+    if (!(columns * rows <= maxCells)) {
+        const double scale = std::sqrt(columns * rows / maxCells);
+        m_cellSize = std::isfinite(scale) ? m_cellSize * scale : (maxX - minX) + (maxY - minY) + 1;
+        columns = std::floor((maxX - minX) / m_cellSize) + 1;
+        rows = std::floor((maxY - minY) / m_cellSize) + 1;
+    }
+
+    m_columns = std::isfinite(columns) ? std::max<size_t>(1, static_cast<size_t>(columns)) : 1;
+    m_rows = std::isfinite(rows) ? std::max<size_t>(1, static_cast<size_t>(rows)) : 1;
+
+    // Counting sort of particle indices by cell
+    m_cellStart.assign(m_columns * m_rows + 1, 0);
+
+    for (size_t i = begin; i < end; i++) {
+        const size_t cell = cellCoordinate(positionY[i], m_originY, m_rows) * m_columns
+            + cellCoordinate(positionX[i], m_originX, m_columns);
+
+        m_particleCell[i - begin] = cell;
+        m_cellStart[cell + 1]++;
+    }
+
+    for (size_t cell = 0; cell < m_columns * m_rows; cell++) m_cellStart[cell + 1] += m_cellStart[cell];
+
+    std::vector<size_t> cursor(m_cellStart.begin(), m_cellStart.end() - 1);
+    for (size_t i = begin; i < end; i++) m_cellEntries[cursor[m_particleCell[i - begin]]++] = i;
+}
+
+size_t SpatialGrid::cellCoordinate(double position, double origin, size_t cellCount) const
+{
+    const double coordinate = (position - origin) / m_cellSize;
+    if (!(coordinate > 0.0)) return 0;
+    if (coordinate >= static_cast<double>(cellCount - 1)) return cellCount - 1;
+    return static_cast<size_t>(coordinate);
+}
+
+bool SpatialGrid::cellRange(double low, double high, double origin, size_t cellCount, size_t& first, size_t& last) const
+{
+    const double lowCell = std::floor((low - origin) / m_cellSize);
+    const double highCell = std::floor((high - origin) / m_cellSize);
+
+    if (cellCount == 0 || !(highCell >= 0) || !(lowCell < static_cast<double>(cellCount))) return false;
+
+    first = lowCell > 0 ? static_cast<size_t>(lowCell) : 0;
+    last = static_cast<size_t>(std::min(highCell, static_cast<double>(cellCount - 1)));
+    return true;
+}
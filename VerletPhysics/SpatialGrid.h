@@ -0,0 +1,137 @@
+#pragma once
+#include "Particle.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace VerletPhysics {
+
+    /**
+     * A uniform grid used as the collision broad phase.
+     *
+     * The `SpatialGrid` buckets particles into square cells whose side is the largest particle
+     * diameter, so any two overlapping particles are guaranteed to sit in the same or adjacent cells.
+     * Cells are stored as a counting sort over particle indices, which keeps every cell's entries in
+     * ascending particle order and the whole structure in two flat arrays.
+     */
+    class SpatialGrid
+    {
+        double m_cellSize = 1.0;  ///< Side length of a grid cell.
+        double m_originX = 0.0;   ///< X-coordinate of the grid's minimum corner.
+        double m_originY = 0.0;   ///< Y-coordinate of the grid's minimum corner.
+        size_t m_columns = 0;     ///< Number of cell columns.
+        size_t m_rows = 0;        ///< Number of cell rows.
+
+        std::vector<size_t> m_cellStart;    ///< Offset of each cell's entries in `m_cellEntries`, plus a trailing end offset.
+        std::vector<size_t> m_cellEntries;  ///< Particle indices sorted by cell.
+        std::vector<size_t> m_particleCell; ///< Cell index of every inserted particle, from the first one.
+
+    public:
+        /**
+         * Rebuilds the grid from the current particle positions.
+         *
+         * The cell size is derived from the largest particle radius. Should the particles be spread
+         * so thinly that a dense grid would be wasteful, the cells are enlarged to bound memory use.
+         *
+         * @param particles The particles to insert, addressed by their index in the store.
+         */
+        void rebuild(const ParticleStore& particles) { rebuild(particles, 0, particles.size()); }
+
+        /**
+         * Rebuilds the grid from the current positions of a range of particles.
+         *
+         * @param particles The store holding the particles, which are still addressed by their index in it.
+         * @param begin Index of the first particle to insert.
+         * @param end One past the index of the last particle to insert.
+         */
+        void rebuild(const ParticleStore& particles, size_t begin, size_t end);
+
+        /**
+         * Gets the number of cell columns.
+         *
+         * @return The column count of the last rebuild.
+         */
+        size_t getColumns() const { return m_columns; }
+
+        /**
+         * Gets the number of cell rows.
+         *
+         * @return The row count of the last rebuild.
+         */
+        size_t getRows() const { return m_rows; }
+
+        /**
+         * Gets a pointer to the first particle index stored in a cell.
+         *
+         * Entries of a cell are contiguous and sorted in ascending particle order.
+         *
+         * @param column The cell's column.
+         * @param row The cell's row.
+         * @return Pointer to the cell's first entry.
+         */
+        const size_t* cellBegin(size_t column, size_t row) const { return m_cellEntries.data() + m_cellStart[row * m_columns + column]; }
+
+        /**
+         * Gets a pointer one past the last particle index stored in a cell.
+         *
+         * @param column The cell's column.
+         * @param row The cell's row.
+         * @return Pointer one past the cell's last entry.
+         */
+        const size_t* cellEnd(size_t column, size_t row) const { return m_cellEntries.data() + m_cellStart[row * m_columns + column + 1]; }
+
+        /**
+         * Gets the side length of a grid cell.
+         *
+         * @return The cell size used by the last rebuild.
+         */
+        double getCellSize() const { return m_cellSize; }
+
+        /**
+         * Gets the X-coordinate of the grid's minimum corner.
+         *
+         * @return The smallest particle X-coordinate of the last rebuild.
+         */
+        double getOriginX() const { return m_originX; }
+
+        /**
+         * Gets the Y-coordinate of the grid's minimum corner.
+         *
+         * @return The smallest particle Y-coordinate of the last rebuild.
+         */
+        double getOriginY() const { return m_originY; }
+
+        /**
+         * Gets the range of columns whose particles may reach into an interval along X.
+         *
+         * @param low Smallest X-coordinate of the interval, already grown by the reach of the particles.
+         * @param high Largest X-coordinate of the interval, already grown by the reach of the particles.
+         * @param first Receives the first column of the range.
+         * @param last Receives the last column of the range.
+         * @return `false` if the interval misses the grid entirely.
+         */
+        bool columnRange(double low, double high, size_t& first, size_t& last) const { return cellRange(low, high, m_originX, m_columns, first, last); }
+
+        /**
+         * Gets the range of rows whose particles may reach into an interval along Y.
+         *
+         * @param low Smallest Y-coordinate of the interval, already grown by the reach of the particles.
+         * @param high Largest Y-coordinate of the interval, already grown by the reach of the particles.
+         * @param first Receives the first row of the range.
+         * @param last Receives the last row of the range.
+         * @return `false` if the interval misses the grid entirely.
+         */
+        bool rowRange(double low, double high, size_t& first, size_t& last) const { return cellRange(low, high, m_originY, m_rows, first, last); }
+
+    private:
+        /**
+         * Gets the range of cells along one axis covering an interval, clamped to the grid.
+         */
+        bool cellRange(double low, double high, double origin, size_t cellCount, size_t& first, size_t& last) const;
+
+        /**
+         * Gets the cell coordinate of a position along one axis, clamped to the grid.
+         */
+        size_t cellCoordinate(double position, double origin, size_t cellCount) const;
+    };
+}
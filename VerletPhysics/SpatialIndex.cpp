@@ -0,0 +1,308 @@
+#include "SpatialIndex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace VerletPhysics;
+
+namespace {
+
+    // Squared distance from a point to a segment
+    double pointSegmentDistanceSquared(double px, double py, double ax, double ay, double bx, double by)
+    {
+        const double abX = bx - ax;
+        const double abY = by - ay;
+        const double lengthSquared = abX * abX + abY * abY;
+
+        double t = lengthSquared > 0 ? ((px - ax) * abX + (py - ay) * abY) / lengthSquared : 0;
+        t = std::min(std::max(t, 0.0), 1.0);
+
+        const double dx = ax + abX * t - px;
+        const double dy = ay + abY * t - py;
+        return dx * dx + dy * dy;
+    }
+
+    // Which side of the line through a and b the point p lies on
+    double orientation(double ax, double ay, double bx, double by, double px, double py)
+    {
+        return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+    }
+
+    // Squared distance between two segments, zero if they cross
+    double segmentDistanceSquared(double ax, double ay, double bx, double by, double cx, double cy, double dx, double dy)
+    {
+        const double abC = orientation(ax, ay, bx, by, cx, cy);
+        const double abD = orientation(ax, ay, bx, by, dx, dy);
+        const double cdA = orientation(cx, cy, dx, dy, ax, ay);
+        const double cdB = orientation(cx, cy, dx, dy, bx, by);
+        if (((abC > 0 && abD < 0) || (abC < 0 && abD > 0)) && ((cdA > 0 && cdB < 0) || (cdA < 0 && cdB > 0))) return 0;
+
+        return std::min(
+            std::min(pointSegmentDistanceSquared(ax, ay, cx, cy, dx, dy), pointSegmentDistanceSquared(bx, by, cx, cy, dx, dy)),
+            std::min(pointSegmentDistanceSquared(cx, cy, ax, ay, bx, by), pointSegmentDistanceSquared(dx, dy, ax, ay, bx, by)));
+    }
+}
+
+void SpatialIndex::refresh(const ParticleStore& particles, const std::vector<PairedParticleConstraint*>& constraints)
+{
+    const size_t count = particles.size();
+    const bool moved = !m_built || particles.getPositionVersion() != m_builtVersion || count != m_builtParticles;
+    const bool relink = constraints.size() != m_indexedConstraints || count != m_builtParticles
+        || particles.getLayoutVersion() != m_builtLayout;
+
+    if (moved) {
+        m_grid.rebuild(particles);
+        m_builtVersion = particles.getPositionVersion();
+        m_built = true;
+    }
+
+    if (relink) {
+        // Counting sort of constraint indices by the particles they attach, like the grid's cells
+        m_constraintStart.assign(count + 1, 0);
+        for (const PairedParticleConstraint* constraint : constraints) {
+            m_constraintStart[constraint->getIndexA() + 1]++;
+            m_constraintStart[constraint->getIndexB() + 1]++;
+        }
+        for (size_t i = 0; i < count; i++) m_constraintStart[i + 1] += m_constraintStart[i];
+
+        m_particleConstraints.resize(m_constraintStart[count]);
+        std::vector<size_t> cursor(m_constraintStart.begin(), m_constraintStart.end() - 1);
+        for (size_t c = 0; c < constraints.size(); c++) {
+            m_particleConstraints[cursor[constraints[c]->getIndexA()]++] = static_cast<uint32_t>(c);
+            m_particleConstraints[cursor[constraints[c]->getIndexB()]++] = static_cast<uint32_t>(c);
+        }
+        m_indexedConstraints = constraints.size();
+        m_builtLayout = particles.getLayoutVersion();
+    }
+
+    m_builtParticles = count;
+
+    // Disabled constraints count too, so enabling one never needs a rebuild
+    if (moved || relink) {
+        const Real* positionX = particles.positionX();
+        const Real* positionY = particles.positionY();
+        Real longestSquared = 0;
+
+        for (const PairedParticleConstraint* constraint : constraints) {
+            const Real dx = positionX[constraint->getIndexB()] - positionX[constraint->getIndexA()];
+            const Real dy = positionY[constraint->getIndexB()] - positionY[constraint->getIndexA()];
+            longestSquared = std::max(longestSquared, dx * dx + dy * dy);
+        }
+        m_longestConstraint = std::sqrt(longestSquared);
+    }
+}
+
+void SpatialIndex::queryCircle(ParticleStore& particles, Vector2 centre, Real radius, std::vector<Particle*>& results) const
+{
+    results.clear();
+
+    const Real* positionX = particles.positionX();
+    const Real* positionY = particles.positionY();
+    const Real* particleRadius = particles.radius();
+
+    // Half a cell covers the radius of any particle
+    const double reach = radius + m_grid.getCellSize() * 0.5;
+    size_t firstColumn, lastColumn, firstRow, lastRow;
+    if (!m_grid.columnRange(centre.x() - reach, centre.x() + reach, firstColumn, lastColumn)) return;
+    if (!m_grid.rowRange(centre.y() - reach, centre.y() + reach, firstRow, lastRow)) return;
+
+    for (size_t row = firstRow; row <= lastRow; row++) {
+        for (size_t column = firstColumn; column <= lastColumn; column++) {
+            for (const size_t* entry = m_grid.cellBegin(column, row); entry != m_grid.cellEnd(column, row); entry++) {
+                const size_t i = *entry;
+                const Real offsetX = positionX[i] - centre.x();
+                const Real offsetY = positionY[i] - centre.y();
+                const Real radii = radius + particleRadius[i];
+
+                if (offsetX * offsetX + offsetY * offsetY <= radii * radii) results.push_back(particles.getHandle(i));
+            }
+        }
+    }
+}
+
+void SpatialIndex::queryBox(ParticleStore& particles, Vector2 minimum, Vector2 maximum, std::vector<Particle*>& results) const
+{
+    results.clear();
+
+    const Real* positionX = particles.positionX();
+    const Real* positionY = particles.positionY();
+    const Real* radius = particles.radius();
+
+    const double reach = m_grid.getCellSize() * 0.5;
+    size_t firstColumn, lastColumn, firstRow, lastRow;
+    if (!m_grid.columnRange(minimum.x() - reach, maximum.x() + reach, firstColumn, lastColumn)) return;
+    if (!m_grid.rowRange(minimum.y() - reach, maximum.y() + reach, firstRow, lastRow)) return;
+
+    for (size_t row = firstRow; row <= lastRow; row++) {
+        for (size_t column = firstColumn; column <= lastColumn; column++) {
+            for (const size_t* entry = m_grid.cellBegin(column, row); entry != m_grid.cellEnd(column, row); entry++) {
+                const size_t i = *entry;
+
+                // Distance from the centre to the closest point of the box
+                const Real offsetX = positionX[i] - std::min(std::max(positionX[i], minimum.x()), maximum.x());
+                const Real offsetY = positionY[i] - std::min(std::max(positionY[i], minimum.y()), maximum.y());
+
+                if (offsetX * offsetX + offsetY * offsetY <= radius[i] * radius[i]) results.push_back(particles.getHandle(i));
+            }
+        }
+    }
+}
+
+bool SpatialIndex::rayCast(ParticleStore& particles, Vector2 origin, Vector2 direction, Real maxDistance, RayHit& hit) const
+{
+    hit = RayHit();
+
+    const double length = VectorMath::magnitude(direction);
+    const long long columns = static_cast<long long>(m_grid.getColumns());
+    const long long rows = static_cast<long long>(m_grid.getRows());
+    if (!(length > 0) || !(maxDistance >= 0) || columns == 0) return false;
+
+    const Real* positionX = particles.positionX();
+    const Real* positionY = particles.positionY();
+    const Real* radius = particles.radius();
+
+    const double cellSize = m_grid.getCellSize();
+    const double originX = origin.x() - m_grid.getOriginX();
+    const double originY = origin.y() - m_grid.getOriginY();
+    const double stepX = direction.x() / length;
+    const double stepY = direction.y() / length;
+
+    // Clip the ray to the grid grown by a cell, the furthest a struck surface can lie from any centre
+    double enter = 0;
+    double leave = maxDistance;
+    const double low[2] = { -cellSize, -cellSize };
+    const double high[2] = { (columns + 1) * cellSize, (rows + 1) * cellSize };
+    const double start[2] = { originX, originY };
+    const double step[2] = { stepX, stepY };
+    for (int axis = 0; axis < 2; axis++) {
+        if (step[axis] == 0) {
+            if (start[axis] < low[axis] || start[axis] > high[axis]) return false;
+            continue;
+        }
+        double near = (low[axis] - start[axis]) / step[axis];
+        double far = (high[axis] - start[axis]) / step[axis];
+        if (near > far) std::swap(near, far);
+        enter = std::max(enter, near);
+        leave = std::min(leave, far);
+    }
+    if (enter > leave) return false;
+
+    // Walk the crossed cells in order, allowing one cell of margin on every side of the grid
+    long long column = std::min(std::max(static_cast<long long>(std::floor((originX + stepX * enter) / cellSize)), -1LL), columns);
+    long long row = std::min(std::max(static_cast<long long>(std::floor((originY + stepY * enter) / cellSize)), -1LL), rows);
+    const long long columnStep = stepX > 0 ? 1 : -1;
+    const long long rowStep = stepY > 0 ? 1 : -1;
+    const double infinity = std::numeric_limits<double>::infinity();
+    const double deltaX = stepX != 0 ? cellSize / std::abs(stepX) : infinity;
+    const double deltaY = stepY != 0 ? cellSize / std::abs(stepY) : infinity;
+    double nextX = stepX != 0 ? ((column + (stepX > 0 ? 1 : 0)) * cellSize - originX) / stepX : infinity;
+    double nextY = stepY != 0 ? ((row + (stepY > 0 ? 1 : 0)) * cellSize - originY) / stepY : infinity;
+
+    double best = infinity;
+    double cellEnter = enter;
+    size_t bestIndex = 0;
+
+    // A hit inside this cell belongs to a particle centred in it or a neighbour, so once a cell is
+    // entered past the best hit so far, no later cell can improve on it
+    while (cellEnter <= leave && cellEnter <= best && column >= -1 && column <= columns && row >= -1 && row <= rows) {
+        for (long long y = std::max(row - 1, 0LL); y <= std::min(row + 1, rows - 1); y++) {
+            for (long long x = std::max(column - 1, 0LL); x <= std::min(column + 1, columns - 1); x++) {
+                for (const size_t* entry = m_grid.cellBegin(static_cast<size_t>(x), static_cast<size_t>(y)); entry != m_grid.cellEnd(static_cast<size_t>(x), static_cast<size_t>(y)); entry++) {
+                    const size_t i = *entry;
+                    const double toOriginX = origin.x() - positionX[i];
+                    const double toOriginY = origin.y() - positionY[i];
+                    const double b = toOriginX * stepX + toOriginY * stepY;
+                    const double c = toOriginX * toOriginX + toOriginY * toOriginY - static_cast<double>(radius[i]) * radius[i];
+                    const double discriminant = b * b - c;
+                    if (discriminant < 0) continue;
+
+                    const double distance = c <= 0 ? 0 : -b - std::sqrt(discriminant);
+                    if (distance < 0 || distance > maxDistance || distance >= best) continue;
+
+                    best = distance;
+                    bestIndex = i;
+                }
+            }
+        }
+
+        if (nextX < nextY) {
+            cellEnter = nextX;
+            nextX += deltaX;
+            column += columnStep;
+        }
+        else {
+            cellEnter = nextY;
+            nextY += deltaY;
+            row += rowStep;
+        }
+    }
+
+    if (best == infinity) return false;
+
+    hit.particle = particles.getHandle(bestIndex);
+    hit.distance = static_cast<Real>(best);
+    hit.point = Vector2(static_cast<Real>(origin.x() + stepX * best), static_cast<Real>(origin.y() + stepY * best));
+
+    // A ray starting inside the particle is pushed straight back out
+    const Vector2 outward = hit.point - Vector2(positionX[bestIndex], positionY[bestIndex]);
+    hit.normal = VectorMath::magnitudeSquared(outward) > 0
+        ? VectorMath::normalize(outward)
+        : Vector2(static_cast<Real>(-stepX), static_cast<Real>(-stepY));
+    return true;
+}
+
+void SpatialIndex::queryConstraints(const ParticleStore& particles, const std::vector<PairedParticleConstraint*>& constraints,
+    Vector2 start, Vector2 end, Real leeway, std::vector<PairedParticleConstraint*>& results) const
+{
+    results.clear();
+    if (m_particleConstraints.empty()) return;
+
+    const Real* positionX = particles.positionX();
+    const Real* positionY = particles.positionY();
+
+    // Any constraint passing within the leeway has an end no further than its own length beyond that
+    const double reach = m_longestConstraint + leeway;
+    const double minimumX = std::min(start.x(), end.x()) - reach;
+    const double maximumX = std::max(start.x(), end.x()) + reach;
+    const double minimumY = std::min(start.y(), end.y()) - reach;
+    const double maximumY = std::max(start.y(), end.y()) + reach;
+
+    auto inRegion = [=](size_t i) {
+        return positionX[i] >= minimumX && positionX[i] <= maximumX && positionY[i] >= minimumY && positionY[i] <= maximumY;
+    };
+
+    size_t firstColumn, lastColumn, firstRow, lastRow;
+    if (!m_grid.columnRange(minimumX, maximumX, firstColumn, lastColumn)) return;
+    if (!m_grid.rowRange(minimumY, maximumY, firstRow, lastRow)) return;
+
+    const double leewaySquared = static_cast<double>(leeway) * leeway;
+    std::vector<uint32_t> found;
+
+    for (size_t row = firstRow; row <= lastRow; row++) {
+        for (size_t column = firstColumn; column <= lastColumn; column++) {
+            for (const size_t* entry = m_grid.cellBegin(column, row); entry != m_grid.cellEnd(column, row); entry++) {
+                const size_t i = *entry;
+                if (!inRegion(i)) continue;
+
+                for (size_t k = m_constraintStart[i]; k < m_constraintStart[i + 1]; k++) {
+                    const PairedParticleConstraint* constraint = constraints[m_particleConstraints[k]];
+                    const size_t a = constraint->getIndexA();
+                    const size_t b = constraint->getIndexB();
+
+                    // Test each constraint once, from its first particle whenever that one is in the region
+                    if (i == b && a != b && inRegion(a)) continue;
+                    if (!constraint->isEnabled()) continue;
+
+                    const double distanceSquared = segmentDistanceSquared(
+                        positionX[a], positionY[a], positionX[b], positionY[b], start.x(), start.y(), end.x(), end.y());
+                    if (distanceSquared <= leewaySquared) found.push_back(m_particleConstraints[k]);
+                }
+            }
+        }
+    }
+
+    std::sort(found.begin(), found.end());
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+    for (uint32_t c : found) results.push_back(constraints[c]);
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include "PhysicsMath.h"
+#include "Particle.h"
+#include "Contraint.h"
+#include "SpatialGrid.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace VerletPhysics {
+
+    /**
+     * The first particle struck by a ray.
+     */
+    struct RayHit
+    {
+        Particle* particle = nullptr; ///< Particle struck, or null if the ray hit nothing.
+        Real distance = 0;            ///< Distance along the ray to the point of impact.
+        Vector2 point;                ///< Point of impact on the particle's surface.
+        Vector2 normal;               ///< Unit surface normal at the point of impact, facing the ray origin.
+    };
+
+    /**
+     * Answers spatial queries against the particles and paired constraints of a world.
+     *
+     * The `SpatialIndex` buckets particles into a `SpatialGrid` and keeps, for every particle, the
+     * paired constraints attached to it. Since the grid cells are at least as wide as the largest
+     * particle, a particle overlapping a region always has its centre in a cell touching the region
+     * grown by half a cell, so queries only visit the cells near their answer. A constraint passing
+     * near a point has an end within its own length of that point, so constraint queries grow the
+     * region by the longest constraint and then follow the constraints of the particles found.
+     *
+     * The index rebuilds itself on the first query after the particles have moved, which costs
+     * about as much as one collision broad phase; queries made between updates reuse it.
+     */
+    class SpatialIndex
+    {
+        SpatialGrid m_grid;                ///< Particles bucketed by cell.
+        uint64_t m_builtVersion = 0;       ///< Position version of the store the grid was built from.
+        size_t m_builtParticles = 0;       ///< Particle count the grid was built with.
+        bool m_built = false;              ///< Set once the grid has been built at least once.
+
+        std::vector<size_t> m_constraintStart;   ///< Offset of each particle's entries in `m_particleConstraints`, plus a trailing end offset.
+        std::vector<uint32_t> m_particleConstraints; ///< Indices of the constraints attached to each particle.
+        size_t m_indexedConstraints = 0;   ///< Number of constraints the attachment lists were built from.
+        uint64_t m_builtLayout = 0;        ///< Layout version of the store the attachment lists were built from.
+        Real m_longestConstraint = 0;      ///< Current length of the longest enabled constraint when the grid was built.
+
+    public:
+        /**
+         * Rebuilds whatever changed since the last query.
+         *
+         * @param particles The store the queries run against.
+         * @param constraints Every paired constraint of the world, enabled or not. The attachment lists
+         *                    are relinked whenever the store's layout version or the constraint count
+         *                    changes, so the order may change along with the layout.
+         */
+        void refresh(const ParticleStore& particles, const std::vector<PairedParticleConstraint*>& constraints);
+
+        /**
+         * Finds every particle overlapping a circle.
+         *
+         * @param particles The store the index was refreshed with.
+         * @param centre Centre of the circle.
+         * @param radius Radius of the circle, zero for a point.
+         * @param results Replaced with the particles found, in ascending index order within each cell.
+         */
+        void queryCircle(ParticleStore& particles, Vector2 centre, Real radius, std::vector<Particle*>& results) const;
+
+        /**
+         * Finds every particle overlapping an axis-aligned box.
+         *
+         * @param particles The store the index was refreshed with.
+         * @param minimum Corner of the box with the smallest coordinates.
+         * @param maximum Corner of the box with the largest coordinates.
+         * @param results Replaced with the particles found.
+         */
+        void queryBox(ParticleStore& particles, Vector2 minimum, Vector2 maximum, std::vector<Particle*>& results) const;
+
+        /**
+         * Finds the first particle a ray strikes.
+         *
+         * Cells are walked in the order the ray crosses them, stopping as soon as no later cell can
+         * hold a closer hit. A ray starting inside a particle strikes it at distance zero.
+         *
+         * @param particles The store the index was refreshed with.
+         * @param origin Start of the ray.
+         * @param direction Direction of the ray, of any non-zero length.
+         * @param maxDistance Length of the ray.
+         * @param hit Receives the closest hit, if any.
+         * @return `true` if a particle was struck.
+         */
+        bool rayCast(ParticleStore& particles, Vector2 origin, Vector2 direction, Real maxDistance, RayHit& hit) const;
+
+        /**
+         * Finds every enabled constraint whose segment passes within a distance of a query segment.
+         *
+         * @param particles The store the index was refreshed with.
+         * @param constraints The constraints the index was refreshed with.
+         * @param start Start of the query segment.
+         * @param end End of the query segment, equal to `start` for a point.
+         * @param leeway Largest distance between the two segments that still counts as a hit.
+         * @param results Replaced with the constraints found, in registration order.
+         */
+        void queryConstraints(const ParticleStore& particles, const std::vector<PairedParticleConstraint*>& constraints,
+            Vector2 start, Vector2 end, Real leeway, std::vector<PairedParticleConstraint*>& results) const;
+    };
+}
@@ -0,0 +1,105 @@
+#include "SubscriberList.h"
+
+#include <algorithm>
+
+using namespace VerletPhysics;
+
+void SubscriberList::add(size_t index)
+{
+    if (contains(index)) return;
+
+    if (m_slot.size() <= index) m_slot.resize(index + 1, NO_SLOT);
+    m_slot[index] = static_cast<uint32_t>(m_indices.size());
+    m_indices.push_back(index);
+    classify(m_indices.size() - 1);
+}
+
+void SubscriberList::clear()
+{
+    m_indices.clear();
+    m_indices.shrink_to_fit();
+    m_slot.clear();
+    m_slot.shrink_to_fit();
+    m_awake = 0;
+}
+
+void SubscriberList::swapSlots(size_t a, size_t b)
+{
+    std::swap(m_indices[a], m_indices[b]);
+    m_slot[m_indices[a]] = static_cast<uint32_t>(a);
+    m_slot[m_indices[b]] = static_cast<uint32_t>(b);
+}
+
+void SubscriberList::classify(size_t slot)
+{
+    // Swapping with the first subscriber past the boundary, or the last before it, moves the boundary by one
+    const bool awake = m_indices[slot] < m_bound;
+    if (awake && slot >= m_awake) swapSlots(slot, m_awake++);
+    else if (!awake && slot < m_awake) swapSlots(slot, --m_awake);
+}
+
+size_t SubscriberList::partition(size_t awakeCount)
+{
+    if (awakeCount == m_bound) return m_awake;
+
+    const size_t first = std::min(awakeCount, m_bound);
+    const size_t last = std::max(awakeCount, m_bound);
+    m_bound = awakeCount;
+
+    // Partitioning afresh is cheaper than looking up every particle the count swept over
+    if (last - first >= m_indices.size()) {
+        m_awake = 0;
+        for (size_t slot = 0; slot < m_indices.size(); slot++) {
+            if (m_indices[slot] < m_bound) swapSlots(slot, m_awake++);
+        }
+        return m_awake;
+    }
+
+    for (size_t particle = first; particle < std::min(last, m_slot.size()); particle++) {
+        if (m_slot[particle] != NO_SLOT) classify(m_slot[particle]);
+    }
+    return m_awake;
+}
+
+void SubscriberList::remap(const ParticleRemap& remap)
+{
+    if (m_indices.empty()) return;
+    const bool resort = resortsOn(remap);
+
+    for (uint32_t removed : remap.removed) {
+        if (!contains(removed)) continue;
+
+        // The last subscriber takes the removed one's place, after the last awake one if that was awake
+        size_t slot = m_slot[removed];
+        if (slot < m_awake) swapSlots(slot, --m_awake);
+        slot = m_slot[removed];
+        const size_t last = m_indices.back();
+        m_indices[slot] = last;
+        m_slot[last] = static_cast<uint32_t>(slot);
+        m_indices.pop_back();
+        m_slot[removed] = NO_SLOT;
+    }
+
+    if (resort) {
+        // Cheaper than the remap itself, and sorted subscribers form long runs again
+        for (const ParticleMove& move : remap.moved) {
+            if (contains(move.from)) m_indices[m_slot[move.from]] = move.to;
+        }
+        std::sort(m_indices.begin(), m_indices.end());
+        m_awake = std::lower_bound(m_indices.begin(), m_indices.end(), m_bound) - m_indices.begin();
+
+        m_slot.assign(m_indices.empty() ? 0 : m_indices.back() + 1, NO_SLOT);
+        for (size_t slot = 0; slot < m_indices.size(); slot++) m_slot[m_indices[slot]] = static_cast<uint32_t>(slot);
+        return;
+    }
+
+    for (const ParticleMove& move : remap.moved) {
+        if (contains(move.from)) m_indices[m_slot[move.from]] = move.to;
+    }
+    remap.apply(m_slot, NO_SLOT);
+
+    // A moved subscriber may have crossed the partition
+    for (const ParticleMove& move : remap.moved) {
+        if (contains(move.to)) classify(m_slot[move.to]);
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include "Particle.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace VerletPhysics {
+
+    /**
+     * The indices of the particles subscribed to a generator or constraint.
+     *
+     * Besides the list itself, the `SubscriberList` remembers where in the list every subscribed
+     * particle sits, so it can follow a `ParticleRemap` in time proportional to the remap: removed
+     * subscribers are swapped out for the last one and moved ones are rewritten in place. Only a remap
+     * moving at least as many particles as there are subscribers, such as sorting the whole store,
+     * sorts the list again, so that subscribers with consecutive indices stay next to each other.
+     *
+     * Once partitioned at the store's awake count, the list keeps the subscribers below it first, so
+     * passes skipping sleeping particles stop early. Following the awake count as it changes only
+     * looks at the particles it swept over.
+     */
+    class SubscriberList
+    {
+        static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+        std::vector<size_t> m_indices; ///< Index of every subscribed particle.
+        std::vector<uint32_t> m_slot;  ///< Position in `m_indices` of every particle, or `NO_SLOT`, as far as the largest subscriber.
+        size_t m_bound = 0;            ///< Particle index the list is partitioned at.
+        size_t m_awake = 0;            ///< Number of subscribers below `m_bound`, which come first.
+
+    public:
+        /**
+         * Subscribes a particle, unless it already is.
+         *
+         * @param index Index of the particle.
+         */
+        void add(size_t index);
+
+        /**
+         * Unsubscribes every particle and releases the memory.
+         */
+        void clear();
+
+        /**
+         * Checks whether a particle is subscribed.
+         *
+         * @param index Index of the particle.
+         * @return `true` if the particle is in the list.
+         */
+        bool contains(size_t index) const { return index < m_slot.size() && m_slot[index] != NO_SLOT; }
+
+        /**
+         * Checks whether following a remap sorts the list again rather than patching it.
+         *
+         * @param remap The remap about to be followed.
+         * @return `true` if `remap` moves at least as many particles as there are subscribers.
+         */
+        bool resortsOn(const ParticleRemap& remap) const { return remap.moved.size() >= m_indices.size(); }
+
+        /**
+         * Unsubscribes removed particles and points the others at their new index.
+         *
+         * @param remap How the store renumbered its particles.
+         */
+        void remap(const ParticleRemap& remap);
+
+        /**
+         * Moves the subscribers below an awake count in front of the others.
+         *
+         * @param awakeCount The store's awake particle count.
+         * @return The number of subscribers below it, which lead the list.
+         */
+        size_t partition(size_t awakeCount);
+
+        /**
+         * Gets the subscribed particles.
+         *
+         * @return Their indices, in subscription order until a removal, a sort or a partition.
+         */
+        const std::vector<size_t>& indices() const { return m_indices; }
+
+        bool empty() const { return m_indices.empty(); }
+        size_t size() const { return m_indices.size(); }
+        const size_t* data() const { return m_indices.data(); }
+        std::vector<size_t>::const_iterator begin() const { return m_indices.begin(); }
+        std::vector<size_t>::const_iterator end() const { return m_indices.end(); }
+
+    private:
+        /**
+         * Moves the subscriber in a slot to the side of the partition its index belongs on.
+         */
+        void classify(size_t slot);
+
+        /**
+         * Exchanges the subscribers in two slots.
+         */
+        void swapSlots(size_t a, size_t b);
+    };
+}
@@ -0,0 +1,57 @@
+#include "SubstepController.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace VerletPhysics;
+
+namespace {
+
+    // An update must stay below this fraction of both tolerances before a substep is given back
+    const Real SHRINK_RATIO = Real(0.5);
+}
+
+void SubstepController::setRange(size_t minSteps, size_t maxSteps)
+{
+    m_minSteps = std::max<size_t>(minSteps, 1);
+    m_maxSteps = std::max(maxSteps, m_minSteps);
+}
+
+void SubstepController::setTolerances(Real constraintError, Real displacement)
+{
+    m_constraintTolerance = constraintError;
+    m_displacementTolerance = displacement;
+}
+
+size_t SubstepController::clamp(size_t steps) const
+{
+    return std::min(std::max(steps, m_minSteps), m_maxSteps);
+}
+
+void SubstepController::beginUpdate()
+{
+    m_constraintError = 0;
+    m_displacement = 0;
+}
+
+void SubstepController::addSubstep(Real constraintError, Real displacement)
+{
+    m_constraintError = std::max(m_constraintError, constraintError);
+    m_displacement = std::max(m_displacement, displacement);
+}
+
+size_t SubstepController::chooseNext(size_t steps)
+{
+    // Factor the substep count would have to grow by to meet each tolerance
+    const Real constraintRatio = m_constraintTolerance > 0 ? std::sqrt(m_constraintError / m_constraintTolerance) : 0;
+    const Real displacementRatio = m_displacementTolerance > 0 ? m_displacement / m_displacementTolerance : 0;
+    const Real ratio = std::max(constraintRatio, displacementRatio);
+
+    if (ratio > 1) {
+        const Real wanted = std::min(std::ceil(ratio * steps), static_cast<Real>(m_maxSteps));
+        return clamp(static_cast<size_t>(wanted));
+    }
+    if (ratio < SHRINK_RATIO && steps > 0) return clamp(steps - 1);
+
+    return clamp(steps);
+}
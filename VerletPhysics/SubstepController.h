@@ -0,0 +1,106 @@
+#pragma once
+#include "PhysicsMath.h"
+
+#include <cstddef>
+
+namespace VerletPhysics {
+
+    /**
+     * Chooses how many substeps each update needs from how stressed the previous one was.
+     *
+     * After every substep the world reports the residual stretch of its distance constraints, relative
+     * to their maximum distance, and the largest distance a particle moved, relative to its radius.
+     * Once the update finishes, the worst of each is compared with its tolerance. Constraint error
+     * shrinks roughly with the square of the substep length and displacement linearly with it, so
+     * an update that exceeded a tolerance asks for enough extra substeps to bring it back within
+     * bounds straight away. An update that stayed comfortably below both gives one substep back,
+     * which lets calm scenes settle at the minimum without oscillating.
+     */
+    class SubstepController
+    {
+        bool m_enabled = false;                    ///< Whether the substep count adapts at all.
+        size_t m_minSteps = 1;                     ///< Fewest substeps an update may use.
+        size_t m_maxSteps = 16;                    ///< Most substeps an update may use.
+        Real m_constraintTolerance = Real(0.01);   ///< Largest acceptable residual stretch, as a fraction of the maximum distance.
+        Real m_displacementTolerance = Real(0.5);  ///< Largest acceptable substep displacement, as a fraction of the radius.
+
+        Real m_constraintError = 0; ///< Worst residual stretch seen during the current or last update.
+        Real m_displacement = 0;    ///< Worst relative displacement seen during the current or last update.
+
+    public:
+        /**
+         * Enables or disables adapting the substep count.
+         *
+         * @param enabled `true` to choose the substep count of every update from the previous one.
+         */
+        void setEnabled(bool enabled) { m_enabled = enabled; }
+
+        /**
+         * Checks whether the substep count adapts.
+         *
+         * @return `true` if adaptive substepping is enabled.
+         */
+        bool isEnabled() const { return m_enabled; }
+
+        /**
+         * Sets the bounds the substep count is kept within.
+         *
+         * @param minSteps Fewest substeps an update may use, at least one.
+         * @param maxSteps Most substeps an update may use, at least `minSteps`.
+         */
+        void setRange(size_t minSteps, size_t maxSteps);
+
+        /**
+         * Sets the error levels that make an update ask for more substeps.
+         *
+         * @param constraintError Largest acceptable residual stretch of a distance constraint, as a
+         *                        fraction of its maximum distance. Zero ignores constraints.
+         * @param displacement Largest acceptable distance a particle moves in one substep, as a
+         *                     fraction of its radius. Zero ignores displacement.
+         */
+        void setTolerances(Real constraintError, Real displacement);
+
+        /**
+         * Keeps a substep count within the configured bounds.
+         *
+         * @param steps The requested substep count.
+         * @return The count clamped to the range.
+         */
+        size_t clamp(size_t steps) const;
+
+        /**
+         * Forgets the measurements of the previous update.
+         */
+        void beginUpdate();
+
+        /**
+         * Records the measurements taken after a substep.
+         *
+         * @param constraintError Largest residual stretch of any distance constraint, relative to its maximum distance.
+         * @param displacement Largest distance any particle moved during the substep, relative to its radius.
+         */
+        void addSubstep(Real constraintError, Real displacement);
+
+        /**
+         * Chooses the substep count of the next update from the measurements of the one that just finished.
+         *
+         * @param steps Substeps performed by the update that just finished.
+         * @return Substeps the next update should perform.
+         */
+        size_t chooseNext(size_t steps);
+
+        /**
+         * Gets the worst residual constraint stretch of the last update.
+         *
+         * @return The largest stretch as a fraction of the maximum distance.
+         */
+        Real getConstraintError() const { return m_constraintError; }
+
+        /**
+         * Gets the worst substep displacement of the last update.
+         *
+         * @return The largest displacement as a fraction of the particle's radius.
+         */
+        Real getDisplacement() const { return m_displacement; }
+    };
+}
@@ -0,0 +1,237 @@
+#include "SweepAndPrune.h"
+
+#include <algorithm>
+
+using namespace VerletPhysics;
+
+namespace {
+
+    // The other axis has to be spread this much wider before the sweep turns, so it never flips back and forth
+    const double AXIS_SWITCH_RATIO = 1.25;
+
+    // Sorted positions swept by one job; blocks are merged in order, keeping the pairs independent of the thread count
+    const size_t SWEEP_BLOCK_SIZE = 1024;
+
+    // Once this fraction of the entries is new, sorting from scratch beats inserting them one by one
+    const size_t FULL_SORT_DIVISOR = 8;
+}
+
+void SweepAndPrune::update(const ParticleStore& particles, ThreadPool& threadPool)
+{
+    // Sleeping particles are stored last and left out of the order
+    const size_t count = particles.getAwakeCount();
+    m_lastShifts = 0;
+
+    const bool axisChanged = chooseAxis(particles, count);
+
+    // Particles are only added, dropped or moved across the awake count along with one of these
+    size_t added = 0;
+    if (!axisChanged && (m_order.empty() || count != m_count || particles.getLayoutVersion() != m_layout || m_removed > 0)) added = compact(count);
+    m_count = count;
+    m_layout = particles.getLayoutVersion();
+
+    if (axisChanged || added > count / FULL_SORT_DIVISOR) {
+        fullSort(particles, count, threadPool);
+    }
+    else {
+        refreshExtents(particles, threadPool);
+        insertionSort();
+    }
+
+    // Gathered into sweep order, so the sweep reads nothing but sequential memory
+    const Real* centre = m_axis == 0 ? particles.positionX() : particles.positionY();
+    const Real* other = m_axis == 0 ? particles.positionY() : particles.positionX();
+    const Real* radius = particles.radius();
+    m_maximum.resize(count);
+    m_other.resize(count);
+    m_radius.resize(count);
+    threadPool.parallelFor(0, count, 4096, [this, centre, other, radius](size_t begin, size_t end) {
+        for (size_t slot = begin; slot < end; slot++) {
+            const uint32_t i = m_order[slot];
+            m_maximum[slot] = centre[i] + radius[i];
+            m_other[slot] = other[i];
+            m_radius[slot] = radius[i];
+        }
+    });
+
+    const size_t blocks = (count + SWEEP_BLOCK_SIZE - 1) / SWEEP_BLOCK_SIZE;
+    m_blockPairs.resize(blocks);
+    threadPool.parallelFor(0, blocks, 1, [this, &particles, count](size_t begin, size_t end) {
+        for (size_t block = begin; block < end; block++) {
+            m_blockPairs[block].clear();
+            sweep(particles.isStatic(), block * SWEEP_BLOCK_SIZE, std::min(count, (block + 1) * SWEEP_BLOCK_SIZE), m_blockPairs[block]);
+        }
+    });
+
+    m_pairs.clear();
+    for (size_t block = 0; block < blocks; block++) m_pairs.insert(m_pairs.end(), m_blockPairs[block].begin(), m_blockPairs[block].end());
+}
+
+void SweepAndPrune::invalidate()
+{
+    m_order.clear();
+    m_slotOf.clear();
+    m_removed = 0;
+    m_minimum.clear();
+    m_maximum.clear();
+    m_other.clear();
+    m_radius.clear();
+}
+
+void SweepAndPrune::remapParticles(const ParticleRemap& remap)
+{
+    for (uint32_t removed : remap.removed) {
+        if (removed >= m_slotOf.size() || m_slotOf[removed] == NO_SLOT) continue;
+        m_order[m_slotOf[removed]] = NO_SLOT;
+        m_slotOf[removed] = NO_SLOT;
+        m_removed++;
+    }
+
+    for (const ParticleMove& move : remap.moved) {
+        if (move.from < m_slotOf.size() && m_slotOf[move.from] != NO_SLOT) m_order[m_slotOf[move.from]] = move.to;
+    }
+    remap.apply(m_slotOf, NO_SLOT);
+}
+
+size_t SweepAndPrune::compact(size_t count)
+{
+    size_t kept = 0;
+    for (size_t slot = 0; slot < m_order.size(); slot++) {
+        const uint32_t i = m_order[slot];
+        if (i == NO_SLOT) continue;
+        if (i >= count) {
+            m_slotOf[i] = NO_SLOT;
+            continue;
+        }
+        m_order[kept] = i;
+        m_slotOf[i] = static_cast<uint32_t>(kept);
+        kept++;
+    }
+    m_order.resize(kept);
+    m_removed = 0;
+
+    // New and woken particles sit at the end of the awake ones, unless a remap moved them onto the
+    // index of a sorted one
+    m_slotOf.resize(count, NO_SLOT);
+    for (size_t i = 0; i < count; i++) {
+        if (m_slotOf[i] != NO_SLOT) continue;
+        m_slotOf[i] = static_cast<uint32_t>(m_order.size());
+        m_order.push_back(static_cast<uint32_t>(i));
+    }
+    return m_order.size() - kept;
+}
+
+bool SweepAndPrune::chooseAxis(const ParticleStore& particles, size_t count)
+{
+    if (count == 0) return false;
+
+    const Real* positionX = particles.positionX();
+    const Real* positionY = particles.positionY();
+
+    // Shifted by the first centre, so far-off scenes do not lose the variance to cancellation
+    const double shiftX = positionX[0];
+    const double shiftY = positionY[0];
+    double sumX = 0, sumY = 0, squaresX = 0, squaresY = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        const double x = positionX[i] - shiftX;
+        const double y = positionY[i] - shiftY;
+        sumX += x;
+        sumY += y;
+        squaresX += x * x;
+        squaresY += y * y;
+    }
+
+    const double variance[2] = { squaresX - sumX * sumX / count, squaresY - sumY * sumY / count };
+    const size_t widest = variance[1] > variance[0] ? 1 : 0;
+
+    if (m_order.empty()) {
+        m_axis = widest;
+        return false;
+    }
+    if (widest == m_axis || !(variance[widest] > variance[m_axis] * AXIS_SWITCH_RATIO)) return false;
+
+    m_axis = widest;
+    return true;
+}
+
+void SweepAndPrune::refreshExtents(const ParticleStore& particles, ThreadPool& threadPool)
+{
+    const Real* centre = m_axis == 0 ? particles.positionX() : particles.positionY();
+    const Real* radius = particles.radius();
+
+    m_minimum.resize(m_order.size());
+    threadPool.parallelFor(0, m_order.size(), 4096, [this, centre, radius](size_t begin, size_t end) {
+        for (size_t slot = begin; slot < end; slot++) m_minimum[slot] = centre[m_order[slot]] - radius[m_order[slot]];
+    });
+}
+
+void SweepAndPrune::insertionSort()
+{
+    size_t shifts = 0;
+
+    for (size_t slot = 1; slot < m_order.size(); slot++) {
+        const Real key = m_minimum[slot];
+        if (!(key < m_minimum[slot - 1])) continue;
+
+        const uint32_t index = m_order[slot];
+        size_t target = slot;
+        while (target > 0 && key < m_minimum[target - 1]) {
+            m_minimum[target] = m_minimum[target - 1];
+            m_order[target] = m_order[target - 1];
+            m_slotOf[m_order[target]] = static_cast<uint32_t>(target);
+            target--;
+        }
+        m_minimum[target] = key;
+        m_order[target] = index;
+        m_slotOf[index] = static_cast<uint32_t>(target);
+        shifts += slot - target;
+    }
+
+    m_lastShifts = shifts;
+}
+
+void SweepAndPrune::fullSort(const ParticleStore& particles, size_t count, ThreadPool& threadPool)
+{
+    const Real* centre = m_axis == 0 ? particles.positionX() : particles.positionY();
+    const Real* radius = particles.radius();
+
+    m_order.resize(count);
+    for (size_t i = 0; i < m_order.size(); i++) m_order[i] = static_cast<uint32_t>(i);
+
+    std::sort(m_order.begin(), m_order.end(), [centre, radius](uint32_t a, uint32_t b) {
+        const Real minimumA = centre[a] - radius[a];
+        const Real minimumB = centre[b] - radius[b];
+        return minimumA < minimumB || (!(minimumB < minimumA) && a < b);
+    });
+
+    m_slotOf.resize(m_order.size());
+    for (size_t slot = 0; slot < m_order.size(); slot++) m_slotOf[m_order[slot]] = static_cast<uint32_t>(slot);
+    m_removed = 0;
+
+    refreshExtents(particles, threadPool);
+}
+
+void SweepAndPrune::sweep(const uint8_t* isStatic, size_t begin, size_t end, std::vector<Pair>& pairs) const
+{
+    const size_t count = m_order.size();
+
+    for (size_t slot = begin; slot < end; slot++) {
+        const Real maximum = m_maximum[slot];
+        const Real other = m_other[slot];
+        const Real radius = m_radius[slot];
+
+        // Later entries start no earlier, so the first that starts past this extent ends the sweep
+        for (size_t next = slot + 1; next < count && m_minimum[next] < maximum; next++) {
+            const Real gap = m_other[next] - other;
+            const Real radii = radius + m_radius[next];
+            if (gap >= radii || gap <= -radii) continue;
+
+            const uint32_t i = m_order[slot];
+            const uint32_t j = m_order[next];
+            if (isStatic[i] && isStatic[j]) continue;
+
+            pairs.emplace_back(i, j);
+        }
+    }
+}
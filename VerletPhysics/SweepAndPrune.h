@@ -0,0 +1,142 @@
+#pragma once
+#include "Particle.h"
+#include "ThreadPool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace VerletPhysics {
+
+    /**
+     * A sort-and-sweep collision broad phase.
+     *
+     * The `SweepAndPrune` keeps every particle's extent along one axis in a list sorted by where
+     * the extent starts. Sweeping the list, a particle can only overlap those that start before its
+     * own extent ends, so candidate pairs fall out without any assumption about particle size. This
+     * makes it the better choice when radii vary widely, where a uniform grid sized for the largest
+     * particle piles the small ones into a few crowded cells. In a dense pile of similar particles,
+     * though, every extent spans a whole column of the pile, and the grid is the faster choice.
+     *
+     * The order is kept between substeps. Particles move little per substep, so re-sorting the
+     * previous order with insertion sort touches only the few entries that swapped places. The sweep
+     * runs along whichever axis the particles are spread out most on, switching, with hysteresis,
+     * when the scene changes shape. The order also survives particles being removed or moved to
+     * other indices, as every particle remembers where it sits in it. Only awake particles are kept
+     * in the order, so a sleeping pile costs nothing until it wakes.
+     */
+    class SweepAndPrune
+    {
+    public:
+        using Pair = std::pair<uint32_t, uint32_t>; ///< Indices of two particles whose bounding boxes overlap.
+
+    private:
+        static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+        size_t m_axis = 0;                 ///< Axis swept along, 0 for X and 1 for Y.
+        std::vector<uint32_t> m_order;     ///< Particle indices sorted by the start of their extent, `NO_SLOT` for removed ones.
+        std::vector<uint32_t> m_slotOf;    ///< Position in `m_order` of every particle, or `NO_SLOT` for particles not sorted in yet.
+        size_t m_removed = 0;              ///< Entries of `m_order` left by removed particles, dropped at the next update.
+        std::vector<Real> m_minimum;       ///< Start of the extent of each entry of `m_order`.
+        std::vector<Real> m_maximum;       ///< End of the extent of each entry of `m_order`.
+        std::vector<Real> m_other;         ///< Centre of each entry of `m_order` on the other axis.
+        std::vector<Real> m_radius;        ///< Radius of each entry of `m_order`.
+        size_t m_lastShifts = 0;           ///< Entries moved by the insertion sort of the last update.
+        size_t m_count = 0;                ///< Awake particle count of the last update.
+        uint64_t m_layout = 0;             ///< Layout version of the store as of the last update.
+
+        std::vector<std::vector<Pair>> m_blockPairs; ///< Candidate pairs found by each block of the sweep.
+        std::vector<Pair> m_pairs;                   ///< Candidate pairs of the last update, in sweep order.
+
+    public:
+        /**
+         * Re-sorts the particles and finds every pair whose bounding boxes overlap.
+         *
+         * Particles added or woken since the last update are sorted in, and those that fell asleep
+         * are left out. Pairs of two static particles are skipped. The pairs and their order are
+         * identical for any thread count.
+         *
+         * @param particles The particles to sweep, addressed by their index in the store.
+         * @param threadPool Pool the sweep is split across.
+         */
+        void update(const ParticleStore& particles, ThreadPool& threadPool);
+
+        /**
+         * Forgets the sorted order, so the next update sorts from scratch.
+         */
+        void invalidate();
+
+        /**
+         * Points the sorted order at the new particle indices and drops removed particles from it at
+         * the next update. Particles moved onto an index that was not sorted in yet are sorted in
+         * along with newly added ones.
+         *
+         * @param remap The removed particles and every particle that changed index.
+         */
+        void remapParticles(const ParticleRemap& remap);
+
+        /**
+         * Gets the candidate pairs found by the last update.
+         *
+         * @return Pairs of particle indices, ordered by the sorted position of their first particle.
+         */
+        const std::vector<Pair>& getPairs() const { return m_pairs; }
+
+        /**
+         * Gets the axis the last update swept along.
+         *
+         * @return 0 for the X axis, 1 for the Y axis.
+         */
+        size_t getAxis() const { return m_axis; }
+
+        /**
+         * Gets how many entries the insertion sort of the last update moved.
+         *
+         * @return The number of single-place shifts, or zero if the last update sorted from scratch.
+         */
+        size_t getLastShiftCount() const { return m_lastShifts; }
+
+    private:
+        /**
+         * Chooses the axis to sweep along from the spread of the centres of the first `count` particles.
+         *
+         * @return `true` if the axis changed and the order has to be sorted from scratch.
+         */
+        bool chooseAxis(const ParticleStore& particles, size_t count);
+
+        /**
+         * Stores the extent of every entry of the order along the current axis.
+         */
+        void refreshExtents(const ParticleStore& particles, ThreadPool& threadPool);
+
+        /**
+         * Restores the order with insertion sort, keeping equal entries in their previous order.
+         */
+        void insertionSort();
+
+        /**
+         * Sorts the first `count` particles from scratch, breaking ties by particle index.
+         */
+        void fullSort(const ParticleStore& particles, size_t count, ThreadPool& threadPool);
+
+        /**
+         * Drops the entries of removed particles and of those from `count` on, and appends every
+         * particle below it not sorted in yet.
+         *
+         * @return The number of entries appended.
+         */
+        size_t compact(size_t count);
+
+        /**
+         * Sweeps part of the sorted order for overlapping pairs.
+         *
+         * Reads only the per-entry arrays, which lie in sweep order, so the scan stays sequential.
+         *
+         * @param begin First sorted position to sweep from.
+         * @param end One past the last sorted position to sweep from.
+         * @param pairs Receives the pairs found.
+         */
+        void sweep(const uint8_t* isStatic, size_t begin, size_t end, std::vector<Pair>& pairs) const;
+    };
+}
@@ -0,0 +1,87 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+using namespace VerletPhysics;
+
+ThreadPool::ThreadPool(size_t threadCount)
+{
+    if (threadCount == 0) threadCount = std::max<size_t>(1, std::thread::hardware_concurrency());
+
+    for (size_t i = 1; i < threadCount; i++) {
+        m_workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_workReady.notify_all();
+
+    for (std::thread& worker : m_workers) worker.join();
+}
+
+void ThreadPool::parallelFor(size_t begin, size_t end, size_t grainSize, const std::function<void(size_t, size_t)>& task)
+{
+    if (begin >= end) return;
+
+    // Aim for a few chunks per thread so uneven chunks still balance out
+    const size_t count = end - begin;
+    const size_t chunkSize = std::max<size_t>(std::max<size_t>(grainSize, 1), (count + getThreadCount() * 4 - 1) / (getThreadCount() * 4));
+
+    if (m_workers.empty() || chunkSize >= count) {
+        task(begin, end);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_task = &task;
+    m_taskBegin = begin;
+    m_taskEnd = end;
+    m_chunkSize = chunkSize;
+    m_chunkCount = (count + chunkSize - 1) / chunkSize;
+    m_nextChunk = 0;
+    m_busyWorkers = m_workers.size();
+    m_generation++;
+
+    m_workReady.notify_all();
+
+    runChunks(lock);
+
+    m_workDone.wait(lock, [this] { return m_busyWorkers == 0; });
+    m_task = nullptr;
+}
+
+void ThreadPool::workerLoop()
+{
+    size_t seenGeneration = 0;
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true) {
+        m_workReady.wait(lock, [&] { return m_stopping || m_generation != seenGeneration; });
+        if (m_stopping) return;
+
+        seenGeneration = m_generation;
+        runChunks(lock);
+
+        if (--m_busyWorkers == 0) m_workDone.notify_one();
+    }
+}
+
+void ThreadPool::runChunks(std::unique_lock<std::mutex>& lock)
+{
+    while (m_nextChunk < m_chunkCount) {
+        const size_t chunk = m_nextChunk++;
+        const size_t chunkBegin = m_taskBegin + chunk * m_chunkSize;
+        const size_t chunkEnd = std::min(chunkBegin + m_chunkSize, m_taskEnd);
+        const std::function<void(size_t, size_t)>& task = *m_task;
+
+        lock.unlock();
+        task(chunkBegin, chunkEnd);
+        lock.lock();
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace VerletPhysics {
+
+    /**
+     * A persistent pool of worker threads for data-parallel loops.
+     *
+     * The `ThreadPool` spawns its workers once and keeps them parked between jobs, so a simulation
+     * can split every phase of every substep across threads without paying thread creation costs.
+     * The calling thread always takes part in the work, so a pool of one thread has no workers
+     * and simply runs each job inline.
+     */
+    class ThreadPool
+    {
+        std::vector<std::thread> m_workers; ///< Worker threads, excluding the calling thread.
+
+        std::mutex m_mutex;                  ///< Guards the job description below.
+        std::condition_variable m_workReady; ///< Signalled when a new job is published.
+        std::condition_variable m_workDone;  ///< Signalled when the last worker finishes a job.
+
+        const std::function<void(size_t, size_t)>* m_task = nullptr; ///< Job being executed.
+        size_t m_taskBegin = 0;     ///< First index of the job.
+        size_t m_taskEnd = 0;       ///< One past the last index of the job.
+        size_t m_chunkSize = 1;     ///< Number of indices handed out at a time.
+        size_t m_chunkCount = 0;    ///< Number of chunks in the job.
+        size_t m_nextChunk = 0;     ///< Next chunk to be handed out.
+        size_t m_busyWorkers = 0;   ///< Workers that have not yet finished the current job.
+        size_t m_generation = 0;    ///< Incremented every time a job is published.
+        bool m_stopping = false;    ///< Set when the pool is being destroyed.
+
+    public:
+        /**
+         * Constructs a ThreadPool object.
+         *
+         * @param threadCount Total number of threads to use, including the calling thread.
+         *                    Zero selects the hardware concurrency.
+         */
+        explicit ThreadPool(size_t threadCount);
+
+        /**
+         * Stops and joins all worker threads.
+         */
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        /**
+         * Gets the total number of threads working on each job.
+         *
+         * @return The worker count plus the calling thread.
+         */
+        size_t getThreadCount() const { return m_workers.size() + 1; }
+
+        /**
+         * Runs a task over an index range, split into chunks across all threads.
+         *
+         * Blocks until every chunk has completed, which makes each call a barrier between phases.
+         *
+         * @param begin First index of the range.
+         * @param end One past the last index of the range.
+         * @param grainSize Smallest number of indices worth handing to a thread.
+         * @param task Callable invoked with the `[begin, end)` bounds of each chunk.
+         */
+        void parallelFor(size_t begin, size_t end, size_t grainSize, const std::function<void(size_t, size_t)>& task);
+
+    private:
+        /**
+         * Body of every worker thread.
+         */
+        void workerLoop();
+
+        /**
+         * Claims and executes chunks of the current job until none remain.
+         */
+        void runChunks(std::unique_lock<std::mutex>& lock);
+    };
+}
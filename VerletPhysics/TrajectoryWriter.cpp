@@ -0,0 +1,249 @@
+#include "TrajectoryWriter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using namespace VerletPhysics;
+
+namespace {
+
+    constexpr uint32_t FORMAT_VERSION = 1;
+    constexpr size_t MAX_PENDING_CHUNKS = 4; // Full chunks queued before `writeFrame` waits for the writer thread
+
+    void appendU32(std::vector<uint8_t>& buffer, uint32_t value)
+    {
+        for (int shift = 0; shift < 32; shift += 8) buffer.push_back(static_cast<uint8_t>(value >> shift));
+    }
+
+    void appendF32(std::vector<uint8_t>& buffer, float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        appendU32(buffer, bits);
+    }
+
+    void appendF64(std::vector<uint8_t>& buffer, double value)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        appendU32(buffer, static_cast<uint32_t>(bits));
+        appendU32(buffer, static_cast<uint32_t>(bits >> 32));
+    }
+
+    void appendVarint(std::vector<uint8_t>& buffer, uint64_t value)
+    {
+        while (value >= 0x80) {
+            buffer.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        buffer.push_back(static_cast<uint8_t>(value));
+    }
+
+    uint64_t zigzag(int64_t value)
+    {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    /**
+     * Rounds a position to the quantum grid, clamping it to the int32 range the file stores.
+     *
+     * @param inRange Cleared if the position is not finite or lies outside that range.
+     */
+    int32_t quantize(Real value, double quantum, bool& inRange)
+    {
+        const double steps = std::round(value / quantum);
+        const double low = std::numeric_limits<int32_t>::min();
+        const double high = std::numeric_limits<int32_t>::max();
+        if (steps >= low && steps <= high) return static_cast<int32_t>(steps);
+
+        inRange = false;
+        return steps > high ? std::numeric_limits<int32_t>::max() : steps < low ? std::numeric_limits<int32_t>::min() : 0;
+    }
+}
+
+TrajectoryWriter::TrajectoryWriter(const std::string& path, size_t particleCount, double timestep,
+    TrajectoryCompression compression, double quantum, size_t framesPerChunk) :
+    m_file(path, std::ios::binary | std::ios::trunc),
+    c_particleCount(particleCount),
+    c_compression(compression),
+    c_framesPerChunk(framesPerChunk == 0 ? 1 : framesPerChunk),
+    c_quantum(quantum > 0 ? quantum : 0.01)
+{
+    std::vector<uint8_t> header;
+    header.insert(header.end(), { 'V', 'T', 'R', 'J' });
+    appendU32(header, FORMAT_VERSION);
+    appendU32(header, static_cast<uint32_t>(c_particleCount));
+    appendU32(header, static_cast<uint32_t>(c_compression));
+    appendU32(header, static_cast<uint32_t>(c_framesPerChunk));
+    appendF64(header, timestep);
+    appendF64(header, c_quantum);
+
+    m_file.write(reinterpret_cast<const char*>(header.data()), header.size());
+    m_failed = !m_file;
+
+    m_current.x.reserve(c_particleCount * c_framesPerChunk);
+    m_current.y.reserve(c_particleCount * c_framesPerChunk);
+
+    m_thread = std::thread(&TrajectoryWriter::writerLoop, this);
+}
+
+TrajectoryWriter::~TrajectoryWriter()
+{
+    close();
+}
+
+void TrajectoryWriter::writeFrame(const ParticleStore& particles)
+{
+    // Frames are laid out by creation slot, which a removal leaves pointing at another particle or none
+    if (particles.size() != c_particleCount || particles.getRemovedCount() != 0) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_failed = true;
+        return;
+    }
+
+    if (m_current.frameCount == 0) m_current.firstFrame = m_frameCount;
+
+    if (particles.getLayoutVersion() == 0) {
+        m_current.x.insert(m_current.x.end(), particles.positionX(), particles.positionX() + c_particleCount);
+        m_current.y.insert(m_current.y.end(), particles.positionY(), particles.positionY() + c_particleCount);
+    }
+    else {
+        // Particles keep the slot they were added in, however the store has been sorted since
+        for (size_t created = 0; created < c_particleCount; created++) {
+            const size_t i = particles.getIndexOfCreated(created);
+            m_current.x.push_back(particles.positionX()[i]);
+            m_current.y.push_back(particles.positionY()[i]);
+        }
+    }
+    m_current.frameCount++;
+    m_frameCount++;
+
+    if (m_current.frameCount == c_framesPerChunk) submitChunk();
+}
+
+bool TrajectoryWriter::close()
+{
+    if (!m_thread.joinable()) return !m_failed;
+
+    if (m_current.frameCount > 0) submitChunk();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closing = true;
+    }
+    m_chunkReady.notify_one();
+    m_thread.join();
+
+    m_file.flush();
+    m_failed = m_failed || !m_file;
+    return !m_failed;
+}
+
+bool TrajectoryWriter::isGood()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return !m_failed;
+}
+
+void TrajectoryWriter::submitChunk()
+{
+    {
+        // Wait for the writer thread when the disk falls behind, rather than queueing without bound
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_chunkWritten.wait(lock, [this] { return m_pending.size() < MAX_PENDING_CHUNKS; });
+        m_pending.push_back(std::move(m_current));
+
+        // Recycle a written chunk's buffers so steady state streaming does not allocate
+        if (!m_spare.empty()) {
+            m_current = std::move(m_spare.back());
+            m_spare.pop_back();
+        }
+        else {
+            m_current = Chunk();
+        }
+    }
+    m_chunkReady.notify_one();
+
+    m_current.frameCount = 0;
+    m_current.x.clear();
+    m_current.y.clear();
+    m_current.x.reserve(c_particleCount * c_framesPerChunk);
+    m_current.y.reserve(c_particleCount * c_framesPerChunk);
+}
+
+void TrajectoryWriter::writerLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true) {
+        m_chunkReady.wait(lock, [this] { return m_closing || !m_pending.empty(); });
+        if (m_pending.empty()) return;
+
+        Chunk chunk = std::move(m_pending.front());
+        m_pending.pop_front();
+        lock.unlock();
+        m_chunkWritten.notify_one();
+
+        const bool inRange = encodeChunk(chunk);
+        m_file.write(reinterpret_cast<const char*>(m_payload.data()), m_payload.size());
+        const bool failed = !m_file || !inRange;
+
+        lock.lock();
+        m_failed = m_failed || failed;
+        m_spare.push_back(std::move(chunk));
+    }
+}
+
+bool TrajectoryWriter::encodeChunk(const Chunk& chunk)
+{
+    bool inRange = true;
+
+    m_payload.clear();
+    m_payload.insert(m_payload.end(), { 'C', 'H', 'N', 'K' });
+    appendU32(m_payload, chunk.firstFrame);
+    appendU32(m_payload, chunk.frameCount);
+    appendU32(m_payload, 0);
+
+    const size_t headerSize = m_payload.size();
+    const size_t n = c_particleCount;
+
+    for (size_t frame = 0; frame < chunk.frameCount; frame++) {
+        const Real* arrays[2] = { chunk.x.data() + frame * n, chunk.y.data() + frame * n };
+
+        for (size_t axis = 0; axis < 2; axis++) {
+            const Real* values = arrays[axis];
+
+            switch (c_compression) {
+            case TrajectoryCompression::None:
+                for (size_t i = 0; i < n; i++) appendF32(m_payload, static_cast<float>(values[i]));
+                break;
+
+            case TrajectoryCompression::Quantized:
+                for (size_t i = 0; i < n; i++) appendU32(m_payload, static_cast<uint32_t>(quantize(values[i], c_quantum, inRange)));
+                break;
+
+            case TrajectoryCompression::QuantizedDelta:
+                if (frame == 0) {
+                    for (size_t i = 0; i < n; i++) appendU32(m_payload, static_cast<uint32_t>(quantize(values[i], c_quantum, inRange)));
+                }
+                else {
+                    // Differences of quantized values, so decoding accumulates no rounding drift, taken
+                    // in 64 bits as two int32 values can be further apart than an int32 holds
+                    const Real* previous = values - n;
+                    for (size_t i = 0; i < n; i++) {
+                        const int64_t delta = static_cast<int64_t>(quantize(values[i], c_quantum, inRange)) - quantize(previous[i], c_quantum, inRange);
+                        appendVarint(m_payload, zigzag(delta));
+                    }
+                }
+                break;
+            }
+        }
+    }
+
+    // Patch the payload size now that it is known
+    const uint32_t payloadSize = static_cast<uint32_t>(m_payload.size() - headerSize);
+    for (size_t byte = 0; byte < 4; byte++) m_payload[headerSize - 4 + byte] = static_cast<uint8_t>(payloadSize >> (byte * 8));
+    return inRange;
+}
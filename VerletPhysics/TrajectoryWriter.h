@@ -0,0 +1,162 @@
+#pragma once
+#include "Particle.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace VerletPhysics {
+
+    /**
+     * Encodings a `TrajectoryWriter` can store particle positions with.
+     */
+    enum class TrajectoryCompression : uint32_t
+    {
+        None = 0,          ///< Raw 32-bit float x and y arrays per frame.
+        Quantized = 1,     ///< Positions rounded to a grid of `quantum` and stored as 32-bit integers.
+        QuantizedDelta = 2 ///< Quantized positions stored as zigzag varint deltas from the previous frame.
+    };
+
+    /**
+     * Streams particle positions to a compact, chunked binary trajectory file.
+     *
+     * Frames are copied into an in-memory chunk on the simulation thread. Full chunks are handed to a
+     * background thread that encodes and writes them, so file I/O only stalls the simulation once the
+     * disk falls a few chunks behind, at which point `writeFrame` waits rather than queueing more.
+     *
+     * All values are little-endian. The file starts with a header:
+     *
+     *     char[4]  magic "VTRJ"
+     *     uint32   format version (1)
+     *     uint32   particle count
+     *     uint32   compression, a `TrajectoryCompression`
+     *     uint32   frames per chunk
+     *     float64  timestep between frames
+     *     float64  quantum of quantized encodings
+     *
+     * followed by chunks, each with a header and a payload:
+     *
+     *     char[4]  magic "CHNK"
+     *     uint32   index of the first frame in the chunk
+     *     uint32   frame count
+     *     uint32   payload size in bytes
+     *
+     * With `None` every frame is `particleCount` float x values then `particleCount` float y values.
+     * `Quantized` stores `round(position / quantum)` as int32 in the same layout, clamped to the int32
+     * range. `QuantizedDelta` stores the first frame of each chunk like `Quantized` and every following
+     * frame as the zigzag-encoded LEB128 varint difference from the previous frame, up to 64 bits wide,
+     * so every chunk decodes on its own. A position that had to be clamped fails the writer.
+     */
+    class TrajectoryWriter
+    {
+        /**
+         * Raw positions of consecutive frames, waiting to be encoded.
+         */
+        struct Chunk
+        {
+            uint32_t firstFrame = 0;  ///< Index of the first frame in the chunk.
+            uint32_t frameCount = 0;  ///< Number of frames copied into the chunk.
+            std::vector<Real> x;      ///< X positions, one block of particles per frame.
+            std::vector<Real> y;      ///< Y positions, one block of particles per frame.
+        };
+
+        std::ofstream m_file;                       ///< Destination of the trajectory.
+        const size_t c_particleCount;               ///< Particles stored per frame.
+        const TrajectoryCompression c_compression;  ///< Encoding of the chunk payloads.
+        const size_t c_framesPerChunk;              ///< Frames collected before a chunk is handed off.
+        const double c_quantum;                     ///< Grid size of quantized encodings.
+
+        Chunk m_current;           ///< Chunk being filled by the simulation thread.
+        uint32_t m_frameCount = 0; ///< Frames written so far.
+
+        std::mutex m_mutex;                       ///< Guards the queues and flags below.
+        std::condition_variable m_chunkReady;     ///< Signalled when a chunk is queued or the writer closes.
+        std::condition_variable m_chunkWritten;   ///< Signalled when the writer thread takes a chunk off the queue.
+        std::deque<Chunk> m_pending;              ///< Full chunks waiting for the writer thread.
+        std::vector<Chunk> m_spare;               ///< Written chunks whose buffers can be reused.
+        bool m_closing = false;                   ///< Set when no further chunks will be queued.
+        bool m_failed = false;                    ///< Set when writing to the file failed.
+        std::thread m_thread;                     ///< Background thread encoding and writing chunks.
+
+        std::vector<uint8_t> m_payload;           ///< Encoding buffer of the writer thread.
+
+    public:
+        /**
+         * Constructs a TrajectoryWriter object and writes the file header.
+         *
+         * @param path Path of the trajectory file to create or overwrite.
+         * @param particleCount Number of particles stored in every frame.
+         * @param timestep Simulated time between frames, recorded in the header.
+         * @param compression Encoding used for the positions.
+         * @param quantum Grid size positions are rounded to by the quantized encodings.
+         * @param framesPerChunk Number of frames grouped into each chunk.
+         */
+        TrajectoryWriter(const std::string& path, size_t particleCount, double timestep,
+            TrajectoryCompression compression = TrajectoryCompression::None, double quantum = 0.01, size_t framesPerChunk = 64);
+
+        /**
+         * Flushes any remaining frames and joins the writer thread.
+         */
+        ~TrajectoryWriter();
+
+        TrajectoryWriter(const TrajectoryWriter&) = delete;
+        TrajectoryWriter& operator=(const TrajectoryWriter&) = delete;
+
+        /**
+         * Appends the current positions of every particle as a new frame.
+         *
+         * Particles are written in the order they were added to the store, even after it was sorted.
+         * Blocks while the writer thread is several chunks behind. Fails the writer without writing
+         * anything if the store does not hold the particle count given on construction, or if any
+         * particle was ever removed from it, since frames can then no longer be laid out by creation order.
+         *
+         * @param particles The store to copy positions from.
+         */
+        void writeFrame(const ParticleStore& particles);
+
+        /**
+         * Writes any remaining frames and waits until everything has reached the file.
+         *
+         * @return True if every chunk was written successfully.
+         */
+        bool close();
+
+        /**
+         * Checks whether the file could be opened and every frame so far was written in full.
+         *
+         * @return True while the writer is healthy.
+         */
+        bool isGood();
+
+        /**
+         * Gets the number of frames written so far.
+         *
+         * @return The frame count.
+         */
+        uint32_t getFrameCount() const { return m_frameCount; }
+
+    private:
+        /**
+         * Queues the current chunk for the writer thread and starts a new one.
+         */
+        void submitChunk();
+
+        /**
+         * Body of the writer thread.
+         */
+        void writerLoop();
+
+        /**
+         * Encodes a chunk into `m_payload` using the configured compression.
+         *
+         * @return False if a quantized position had to be clamped to the int32 range.
+         */
+        bool encodeChunk(const Chunk& chunk);
+    };
+}
@@ -0,0 +1,432 @@
+#include "WorldSnapshot.h"
+
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace VerletPhysics;
+
+namespace {
+
+    constexpr char MAGIC[8] = { 'V', 'R', 'L', 'T', 'S', 'N', 'A', 'P' };
+    constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+    constexpr size_t PARTICLE_ARRAY_COUNT = 6;
+
+    size_t alignSection(size_t offset)
+    {
+        return (offset + 15) & ~size_t(15);
+    }
+
+    size_t particleSectionSize(size_t particleCount)
+    {
+        return alignSection(particleCount * sizeof(Real)) * PARTICLE_ARRAY_COUNT + alignSection(particleCount);
+    }
+
+    /**
+     * A read-only memory mapping of a whole file, unmapped on destruction.
+     */
+    class MappedFile
+    {
+        const uint8_t* m_data = nullptr;
+        size_t m_size = 0;
+#ifdef _WIN32
+        HANDLE m_file = INVALID_HANDLE_VALUE;
+        HANDLE m_mapping = nullptr;
+#endif
+
+    public:
+        explicit MappedFile(const std::string& path)
+        {
+#ifdef _WIN32
+            m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (m_file == INVALID_HANDLE_VALUE) return;
+
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0) return;
+
+            m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!m_mapping) return;
+
+            m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+            if (m_data) m_size = static_cast<size_t>(size.QuadPart);
+#else
+            const int file = open(path.c_str(), O_RDONLY);
+            if (file < 0) return;
+
+            struct stat status;
+            if (fstat(file, &status) == 0 && status.st_size > 0) {
+                void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+                if (data != MAP_FAILED) {
+                    m_data = static_cast<const uint8_t*>(data);
+                    m_size = static_cast<size_t>(status.st_size);
+                }
+            }
+
+            close(file);
+#endif
+        }
+
+        ~MappedFile()
+        {
+#ifdef _WIN32
+            if (m_data) UnmapViewOfFile(m_data);
+            if (m_mapping) CloseHandle(m_mapping);
+            if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+#else
+            if (m_data) munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const uint8_t* data() const { return m_data; }
+        size_t size() const { return m_size; }
+    };
+
+    void writeSection(std::vector<uint8_t>& image, size_t offset, const void* data, size_t size)
+    {
+        if (size > 0) std::memcpy(image.data() + offset, data, size);
+    }
+
+    void appendSubscribers(std::vector<uint32_t>& subscriptions, const std::vector<size_t>& subscribers, uint64_t& first, uint64_t& count)
+    {
+        first = subscriptions.size();
+        count = subscribers.size();
+        for (size_t index : subscribers) subscriptions.push_back(static_cast<uint32_t>(index));
+    }
+}
+
+bool WorldSnapshot::save(const SimulationWorld& world, const std::string& path)
+{
+    const ParticleStore& particles = world.m_particles;
+    const size_t particleCount = particles.size();
+
+    std::vector<GeneratorRecord> generators;
+    std::vector<ConstraintRecord> constraints;
+    std::vector<uint32_t> subscriptions;
+    std::vector<WindFieldRecord> windFields;
+    std::vector<Real> grid;
+    std::vector<SpringRecord> springs;
+
+    for (const ForceGenerator* generator : world.m_generators) {
+        GeneratorRecord record = {};
+
+        // Springs are the one generator type without subscribers, so they are recorded on their own
+        if (const SpringForce* spring = dynamic_cast<const SpringForce*>(generator)) {
+            record.type = GeneratorType::Spring;
+            record.firstRecord = springs.size();
+            record.recordCount = spring->m_springA.size();
+            for (size_t s = 0; s < spring->m_springA.size(); s++) {
+                springs.push_back({ spring->m_springA[s], spring->m_springB[s], spring->m_restLength[s], spring->m_stiffness[s], spring->m_damping[s] });
+            }
+            generators.push_back(record);
+            continue;
+        }
+
+        if (const ConstantAcceleration* acceleration = dynamic_cast<const ConstantAcceleration*>(generator)) {
+            record.type = GeneratorType::ConstantAcceleration;
+            record.parameters[0] = acceleration->getAcceleration().x();
+            record.parameters[1] = acceleration->getAcceleration().y();
+        }
+        else if (const DragForce* drag = dynamic_cast<const DragForce*>(generator)) {
+            record.type = GeneratorType::Drag;
+            record.parameters[0] = drag->getCoefficient();
+        }
+        else if (const RadialAttractor* attractor = dynamic_cast<const RadialAttractor*>(generator)) {
+            record.type = GeneratorType::RadialAttractor;
+            record.parameters[0] = attractor->getCenter().x();
+            record.parameters[1] = attractor->getCenter().y();
+            record.parameters[2] = attractor->getStrength();
+            record.parameters[3] = attractor->getSoftening();
+        }
+        else if (const NBodyGravity* gravity = dynamic_cast<const NBodyGravity*>(generator)) {
+            record.type = GeneratorType::NBodyGravity;
+            record.parameters[0] = gravity->getGravitationalConstant();
+            record.parameters[1] = gravity->getOpeningAngle();
+            record.parameters[2] = gravity->getSoftening();
+        }
+        else if (const WindField* wind = dynamic_cast<const WindField*>(generator)) {
+            record.type = GeneratorType::WindField;
+            record.firstRecord = windFields.size();
+            record.recordCount = 1;
+            windFields.push_back({ { wind->getOrigin().x(), wind->getOrigin().y() }, wind->getCellSize(), wind->getColumns(), wind->getRows(), grid.size() });
+            grid.insert(grid.end(), wind->m_forceX.begin(), wind->m_forceX.end());
+            grid.insert(grid.end(), wind->m_forceY.begin(), wind->m_forceY.end());
+        }
+        else {
+            return false;
+        }
+
+        // Every generator type the format knows is a bulk generator
+        const BulkForceGenerator* bulk = static_cast<const BulkForceGenerator*>(generator);
+        if (bulk->isSubscribedToAll()) record.flags |= GENERATOR_ALL_PARTICLES;
+        appendSubscribers(subscriptions, bulk->getSubscribers(), record.firstSubscription, record.subscriptionCount);
+
+        generators.push_back(record);
+    }
+
+    // Paired constraints are restored in solver order with their colours, so they recolour identically
+    const std::vector<PairedParticleConstraint*>& pairs = world.m_distanceSolver.getConstraints();
+    for (size_t i = 0; i < pairs.size(); i++) {
+        const PairedParticleConstraint* paired = pairs[i];
+        ConstraintRecord record = {};
+        record.type = ConstraintType::PairedParticle;
+        record.enabled = paired->isEnabled();
+        record.colour = world.m_distanceSolver.getColour(i);
+        record.indexA = paired->getIndexA();
+        record.indexB = paired->getIndexB();
+        record.parameters[0] = paired->getMaxDistance();
+        constraints.push_back(record);
+    }
+
+    for (const BoxedPositionConstraint* box : world.m_positionSolver.getBoxes()) {
+        ConstraintRecord record = {};
+        record.type = ConstraintType::BoxedPosition;
+        record.enabled = box->isEnabled();
+        record.parameters[0] = box->getMinCorner().x();
+        record.parameters[1] = box->getMinCorner().y();
+        record.parameters[2] = box->getMaxCorner().x();
+        record.parameters[3] = box->getMaxCorner().y();
+        appendSubscribers(subscriptions, box->getSubscribers(), record.firstSubscription, record.subscriptionCount);
+        constraints.push_back(record);
+    }
+
+    for (const EncircledPositionConstraint* circle : world.m_positionSolver.getCircles()) {
+        ConstraintRecord record = {};
+        record.type = ConstraintType::EncircledPosition;
+        record.enabled = circle->isEnabled();
+        record.parameters[0] = circle->getRadius();
+        record.parameters[1] = circle->getCenterPoint().x();
+        record.parameters[2] = circle->getCenterPoint().y();
+        appendSubscribers(subscriptions, circle->getSubscribers(), record.firstSubscription, record.subscriptionCount);
+        constraints.push_back(record);
+    }
+
+    // Constraints without a batched solver are of types the format does not know
+    if (!world.m_constraints.empty()) return false;
+
+    Header header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.byteOrderMark = BYTE_ORDER_MARK;
+    header.realSize = sizeof(Real);
+    header.handleCollisions = world.c_handleCollisions;
+    header.steps = world.m_steps;
+    header.particleCount = particleCount;
+    header.generatorCount = generators.size();
+    header.constraintCount = constraints.size();
+    header.subscriptionCount = subscriptions.size();
+    header.windFieldCount = windFields.size();
+    header.gridValueCount = grid.size();
+    header.springCount = springs.size();
+    header.particleOffset = alignSection(sizeof(Header));
+    header.generatorOffset = header.particleOffset + particleSectionSize(particleCount);
+    header.constraintOffset = alignSection(header.generatorOffset + generators.size() * sizeof(GeneratorRecord));
+    header.subscriptionOffset = alignSection(header.constraintOffset + constraints.size() * sizeof(ConstraintRecord));
+    header.windFieldOffset = alignSection(header.subscriptionOffset + subscriptions.size() * sizeof(uint32_t));
+    header.gridOffset = alignSection(header.windFieldOffset + windFields.size() * sizeof(WindFieldRecord));
+    header.springOffset = alignSection(header.gridOffset + grid.size() * sizeof(Real));
+    header.fileSize = alignSection(header.springOffset + springs.size() * sizeof(SpringRecord));
+
+    std::vector<uint8_t> image(header.fileSize, 0);
+    writeSection(image, 0, &header, sizeof(header));
+
+    const Real* arrays[PARTICLE_ARRAY_COUNT] = { particles.positionX(), particles.positionY(), particles.previousX(),
+        particles.previousY(), particles.inverseMass(), particles.radius() };
+
+    size_t offset = header.particleOffset;
+    for (const Real* array : arrays) {
+        writeSection(image, offset, array, particleCount * sizeof(Real));
+        offset += alignSection(particleCount * sizeof(Real));
+    }
+    writeSection(image, offset, particles.isStatic(), particleCount);
+
+    writeSection(image, header.generatorOffset, generators.data(), generators.size() * sizeof(GeneratorRecord));
+    writeSection(image, header.constraintOffset, constraints.data(), constraints.size() * sizeof(ConstraintRecord));
+    writeSection(image, header.subscriptionOffset, subscriptions.data(), subscriptions.size() * sizeof(uint32_t));
+    writeSection(image, header.windFieldOffset, windFields.data(), windFields.size() * sizeof(WindFieldRecord));
+    writeSection(image, header.gridOffset, grid.data(), grid.size() * sizeof(Real));
+    writeSection(image, header.springOffset, springs.data(), springs.size() * sizeof(SpringRecord));
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(image.data()), image.size());
+    return static_cast<bool>(file);
+}
+
+std::unique_ptr<SimulationWorld> WorldSnapshot::load(const std::string& path, size_t threadCount)
+{
+    MappedFile file(path);
+    if (file.size() < sizeof(Header)) return nullptr;
+
+    Header header;
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION) return nullptr;
+    if (header.byteOrderMark != BYTE_ORDER_MARK || header.realSize != sizeof(Real)) return nullptr;
+    if (header.fileSize != file.size()) return nullptr;
+
+    const uint64_t particleCount = header.particleCount;
+    if (particleCount > header.fileSize || header.generatorCount > header.fileSize
+        || header.constraintCount > header.fileSize || header.subscriptionCount > header.fileSize
+        || header.windFieldCount > header.fileSize || header.gridValueCount > header.fileSize
+        || header.springCount > header.fileSize) return nullptr;
+
+    // Offsets are bounded on their own before sizes are added, so a crafted offset cannot wrap
+    // around, and must keep the records they point at aligned within the page-aligned mapping
+    auto validSection = [&](uint64_t offset, uint64_t size) {
+        return offset % 16 == 0 && offset <= header.fileSize && size <= header.fileSize - offset;
+    };
+    if (!validSection(header.particleOffset, particleSectionSize(particleCount))
+        || !validSection(header.generatorOffset, header.generatorCount * sizeof(GeneratorRecord))
+        || !validSection(header.constraintOffset, header.constraintCount * sizeof(ConstraintRecord))
+        || !validSection(header.subscriptionOffset, header.subscriptionCount * sizeof(uint32_t))
+        || !validSection(header.windFieldOffset, header.windFieldCount * sizeof(WindFieldRecord))
+        || !validSection(header.gridOffset, header.gridValueCount * sizeof(Real))
+        || !validSection(header.springOffset, header.springCount * sizeof(SpringRecord))) return nullptr;
+
+    std::unique_ptr<SimulationWorld> world = std::make_unique<SimulationWorld>(header.steps, header.handleCollisions != 0, threadCount);
+    ParticleStore& particles = world->m_particles;
+    particles.grow(particleCount);
+
+    Real* arrays[PARTICLE_ARRAY_COUNT] = { particles.positionX(), particles.positionY(), particles.previousX(),
+        particles.previousY(), particles.inverseMass(), particles.radius() };
+
+    const uint8_t* section = file.data() + header.particleOffset;
+    for (Real* array : arrays) {
+        if (particleCount > 0) std::memcpy(array, section, particleCount * sizeof(Real));
+        section += alignSection(particleCount * sizeof(Real));
+    }
+    if (particleCount > 0) std::memcpy(particles.isStatic(), section, particleCount);
+
+    // Islands are not part of the snapshot, so particles saved asleep are restored awake
+    uint8_t* flags = particles.isStatic();
+    for (uint64_t i = 0; i < particleCount; i++) flags[i] &= ParticleStore::STATIC_FLAG;
+
+    const GeneratorRecord* generators = reinterpret_cast<const GeneratorRecord*>(file.data() + header.generatorOffset);
+    const ConstraintRecord* constraints = reinterpret_cast<const ConstraintRecord*>(file.data() + header.constraintOffset);
+    const uint32_t* subscriptions = reinterpret_cast<const uint32_t*>(file.data() + header.subscriptionOffset);
+    const WindFieldRecord* windFields = reinterpret_cast<const WindFieldRecord*>(file.data() + header.windFieldOffset);
+    const Real* grid = reinterpret_cast<const Real*>(file.data() + header.gridOffset);
+    const SpringRecord* springs = reinterpret_cast<const SpringRecord*>(file.data() + header.springOffset);
+
+    auto validSubscribers = [&](uint64_t first, uint64_t count) {
+        if (first > header.subscriptionCount || count > header.subscriptionCount - first) return false;
+        for (uint64_t i = first; i < first + count; i++) {
+            if (subscriptions[i] >= particleCount) return false;
+        }
+        return true;
+    };
+
+    for (uint64_t i = 0; i < header.generatorCount; i++) {
+        const GeneratorRecord& record = generators[i];
+        if (!validSubscribers(record.firstSubscription, record.subscriptionCount)) return nullptr;
+
+        if (record.type == GeneratorType::Spring) {
+            if (record.firstRecord > header.springCount || record.recordCount > header.springCount - record.firstRecord) return nullptr;
+
+            SpringForce* spring = world->emplaceGenerator<SpringForce>();
+            for (uint64_t s = record.firstRecord; s < record.firstRecord + record.recordCount; s++) {
+                if (springs[s].indexA >= particleCount || springs[s].indexB >= particleCount) return nullptr;
+                spring->addSpring(particles.getHandle(springs[s].indexA), particles.getHandle(springs[s].indexB),
+                    static_cast<Real>(springs[s].restLength), static_cast<Real>(springs[s].stiffness), static_cast<Real>(springs[s].damping));
+            }
+            continue;
+        }
+
+        BulkForceGenerator* generator = nullptr;
+        switch (record.type) {
+        case GeneratorType::ConstantAcceleration:
+            generator = world->emplaceGenerator<ConstantAcceleration>(
+                Vector2(static_cast<Real>(record.parameters[0]), static_cast<Real>(record.parameters[1])));
+            break;
+        case GeneratorType::Drag:
+            generator = world->emplaceGenerator<DragForce>(static_cast<Real>(record.parameters[0]));
+            break;
+        case GeneratorType::RadialAttractor:
+            generator = world->emplaceGenerator<RadialAttractor>(
+                Vector2(static_cast<Real>(record.parameters[0]), static_cast<Real>(record.parameters[1])),
+                static_cast<Real>(record.parameters[2]), static_cast<Real>(record.parameters[3]));
+            break;
+        case GeneratorType::NBodyGravity:
+            generator = world->emplaceGenerator<NBodyGravity>(static_cast<Real>(record.parameters[0]),
+                static_cast<Real>(record.parameters[1]), static_cast<Real>(record.parameters[2]));
+            break;
+        case GeneratorType::WindField: {
+            if (record.recordCount != 1 || record.firstRecord >= header.windFieldCount) return nullptr;
+
+            const WindFieldRecord& field = windFields[record.firstRecord];
+            if (field.columns == 0 || field.rows == 0 || field.columns > header.gridValueCount || field.rows > header.gridValueCount / field.columns) return nullptr;
+
+            const uint64_t points = field.columns * field.rows;
+            if (field.firstValue > header.gridValueCount || points * 2 > header.gridValueCount - field.firstValue) return nullptr;
+
+            WindField* wind = world->emplaceGenerator<WindField>(
+                Vector2(static_cast<Real>(field.origin[0]), static_cast<Real>(field.origin[1])), static_cast<Real>(field.cellSize), field.columns, field.rows);
+            std::memcpy(wind->m_forceX.data(), grid + field.firstValue, points * sizeof(Real));
+            std::memcpy(wind->m_forceY.data(), grid + field.firstValue + points, points * sizeof(Real));
+            generator = wind;
+            break;
+        }
+        default:
+            return nullptr;
+        }
+
+        if (record.flags & GENERATOR_ALL_PARTICLES) generator->subscribeAllParticles(particles);
+        for (uint64_t s = 0; s < record.subscriptionCount; s++) {
+            generator->subscribeParticle(particles.getHandle(subscriptions[record.firstSubscription + s]));
+        }
+    }
+
+    for (uint64_t i = 0; i < header.constraintCount; i++) {
+        const ConstraintRecord& record = constraints[i];
+        if (!validSubscribers(record.firstSubscription, record.subscriptionCount)) return nullptr;
+
+        Constraint* constraint = nullptr;
+        WorldPositionConstraint* positional = nullptr;
+
+        switch (record.type) {
+        case ConstraintType::BoxedPosition:
+            positional = world->emplaceConstraint<BoxedPositionConstraint>(
+                Vector2(static_cast<Real>(record.parameters[0]), static_cast<Real>(record.parameters[1])),
+                Vector2(static_cast<Real>(record.parameters[2]), static_cast<Real>(record.parameters[3])));
+            constraint = positional;
+            break;
+        case ConstraintType::EncircledPosition:
+            positional = world->emplaceConstraint<EncircledPositionConstraint>(static_cast<Real>(record.parameters[0]),
+                Vector2(static_cast<Real>(record.parameters[1]), static_cast<Real>(record.parameters[2])));
+            constraint = positional;
+            break;
+        case ConstraintType::PairedParticle:
+            if (record.indexA >= particleCount || record.indexB >= particleCount) return nullptr;
+            constraint = world->emplaceConstraint<PairedParticleConstraint>(particles.getHandle(record.indexA),
+                particles.getHandle(record.indexB), static_cast<Real>(record.parameters[0]));
+            world->m_distanceSolver.setColour(world->m_distanceSolver.getConstraints().size() - 1,
+                static_cast<uint8_t>(record.colour));
+            break;
+        default:
+            return nullptr;
+        }
+
+        if (positional) {
+            for (uint64_t s = 0; s < record.subscriptionCount; s++) {
+                positional->subscribeParticle(particles.getHandle(subscriptions[record.firstSubscription + s]));
+            }
+        }
+
+        if (!record.enabled) constraint->disable();
+    }
+
+    return world;
+}
@@ -0,0 +1,166 @@
+#pragma once
+#include "SimulationWorld.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace VerletPhysics {
+
+    /**
+     * Saves and restores the complete state of a `SimulationWorld`.
+     *
+     * A snapshot is a flat, versioned binary image laid out exactly as it is restored: a fixed size
+     * header, the particle attribute arrays in the world's `Real` type, then fixed size records for
+     * every force generator and constraint followed by one array holding all their subscribed particle
+     * indices. Wind fields and springs carry more state than fits in a generator record, so their
+     * grids and spring lists follow in sections of their own. Every section is 16-byte aligned. Loading maps the file into memory, validates the
+     * header and copies each array straight into the new world without any per-field parsing.
+     *
+     * Snapshots store native byte order and are only loaded by builds with the same `Real` type.
+     * Accumulated forces are not stored since they are always zero between updates. Saving fails
+     * for generators and constraints of types the snapshot format does not know.
+     */
+    struct WorldSnapshot
+    {
+        static constexpr uint32_t VERSION = 3; ///< Layout version written to and required from every file.
+
+        /**
+         * Fixed size header at the start of every snapshot.
+         */
+        struct Header
+        {
+            char magic[8];               ///< "VRLTSNAP".
+            uint32_t version;            ///< Layout version, `VERSION`.
+            uint32_t byteOrderMark;      ///< 0x01020304 in the byte order of the writer.
+            uint32_t realSize;           ///< Size of `Real` in bytes.
+            uint32_t handleCollisions;   ///< Non-zero if the world handles collisions.
+            uint64_t steps;              ///< Substeps per update.
+            uint64_t particleCount;      ///< Particles in the world.
+            uint64_t generatorCount;     ///< Force generator records.
+            uint64_t constraintCount;    ///< Constraint records.
+            uint64_t subscriptionCount;  ///< Entries of the subscription array.
+            uint64_t windFieldCount;     ///< Wind field records.
+            uint64_t gridValueCount;     ///< Entries of the wind grid array.
+            uint64_t springCount;        ///< Spring records.
+            uint64_t particleOffset;     ///< Offset of the particle arrays.
+            uint64_t generatorOffset;    ///< Offset of the generator records.
+            uint64_t constraintOffset;   ///< Offset of the constraint records.
+            uint64_t subscriptionOffset; ///< Offset of the subscription array.
+            uint64_t windFieldOffset;    ///< Offset of the wind field records.
+            uint64_t gridOffset;         ///< Offset of the wind grid array.
+            uint64_t springOffset;       ///< Offset of the spring records.
+            uint64_t fileSize;           ///< Total size of the snapshot.
+        };
+
+        /**
+         * Types of force generators a snapshot can hold.
+         */
+        enum class GeneratorType : uint32_t
+        {
+            ConstantAcceleration = 1,
+            Drag = 2,
+            RadialAttractor = 3,
+            NBodyGravity = 4,
+            WindField = 5,
+            Spring = 6
+        };
+
+        static constexpr uint32_t GENERATOR_ALL_PARTICLES = 1; ///< Generator flag set when it acts on every particle.
+
+        /**
+         * Types of constraints a snapshot can hold.
+         */
+        enum class ConstraintType : uint32_t
+        {
+            BoxedPosition = 1,
+            EncircledPosition = 2,
+            PairedParticle = 3
+        };
+
+        /**
+         * A force generator and the range of its subscribers in the subscription array.
+         *
+         * Wind fields refer to their one wind field record, and spring generators to the range of
+         * their springs in the spring records.
+         */
+        struct GeneratorRecord
+        {
+            GeneratorType type;
+            uint32_t flags;       ///< `GENERATOR_ALL_PARTICLES` or zero.
+            uint64_t firstSubscription;
+            uint64_t subscriptionCount;
+            uint64_t firstRecord; ///< First wind field or spring record.
+            uint64_t recordCount; ///< Wind field or spring records belonging to the generator.
+            double parameters[4]; ///< Acceleration, drag coefficient, attractor center, strength and softening, or gravitational constant, opening angle and softening.
+        };
+
+        /**
+         * The grid of a wind field and where its forces lie in the wind grid array.
+         *
+         * The grid array holds the X components of all grid points of a field row by row, followed
+         * by their Y components, in the world's `Real` type.
+         */
+        struct WindFieldRecord
+        {
+            double origin[2];    ///< Position of the first grid point.
+            double cellSize;     ///< Distance between neighbouring grid points.
+            uint64_t columns;    ///< Grid points along X.
+            uint64_t rows;       ///< Grid points along Y.
+            uint64_t firstValue; ///< First entry of the field's forces in the wind grid array.
+        };
+
+        /**
+         * One spring of a spring generator.
+         */
+        struct SpringRecord
+        {
+            uint64_t indexA;
+            uint64_t indexB;
+            double restLength;
+            double stiffness;
+            double damping;
+        };
+
+        /**
+         * A constraint, its enabled state, and its particles.
+         *
+         * Position constraints list their subscribers in the subscription array, paired particle
+         * constraints store their two endpoints directly.
+         */
+        struct ConstraintRecord
+        {
+            ConstraintType type;
+            uint32_t enabled;
+            uint32_t colour;   ///< Distance solver colour of a paired particle constraint.
+            uint32_t padding;
+            uint64_t firstSubscription;
+            uint64_t subscriptionCount;
+            uint64_t indexA;
+            uint64_t indexB;
+            double parameters[4]; ///< Box corners, circle radius and center, or maximum distance.
+        };
+
+        /**
+         * Writes a snapshot of a world to a file.
+         *
+         * @param world The world to save. Should be saved between updates.
+         * @param path Path of the file to create or overwrite.
+         * @return True if the snapshot was written, false if the file could not be written or the
+         *         world holds a generator or constraint the format cannot represent.
+         */
+        static bool save(const SimulationWorld& world, const std::string& path);
+
+        /**
+         * Restores a world from a snapshot file.
+         *
+         * The restored world owns the generators and constraints it recreates.
+         *
+         * @param path Path of the snapshot to load.
+         * @param threadCount Number of threads the restored world simulates with.
+         * @return The restored world, or null if the file is missing, truncated or incompatible.
+         */
+        static std::unique_ptr<SimulationWorld> load(const std::string& path, size_t threadCount = 1);
+    };
+}